@@ -0,0 +1,34 @@
+#ifndef ARDUINO_HAL_H
+#define ARDUINO_HAL_H
+
+#include <Arduino.h>
+#include <ESP32Servo.h>
+#include <esp_timer.h>
+#include "Hal.h"
+
+// Clock backed by the Arduino core
+class ArduinoClock : public Clock {
+public:
+    uint32_t millis() override { return ::millis(); }
+    uint32_t micros() override { return ::micros(); }
+    uint64_t micros64() override { return (uint64_t)esp_timer_get_time(); }
+    void delay(uint32_t ms) override { ::delay(ms); }
+};
+
+// PwmOutput backed by ESP32Servo (50 Hz LEDC)
+class ServoPwmOutput : public PwmOutput {
+public:
+    explicit ServoPwmOutput(int pin) : pin(pin) {}
+
+    bool attach(int minPulseUs, int maxPulseUs) override {
+        servo.attach(pin, minPulseUs, maxPulseUs);
+        return servo.attached();
+    }
+    void writeMicroseconds(int pulseUs) override { servo.writeMicroseconds(pulseUs); }
+
+private:
+    Servo servo;
+    int pin;
+};
+
+#endif // ARDUINO_HAL_H
@@ -0,0 +1,343 @@
+#include "BatchUploader.h"
+#include "UploadJson.h"
+
+// Print into a spool record, for writing batches to flash
+class SinkPrint : public Print {
+public:
+    explicit SinkPrint(ByteSink& sink) : sink(sink) {}
+
+    size_t write(uint8_t value) override {
+        return write(&value, 1);
+    }
+    size_t write(const uint8_t* buffer, size_t size) override {
+        return sink.put(buffer, size) ? size : 0;
+    }
+
+private:
+    ByteSink& sink;
+};
+
+// Spooled bytes into a request body, for replaying them
+class PrintSink : public ByteSink {
+public:
+    explicit PrintSink(Print& out) : out(out) {}
+
+    bool put(const uint8_t* data, size_t length) override {
+        return out.write(data, length) == length;
+    }
+
+private:
+    Print& out;
+};
+
+BatchUploader::BatchUploader()
+    : freeQueue(nullptr), pendingQueue(nullptr), body(nullptr), jsonPicker(COMPRESSION_SEED_JSON),
+      binaryPicker(COMPRESSION_SEED_BINARY), urlValid(false), lastBodyBytes(0), pendingCount(0),
+      spool(nullptr), sentBatches(0), failedBatches(0), retries(0), lastRoundTripMs(0),
+      spooledBatches(0), replayedBatches(0), rawBytes(0), sentBytes(0), lastLevel(0),
+      uplinkBytesPerMs(COMPRESSION_UPLINK_SEED) {
+}
+
+void BatchUploader::setCompression(uint8_t level) {
+    jsonPicker.setLevel(level);
+    binaryPicker.setLevel(level);
+}
+
+bool BatchUploader::begin(const char* baseUrl, UBaseType_t priority, BaseType_t core) {
+    urlValid = http.setBaseUrl(baseUrl);
+    if (!urlValid && strlen(baseUrl) > 0) {
+        Serial.printf("Uploader: unsupported data URL %s\n", baseUrl);
+    }
+
+    freeQueue = xQueueCreate(UPLOAD_BATCH_COUNT, sizeof(SampleBatch*));
+    pendingQueue = xQueueCreate(UPLOAD_BATCH_COUNT, sizeof(SampleBatch*));
+    if (freeQueue == nullptr || pendingQueue == nullptr) {
+        return false;
+    }
+
+    for (size_t i = 0; i < UPLOAD_BATCH_COUNT; i++) {
+        SampleBatch* batch = &batches[i];
+        xQueueSend(freeQueue, &batch, 0);
+    }
+
+    return xTaskCreatePinnedToCore(taskEntry, "uploader", 8192, this, priority, nullptr, core) == pdPASS;
+}
+
+SampleBatch* BatchUploader::acquire(const char* testId, TelemetryFormat format) {
+    SampleBatch* batch = nullptr;
+    if (freeQueue == nullptr || xQueueReceive(freeQueue, &batch, 0) != pdTRUE) {
+        return nullptr;
+    }
+
+    strncpy(batch->testId, testId, sizeof(batch->testId) - 1);
+    batch->testId[sizeof(batch->testId) - 1] = '\0';
+    batch->format = format;
+    batch->loadCellReady = false;
+    batch->droppedSamples = 0;
+    batch->overwrittenSamples = 0;
+    batch->count = 0;
+    batch->summaryCount = 0;
+    return batch;
+}
+
+void BatchUploader::submit(SampleBatch* batch) {
+    if (batch == nullptr) {
+        return;
+    }
+    if (batch->empty()) {
+        // Nothing to send, hand it straight back
+        xQueueSend(freeQueue, &batch, 0);
+        return;
+    }
+    pendingCount++;
+    xQueueSend(pendingQueue, &batch, portMAX_DELAY);
+}
+
+size_t BatchUploader::pending() const {
+    return pendingCount;
+}
+
+void BatchUploader::taskEntry(void* parameter) {
+    static_cast<BatchUploader*>(parameter)->run();
+}
+
+void BatchUploader::run() {
+    for (;;) {
+        // Wake up periodically while there is spooled data to replay
+        TickType_t wait = (spool != nullptr && spool->hasPending()) ? pdMS_TO_TICKS(SPOOL_REPLAY_INTERVAL_MS)
+                                                                    : portMAX_DELAY;
+        SampleBatch* batch = nullptr;
+        if (xQueueReceive(pendingQueue, &batch, wait) == pdTRUE) {
+            if (!upload(*batch) && !spoolBatch(*batch)) {
+                failedBatches++;
+                Serial.printf("Uploader: dropping batch of %u samples, %u step summaries\n",
+                              (unsigned)batch->count, (unsigned)batch->summaryCount);
+            }
+
+            pendingCount--;
+            xQueueSend(freeQueue, &batch, portMAX_DELAY);
+        }
+
+        // Live batches always go first; replay fills the gaps between them
+        if (retry.replayDue(millis(), uxQueueMessagesWaiting(pendingQueue) > 0)) {
+            replayOne();
+        }
+    }
+}
+
+bool BatchUploader::upload(SampleBatch& batch) {
+    if (!urlValid) {
+        return false;
+    }
+
+    // With a spool to fall back on, don't hold batches up while the uplink is down
+    uint8_t maxAttempts = retry.attempts(millis());
+    if (maxAttempts == 0) {
+        return false;
+    }
+
+    for (uint8_t attempt = 1; attempt <= maxAttempts; attempt++) {
+        unsigned long start = millis();
+        int httpResponseCode = post(batch);
+
+        if (httpResponseCode > 0 && httpResponseCode < 500) {
+            lastRoundTripMs = millis() - start;
+            sentBatches++;
+            retry.succeeded();
+            // Heap figures let batch size be tuned against peak RAM on the device
+            Serial.printf("Uploader: sent %u samples, %u step summaries (%u bytes, gzip level %u from %u), "
+                          "response %d in %lums, free heap %u, low-water %u\n",
+                          (unsigned)batch.count, (unsigned)batch.summaryCount, (unsigned)lastBodyBytes,
+                          (unsigned)lastLevel, (unsigned)gzip.getInputBytes(), httpResponseCode,
+                          (unsigned long)lastRoundTripMs, ESP.getFreeHeap(), ESP.getMinFreeHeap());
+            return true;
+        }
+
+        Serial.printf("Uploader: attempt %u failed: %d (%s)\n", attempt, httpResponseCode,
+                      HTTPClient::errorToString(httpResponseCode).c_str());
+        if (!retry.retryAfter(attempt, maxAttempts, uxQueueMessagesWaiting(pendingQueue) > 0)) {
+            break;
+        }
+
+        retries++;
+        vTaskDelay(pdMS_TO_TICKS(UploadRetry::backoffMs(attempt)));
+    }
+
+    retry.failed(millis());
+    return false;
+}
+
+bool BatchUploader::spoolBatch(SampleBatch& batch) {
+    if (spool == nullptr) {
+        return false;
+    }
+
+    // Spooled batches are always stored as binary frames
+    bool stored = spool->append(SPOOL_FLAG_TELEMETRY_FRAME, [this, &batch](ByteSink& sink) {
+        SinkPrint out(sink);
+        writeBinary(out, batch);
+    });
+    if (stored) {
+        spooledBatches++;
+        Serial.printf("Uploader: spooled %u samples to flash\n", (unsigned)batch.count);
+    }
+    return stored;
+}
+
+bool BatchUploader::replayOne() {
+    if (spool == nullptr || retry.isDown() || !urlValid) {
+        return false;
+    }
+
+    SpoolRecordInfo info;
+    if (!spool->peek(info)) {
+        return false;
+    }
+
+    // The frame header carries the test ID needed for the URL
+    uint8_t prefix[TELEMETRY_MAX_HEADER_BYTES];
+    size_t prefixLength = spool->readPayload(info, prefix, sizeof(prefix));
+    TelemetryDecoder decoder(prefix, prefixLength);
+    TelemetryHeader header;
+    if ((info.header.flags & SPOOL_FLAG_TELEMETRY_FRAME) == 0 || !decoder.readHeader(header)) {
+        Serial.printf("Uploader: skipping unreadable spool record\n");
+        spool->consume(info);
+        return false;
+    }
+
+    // Stream the stored frame from flash straight into the request body
+    int httpResponseCode;
+    Print* out = beginBody(header.testId, TELEMETRY_CONTENT_TYPE, binaryPicker);
+    if (out == nullptr) {
+        httpResponseCode = HTTPC_ERROR_CONNECTION_REFUSED;
+    } else {
+        PrintSink sink(*out);
+        if (!spool->copyPayload(info, sink)) {
+            http.stop();
+            httpResponseCode = HTTPC_ERROR_SEND_PAYLOAD_FAILED;
+        } else {
+            httpResponseCode = finishBody(binaryPicker);
+        }
+    }
+
+    if (httpResponseCode > 0 && httpResponseCode < 500) {
+        spool->consume(info);
+        replayedBatches++;
+        Serial.printf("Uploader: replayed %u spooled samples for %s, response %d\n",
+                      (unsigned)header.sampleCount, header.testId, httpResponseCode);
+        return true;
+    }
+
+    retry.failed(millis());
+    return false;
+}
+
+int BatchUploader::post(const SampleBatch& batch) {
+    bool binary = batch.format == TelemetryFormat::Binary;
+    CompressionPicker& picker = binary ? binaryPicker : jsonPicker;
+    Print* out = beginBody(batch.testId, binary ? TELEMETRY_CONTENT_TYPE : "application/json", picker);
+    if (out == nullptr) {
+        return HTTPC_ERROR_CONNECTION_REFUSED;
+    }
+
+    if (binary) {
+        writeBinary(*out, batch);
+    } else {
+        writeJson(*out, batch);
+    }
+    return finishBody(picker);
+}
+
+Print* BatchUploader::beginBody(const char* testId, const char* contentType, CompressionPicker& picker) {
+    uint8_t level = picker.pick();
+    body = http.beginPost(testId, contentType, level > 0 ? "gzip" : nullptr);
+    if (body == nullptr) {
+        return nullptr;
+    }
+    lastLevel = level;
+    gzip.begin(*body, level);
+    return &gzip;
+}
+
+int BatchUploader::finishBody(CompressionPicker& picker) {
+    if (!gzip.finish()) {
+        http.stop();
+        return HTTPC_ERROR_SEND_PAYLOAD_FAILED;
+    }
+    lastBodyBytes = body->getBodyBytes();
+
+    // Socket time is the writes made while encoding plus sending the last
+    // chunk and waiting for the response; together they measure the uplink
+    uint32_t start = micros();
+    int status = http.finishPost();
+    if (status > 0 && status < 500) {
+        picker.record(lastLevel, gzip.getInputBytes(), (uint32_t)lastBodyBytes, gzip.getCompressMicros(),
+                      gzip.getSinkMicros() + (micros() - start));
+        rawBytes += gzip.getInputBytes();
+        sentBytes += (uint32_t)lastBodyBytes;
+        uplinkBytesPerMs = picker.getUplinkBytesPerMs();
+    }
+    return status;
+}
+
+void BatchUploader::writeJson(Print& out, const SampleBatch& batch) {
+    // Same document shape the ArduinoJson version produced, one sample at a time
+    char line[UPLOAD_JSON_LINE_SIZE];
+
+    snprintf(line, sizeof(line), "{\"dropped\":%u,\"overwritten\":%u,\"data\":[",
+             (unsigned)batch.droppedSamples, (unsigned)batch.overwrittenSamples);
+    out.print(line);
+    for (size_t i = 0; i < batch.count; i++) {
+        size_t n = formatJsonSample(line, sizeof(line), batch.samples[i], batch.loadCellReady, i == 0);
+        out.write((const uint8_t*)line, n);
+    }
+    out.print("]");
+
+    // Per-step statistics, present when the test produced any in this batch
+    if (batch.summaryCount > 0) {
+        out.print(",\"steps\":[");
+        for (size_t i = 0; i < batch.summaryCount; i++) {
+            const StepSummary& summary = batch.summaries[i];
+            int n = snprintf(line, sizeof(line),
+                             "%s{\"channel\":%u,\"step\":%u,\"speed\":%.4f,\"start_ms\":%lu,\"duration_ms\":%lu,"
+                             "\"samples\":%lu,\"grams_per_watt\":%.3f",
+                             i == 0 ? "" : ",", (unsigned)summary.channel, (unsigned)summary.step, summary.speed,
+                             (unsigned long)summary.startMs, (unsigned long)summary.durationMs,
+                             (unsigned long)summary.samples, summary.gramsPerWatt);
+            out.write((const uint8_t*)line, min((size_t)n, sizeof(line) - 1));
+            writeJsonChannel(out, "thrust_g", summary.thrust);
+            writeJsonChannel(out, "voltage_v", summary.voltage);
+            writeJsonChannel(out, "current_ma", summary.current);
+            writeJsonChannel(out, "power_w", summary.power);
+            out.print("}");
+        }
+        out.print("]");
+    }
+    out.print("}");
+}
+
+void BatchUploader::writeJsonChannel(Print& out, const char* name, const ChannelSummary& channel) {
+    char line[192];
+    int n = snprintf(line, sizeof(line),
+                     ",\"%s\":{\"mean\":%.4f,\"stddev\":%.4f,\"min\":%.4f,\"max\":%.4f,\"p50\":%.4f,\"p95\":%.4f}",
+                     name, channel.mean, channel.stddev, channel.min, channel.max, channel.p50, channel.p95);
+    out.write((const uint8_t*)line, min((size_t)n, sizeof(line) - 1));
+}
+
+void BatchUploader::writeBinary(Print& out, const SampleBatch& batch) {
+    // Compact frame, see TelemetryFrame.h for the layout
+    TelemetryEncoder encoder;
+    uint8_t scratch[TELEMETRY_MAX_HEADER_BYTES];
+    uint64_t baseTimestampUs = batch.count > 0 ? batch.samples[0].timestamp_us : 0;
+    uint8_t flags = batch.loadCellReady ? TELEMETRY_FLAG_LOAD_CELL_READY : 0;
+
+    out.write(scratch, encoder.encodeHeader(scratch, batch.testId, baseTimestampUs, (uint32_t)batch.count, flags,
+                                            batch.droppedSamples, batch.overwrittenSamples,
+                                            (uint32_t)batch.summaryCount));
+    for (size_t i = 0; i < batch.count; i++) {
+        out.write(scratch, encoder.encodeSample(scratch, batch.samples[i]));
+    }
+    for (size_t i = 0; i < batch.summaryCount; i++) {
+        out.write(scratch, encoder.encodeSummary(scratch, batch.summaries[i]));
+    }
+}
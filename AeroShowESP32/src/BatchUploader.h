@@ -0,0 +1,129 @@
+#ifndef BATCH_UPLOADER_H
+#define BATCH_UPLOADER_H
+
+#include <Arduino.h>
+#include <atomic>
+#include "SensorData.h"
+#include "TelemetryFrame.h"
+#include "HttpUploadClient.h"
+#include "SpoolStore.h"
+#include "GzipWriter.h"
+#include "UploadCompression.h"
+#include "UploadRetry.h"
+
+// Samples per upload batch and number of batch buffers in rotation. The
+// batches are static and the largest buffers in RAM: each costs
+// UPLOAD_BATCH_CAPACITY * sizeof(SensorData) bytes of samples (12 KB) plus
+// its summaries, about 13 KB, and all of them must fit
+// UPLOAD_BATCH_RAM_BUDGET. 256 samples take 256 ms to fill on one channel
+// at 1 kHz, longer than a post at 200 ms round trip; three batches let one
+// fill while one is in flight and one waits out a retry.
+const size_t UPLOAD_BATCH_RAM_BUDGET = 40 * 1024;
+const size_t UPLOAD_BATCH_CAPACITY = 256;
+const size_t UPLOAD_BATCH_COUNT = 3;
+
+// Step summaries a batch can carry alongside (or instead of) its samples
+const size_t UPLOAD_BATCH_SUMMARIES = 8;
+
+// A fixed-size batch of samples plus everything needed to post it
+struct SampleBatch {
+    char testId[64];
+    TelemetryFormat format;
+    bool loadCellReady;
+    uint32_t droppedSamples;      // Ring overflow totals for the test when the batch was closed
+    uint32_t overwrittenSamples;
+    size_t count;
+    SensorData samples[UPLOAD_BATCH_CAPACITY];
+    size_t summaryCount;
+    StepSummary summaries[UPLOAD_BATCH_SUMMARIES];
+
+    bool full() const { return count >= UPLOAD_BATCH_CAPACITY || summaryCount >= UPLOAD_BATCH_SUMMARIES; }
+    bool empty() const { return count == 0 && summaryCount == 0; }
+};
+
+static_assert(UPLOAD_BATCH_COUNT * sizeof(SampleBatch) <= UPLOAD_BATCH_RAM_BUDGET,
+              "Upload batches must fit UPLOAD_BATCH_RAM_BUDGET");
+
+// Background uploader. The producer fills one batch while earlier batches are
+// posted from a separate task over a single keep-alive connection. Batches
+// are serialized sample by sample into a chunked request body, gzipped on
+// the way out (Content-Encoding: gzip) at a level picked per batch from the
+// measured uplink throughput unless a fixed level is set.
+class BatchUploader {
+public:
+    BatchUploader();
+
+    // Start the upload task; baseUrl gets the test ID appended per batch
+    bool begin(const char* baseUrl, UBaseType_t priority, BaseType_t core);
+
+    // Enable store-and-forward of failed batches (call before begin())
+    void setSpool(SpoolStore* store) {
+        spool = store;
+        retry.setSpooling(store != nullptr);
+    }
+
+    // Fixed gzip level (0 sends bodies unencoded) or COMPRESSION_AUTO, the default
+    void setCompression(uint8_t level);
+
+    // Producer side: take an empty batch, or nullptr if every batch is busy
+    SampleBatch* acquire(const char* testId, TelemetryFormat format);
+
+    // Producer side: queue a filled batch for upload (ownership passes to the task)
+    void submit(SampleBatch* batch);
+
+    // Batches waiting for or in upload
+    size_t pending() const;
+
+    // Counters for status reporting
+    uint32_t getSentBatches() const { return sentBatches; }
+    uint32_t getFailedBatches() const { return failedBatches; }
+    uint32_t getRetries() const { return retries; }
+    uint32_t getLastRoundTripMs() const { return lastRoundTripMs; }
+    uint32_t getSpooledBatches() const { return spooledBatches; }
+    uint32_t getReplayedBatches() const { return replayedBatches; }
+    uint32_t getRawBytes() const { return rawBytes; }
+    uint32_t getSentBytes() const { return sentBytes; }
+    uint8_t getLastLevel() const { return lastLevel; }
+    float getUplinkBytesPerMs() const { return uplinkBytesPerMs; }
+    bool isUplinkDown() const { return retry.isDown(); }
+
+private:
+    static void taskEntry(void* parameter);
+    void run();
+    bool upload(SampleBatch& batch);
+    bool spoolBatch(SampleBatch& batch);
+    bool replayOne();
+    int post(const SampleBatch& batch);
+    Print* beginBody(const char* testId, const char* contentType, CompressionPicker& picker);
+    int finishBody(CompressionPicker& picker);
+    void writeJson(Print& out, const SampleBatch& batch);
+    void writeBinary(Print& out, const SampleBatch& batch);
+    void writeJsonChannel(Print& out, const char* name, const ChannelSummary& channel);
+
+    SampleBatch batches[UPLOAD_BATCH_COUNT];
+    QueueHandle_t freeQueue;     // Empty batches for the producer
+    QueueHandle_t pendingQueue;  // Filled batches for the upload task
+    HttpUploadClient http;
+    ChunkedWriter* body;  // Request body in progress
+    GzipWriter gzip;
+    CompressionPicker jsonPicker;    // Estimates kept per format, the two compress very differently
+    CompressionPicker binaryPicker;
+    bool urlValid;
+    size_t lastBodyBytes;
+    std::atomic<size_t> pendingCount;
+    SpoolStore* spool;
+    UploadRetry retry;
+
+    volatile uint32_t sentBatches;
+    volatile uint32_t failedBatches;
+    volatile uint32_t retries;
+    volatile uint32_t lastRoundTripMs;
+    volatile uint32_t spooledBatches;
+    volatile uint32_t replayedBatches;
+    volatile uint32_t rawBytes;   // Body bytes before and after encoding, successful posts only
+    volatile uint32_t sentBytes;
+    volatile uint8_t lastLevel;
+    volatile float uplinkBytesPerMs;
+};
+
+#endif // BATCH_UPLOADER_H
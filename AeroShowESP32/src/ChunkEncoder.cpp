@@ -0,0 +1,63 @@
+#include "ChunkEncoder.h"
+#include <stdio.h>
+#include <string.h>
+
+ChunkEncoder::ChunkEncoder()
+    : sink(nullptr), used(0), bodyBytes(0), failed(false) {
+}
+
+void ChunkEncoder::begin(ByteSink* target) {
+    sink = target;
+    used = 0;
+    bodyBytes = 0;
+    failed = (target == nullptr);
+}
+
+size_t ChunkEncoder::write(const uint8_t* data, size_t size) {
+    if (failed) {
+        return 0;
+    }
+
+    size_t remaining = size;
+    while (remaining > 0) {
+        size_t space = CHUNK_SCRATCH_SIZE - used;
+        size_t n = remaining < space ? remaining : space;
+        memcpy(scratch + used, data, n);
+        used += n;
+        data += n;
+        remaining -= n;
+
+        if (used == CHUNK_SCRATCH_SIZE && !flushChunk()) {
+            return size - remaining;
+        }
+    }
+
+    bodyBytes += size;
+    return size;
+}
+
+bool ChunkEncoder::finish() {
+    if (failed) {
+        return false;
+    }
+    if (used > 0 && !flushChunk()) {
+        return false;
+    }
+    static const uint8_t lastChunk[] = {'0', '\r', '\n', '\r', '\n'};
+    return put(lastChunk, sizeof(lastChunk));
+}
+
+bool ChunkEncoder::flushChunk() {
+    char header[12];
+    int headerLength = snprintf(header, sizeof(header), "%X\r\n", (unsigned)used);
+    bool ok = put((const uint8_t*)header, headerLength) &&
+              put(scratch, used) &&
+              put((const uint8_t*)"\r\n", 2);
+    used = 0;
+    return ok;
+}
+
+bool ChunkEncoder::put(const uint8_t* data, size_t size) {
+    failed = failed || !sink->put(data, size);
+    return !failed;
+}
@@ -0,0 +1,45 @@
+#ifndef CHUNK_ENCODER_H
+#define CHUNK_ENCODER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "GzipEncoder.h"
+
+// Scratch buffer size; each full buffer goes out as one HTTP chunk
+const size_t CHUNK_SCRATCH_SIZE = 512;
+
+// HTTP/1.1 chunked transfer encoding of a request body into a ByteSink
+// through one fixed scratch buffer, so a body of any size costs
+// CHUNK_SCRATCH_SIZE bytes of RAM and never touches the heap. Free of
+// Arduino calls, so bodies can be checked on the host.
+class ChunkEncoder {
+public:
+    ChunkEncoder();
+
+    // Start a new body; a null sink fails every write
+    void begin(ByteSink* target);
+
+    // Returns the bytes accepted, fewer than size once the sink has refused some
+    size_t write(const uint8_t* data, size_t size);
+
+    // Send any buffered data followed by the terminating zero-length chunk
+    bool finish();
+
+    // True once the sink has refused bytes; further writes are discarded
+    bool hasError() const { return failed; }
+
+    // Body bytes accepted since begin()
+    size_t getBodyBytes() const { return bodyBytes; }
+
+private:
+    bool flushChunk();
+    bool put(const uint8_t* data, size_t size);
+
+    ByteSink* sink;
+    uint8_t scratch[CHUNK_SCRATCH_SIZE];
+    size_t used;
+    size_t bodyBytes;
+    bool failed;
+};
+
+#endif // CHUNK_ENCODER_H
@@ -0,0 +1,29 @@
+#include "ChunkedWriter.h"
+
+ChunkedWriter::ChunkedWriter() : client(nullptr) {
+}
+
+void ChunkedWriter::begin(Client* target) {
+    client = target;
+    encoder.begin(target != nullptr ? this : nullptr);
+}
+
+size_t ChunkedWriter::write(uint8_t value) {
+    return write(&value, 1);
+}
+
+size_t ChunkedWriter::write(const uint8_t* buffer, size_t size) {
+    return encoder.write(buffer, size);
+}
+
+bool ChunkedWriter::put(const uint8_t* data, size_t length) {
+    while (length > 0) {
+        size_t written = client->write(data, length);
+        if (written == 0) {
+            return false;
+        }
+        data += written;
+        length -= written;
+    }
+    return true;
+}
@@ -0,0 +1,36 @@
+#ifndef CHUNKED_WRITER_H
+#define CHUNKED_WRITER_H
+
+#include <Arduino.h>
+#include <Client.h>
+#include "ChunkEncoder.h"
+
+// Print adapter that streams an HTTP/1.1 request body to a client using
+// chunked transfer encoding, so the body never has to exist in RAM at once.
+class ChunkedWriter : public Print, private ByteSink {
+public:
+    ChunkedWriter();
+
+    // Start a new body on the given client
+    void begin(Client* target);
+
+    size_t write(uint8_t value) override;
+    size_t write(const uint8_t* buffer, size_t size) override;
+
+    // Send any buffered data followed by the terminating zero-length chunk
+    bool finish() { return encoder.finish(); }
+
+    // True once a socket write has failed; further writes are discarded
+    bool hasError() const { return encoder.hasError(); }
+
+    // Body bytes accepted since begin()
+    size_t getBodyBytes() const { return encoder.getBodyBytes(); }
+
+private:
+    bool put(const uint8_t* data, size_t length) override;
+
+    Client* client;
+    ChunkEncoder encoder;
+};
+
+#endif // CHUNKED_WRITER_H
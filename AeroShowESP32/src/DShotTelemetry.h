@@ -0,0 +1,210 @@
+#ifndef DSHOT_TELEMETRY_H
+#define DSHOT_TELEMETRY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include "EscProtocol.h"
+
+// Bidirectional DShot eRPM replies. After each (inverted) frame the ESC
+// answers on the same wire at 5/4 of the frame bit rate with 21 bits: a
+// start edge plus 20 GCR bits, where a 1 is a level change. The GCR
+// decodes to 16 bits: a 12-bit period (eee mmmmmmmmm, period = m << e us
+// per electrical revolution) and a 4-bit inverted checksum. Pure code, so
+// captured waveforms can be decoded on the host.
+
+const int DSHOT_REPLY_BITS = 21;
+
+// Reply value meaning the motor is stopped (the longest period)
+const uint16_t DSHOT_REPLY_STOPPED = 0x0FFF;
+
+// One stretch of constant line level as captured by the receiver
+struct DShotRun {
+    uint8_t level;
+    uint16_t ticks;
+};
+
+enum class DShotReplyStatus : uint8_t {
+    Ok,
+    Framing,  // Wrong bit count, or the reply did not start with a falling edge
+    Gcr,      // A 5-bit group outside the GCR code
+    Checksum
+};
+
+// Reply bit period in ns: 4/5 of the frame bit period
+inline uint32_t dshotReplyBitNs(EscProtocol protocol) {
+    return dshotBitNs(protocol) * 4 / 5;
+}
+
+inline uint32_t dshotReplyBitTicks(EscProtocol protocol, uint32_t ticksPerUs) {
+    return (dshotReplyBitNs(protocol) * ticksPerUs + 500) / 1000;
+}
+
+// 5-bit GCR code for each nibble
+static const uint8_t DSHOT_GCR_ENCODE[16] = {
+    0x19, 0x1B, 0x12, 0x13, 0x1D, 0x15, 0x16, 0x17, 0x1A, 0x09, 0x0A, 0x0B, 0x1E, 0x0D, 0x0E, 0x0F,
+};
+
+// Nibble for a GCR code, 0xFF for codes outside the table
+inline uint8_t dshotGcrDecode(uint8_t code) {
+    for (uint8_t nibble = 0; nibble < 16; nibble++) {
+        if (DSHOT_GCR_ENCODE[nibble] == code) {
+            return nibble;
+        }
+    }
+    return 0xFF;
+}
+
+// 16-bit reply word for a 12-bit value, with its inverted checksum
+inline uint16_t dshotReplyWord(uint16_t value) {
+    value &= 0x0FFF;
+    uint16_t crc = (uint16_t)(~(value ^ (value >> 4) ^ (value >> 8)) & 0x0F);
+    return (uint16_t)((value << 4) | crc);
+}
+
+// Decode captured runs. The idle-high tail of the reply is never captured,
+// so a short last run is inferred from the bit count. Zero-length runs
+// (end markers) are skipped.
+inline DShotReplyStatus dshotDecodeReply(const DShotRun* runs, size_t count, uint32_t bitTicks, uint16_t& value) {
+    if (bitTicks == 0) {
+        return DShotReplyStatus::Framing;
+    }
+
+    uint32_t gcr = 0;  // 1 where a run starts, i.e. at each level change
+    int bits = 0;
+    int expectedLevel = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (runs[i].ticks == 0) {
+            continue;
+        }
+        if (runs[i].level != expectedLevel) {
+            return DShotReplyStatus::Framing;
+        }
+        int length = (int)((runs[i].ticks + bitTicks / 2) / bitTicks);
+        if (length == 0) {
+            length = 1;
+        }
+        bits += length;
+        if (bits > DSHOT_REPLY_BITS) {
+            return DShotReplyStatus::Framing;
+        }
+        gcr = (gcr << length) | (1u << (length - 1));
+        expectedLevel ^= 1;
+    }
+    if (bits == 0) {
+        return DShotReplyStatus::Framing;
+    }
+    int missing = DSHOT_REPLY_BITS - bits;
+    if (missing > 0) {
+        // Only a high run can merge into the idle line
+        if (expectedLevel != 1) {
+            return DShotReplyStatus::Framing;
+        }
+        gcr = (gcr << missing) | (1u << (missing - 1));
+    }
+
+    uint16_t word = 0;
+    for (int group = 3; group >= 0; group--) {
+        uint8_t nibble = dshotGcrDecode((uint8_t)((gcr >> (5 * group)) & 0x1F));
+        if (nibble == 0xFF) {
+            return DShotReplyStatus::Gcr;
+        }
+        word = (uint16_t)((word << 4) | nibble);
+    }
+
+    uint16_t sum = (uint16_t)(word ^ (word >> 4) ^ (word >> 8) ^ (word >> 12));
+    if ((sum & 0x0F) != 0x0F) {
+        return DShotReplyStatus::Checksum;
+    }
+    value = (uint16_t)(word >> 4);
+    return DShotReplyStatus::Ok;
+}
+
+// Runs the ESC puts on the wire for 21 GCR bits (start bit first), as the
+// receiver records them: the final high run merges into idle. GCR never
+// has more than two zeros in a row, so no run is longer than three bits. Returns the
+// run count, at most DSHOT_REPLY_BITS.
+inline size_t dshotGcrRuns(uint32_t gcr, uint32_t bitTicks, DShotRun* runs) {
+    size_t count = 0;
+    uint8_t level = 1;
+    for (int bit = DSHOT_REPLY_BITS - 1; bit >= 0; bit--) {
+        if ((gcr >> bit) & 1) {
+            level ^= 1;
+            runs[count].level = level;
+            runs[count].ticks = 0;
+            count++;
+        }
+        runs[count - 1].ticks = (uint16_t)(runs[count - 1].ticks + bitTicks);
+    }
+    if (runs[count - 1].level == 1) {
+        count--;
+    }
+    return count;
+}
+
+// Runs for a reply word (the ESC side of the encoding)
+inline size_t dshotEncodeReply(uint16_t word, uint32_t bitTicks, DShotRun* runs) {
+    uint32_t gcr = 1;  // Start bit
+    for (int shift = 12; shift >= 0; shift -= 4) {
+        gcr = (gcr << 5) | DSHOT_GCR_ENCODE[(word >> shift) & 0x0F];
+    }
+    return dshotGcrRuns(gcr, bitTicks, runs);
+}
+
+// Reply value for a period in us (the ESC side of the encoding)
+inline uint16_t dshotReplyValueForPeriod(uint32_t periodUs) {
+    for (uint16_t exponent = 0; exponent < 8; exponent++) {
+        if ((periodUs >> exponent) < 512) {
+            return (uint16_t)((exponent << 9) | (periodUs >> exponent));
+        }
+    }
+    return DSHOT_REPLY_STOPPED;
+}
+
+// Mechanical RPM from a reply value; 0 when stopped
+inline float dshotReplyRpm(uint16_t value, uint8_t polePairs) {
+    uint32_t periodUs = (uint32_t)(value & 0x1FF) << (value >> 9);
+    if (value == DSHOT_REPLY_STOPPED || periodUs == 0 || polePairs == 0) {
+        return 0.0f;
+    }
+    return 60000000.0f / (float)periodUs / (float)polePairs;
+}
+
+// Reply accounting. Written by the task that decodes, read from anywhere.
+class DShotReplyStats {
+public:
+    void record(DShotReplyStatus status) {
+        switch (status) {
+        case DShotReplyStatus::Ok:
+            decoded.fetch_add(1, std::memory_order_relaxed);
+            break;
+        case DShotReplyStatus::Framing:
+            framingErrors.fetch_add(1, std::memory_order_relaxed);
+            break;
+        case DShotReplyStatus::Gcr:
+            gcrErrors.fetch_add(1, std::memory_order_relaxed);
+            break;
+        case DShotReplyStatus::Checksum:
+            checksumErrors.fetch_add(1, std::memory_order_relaxed);
+            break;
+        }
+    }
+
+    // A frame went out and nothing came back before the next one
+    void recordMissing() { missing.fetch_add(1, std::memory_order_relaxed); }
+
+    uint32_t getDecoded() const { return decoded.load(std::memory_order_relaxed); }
+    uint32_t getMissing() const { return missing.load(std::memory_order_relaxed); }
+    uint32_t getFramingErrors() const { return framingErrors.load(std::memory_order_relaxed); }
+    uint32_t getGcrErrors() const { return gcrErrors.load(std::memory_order_relaxed); }
+    uint32_t getChecksumErrors() const { return checksumErrors.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint32_t> decoded{0};
+    std::atomic<uint32_t> missing{0};
+    std::atomic<uint32_t> framingErrors{0};
+    std::atomic<uint32_t> gcrErrors{0};
+    std::atomic<uint32_t> checksumErrors{0};
+};
+
+#endif // DSHOT_TELEMETRY_H
@@ -0,0 +1,144 @@
+#ifndef DISPLAY_PAGES_H
+#define DISPLAY_PAGES_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "I2CBus.h"
+
+// Longest a single panel write may hold the I2C bus. At the default 1 kHz
+// sample rate the INA260 reads on the same bus must not wait half a period.
+const uint32_t DISPLAY_BUS_HOLD_US = 500;
+
+// Pixel bytes per I2C transaction never exceed this (Wire buffers 128
+// bytes, control byte included)
+const size_t DISPLAY_MAX_CHUNK = 64;
+
+// SSD1306 control bytes and addressing commands
+const uint8_t SSD1306_CONTROL_COMMANDS = 0x00;
+const uint8_t SSD1306_CONTROL_DATA = 0x40;
+const uint8_t SSD1306_CMD_COLUMN_ADDRESS = 0x21;
+const uint8_t SSD1306_CMD_PAGE_ADDRESS = 0x22;
+
+// Pixel bytes per transaction that keep it within holdUs at clockHz: a
+// transfer of n bytes takes i2cTransferBits(n), and one is the control byte
+inline size_t displayChunkBytes(uint32_t clockHz, uint32_t holdUs) {
+    uint64_t bits = (uint64_t)holdUs * clockHz / 1000000;
+    size_t transfer = bits > 11 ? (size_t)((bits - 11) / 9) : 0;
+    size_t chunk = transfer > 1 ? transfer - 1 : 1;
+    return chunk < DISPLAY_MAX_CHUNK ? chunk : DISPLAY_MAX_CHUNK;
+}
+
+// Receives the parts of a page-organised framebuffer (SSD1306 layout: one
+// byte per column per 8-pixel page) that changed since the last flush
+class PageSink {
+public:
+    virtual ~PageSink() {}
+
+    // Send length bytes of page, starting at firstColumn
+    virtual bool sendPage(uint8_t page, uint8_t firstColumn, const uint8_t* data, size_t length) = 0;
+};
+
+// Keeps a copy of what the panel is showing and, on each flush, sends only
+// the changed column span of each changed page. Free of Arduino calls so it
+// can be driven against a fake sink on the host.
+template <size_t Width, size_t Pages>
+class PageFlusher {
+    static_assert(Width <= 256, "Column index must fit in a byte");
+
+public:
+    PageFlusher() {
+        invalidate();
+    }
+
+    // Forget what the panel shows, so the next flush sends everything
+    void invalidate() {
+        for (size_t page = 0; page < Pages; page++) {
+            pageValid[page] = false;
+        }
+    }
+
+    // Whether the last flush left pages the sink refused; flush again to retry them
+    bool hasUnsent() const { return unsent; }
+
+    // Returns the number of framebuffer bytes sent
+    size_t flush(const uint8_t* framebuffer, PageSink& sink) {
+        size_t sent = 0;
+        unsent = false;
+        for (size_t page = 0; page < Pages; page++) {
+            const uint8_t* row = framebuffer + page * Width;
+            uint8_t* shown = shadow + page * Width;
+
+            size_t first = 0;
+            size_t last = Width;
+            if (pageValid[page]) {
+                while (first < Width && row[first] == shown[first]) {
+                    first++;
+                }
+                if (first == Width) {
+                    continue;
+                }
+                while (row[last - 1] == shown[last - 1]) {
+                    last--;
+                }
+            }
+
+            // A failed page keeps its old shadow and is retried next flush
+            if (!sink.sendPage((uint8_t)page, (uint8_t)first, row + first, last - first)) {
+                unsent = true;
+                continue;
+            }
+            memcpy(shown + first, row + first, last - first);
+            pageValid[page] = true;
+            sent += last - first;
+        }
+        return sent;
+    }
+
+private:
+    uint8_t shadow[Width * Pages];
+    bool pageValid[Pages];
+    bool unsent = false;
+};
+
+// Writes page spans to an SSD1306 as I2C write transactions: the page and
+// column window, then the pixels in pieces small enough that no
+// transaction holds the bus longer than DISPLAY_BUS_HOLD_US. Subclasses
+// put the transactions on the bus.
+class Ssd1306PageSink : public PageSink {
+public:
+    explicit Ssd1306PageSink(size_t chunkBytes = displayChunkBytes(I2C_CLOCK_HZ, DISPLAY_BUS_HOLD_US))
+        : chunkBytes(chunkBytes < DISPLAY_MAX_CHUNK ? chunkBytes : DISPLAY_MAX_CHUNK) {}
+
+    bool sendPage(uint8_t page, uint8_t firstColumn, const uint8_t* data, size_t length) override {
+        // Horizontal addressing: restrict the write window to the changed span
+        const uint8_t pageWindow[] = {SSD1306_CONTROL_COMMANDS, SSD1306_CMD_PAGE_ADDRESS, page, page};
+        const uint8_t columnWindow[] = {SSD1306_CONTROL_COMMANDS, SSD1306_CMD_COLUMN_ADDRESS, firstColumn,
+                                        (uint8_t)(firstColumn + length - 1)};
+        if (!transmit(pageWindow, sizeof(pageWindow)) || !transmit(columnWindow, sizeof(columnWindow))) {
+            return false;
+        }
+
+        uint8_t buffer[DISPLAY_MAX_CHUNK + 1];
+        buffer[0] = SSD1306_CONTROL_DATA;
+        while (length > 0) {
+            size_t chunk = length < chunkBytes ? length : chunkBytes;
+            memcpy(buffer + 1, data, chunk);
+            if (!transmit(buffer, chunk + 1)) {
+                return false;
+            }
+            data += chunk;
+            length -= chunk;
+        }
+        return true;
+    }
+
+protected:
+    // One I2C write transaction to the panel; false if it was not acknowledged
+    virtual bool transmit(const uint8_t* bytes, size_t length) = 0;
+
+private:
+    size_t chunkBytes;
+};
+
+#endif // DISPLAY_PAGES_H
@@ -0,0 +1,129 @@
+#include "DisplayRenderer.h"
+
+DisplayRenderer::DisplayRenderer(Adafruit_SSD1306& display, uint8_t address, TwoWire& wire)
+    : display(display), sink(wire, address), modelLock(nullptr), task(nullptr),
+      bannerSize(0), frames(0), bytesSent(0) {
+    memset(lines, 0, sizeof(lines));
+    memset(banner, 0, sizeof(banner));
+}
+
+bool DisplayRenderer::begin(UBaseType_t priority, BaseType_t core) {
+    if (modelLock == nullptr) {
+        modelLock = xSemaphoreCreateMutex();
+        if (modelLock == nullptr) {
+            return false;
+        }
+    }
+
+    // The panel may still show a splash screen; resend everything on the first frame
+    flusher.invalidate();
+    if (xTaskCreatePinnedToCore(taskEntry, "display", 3072, this, priority, &task, core) != pdPASS) {
+        return false;
+    }
+    requestFrame();
+    return true;
+}
+
+void DisplayRenderer::setLine(int line, const char* text, bool clearOthers) {
+    if (line < 0 || line >= DISPLAY_LINES || modelLock == nullptr) {
+        return;
+    }
+
+    bool changed = false;
+    xSemaphoreTake(modelLock, portMAX_DELAY);
+    if (clearOthers) {
+        for (int i = 0; i < DISPLAY_LINES; i++) {
+            changed |= lines[i][0] != '\0';
+            lines[i][0] = '\0';
+        }
+    }
+    if (bannerSize != 0) {
+        bannerSize = 0;
+        changed = true;
+    }
+    if (strncmp(lines[line], text, DISPLAY_LINE_CHARS) != 0) {
+        strncpy(lines[line], text, DISPLAY_LINE_CHARS);
+        lines[line][DISPLAY_LINE_CHARS] = '\0';
+        changed = true;
+    }
+    xSemaphoreGive(modelLock);
+
+    // Unchanged text costs nothing
+    if (changed) {
+        requestFrame();
+    }
+}
+
+void DisplayRenderer::showBanner(const char* text, uint8_t textSize) {
+    if (modelLock == nullptr) {
+        return;
+    }
+    xSemaphoreTake(modelLock, portMAX_DELAY);
+    strncpy(banner, text, DISPLAY_LINE_CHARS);
+    banner[DISPLAY_LINE_CHARS] = '\0';
+    bannerSize = textSize;
+    xSemaphoreGive(modelLock);
+    requestFrame();
+}
+
+void DisplayRenderer::clear() {
+    if (modelLock == nullptr) {
+        return;
+    }
+    xSemaphoreTake(modelLock, portMAX_DELAY);
+    memset(lines, 0, sizeof(lines));
+    bannerSize = 0;
+    xSemaphoreGive(modelLock);
+    requestFrame();
+}
+
+void DisplayRenderer::requestFrame() {
+    if (task != nullptr) {
+        xTaskNotifyGive(task);
+    }
+}
+
+void DisplayRenderer::taskEntry(void* arg) {
+    static_cast<DisplayRenderer*>(arg)->run();
+}
+
+void DisplayRenderer::run() {
+    const TickType_t framePeriod = pdMS_TO_TICKS(1000 / DISPLAY_MAX_FPS);
+    for (;;) {
+        // Requests made while the last frame was going out collapse into one.
+        // A frame the panel refused part of is retried a frame period later.
+        ulTaskNotifyTake(pdTRUE, flusher.hasUnsent() ? 0 : portMAX_DELAY);
+        render();
+        frames++;
+        vTaskDelay(framePeriod);
+    }
+}
+
+void DisplayRenderer::render() {
+    // Draw into the Adafruit framebuffer; only this task touches it once started
+    display.clearDisplay();
+    display.setTextColor(SSD1306_WHITE);
+    display.setTextWrap(false);
+
+    xSemaphoreTake(modelLock, portMAX_DELAY);
+    if (bannerSize != 0) {
+        display.setTextSize(bannerSize);
+        display.setCursor(0, 0);
+        display.print(banner);
+    } else {
+        display.setTextSize(1);
+        for (int line = 0; line < DISPLAY_LINES; line++) {
+            display.setCursor(0, line * 8);
+            display.print(lines[line]);
+        }
+    }
+    xSemaphoreGive(modelLock);
+
+    bytesSent += flusher.flush(display.getBuffer(), sink);
+}
+
+bool DisplayRenderer::WireSink::transmit(const uint8_t* bytes, size_t length) {
+    wire.beginTransmission(address);
+    wire.write(bytes, length);
+    return wire.endTransmission() == 0;
+}
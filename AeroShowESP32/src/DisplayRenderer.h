@@ -0,0 +1,77 @@
+#ifndef DISPLAY_RENDERER_H
+#define DISPLAY_RENDERER_H
+
+#include <Arduino.h>
+#include <Wire.h>
+#include <Adafruit_SSD1306.h>
+#include "DisplayPages.h"
+
+// Text layout of the 128x32 panel: four lines of 8 pixels, one per SSD1306 page
+const int DISPLAY_WIDTH = 128;
+const int DISPLAY_PAGES = 4;
+const int DISPLAY_LINES = DISPLAY_PAGES;
+const int DISPLAY_LINE_CHARS = DISPLAY_WIDTH / 6;
+
+// Upper bound on panel refreshes; updates in between are merged
+const uint32_t DISPLAY_MAX_FPS = 10;
+
+// Owns the OLED once started. Callers only update a text model, which is
+// cheap and safe from any task. A low-priority task renders the model at
+// most DISPLAY_MAX_FPS times per second and pushes only the changed parts
+// of changed pages over I2C, in transactions short enough that the INA260
+// reads never wait long for the bus. Pages the panel did not acknowledge
+// are sent again on the next frame, which follows without a new request.
+class DisplayRenderer {
+public:
+    DisplayRenderer(Adafruit_SSD1306& display, uint8_t address, TwoWire& wire = Wire);
+
+    // Start the render task; anything drawn before is overwritten by the first frame
+    bool begin(UBaseType_t priority, BaseType_t core);
+
+    // Replace one line of text, optionally blanking the others first
+    void setLine(int line, const char* text, bool clearOthers = false);
+
+    // Show large text across the whole panel until the next setLine() or clear()
+    void showBanner(const char* text, uint8_t textSize);
+
+    // Blank the panel
+    void clear();
+
+    uint32_t getFrames() const { return frames; }
+    uint32_t getBytesSent() const { return bytesSent; }
+
+private:
+    // Puts the SSD1306 transactions on the Wire bus
+    class WireSink : public Ssd1306PageSink {
+    public:
+        WireSink(TwoWire& wire, uint8_t address) : wire(wire), address(address) {}
+
+    protected:
+        bool transmit(const uint8_t* bytes, size_t length) override;
+
+    private:
+        TwoWire& wire;
+        uint8_t address;
+    };
+
+    static void taskEntry(void* arg);
+    void run();
+    void render();
+    void requestFrame();
+
+    Adafruit_SSD1306& display;
+    WireSink sink;
+    PageFlusher<DISPLAY_WIDTH, DISPLAY_PAGES> flusher;
+    SemaphoreHandle_t modelLock;
+    TaskHandle_t task;
+
+    // Text model, guarded by modelLock
+    char lines[DISPLAY_LINES][DISPLAY_LINE_CHARS + 1];
+    char banner[DISPLAY_LINE_CHARS + 1];
+    uint8_t bannerSize;
+
+    volatile uint32_t frames;
+    volatile uint32_t bytesSent;
+};
+
+#endif // DISPLAY_RENDERER_H
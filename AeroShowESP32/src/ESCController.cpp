@@ -1,27 +1,31 @@
 #include "ESCController.h"
 
-ESCController::ESCController(int escPin, int minPulseWidth, int maxPulseWidth) 
-    : pin(escPin), minPulse(minPulseWidth), maxPulse(maxPulseWidth), 
-      initialized(false), currentSpeed(0.0) {
+// Throttle of the arming bump (50us on a standard 1000-2000us range)
+static const float ARMING_BUMP_THROTTLE = 0.05f;
+
+ESCController::ESCController(ThrottleOutput& output, Clock& clock) 
+    : esc(output), clock(clock), initialized(false), currentSpeed(0.0) {
 }
 
 bool ESCController::initialize() {
-    // Attach the ESC to the pin with specified pulse width range
-    esc.attach(pin, minPulse, maxPulse);
+    // Start the output (pin, timer and protocol set up by the output)
+    if (!esc.begin()) {
+        return false;
+    }
     
     // ESC calibration sequence
     // Most ESCs require seeing max then min throttle at power-on
-    // esc.writeMicroseconds(maxPulse);
-    delay(500); // Wait for ESC to register max throttle
+    // esc.writeThrottle(1.0f);
+    clock.delay(500); // Wait for ESC to register max throttle
     
-    esc.writeMicroseconds(minPulse);
-    delay(3000); // Wait for ESC to complete initialization (listen for beeps)
+    esc.writeThrottle(0.0f);
+    clock.delay(3000); // Wait for ESC to complete initialization (listen for beeps)
     
     // Some ESCs need a slight throttle bump to confirm arming
-    esc.writeMicroseconds(minPulse + 50);
-    delay(500);
-    esc.writeMicroseconds(minPulse);
-    delay(500);
+    esc.writeThrottle(ARMING_BUMP_THROTTLE);
+    clock.delay(500);
+    esc.writeThrottle(0.0f);
+    clock.delay(500);
     
     initialized = true;
     currentSpeed = 0.0;
@@ -35,13 +39,10 @@ void ESCController::setSpeed(float speed) {
     }
     
     // Clamp speed between 0 and 1
-    speed = constrain(speed, 0.0, 1.0);
+    speed = speed < 0.0f ? 0.0f : (speed > 1.0f ? 1.0f : speed);
     
-    // Calculate pulse width based on speed
-    int pulseWidth = minPulse + (speed * (maxPulse - minPulse));
-    
-    // Send the pulse width to the ESC
-    esc.writeMicroseconds(pulseWidth);
+    // The output encodes it for the ESC's protocol
+    esc.writeThrottle(speed);
     
     currentSpeed = speed;
 }
@@ -64,13 +65,19 @@ void ESCController::arm() {
     }
     
     // Standard arming sequence
-    esc.writeMicroseconds(minPulse);
-    delay(1000);
+    esc.writeThrottle(0.0f);
+    clock.delay(1000);
     
     // Some ESCs need a small throttle bump
-    esc.writeMicroseconds(minPulse + 50);
-    delay(100);
-    esc.writeMicroseconds(minPulse);
-    
-    Serial.println("ESC armed!");
+    esc.writeThrottle(ARMING_BUMP_THROTTLE);
+    clock.delay(100);
+    esc.writeThrottle(0.0f);
+}
+
+uint32_t ESCController::getCommandRateHz() const {
+    return esc.getCommandRateHz();
+}
+
+bool ESCController::readRpm(EscRpmReading& reading) const {
+    return esc.readRpm(reading);
 }
@@ -1,21 +1,38 @@
 #ifndef ESC_CONTROLLER_H
 #define ESC_CONTROLLER_H
 
-#include <Arduino.h>
-#include <ESP32Servo.h>
+#include "Hal.h"
+#include "EscProtocol.h"
+
+// Standard servo PWM through a PwmOutput, mapping throttle onto a pulse range
+class PwmThrottleOutput : public ThrottleOutput {
+public:
+    // Default PWM values for standard ESCs
+    explicit PwmThrottleOutput(PwmOutput& pwm, int minPulseWidth = 1000, int maxPulseWidth = 2000)
+        : pwm(pwm), minPulse(minPulseWidth), maxPulse(maxPulseWidth) {}
+
+    bool begin() override { return pwm.attach(minPulse, maxPulse); }
+    void writeThrottle(float throttle) override {
+        pwm.writeMicroseconds(minPulse + (int)(throttle * (maxPulse - minPulse)));
+    }
+    uint32_t getCommandRateHz() const override { return ESC_PWM_COMMAND_HZ; }
 
-class ESCController {
 private:
-    Servo esc;
-    int pin;
+    PwmOutput& pwm;
     int minPulse;
     int maxPulse;
+};
+
+class ESCController {
+private:
+    ThrottleOutput& esc;
+    Clock& clock;
     bool initialized;
     float currentSpeed;
 
 public:
-    // Constructor with default PWM values for standard ESCs
-    ESCController(int escPin, int minPulseWidth = 1000, int maxPulseWidth = 2000);
+    // The output decides the protocol (servo PWM, OneShot, Multishot or DShot)
+    ESCController(ThrottleOutput& output, Clock& clock);
     
     // Initialize the ESC (includes calibration sequence)
     bool initialize();
@@ -34,6 +51,12 @@ public:
     
     // Arm the ESC (some ESCs require this after power-on)
     void arm();
+    
+    // Commands per second reaching the ESC
+    uint32_t getCommandRateHz() const;
+    
+    // Latest rotor speed, for ESCs that report it (bidirectional DShot)
+    bool readRpm(EscRpmReading& reading) const;
 };
 
 #endif // ESC_CONTROLLER_H
@@ -0,0 +1,192 @@
+#include "EscOutputs.h"
+#include <esp_rom_gpio.h>
+#include <soc/gpio_sig_map.h>
+
+// RMT counts the 80 MHz APB clock undivided, 12.5 ns per tick
+static const uint8_t RMT_CLOCK_DIVIDER = 1;
+static const uint32_t RMT_TICKS_PER_US = 80;
+
+// Receive ring for eRPM replies, and the most runs one reply can have
+static const size_t RMT_REPLY_BUFFER_BYTES = 256;
+static const size_t RMT_REPLY_MAX_RUNS = 24;
+
+LedcPulseOutput::LedcPulseOutput(int pin, uint8_t channel, EscProtocol protocol, uint32_t commandHz)
+    : pin(pin), channel(channel), protocol(protocol), commandHz(escCommandHz(protocol, commandHz)),
+      resolutionBits(ledcResolutionForFrequency(this->commandHz)) {
+}
+
+bool LedcPulseOutput::begin() {
+    if (ledcSetup(channel, commandHz, resolutionBits) == 0) {
+        return false;
+    }
+    ledcAttachPin(pin, channel);
+    writeThrottle(0.0f);
+    return true;
+}
+
+void LedcPulseOutput::writeThrottle(float throttle) {
+    ledcWrite(channel, ledcDutyForPulse(escPulseNs(protocol, throttle), commandHz, resolutionBits));
+}
+
+RmtDShotOutput::RmtDShotOutput(int pin, rmt_channel_t channel, EscProtocol protocol, uint32_t commandHz)
+    : pin(pin), channel(channel), protocol(protocol), commandHz(escCommandHz(protocol, commandHz)),
+      timer(nullptr), bidirectional(false), rxChannel(RMT_CHANNEL_MAX), polePairs(1), replies(nullptr),
+      awaitingReply(false), frame(dshotEncodeFrame(DSHOT_MOTOR_STOP, false)), framesSent(0) {
+}
+
+void RmtDShotOutput::enableTelemetry(rmt_channel_t receiveChannel, uint8_t motorPoles) {
+    bidirectional = true;
+    rxChannel = receiveChannel;
+    polePairs = motorPoles >= 2 ? motorPoles / 2 : 1;
+    frame = dshotEncodeFrame(DSHOT_MOTOR_STOP, false, true);
+}
+
+bool RmtDShotOutput::begin() {
+    // ESCController re-initializes before each test; frames are already going out
+    if (timer != nullptr) {
+        return true;
+    }
+
+    // The receiver is set up first so the transmitter ends up owning the pin's output
+    if (bidirectional && !beginReceiver()) {
+        return false;
+    }
+
+    rmt_config_t config = RMT_DEFAULT_CONFIG_TX((gpio_num_t)pin, channel);
+    config.clk_div = RMT_CLOCK_DIVIDER;
+    config.tx_config.idle_output_en = true;
+    config.tx_config.idle_level = bidirectional ? RMT_IDLE_LEVEL_HIGH : RMT_IDLE_LEVEL_LOW;
+    if (rmt_config(&config) != ESP_OK || rmt_driver_install(channel, 0, 0) != ESP_OK) {
+        return false;
+    }
+
+    if (bidirectional) {
+        // Open drain with a pull-up, so the ESC can drive its reply while the
+        // transmitter idles high, and the receiver listens on the same pin
+        gpio_set_direction((gpio_num_t)pin, GPIO_MODE_INPUT_OUTPUT_OD);
+        gpio_set_pull_mode((gpio_num_t)pin, GPIO_PULLUP_ONLY);
+        esp_rom_gpio_connect_out_signal(pin, RMT_SIG_OUT0_IDX + channel, false, false);
+        esp_rom_gpio_connect_in_signal(pin, RMT_SIG_IN0_IDX + rxChannel, false);
+    }
+
+    esp_timer_create_args_t args = {};
+    args.callback = timerEntry;
+    args.arg = this;
+    args.dispatch_method = ESP_TIMER_TASK;
+    args.name = "dshot";
+    if (esp_timer_create(&args, &timer) != ESP_OK) {
+        return false;
+    }
+    return esp_timer_start_periodic(timer, 1000000 / commandHz) == ESP_OK;
+}
+
+bool RmtDShotOutput::beginReceiver() {
+    uint32_t bitTicks = dshotReplyBitTicks(protocol, RMT_TICKS_PER_US);
+
+    rmt_config_t config = RMT_DEFAULT_CONFIG_RX((gpio_num_t)pin, rxChannel);
+    config.clk_div = RMT_CLOCK_DIVIDER;
+    // Ignore glitches under a fifth of a reply bit
+    config.rx_config.filter_en = true;
+    config.rx_config.filter_ticks_thresh = (uint8_t)(bitTicks / 5);
+    // No run in a reply is longer than three bits, so four ends the capture
+    config.rx_config.idle_threshold = (uint16_t)(bitTicks * 4);
+    if (rmt_config(&config) != ESP_OK || rmt_driver_install(rxChannel, RMT_REPLY_BUFFER_BYTES, 0) != ESP_OK) {
+        return false;
+    }
+    return rmt_get_ringbuf_handle(rxChannel, &replies) == ESP_OK && replies != nullptr;
+}
+
+void RmtDShotOutput::writeThrottle(float throttle) {
+    frame = dshotEncodeFrame(dshotThrottleValue(throttle), false, bidirectional);
+}
+
+bool RmtDShotOutput::readRpm(EscRpmReading& reading) const {
+    return bidirectional && rpm.read(reading);
+}
+
+void RmtDShotOutput::sendFrame() {
+    if (bidirectional) {
+        collectReply();
+    }
+
+    DShotSymbol symbols[DSHOT_FRAME_BITS];
+    dshotFrameSymbols(frame, dshotBitNs(protocol), RMT_TICKS_PER_US, symbols);
+
+    // One item per bit, plus an end marker. Bidirectional frames are inverted.
+    uint32_t active = bidirectional ? 0 : 1;
+    rmt_item32_t items[DSHOT_FRAME_BITS + 1];
+    for (int i = 0; i < DSHOT_FRAME_BITS; i++) {
+        items[i].level0 = active;
+        items[i].duration0 = symbols[i].highTicks;
+        items[i].level1 = !active;
+        items[i].duration1 = symbols[i].lowTicks;
+    }
+    items[DSHOT_FRAME_BITS].val = 0;
+
+    // Waits out a frame still on the wire (at most 107us, well inside a period).
+    // A bidirectional frame must be finished before listening, or the
+    // receiver would capture the frame itself.
+    if (rmt_write_items(channel, items, DSHOT_FRAME_BITS + 1, bidirectional) == ESP_OK) {
+        framesSent++;
+        if (bidirectional) {
+            rmt_rx_start(rxChannel, true);
+            awaitingReply = true;
+        }
+    }
+}
+
+void RmtDShotOutput::collectReply() {
+    if (!awaitingReply) {
+        return;
+    }
+    awaitingReply = false;
+    rmt_rx_stop(rxChannel);
+
+    size_t size = 0;
+    rmt_item32_t* items = (rmt_item32_t*)xRingbufferReceive(replies, &size, 0);
+    if (items == nullptr) {
+        replyStats.recordMissing();
+        return;
+    }
+
+    // Flatten the items into runs, merging any the filter split. Idle line
+    // before the reply's first falling edge is not part of it.
+    DShotRun runs[RMT_REPLY_MAX_RUNS];
+    size_t count = 0;
+    size_t itemCount = size / sizeof(rmt_item32_t);
+    bool overflow = false;
+    for (size_t i = 0; i < itemCount && !overflow; i++) {
+        const uint32_t levels[2] = {items[i].level0, items[i].level1};
+        const uint32_t durations[2] = {items[i].duration0, items[i].duration1};
+        for (int half = 0; half < 2; half++) {
+            if (durations[half] == 0 || (count == 0 && levels[half] == 1)) {
+                continue;
+            }
+            if (count > 0 && runs[count - 1].level == levels[half]) {
+                runs[count - 1].ticks = (uint16_t)(runs[count - 1].ticks + durations[half]);
+            } else if (count < RMT_REPLY_MAX_RUNS) {
+                runs[count].level = (uint8_t)levels[half];
+                runs[count].ticks = (uint16_t)durations[half];
+                count++;
+            } else {
+                overflow = true;
+            }
+        }
+    }
+    vRingbufferReturnItem(replies, items);
+
+    uint16_t value = 0;
+    DShotReplyStatus status = overflow ? DShotReplyStatus::Framing
+                                       : dshotDecodeReply(runs, count, dshotReplyBitTicks(protocol, RMT_TICKS_PER_US), value);
+    replyStats.record(status);
+    if (status == DShotReplyStatus::Ok) {
+        EscRpmReading reading;
+        reading.rpm = dshotReplyRpm(value, polePairs);
+        reading.timestampMs = millis();
+        rpm.publish(reading);
+    }
+}
+
+void RmtDShotOutput::timerEntry(void* arg) {
+    static_cast<RmtDShotOutput*>(arg)->sendFrame();
+}
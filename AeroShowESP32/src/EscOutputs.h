@@ -0,0 +1,80 @@
+#ifndef ESC_OUTPUTS_H
+#define ESC_OUTPUTS_H
+
+#include <Arduino.h>
+#include <atomic>
+#include <driver/rmt.h>
+#include <esp_timer.h>
+#include <freertos/ringbuf.h>
+#include "Hal.h"
+#include "DShotTelemetry.h"
+#include "EscProtocol.h"
+#include "StatusSnapshot.h"
+
+// OneShot125 or Multishot pulses from an LEDC channel. The LEDC timer runs
+// at the command rate, so every period carries one pulse.
+class LedcPulseOutput : public ThrottleOutput {
+public:
+    LedcPulseOutput(int pin, uint8_t channel, EscProtocol protocol, uint32_t commandHz);
+
+    bool begin() override;
+    void writeThrottle(float throttle) override;
+    uint32_t getCommandRateHz() const override { return commandHz; }
+
+private:
+    int pin;
+    uint8_t channel;
+    EscProtocol protocol;
+    uint32_t commandHz;
+    uint8_t resolutionBits;
+};
+
+// DShot150/300/600 frames from an RMT channel. writeThrottle() only swaps
+// the frame; an esp_timer sends the latest one at the command rate, since
+// DShot ESCs disarm when frames stop arriving.
+//
+// With telemetry enabled the output speaks bidirectional DShot: the line
+// is inverted and open drain, and a second RMT channel on the same pin
+// captures the ESC's eRPM reply after each frame. Replies are decoded on
+// the next timer tick.
+class RmtDShotOutput : public ThrottleOutput {
+public:
+    RmtDShotOutput(int pin, rmt_channel_t channel, EscProtocol protocol, uint32_t commandHz);
+
+    // Call before begin(); motorPoles converts eRPM to mechanical RPM
+    void enableTelemetry(rmt_channel_t rxChannel, uint8_t motorPoles);
+
+    bool begin() override;
+    void writeThrottle(float throttle) override;
+    uint32_t getCommandRateHz() const override { return commandHz; }
+    bool readRpm(EscRpmReading& reading) const override;
+
+    // Frames handed to the RMT since begin()
+    uint32_t getFramesSent() const { return framesSent; }
+
+    bool isBidirectional() const { return bidirectional; }
+    const DShotReplyStats& getReplyStats() const { return replyStats; }
+
+private:
+    static void timerEntry(void* arg);
+    bool beginReceiver();
+    void sendFrame();
+    void collectReply();
+
+    int pin;
+    rmt_channel_t channel;
+    EscProtocol protocol;
+    uint32_t commandHz;
+    esp_timer_handle_t timer;
+    bool bidirectional;
+    rmt_channel_t rxChannel;
+    uint8_t polePairs;
+    RingbufHandle_t replies;
+    bool awaitingReply;
+    DShotReplyStats replyStats;
+    SnapshotCell<EscRpmReading> rpm;
+    std::atomic<uint16_t> frame;
+    std::atomic<uint32_t> framesSent;
+};
+
+#endif // ESC_OUTPUTS_H
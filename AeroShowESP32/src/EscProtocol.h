@@ -0,0 +1,176 @@
+#ifndef ESC_PROTOCOL_H
+#define ESC_PROTOCOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Timing and frame encoding for the ESC input protocols. Kept free of
+// Arduino calls so the encoders can be checked bit for bit on the host.
+
+enum class EscProtocol : uint8_t {
+    Pwm,         // 1000-2000us servo pulses at 50 Hz
+    OneShot125,  // 125-250us pulses
+    Multishot,   // 5-25us pulses
+    DShot150,    // 16-bit digital frames, 150 kbit/s
+    DShot300,
+    DShot600
+};
+
+// Command rate used when none is configured (PWM is fixed at 50 Hz)
+const uint32_t ESC_DEFAULT_COMMAND_HZ = 1000;
+const uint32_t ESC_PWM_COMMAND_HZ = 50;
+
+// Idle line time required between pulses or frames
+const uint32_t ESC_MIN_GAP_NS = 10000;
+
+// Highest rate the output timers are asked to run at
+const uint32_t ESC_MAX_COMMAND_HZ = 8000;
+
+inline bool escIsDShot(EscProtocol protocol) {
+    return protocol == EscProtocol::DShot150 || protocol == EscProtocol::DShot300 ||
+           protocol == EscProtocol::DShot600;
+}
+
+// Parse the names used in build flags; false if unknown
+inline bool parseEscProtocol(const char* name, EscProtocol& protocol) {
+    static const struct {
+        const char* name;
+        EscProtocol protocol;
+    } NAMES[] = {
+        {"pwm", EscProtocol::Pwm},           {"oneshot125", EscProtocol::OneShot125},
+        {"multishot", EscProtocol::Multishot}, {"dshot150", EscProtocol::DShot150},
+        {"dshot300", EscProtocol::DShot300}, {"dshot600", EscProtocol::DShot600},
+    };
+    for (size_t i = 0; i < sizeof(NAMES) / sizeof(NAMES[0]); i++) {
+        if (strcmp(name, NAMES[i].name) == 0) {
+            protocol = NAMES[i].protocol;
+            return true;
+        }
+    }
+    return false;
+}
+
+// --- Pulse-width protocols ---
+
+// Pulse width for a throttle in [0, 1]
+inline uint32_t escPulseNs(EscProtocol protocol, float throttle) {
+    uint32_t minNs;
+    uint32_t maxNs;
+    switch (protocol) {
+    case EscProtocol::OneShot125:
+        minNs = 125000;
+        maxNs = 250000;
+        break;
+    case EscProtocol::Multishot:
+        minNs = 5000;
+        maxNs = 25000;
+        break;
+    default:
+        minNs = 1000000;
+        maxNs = 2000000;
+        break;
+    }
+    throttle = throttle < 0.0f ? 0.0f : (throttle > 1.0f ? 1.0f : throttle);
+    return minNs + (uint32_t)(throttle * (float)(maxNs - minNs) + 0.5f);
+}
+
+// --- DShot ---
+
+// Frame values: 0 is motor stop, 1-47 are commands, 48-2047 are throttle
+const uint16_t DSHOT_MOTOR_STOP = 0;
+const uint16_t DSHOT_MIN_THROTTLE = 48;
+const uint16_t DSHOT_MAX_THROTTLE = 2047;
+const int DSHOT_FRAME_BITS = 16;
+
+// Bit period in ns: 1e9 / bitrate
+inline uint32_t dshotBitNs(EscProtocol protocol) {
+    switch (protocol) {
+    case EscProtocol::DShot150:
+        return 6667;
+    case EscProtocol::DShot300:
+        return 3333;
+    default:
+        return 1667;
+    }
+}
+
+// Throttle in [0, 1] to a frame value; zero throttle sends motor stop
+inline uint16_t dshotThrottleValue(float throttle) {
+    if (throttle <= 0.0f) {
+        return DSHOT_MOTOR_STOP;
+    }
+    if (throttle >= 1.0f) {
+        return DSHOT_MAX_THROTTLE;
+    }
+    return DSHOT_MIN_THROTTLE + (uint16_t)(throttle * (DSHOT_MAX_THROTTLE - DSHOT_MIN_THROTTLE) + 0.5f);
+}
+
+// 4-bit checksum over the 12 data bits: XOR of their three nibbles
+inline uint16_t dshotChecksum(uint16_t data12) {
+    return (data12 ^ (data12 >> 4) ^ (data12 >> 8)) & 0x0F;
+}
+
+// Frame: 11-bit value, telemetry request bit, checksum; sent MSB first.
+// Bidirectional DShot inverts the checksum (and the line), which is how
+// the ESC knows to answer with eRPM.
+inline uint16_t dshotEncodeFrame(uint16_t value, bool telemetry, bool bidirectional = false) {
+    uint16_t data = (uint16_t)(((value & 0x07FF) << 1) | (telemetry ? 1 : 0));
+    uint16_t crc = dshotChecksum(data);
+    return (uint16_t)((data << 4) | (bidirectional ? (~crc & 0x0F) : crc));
+}
+
+// One bit on the wire: high for highTicks, then low for lowTicks
+struct DShotSymbol {
+    uint16_t highTicks;
+    uint16_t lowTicks;
+};
+
+// Expand a frame into DSHOT_FRAME_BITS symbols. A 1 is high for 3/4 of
+// the bit period, a 0 for 3/8.
+inline void dshotFrameSymbols(uint16_t frame, uint32_t bitNs, uint32_t ticksPerUs, DShotSymbol* symbols) {
+    uint16_t bitTicks = (uint16_t)((bitNs * ticksPerUs + 500) / 1000);
+    uint16_t oneHigh = (uint16_t)((bitTicks * 3 + 2) / 4);
+    uint16_t zeroHigh = (uint16_t)((bitTicks * 3 + 4) / 8);
+    for (int i = 0; i < DSHOT_FRAME_BITS; i++) {
+        bool one = (frame >> (DSHOT_FRAME_BITS - 1 - i)) & 1;
+        symbols[i].highTicks = one ? oneHigh : zeroHigh;
+        symbols[i].lowTicks = (uint16_t)(bitTicks - symbols[i].highTicks);
+    }
+}
+
+// --- Command rate ---
+
+// Fastest command rate the protocol allows, capped at ESC_MAX_COMMAND_HZ
+inline uint32_t escMaxCommandHz(EscProtocol protocol) {
+    if (protocol == EscProtocol::Pwm) {
+        return ESC_PWM_COMMAND_HZ;
+    }
+    uint32_t commandNs = escIsDShot(protocol) ? dshotBitNs(protocol) * DSHOT_FRAME_BITS : escPulseNs(protocol, 1.0f);
+    uint32_t limit = 1000000000u / (commandNs + ESC_MIN_GAP_NS);
+    return limit < ESC_MAX_COMMAND_HZ ? limit : ESC_MAX_COMMAND_HZ;
+}
+
+// Requested rate clamped to what the protocol allows; 0 picks the default
+inline uint32_t escCommandHz(EscProtocol protocol, uint32_t requestedHz) {
+    uint32_t maxHz = escMaxCommandHz(protocol);
+    uint32_t hz = requestedHz > 0 ? requestedHz : ESC_DEFAULT_COMMAND_HZ;
+    return hz < maxHz ? hz : maxHz;
+}
+
+// LEDC duty for a pulse at the given frequency and resolution
+inline uint32_t ledcDutyForPulse(uint32_t pulseNs, uint32_t frequencyHz, uint8_t resolutionBits) {
+    uint64_t scaled = (uint64_t)pulseNs * frequencyHz * ((uint64_t)1 << resolutionBits);
+    return (uint32_t)((scaled + 500000000u) / 1000000000u);
+}
+
+// Finest LEDC resolution available at a frequency from an 80 MHz clock
+inline uint8_t ledcResolutionForFrequency(uint32_t frequencyHz) {
+    uint8_t bits = 1;
+    while (bits < 16 && (80000000u >> (bits + 1)) >= frequencyHz) {
+        bits++;
+    }
+    return bits;
+}
+
+#endif // ESC_PROTOCOL_H
@@ -0,0 +1,38 @@
+#ifndef FLASH_FILES_H
+#define FLASH_FILES_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <functional>
+
+// The file operations the spool needs from a flash filesystem, by path and
+// offset. The device binds them to LittleFS (LittleFsFiles.h); the native
+// build binds them to files on the host (sim/SimFlash.h), which can also
+// cut the power part way through a write.
+class FlashFiles {
+public:
+    virtual ~FlashFiles() {}
+
+    // Create a directory unless it already exists
+    virtual bool makeDirectory(const char* path) = 0;
+
+    // Call visit with the name, without the directory, of each entry
+    virtual bool list(const char* directory, const std::function<void(const char*)>& visit) = 0;
+
+    // False if the file does not exist
+    virtual bool size(const char* path, uint32_t& bytes) = 0;
+
+    // Up to length bytes from offset; returns the bytes read
+    virtual size_t read(const char* path, uint32_t offset, uint8_t* buffer, size_t length) = 0;
+
+    // Add to the end of a file, creating it; returns the bytes accepted.
+    // They are only certain to be on flash after commit().
+    virtual size_t append(const char* path, const uint8_t* data, size_t length) = 0;
+    virtual bool commit() = 0;
+
+    // Replaces to if it exists, in one step
+    virtual bool rename(const char* from, const char* to) = 0;
+    virtual bool remove(const char* path) = 0;
+};
+
+#endif // FLASH_FILES_H
@@ -0,0 +1,260 @@
+#include "GzipEncoder.h"
+#include <string.h>
+#include "Crc32.h"
+
+namespace {
+
+// Deflate length codes 257..285 and distance codes 0..29 (RFC 1951 3.2.5)
+const uint16_t LENGTH_BASE[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+const uint8_t LENGTH_EXTRA[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+const uint16_t DISTANCE_BASE[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+const uint8_t DISTANCE_EXTRA[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+// Chain depth per level; level 1 also skips indexing inside matches
+const uint16_t LEVEL_CHAIN[GZIP_MAX_LEVEL + 1] = { 0, 4, 16, 128 };
+
+// Member, modification time, extra flags, OS unknown
+const uint8_t GZIP_HEADER[10] = { 0x1f, 0x8b, 0x08, 0x00, 0, 0, 0, 0, 0x00, 0xff };
+
+inline size_t hashAt(const uint8_t* p) {
+    uint32_t v = ((uint32_t)p[0] << 16) | ((uint32_t)p[1] << 8) | p[2];
+    return (v * 2654435761u) >> (32 - GZIP_HASH_BITS);
+}
+
+// Index of the last base not above value
+inline size_t findCode(const uint16_t* base, size_t count, size_t value) {
+    size_t code = count - 1;
+    while (base[code] > value) {
+        code--;
+    }
+    return code;
+}
+
+}  // namespace
+
+GzipEncoder::GzipEncoder()
+    : sink(nullptr), maxChain(0), insertMatched(false), position(0), end(0), bitBuffer(0), bitCount(0),
+      outputUsed(0), crc(0), inputBytes(0), outputBytes(0), failed(true) {
+}
+
+void GzipEncoder::begin(ByteSink& target, uint8_t level) {
+    if (level == 0) {
+        level = 1;
+    } else if (level > GZIP_MAX_LEVEL) {
+        level = GZIP_MAX_LEVEL;
+    }
+
+    sink = &target;
+    maxChain = LEVEL_CHAIN[level];
+    insertMatched = level > 1;
+    memset(head, 0, sizeof(head));
+    memset(prev, 0, sizeof(prev));
+    position = 0;
+    end = 0;
+    bitBuffer = 0;
+    bitCount = 0;
+    outputUsed = 0;
+    crc = 0;
+    inputBytes = 0;
+    outputBytes = 0;
+    failed = false;
+
+    for (size_t i = 0; i < sizeof(GZIP_HEADER); i++) {
+        putByte(GZIP_HEADER[i]);
+    }
+    putBits(1, 1);  // BFINAL: this is the only block
+    putBits(1, 2);  // BTYPE 01: fixed Huffman codes
+}
+
+bool GzipEncoder::write(const uint8_t* data, size_t length) {
+    crc = crc32Update(crc, data, length);
+    inputBytes += length;
+
+    while (length > 0 && !failed) {
+        if (end == sizeof(window)) {
+            slide();
+        }
+        size_t n = sizeof(window) - end;
+        if (n > length) {
+            n = length;
+        }
+        memcpy(window + end, data, n);
+        end += n;
+        data += n;
+        length -= n;
+        compress(false);
+    }
+    return !failed;
+}
+
+bool GzipEncoder::finish() {
+    compress(true);
+    putCode(0, 7);  // End of block, symbol 256
+    if (bitCount > 0) {
+        putByte((uint8_t)bitBuffer);
+        bitBuffer = 0;
+        bitCount = 0;
+    }
+    for (int i = 0; i < 32; i += 8) {
+        putByte((uint8_t)(crc >> i));
+    }
+    for (int i = 0; i < 32; i += 8) {
+        putByte((uint8_t)(inputBytes >> i));
+    }
+    flushOutput();
+    return !failed;
+}
+
+void GzipEncoder::compress(bool flush) {
+    // Without flush, keep a full match of lookahead so no match is cut short
+    while (position < end && (flush || end - position >= GZIP_MAX_MATCH)) {
+        size_t distance = 0;
+        size_t length = 0;
+        if (end - position >= GZIP_MIN_MATCH) {
+            length = longestMatch(distance);
+            insert(position);
+        }
+
+        if (length >= GZIP_MIN_MATCH) {
+            putMatch(length, distance);
+            if (insertMatched) {
+                for (size_t i = 1; i < length && position + i + GZIP_MIN_MATCH <= end; i++) {
+                    insert(position + i);
+                }
+            }
+            position += length;
+        } else {
+            putLiteral(window[position]);
+            position++;
+        }
+    }
+}
+
+void GzipEncoder::slide() {
+    // The lookahead never exceeds a window, so the upper half is all that can still be matched
+    memcpy(window, window + GZIP_WINDOW_SIZE, GZIP_WINDOW_SIZE);
+    position -= GZIP_WINDOW_SIZE;
+    end -= GZIP_WINDOW_SIZE;
+    for (size_t i = 0; i < GZIP_HASH_SIZE; i++) {
+        head[i] = head[i] > GZIP_WINDOW_SIZE ? head[i] - GZIP_WINDOW_SIZE : 0;
+    }
+    for (size_t i = 0; i < GZIP_WINDOW_SIZE; i++) {
+        prev[i] = prev[i] > GZIP_WINDOW_SIZE ? prev[i] - GZIP_WINDOW_SIZE : 0;
+    }
+}
+
+void GzipEncoder::insert(size_t at) {
+    size_t hash = hashAt(window + at);
+    prev[at & (GZIP_WINDOW_SIZE - 1)] = head[hash];
+    head[hash] = (uint16_t)(at + 1);
+}
+
+size_t GzipEncoder::longestMatch(size_t& distance) {
+    size_t limit = end - position;
+    if (limit > GZIP_MAX_MATCH) {
+        limit = GZIP_MAX_MATCH;
+    }
+
+    const uint8_t* current = window + position;
+    size_t best = 0;
+    size_t candidate = head[hashAt(current)];
+    for (uint16_t chain = maxChain; chain > 0 && candidate > 0; chain--) {
+        size_t from = candidate - 1;
+        if (position - from > GZIP_WINDOW_SIZE) {
+            break;
+        }
+
+        const uint8_t* match = window + from;
+        // Cheap rejection: a longer match must agree at the current best length
+        if (match[best] == current[best] && match[0] == current[0]) {
+            size_t length = 1;
+            while (length < limit && match[length] == current[length]) {
+                length++;
+            }
+            if (length > best) {
+                best = length;
+                distance = position - from;
+                if (best == limit) {
+                    break;
+                }
+            }
+        }
+
+        // prev slots are reused every window, so only follow links that go back
+        size_t next = prev[from & (GZIP_WINDOW_SIZE - 1)];
+        if (next >= candidate) {
+            break;
+        }
+        candidate = next;
+    }
+    return best;
+}
+
+void GzipEncoder::putBits(uint32_t bits, int count) {
+    bitBuffer |= bits << bitCount;
+    bitCount += count;
+    while (bitCount >= 8) {
+        putByte((uint8_t)bitBuffer);
+        bitBuffer >>= 8;
+        bitCount -= 8;
+    }
+}
+
+void GzipEncoder::putCode(uint32_t code, int length) {
+    // Huffman codes go most significant bit first
+    uint32_t reversed = 0;
+    for (int i = 0; i < length; i++) {
+        reversed = (reversed << 1) | ((code >> i) & 1);
+    }
+    putBits(reversed, length);
+}
+
+void GzipEncoder::putLiteral(uint8_t value) {
+    if (value < 144) {
+        putCode(0x30 + value, 8);
+    } else {
+        putCode(0x190 + (value - 144), 9);
+    }
+}
+
+void GzipEncoder::putMatch(size_t length, size_t distance) {
+    size_t code = findCode(LENGTH_BASE, 29, length);
+    size_t symbol = 257 + code;
+    if (symbol < 280) {
+        putCode((uint32_t)(symbol - 256), 7);
+    } else {
+        putCode((uint32_t)(0xc0 + (symbol - 280)), 8);
+    }
+    putBits((uint32_t)(length - LENGTH_BASE[code]), LENGTH_EXTRA[code]);
+
+    code = findCode(DISTANCE_BASE, 30, distance);
+    putCode((uint32_t)code, 5);
+    putBits((uint32_t)(distance - DISTANCE_BASE[code]), DISTANCE_EXTRA[code]);
+}
+
+void GzipEncoder::putByte(uint8_t value) {
+    output[outputUsed++] = value;
+    if (outputUsed == sizeof(output)) {
+        flushOutput();
+    }
+}
+
+void GzipEncoder::flushOutput() {
+    if (outputUsed > 0 && !failed && !sink->put(output, outputUsed)) {
+        failed = true;
+    }
+    outputBytes += (uint32_t)outputUsed;
+    outputUsed = 0;
+}
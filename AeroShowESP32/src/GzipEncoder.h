@@ -0,0 +1,84 @@
+#ifndef GZIP_ENCODER_H
+#define GZIP_ENCODER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Streaming gzip (RFC 1952) for upload bodies: LZ77 over a 2 KB window with
+// hash chains, coded as a single fixed-Huffman deflate block (RFC 1951), so
+// there are no trees to build or buffer and any gzip reader, including a
+// server honouring Content-Encoding: gzip, can decode it. All state lives in
+// the object (about 10 KB) and nothing touches the heap. This file has no
+// Arduino dependencies, so batches can be compressed and checked on the host.
+
+// Level 0 means no encoding at all; 1 is fastest, GZIP_MAX_LEVEL smallest
+const uint8_t GZIP_MAX_LEVEL = 3;
+
+const int GZIP_WINDOW_BITS = 11;
+const size_t GZIP_WINDOW_SIZE = (size_t)1 << GZIP_WINDOW_BITS;
+const int GZIP_HASH_BITS = 10;
+const size_t GZIP_HASH_SIZE = (size_t)1 << GZIP_HASH_BITS;
+const size_t GZIP_MIN_MATCH = 3;
+const size_t GZIP_MAX_MATCH = 258;
+const size_t GZIP_OUTPUT_SIZE = 256;  // Compressed bytes are handed on in pieces this size
+
+// Destination for compressed bytes
+class ByteSink {
+public:
+    virtual ~ByteSink() {}
+    // False stops the stream
+    virtual bool put(const uint8_t* data, size_t length) = 0;
+};
+
+class GzipEncoder {
+public:
+    GzipEncoder();
+
+    // Start a stream; levels above GZIP_MAX_LEVEL are clamped, 0 is taken as 1
+    void begin(ByteSink& sink, uint8_t level);
+
+    // Compress more input. False once the sink has refused output.
+    bool write(const uint8_t* data, size_t length);
+
+    // Code the remaining input, close the block and append the trailer
+    bool finish();
+
+    uint32_t getInputBytes() const { return inputBytes; }
+    uint32_t getOutputBytes() const { return outputBytes; }
+
+private:
+    void compress(bool flush);
+    void slide();
+    void insert(size_t at);
+    size_t longestMatch(size_t& distance);
+    void putBits(uint32_t bits, int count);
+    void putCode(uint32_t code, int length);
+    void putLiteral(uint8_t value);
+    void putMatch(size_t length, size_t distance);
+    void putByte(uint8_t value);
+    void flushOutput();
+
+    ByteSink* sink;
+    uint16_t maxChain;     // Candidates tried per position
+    bool insertMatched;    // Also index the positions inside a match
+
+    // Input for the last window plus the lookahead; slides down by one
+    // window when full. head and prev hold positions + 1, 0 for none.
+    uint8_t window[2 * GZIP_WINDOW_SIZE];
+    uint16_t head[GZIP_HASH_SIZE];
+    uint16_t prev[GZIP_WINDOW_SIZE];
+    size_t position;  // Next byte to code
+    size_t end;       // Bytes in window
+
+    uint32_t bitBuffer;
+    int bitCount;
+    uint8_t output[GZIP_OUTPUT_SIZE];
+    size_t outputUsed;
+
+    uint32_t crc;
+    uint32_t inputBytes;
+    uint32_t outputBytes;
+    bool failed;
+};
+
+#endif // GZIP_ENCODER_H
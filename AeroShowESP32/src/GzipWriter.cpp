@@ -0,0 +1,55 @@
+#include "GzipWriter.h"
+
+GzipWriter::GzipWriter()
+    : target(nullptr), level(0), inputBytes(0), compressMicros(0), sinkMicros(0), failed(true) {
+}
+
+void GzipWriter::begin(Print& out, uint8_t newLevel) {
+    target = &out;
+    level = newLevel;
+    inputBytes = 0;
+    compressMicros = 0;
+    sinkMicros = 0;
+    failed = false;
+    if (level > 0) {
+        encoder.begin(*this, level);
+    }
+}
+
+size_t GzipWriter::write(uint8_t value) {
+    return write(&value, 1);
+}
+
+size_t GzipWriter::write(const uint8_t* buffer, size_t size) {
+    if (failed) {
+        return 0;
+    }
+    inputBytes += size;
+    if (level == 0) {
+        put(buffer, size);
+        return failed ? 0 : size;
+    }
+
+    uint32_t sinkBefore = sinkMicros;
+    uint32_t start = micros();
+    encoder.write(buffer, size);
+    compressMicros += (micros() - start) - (sinkMicros - sinkBefore);
+    return failed ? 0 : size;
+}
+
+bool GzipWriter::finish() {
+    if (level > 0 && !failed) {
+        uint32_t sinkBefore = sinkMicros;
+        uint32_t start = micros();
+        encoder.finish();
+        compressMicros += (micros() - start) - (sinkMicros - sinkBefore);
+    }
+    return !failed;
+}
+
+bool GzipWriter::put(const uint8_t* data, size_t length) {
+    uint32_t start = micros();
+    failed = failed || target->write(data, length) != length;
+    sinkMicros += micros() - start;
+    return !failed;
+}
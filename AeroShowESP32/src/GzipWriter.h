@@ -0,0 +1,40 @@
+#ifndef GZIP_WRITER_H
+#define GZIP_WRITER_H
+
+#include <Arduino.h>
+#include "GzipEncoder.h"
+
+// Print adapter that gzips everything written to it into another Print
+// (the chunked request body), or passes it straight through at level 0.
+// Times the encoder and the downstream writes separately so the uploader
+// can tell CPU cost from uplink speed.
+class GzipWriter : public Print, private ByteSink {
+public:
+    GzipWriter();
+
+    // Start a body into target; level 0 sends it unencoded
+    void begin(Print& target, uint8_t level);
+
+    size_t write(uint8_t value) override;
+    size_t write(const uint8_t* buffer, size_t size) override;
+
+    // Flush the encoder and write the gzip trailer. False if target refused bytes.
+    bool finish();
+
+    uint32_t getInputBytes() const { return inputBytes; }
+    uint32_t getCompressMicros() const { return compressMicros; }
+    uint32_t getSinkMicros() const { return sinkMicros; }
+
+private:
+    bool put(const uint8_t* data, size_t length) override;
+
+    GzipEncoder encoder;
+    Print* target;
+    uint8_t level;
+    uint32_t inputBytes;
+    uint32_t compressMicros;  // In the encoder, excluding sink time
+    uint32_t sinkMicros;      // In target's write()
+    bool failed;
+};
+
+#endif // GZIP_WRITER_H
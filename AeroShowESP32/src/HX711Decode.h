@@ -0,0 +1,55 @@
+#ifndef HX711_DECODE_H
+#define HX711_DECODE_H
+
+#include <stdint.h>
+
+// Bit-level helpers for the HX711 serial protocol. Kept free of Arduino
+// calls so recorded DT bit streams can be decoded on the host.
+
+// Data bits shifted out per conversion (MSB first, two's complement)
+const int HX711_DATA_BITS = 24;
+
+// Extra SCK pulses after the data select the input and gain of the next conversion
+const int HX711_PULSES_GAIN_A128 = 1;
+const int HX711_PULSES_GAIN_B32 = 2;
+const int HX711_PULSES_GAIN_A64 = 3;
+
+// Output codes the HX711 clamps to when the input is out of range
+const int32_t HX711_MAX_CODE = 0x7FFFFF;
+const int32_t HX711_MIN_CODE = -0x800000;
+
+// One conversion result with the time DT signalled data-ready
+struct HX711Reading {
+    int32_t value = 0;
+    uint32_t timestampMicros = 0;
+};
+
+// Sign-extend a 24-bit two's complement value to 32 bits
+inline int32_t hx711SignExtend(uint32_t raw) {
+    raw &= 0xFFFFFF;
+    if (raw & 0x800000) {
+        raw |= 0xFF000000;
+    }
+    return (int32_t)raw;
+}
+
+// Shift one sampled DT level into an accumulating raw value
+inline uint32_t hx711ShiftBit(uint32_t raw, int level) {
+    return (raw << 1) | (level ? 1u : 0u);
+}
+
+// Decode HX711_DATA_BITS sampled DT levels (one per element, MSB first)
+inline int32_t hx711DecodeBits(const uint8_t* levels) {
+    uint32_t raw = 0;
+    for (int i = 0; i < HX711_DATA_BITS; i++) {
+        raw = hx711ShiftBit(raw, levels[i]);
+    }
+    return hx711SignExtend(raw);
+}
+
+// True if the reading sits on either clamp code
+inline bool hx711IsSaturated(int32_t value) {
+    return value == HX711_MAX_CODE || value == HX711_MIN_CODE;
+}
+
+#endif // HX711_DECODE_H
@@ -0,0 +1,105 @@
+#include "HX711Reader.h"
+
+HX711Reader::HX711Reader(int dtPin, int sckPin, int gainPulses, int ratePin)
+    : dtPin(dtPin), sckPin(sckPin), gainPulses(gainPulses), ratePin(ratePin),
+      queue(nullptr), overflowCount(0), readingCount(0) {
+}
+
+bool HX711Reader::begin(size_t queueLength) {
+    pinMode(dtPin, INPUT);
+    pinMode(sckPin, OUTPUT);
+    digitalWrite(sckPin, LOW);
+    if (ratePin >= 0) {
+        // 80 SPS; takes effect from the power cycle in reset()
+        pinMode(ratePin, OUTPUT);
+        digitalWrite(ratePin, HIGH);
+    }
+
+    if (queue == nullptr) {
+        queue = xQueueCreate(queueLength, sizeof(HX711Reading));
+        if (queue == nullptr) {
+            return false;
+        }
+    }
+
+    reset();
+    attachInterruptArg(digitalPinToInterrupt(dtPin), onDataReady, this, FALLING);
+    return true;
+}
+
+void HX711Reader::reset() {
+    // SCK high for more than 60us powers the chip down; low again powers it up
+    digitalWrite(sckPin, HIGH);
+    delayMicroseconds(100);
+    digitalWrite(sckPin, LOW);
+}
+
+bool HX711Reader::read(HX711Reading& reading) {
+    if (queue == nullptr) {
+        return false;
+    }
+    return xQueueReceive(queue, &reading, 0) == pdTRUE;
+}
+
+bool HX711Reader::readLatest(HX711Reading& reading) {
+    bool gotReading = false;
+    while (read(reading)) {
+        gotReading = true;
+    }
+    return gotReading;
+}
+
+bool HX711Reader::waitForReading(HX711Reading& reading, uint32_t timeoutMs) {
+    if (queue == nullptr) {
+        return false;
+    }
+    return xQueueReceive(queue, &reading, pdMS_TO_TICKS(timeoutMs)) == pdTRUE;
+}
+
+void IRAM_ATTR HX711Reader::onDataReady(void* arg) {
+    static_cast<HX711Reader*>(arg)->shiftIn();
+}
+
+void IRAM_ATTR HX711Reader::shiftIn() {
+    // Clocking out the data toggles DT, which latches another edge. That edge
+    // is serviced after we return, when DT is already back high, so ignore it.
+    if (digitalRead(dtPin) != LOW) {
+        return;
+    }
+
+    HX711Reading reading;
+    reading.timestampMicros = micros();
+
+    // SCK high time must stay well under 60us or the HX711 powers down
+    uint32_t raw = 0;
+    for (int i = 0; i < HX711_DATA_BITS; i++) {
+        digitalWrite(sckPin, HIGH);
+        delayMicroseconds(1);
+        raw = hx711ShiftBit(raw, digitalRead(dtPin));
+        digitalWrite(sckPin, LOW);
+        delayMicroseconds(1);
+    }
+
+    // Extra pulses select channel and gain for the next conversion
+    for (int i = 0; i < gainPulses; i++) {
+        digitalWrite(sckPin, HIGH);
+        delayMicroseconds(1);
+        digitalWrite(sckPin, LOW);
+        delayMicroseconds(1);
+    }
+
+    reading.value = hx711SignExtend(raw);
+    readingCount++;
+
+    BaseType_t higherPriorityTaskWoken = pdFALSE;
+    if (xQueueSendFromISR(queue, &reading, &higherPriorityTaskWoken) != pdTRUE) {
+        // Queue full: drop the oldest reading so the newest one is kept
+        HX711Reading discarded;
+        xQueueReceiveFromISR(queue, &discarded, &higherPriorityTaskWoken);
+        xQueueSendFromISR(queue, &reading, &higherPriorityTaskWoken);
+        overflowCount++;
+    }
+    if (higherPriorityTaskWoken) {
+        portYIELD_FROM_ISR();
+    }
+}
@@ -0,0 +1,50 @@
+#ifndef HX711_READER_H
+#define HX711_READER_H
+
+#include <Arduino.h>
+#include "HX711Decode.h"
+#include "Hal.h"
+
+// Interrupt-driven HX711 driver. The DT falling edge (data ready) triggers an
+// ISR that clocks out the 24 data bits and queues a timestamped reading, so
+// callers never wait on a conversion.
+class HX711Reader : public LoadCellInput {
+public:
+    // ratePin drives RATE high for 80 SPS; -1 where the board straps it
+    HX711Reader(int dtPin, int sckPin, int gainPulses = HX711_PULSES_GAIN_A128, int ratePin = -1);
+
+    // Configure pins, create the reading queue and attach the data-ready interrupt
+    bool begin(size_t queueLength = 16);
+
+    // Power-cycle the HX711 by holding SCK high, then restart conversions
+    void reset();
+
+    // Pop the oldest queued reading without blocking
+    bool read(HX711Reading& reading) override;
+
+    // Drain the queue and keep only the newest reading, without blocking
+    bool readLatest(HX711Reading& reading);
+
+    // Wait up to timeoutMs for a reading (setup-time use only)
+    bool waitForReading(HX711Reading& reading, uint32_t timeoutMs);
+
+    // Readings discarded because the queue was full
+    uint32_t getOverflowCount() const { return overflowCount; }
+
+    // Conversions clocked out since begin()
+    uint32_t getReadingCount() const { return readingCount; }
+
+private:
+    static void onDataReady(void* arg);
+    void shiftIn();
+
+    int dtPin;
+    int sckPin;
+    int gainPulses;
+    int ratePin;
+    QueueHandle_t queue;
+    volatile uint32_t overflowCount;
+    volatile uint32_t readingCount;
+};
+
+#endif // HX711_READER_H
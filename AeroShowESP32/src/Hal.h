@@ -0,0 +1,61 @@
+#ifndef HAL_H
+#define HAL_H
+
+#include <stdint.h>
+#include "HX711Decode.h"
+
+// Hardware seams for rig logic that should also run off-target. The device
+// build binds them to Arduino (ArduinoHal.h); the native build binds them
+// to the simulators in src/sim. I2C devices use I2CBus.h.
+
+// Time source and blocking delay
+class Clock {
+public:
+    virtual ~Clock() {}
+    virtual uint32_t millis() = 0;
+    virtual uint32_t micros() = 0;
+    // Microseconds since boot; never wraps
+    virtual uint64_t micros64() = 0;
+    virtual void delay(uint32_t ms) = 0;
+};
+
+// Servo-style pulse output driving an ESC
+class PwmOutput {
+public:
+    virtual ~PwmOutput() {}
+    virtual bool attach(int minPulseUs, int maxPulseUs) = 0;
+    virtual void writeMicroseconds(int pulseUs) = 0;
+};
+
+// Load cell ADC delivering timestamped conversions
+class LoadCellInput {
+public:
+    virtual ~LoadCellInput() {}
+    // Oldest conversion not yet read; never waits. Every conversion is
+    // delivered once, so filters see the full stream.
+    virtual bool read(HX711Reading& reading) = 0;
+};
+
+// Rotor speed reported back by an ESC
+struct EscRpmReading {
+    float rpm = 0.0f;          // Mechanical RPM
+    uint32_t timestampMs = 0;  // millis() when the ESC's reply was decoded
+};
+
+// Throttle command output driving an ESC in whatever protocol it speaks
+class ThrottleOutput {
+public:
+    virtual ~ThrottleOutput() {}
+    virtual bool begin() = 0;
+    // 0.0 is stopped, 1.0 is full throttle
+    virtual void writeThrottle(float throttle) = 0;
+    // How often the ESC receives a command
+    virtual uint32_t getCommandRateHz() const = 0;
+    // Latest RPM for outputs that get telemetry back; false if there is none yet
+    virtual bool readRpm(EscRpmReading& reading) const {
+        (void)reading;
+        return false;
+    }
+};
+
+#endif // HAL_H
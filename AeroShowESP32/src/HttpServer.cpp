@@ -0,0 +1,846 @@
+#include "HttpServer.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#ifdef ARDUINO
+#include <lwip/sockets.h>
+#else
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#endif
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+namespace {
+
+// Chunk size field ("xxxx\r\n") reserved at the start of each part, and room
+// kept at the end for its "\r\n" and the last chunk "0\r\n\r\n"
+const size_t CHUNK_HEAD = 6;
+const size_t CHUNK_TAIL = 7;
+const size_t OUTPUT_LIMIT = HTTP_OUTPUT_BYTES - CHUNK_TAIL;
+
+const char* reason(int code) {
+    switch (code) {
+    case 200: return "OK";
+    case 202: return "Accepted";
+    case 400: return "Bad Request";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    case 409: return "Conflict";
+    case 411: return "Length Required";
+    case 413: return "Payload Too Large";
+    case 414: return "URI Too Long";
+    case 431: return "Request Header Fields Too Large";
+    case 500: return "Internal Server Error";
+    case 503: return "Service Unavailable";
+    default: return code < 400 ? "OK" : "Error";
+    }
+}
+
+int hexDigit(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+// Cut the next line off a NUL-terminated head, without its CR
+char* takeLine(char*& at) {
+    char* line = at;
+    char* newline = strchr(at, '\n');
+    if (newline != nullptr) {
+        *newline = '\0';
+        at = newline + 1;
+    } else {
+        at = line + strlen(line);
+    }
+    size_t length = strlen(line);
+    if (length > 0 && line[length - 1] == '\r') {
+        line[length - 1] = '\0';
+    }
+    return line;
+}
+
+// Whether a comma-separated header value lists token, ignoring case
+bool hasToken(const char* value, const char* token) {
+    size_t length = strlen(token);
+    for (const char* at = value; *at != '\0'; at++) {
+        if (strncasecmp(at, token, length) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool wouldBlock() {
+    return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+}
+
+void setNonBlocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    fcntl(fd, F_SETFL, (flags < 0 ? 0 : flags) | O_NONBLOCK);
+}
+
+}  // namespace
+
+HttpRequest::HttpRequest() : fd(-1), state(State::Free), call(Call::Request), lastActivityMs(0), inputUsed(0) {
+    reset();
+}
+
+void HttpRequest::reset() {
+    route = 0;
+    requestMethod = HttpMethod::Other;
+    target[0] = '\0';
+    query = nullptr;
+    keepAlive = false;
+    expectContinue = false;
+    holdsRoute = false;
+    contentLength = 0;
+    bodyRead = 0;
+    pieceLength = 0;
+    outputUsed = 0;
+    outputSent = 0;
+    chunkStart = 0;
+    responsePart = 0;
+    started = false;
+    chunked = false;
+    wantsMore = false;
+    overflowed = false;
+    detached = false;
+}
+
+const char* HttpRequest::findArg(const char* name) const {
+    if (query == nullptr) {
+        return nullptr;
+    }
+    size_t length = strlen(name);
+    const char* at = query;
+    while (*at != '\0') {
+        const char* end = strchr(at, '&');
+        if (end == nullptr) {
+            end = at + strlen(at);
+        }
+        if ((size_t)(end - at) >= length && strncmp(at, name, length) == 0 &&
+            (at + length == end || at[length] == '=')) {
+            return at + length;
+        }
+        at = *end == '&' ? end + 1 : end;
+    }
+    return nullptr;
+}
+
+bool HttpRequest::hasArg(const char* name) const {
+    return findArg(name) != nullptr;
+}
+
+bool HttpRequest::arg(const char* name, char* value, size_t size) const {
+    const char* at = findArg(name);
+    if (at == nullptr || size == 0) {
+        return false;
+    }
+    if (*at == '=') {
+        at++;
+    }
+    size_t used = 0;
+    while (*at != '\0' && *at != '&' && used + 1 < size) {
+        char c = *at++;
+        if (c == '+') {
+            c = ' ';
+        } else if (c == '%' && hexDigit(at[0]) >= 0 && hexDigit(at[1]) >= 0) {
+            c = (char)(hexDigit(at[0]) * 16 + hexDigit(at[1]));
+            at += 2;
+        }
+        value[used++] = c;
+    }
+    value[used] = '\0';
+    return true;
+}
+
+void HttpRequest::appendHead(int code, const char* contentType, long length) {
+    char framing[40];
+    if (length < 0) {
+        snprintf(framing, sizeof(framing), "Transfer-Encoding: chunked");
+    } else {
+        snprintf(framing, sizeof(framing), "Content-Length: %ld", length);
+    }
+    int n = snprintf(output + outputUsed, OUTPUT_LIMIT - outputUsed,
+                     "HTTP/1.1 %d %s\r\nContent-Type: %s\r\n%s\r\nConnection: %s\r\n\r\n", code, reason(code),
+                     contentType, framing, keepAlive ? "keep-alive" : "close");
+    if (n > 0) {
+        outputUsed += (size_t)n < OUTPUT_LIMIT - outputUsed ? (size_t)n : OUTPUT_LIMIT - outputUsed - 1;
+    }
+}
+
+void HttpRequest::append(const char* data, size_t length) {
+    size_t room = outputUsed < OUTPUT_LIMIT ? OUTPUT_LIMIT - outputUsed : 0;
+    if (length > room) {
+        overflowed = true;
+        length = room;
+    }
+    memcpy(output + outputUsed, data, length);
+    outputUsed += length;
+}
+
+void HttpRequest::respond(int code, const char* contentType, const char* body) {
+    size_t length = strlen(body);
+    outputUsed = 0;
+    started = true;
+    chunked = false;
+    appendHead(code, contentType, (long)length);
+    if (outputUsed + length > OUTPUT_LIMIT) {
+        overflowed = true;
+        outputUsed = 0;
+        appendHead(500, contentType, 0);
+        return;
+    }
+    append(body, length);
+}
+
+void HttpRequest::begin(int code, const char* contentType) {
+    outputUsed = 0;
+    started = true;
+    chunked = true;
+    appendHead(code, contentType, -1);
+    openChunk();
+}
+
+size_t HttpRequest::write(const char* data, size_t length) {
+    if (!started || detached) {
+        return 0;
+    }
+    append(data, length);
+    return length;
+}
+
+size_t HttpRequest::print(const char* text) {
+    return write(text, strlen(text));
+}
+
+size_t HttpRequest::format(const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    size_t n = vformat(format, args);
+    va_end(args);
+    return n;
+}
+
+size_t HttpRequest::vformat(const char* format, va_list args) {
+    if (!started || detached || outputUsed >= OUTPUT_LIMIT) {
+        return 0;
+    }
+    // The NUL lands in the room kept for the chunk tail
+    size_t room = OUTPUT_LIMIT - outputUsed;
+    int n = vsnprintf(output + outputUsed, room + 1, format, args);
+    if (n < 0) {
+        return 0;
+    }
+    if ((size_t)n > room) {
+        overflowed = true;
+        n = (int)room;
+    }
+    outputUsed += n;
+    return n;
+}
+
+int HttpRequest::detach() {
+    detached = true;
+    return fd;
+}
+
+void HttpRequest::openChunk() {
+    chunkStart = outputUsed;
+    append("000000", CHUNK_HEAD);
+}
+
+void HttpRequest::closeChunk(bool last) {
+    size_t length = outputUsed - chunkStart - CHUNK_HEAD;
+    if (length == 0) {
+        // An empty chunk would end the response
+        outputUsed = chunkStart;
+    } else {
+        char head[CHUNK_HEAD + 1];
+        snprintf(head, sizeof(head), "%04x\r\n", (unsigned)length);
+        memcpy(output + chunkStart, head, CHUNK_HEAD);
+        memcpy(output + outputUsed, "\r\n", 2);
+        outputUsed += 2;
+    }
+    if (last) {
+        memcpy(output + outputUsed, "0\r\n\r\n", 5);
+        outputUsed += 5;
+    }
+}
+
+HttpServer::HttpServer(Clock& clock) : clock(clock), listener(-1), port(0), routeCount(0) {
+}
+
+HttpServer::~HttpServer() {
+    end();
+}
+
+bool HttpServer::on(const char* path, HttpMethod method, HttpHandler handler, HttpBodyHandler body) {
+    if (routeCount == HTTP_MAX_ROUTES || handler == nullptr) {
+        return false;
+    }
+    Route& route = routes[routeCount++];
+    route.path = path;
+    route.method = method;
+    route.handler = handler;
+    route.body = body;
+    route.busy = false;
+    return true;
+}
+
+bool HttpServer::begin(uint16_t listenPort) {
+    listener = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (listener < 0) {
+        return false;
+    }
+    int yes = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(listenPort);
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (::bind(listener, (struct sockaddr*)&address, sizeof(address)) < 0 ||
+        ::listen(listener, HTTP_MAX_CONNECTIONS) < 0) {
+        ::close(listener);
+        listener = -1;
+        return false;
+    }
+    setNonBlocking(listener);
+
+    socklen_t length = sizeof(address);
+    getsockname(listener, (struct sockaddr*)&address, &length);
+    port = ntohs(address.sin_port);
+    return true;
+}
+
+void HttpServer::end() {
+    for (size_t i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+        if (slots[i].fd >= 0) {
+            closeConnection(slots[i]);
+        }
+    }
+    if (listener >= 0) {
+        ::close(listener);
+        listener = -1;
+    }
+}
+
+void HttpServer::serve(uint32_t waitMs) {
+    uint32_t now = clock.millis();
+    uint8_t index;
+    while (replies.pop(index)) {
+        returned(slots[index], now);
+    }
+
+    // Only sockets in a state that wants them are waited on; what the core
+    // holds is picked up from the reply queue on the next call
+    fd_set readable;
+    fd_set writable;
+    FD_ZERO(&readable);
+    FD_ZERO(&writable);
+    int highest = -1;
+    bool coreHolds = false;
+    int polled[HTTP_MAX_CONNECTIONS];
+    if (listener >= 0 && canAccept()) {
+        FD_SET(listener, &readable);
+        highest = listener;
+    }
+    for (size_t i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+        HttpRequest& connection = slots[i];
+        polled[i] = -1;
+        if (connection.state == HttpRequest::State::Head || connection.state == HttpRequest::State::Body) {
+            FD_SET(connection.fd, &readable);
+        } else if (connection.state == HttpRequest::State::Sending) {
+            FD_SET(connection.fd, &writable);
+        } else {
+            coreHolds = coreHolds || connection.state == HttpRequest::State::Core;
+            continue;
+        }
+        polled[i] = connection.fd;
+        highest = connection.fd > highest ? connection.fd : highest;
+    }
+
+    uint32_t wait = coreHolds && waitMs > HTTP_REPLY_POLL_MS ? HTTP_REPLY_POLL_MS : waitMs;
+    if (highest < 0) {
+        if (wait > 0) {
+            clock.delay(wait);
+        }
+        return;
+    }
+    struct timeval timeout;
+    timeout.tv_sec = wait / 1000;
+    timeout.tv_usec = (wait % 1000) * 1000;
+    int ready = ::select(highest + 1, &readable, &writable, nullptr, &timeout);
+    if (ready < 0) {
+        return;
+    }
+
+    now = clock.millis();
+    if (ready > 0) {
+        for (size_t i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+            HttpRequest& connection = slots[i];
+            if (polled[i] < 0 || connection.fd != polled[i]) {
+                continue;
+            }
+            if ((connection.state == HttpRequest::State::Head || connection.state == HttpRequest::State::Body) &&
+                FD_ISSET(connection.fd, &readable)) {
+                receive(connection, now);
+            } else if (connection.state == HttpRequest::State::Sending && FD_ISSET(connection.fd, &writable)) {
+                transmit(connection, now);
+            }
+        }
+        if (listener >= 0 && FD_ISSET(listener, &readable)) {
+            acceptClient(now);
+        }
+    }
+
+    for (size_t i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+        HttpRequest& connection = slots[i];
+        bool waitingOnClient = connection.state == HttpRequest::State::Head ||
+                               connection.state == HttpRequest::State::Body ||
+                               connection.state == HttpRequest::State::Sending;
+        if (waitingOnClient && now - connection.lastActivityMs > HTTP_IDLE_TIMEOUT_MS) {
+            timeouts.fetch_add(1, std::memory_order_relaxed);
+            drop(connection);
+        }
+    }
+}
+
+// Room for a new client: a free slot, or an idle keep-alive connection to close
+bool HttpServer::canAccept() const {
+    for (size_t i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+        const HttpRequest& connection = slots[i];
+        if (connection.state == HttpRequest::State::Free ||
+            (connection.state == HttpRequest::State::Head && connection.inputUsed == 0)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void HttpServer::acceptClient(uint32_t now) {
+    // Look again: a connection that was idle may have had a request since,
+    // and a client left in the backlog is better than one closed
+    HttpRequest* slot = nullptr;
+    HttpRequest* idle = nullptr;
+    for (size_t i = 0; i < HTTP_MAX_CONNECTIONS && slot == nullptr; i++) {
+        HttpRequest& connection = slots[i];
+        if (connection.state == HttpRequest::State::Free) {
+            slot = &connection;
+        } else if (connection.state == HttpRequest::State::Head && connection.inputUsed == 0 &&
+                   (idle == nullptr || now - connection.lastActivityMs > now - idle->lastActivityMs)) {
+            idle = &connection;
+        }
+    }
+    if (slot == nullptr && idle == nullptr) {
+        return;
+    }
+    int fd = ::accept(listener, nullptr, nullptr);
+    if (fd < 0) {
+        return;
+    }
+    if (slot == nullptr) {
+        evicted.fetch_add(1, std::memory_order_relaxed);
+        closeConnection(*idle);
+        slot = idle;
+    }
+
+    setNonBlocking(fd);
+    int yes = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+    slot->reset();
+    slot->fd = fd;
+    slot->state = HttpRequest::State::Head;
+    slot->inputUsed = 0;
+    slot->lastActivityMs = now;
+    connections.fetch_add(1, std::memory_order_relaxed);
+    open.fetch_add(1, std::memory_order_relaxed);
+}
+
+void HttpServer::receive(HttpRequest& connection, uint32_t now) {
+    size_t room = HTTP_INPUT_BYTES - connection.inputUsed;
+    if (connection.state == HttpRequest::State::Body) {
+        // Never past the body, so the next request's head stays in the socket
+        size_t remaining = connection.contentLength - connection.bodyRead - connection.inputUsed;
+        room = remaining < room ? remaining : room;
+    }
+    if (room == 0) {
+        return;
+    }
+    ssize_t n = ::recv(connection.fd, connection.input + connection.inputUsed, room, 0);
+    if (n <= 0) {
+        if (n < 0 && wouldBlock()) {
+            return;
+        }
+        drop(connection);
+        return;
+    }
+    connection.inputUsed += (size_t)n;
+    connection.lastActivityMs = now;
+    if (connection.state == HttpRequest::State::Head) {
+        parseHead(connection, now);
+    } else {
+        bodyProgress(connection);
+    }
+}
+
+void HttpServer::parseHead(HttpRequest& connection, uint32_t now) {
+    char* input = connection.input;
+    size_t end = 0;
+    for (size_t i = 3; i < connection.inputUsed; i++) {
+        if (input[i] == '\n' && input[i - 1] == '\r' && input[i - 2] == '\n' && input[i - 3] == '\r') {
+            end = i + 1;
+            break;
+        }
+    }
+    if (end == 0) {
+        if (connection.inputUsed == HTTP_INPUT_BYTES) {
+            connection.keepAlive = false;
+            refuse(connection, 431, "Request head too large", now);
+        }
+        return;
+    }
+
+    requests.fetch_add(1, std::memory_order_relaxed);
+    connection.reset();
+    connection.route = NO_ROUTE;
+
+    // The head is consumed below, so it is cut up in place
+    input[end - 1] = '\0';
+    char* at = input;
+    char* method = takeLine(at);
+    char* targetText = strchr(method, ' ');
+    char* version = targetText != nullptr ? strchr(targetText + 1, ' ') : nullptr;
+    if (version == nullptr || strncmp(version + 1, "HTTP/1.", 7) != 0) {
+        refuse(connection, 400, "Bad request", now);
+        return;
+    }
+    *targetText++ = '\0';
+    *version++ = '\0';
+    if (strlen(targetText) >= HTTP_TARGET_CHARS) {
+        refuse(connection, 414, "URI too long", now);
+        return;
+    }
+    connection.requestMethod = strcmp(method, "GET") == 0    ? HttpMethod::Get
+                               : strcmp(method, "POST") == 0 ? HttpMethod::Post
+                                                             : HttpMethod::Other;
+    connection.keepAlive = version[7] != '0';  // HTTP/1.1 keeps the connection by default
+    strcpy(connection.target, targetText);
+    char* question = strchr(connection.target, '?');
+    if (question != nullptr) {
+        *question = '\0';
+        connection.query = question + 1;
+    }
+
+    bool lengthKnown = true;
+    while (*at != '\0') {
+        char* line = takeLine(at);
+        char* colon = strchr(line, ':');
+        if (colon == nullptr) {
+            continue;
+        }
+        *colon = '\0';
+        char* value = colon + 1;
+        while (*value == ' ' || *value == '\t') {
+            value++;
+        }
+        if (strcasecmp(line, "Content-Length") == 0) {
+            char* digitsEnd = nullptr;
+            unsigned long length = strtoul(value, &digitsEnd, 10);
+            if (digitsEnd == value || length > 0xffffffffUL) {
+                refuse(connection, 400, "Bad Content-Length", now);
+                return;
+            }
+            connection.contentLength = (uint32_t)length;
+        } else if (strcasecmp(line, "Transfer-Encoding") == 0) {
+            lengthKnown = false;
+        } else if (strcasecmp(line, "Connection") == 0) {
+            if (hasToken(value, "close")) {
+                connection.keepAlive = false;
+            } else if (hasToken(value, "keep-alive")) {
+                connection.keepAlive = true;
+            }
+        } else if (strcasecmp(line, "Expect") == 0) {
+            connection.expectContinue = hasToken(value, "100-continue");
+        }
+    }
+    memmove(input, input + end, connection.inputUsed - end);
+    connection.inputUsed -= end;
+
+    bool pathFound = false;
+    for (size_t i = 0; i < routeCount; i++) {
+        if (strcmp(routes[i].path, connection.target) == 0) {
+            pathFound = true;
+            if (routes[i].method == connection.requestMethod) {
+                connection.route = (uint8_t)i;
+                break;
+            }
+        }
+    }
+    bool tooLarge = connection.route != NO_ROUTE && routes[connection.route].body == nullptr &&
+                    connection.contentLength > HTTP_INPUT_BYTES;
+    if (connection.route == NO_ROUTE || !lengthKnown || tooLarge) {
+        // A body left unread would be taken for the next request
+        if (connection.contentLength > 0 || !lengthKnown) {
+            connection.keepAlive = false;
+        }
+        if (connection.route == NO_ROUTE) {
+            refuse(connection, pathFound ? 405 : 404, pathFound ? "Method not allowed" : "Not found", now);
+        } else if (!lengthKnown) {
+            refuse(connection, 411, "Length required", now);
+        } else {
+            refuse(connection, 413, "Request too large", now);
+        }
+        return;
+    }
+    connection.state = HttpRequest::State::Waiting;
+    start(connection);
+}
+
+void HttpServer::start(HttpRequest& connection) {
+    Route& route = routes[connection.route];
+    if (route.body != nullptr) {
+        if (route.busy) {
+            return;
+        }
+        route.busy = true;
+        connection.holdsRoute = true;
+    }
+    if (connection.expectContinue && connection.contentLength > 0) {
+        // A fresh socket always has room for this; a client that misses it
+        // sends the body after a short wait anyway
+        static const char CONTINUE[] = "HTTP/1.1 100 Continue\r\n\r\n";
+        ::send(connection.fd, CONTINUE, sizeof(CONTINUE) - 1, MSG_NOSIGNAL);
+    }
+    if (route.body != nullptr) {
+        size_t piece = connection.inputUsed < connection.contentLength ? connection.inputUsed : connection.contentLength;
+        handOver(connection, HttpRequest::Call::Request, piece);
+    } else if (connection.inputUsed >= connection.contentLength) {
+        handOver(connection, HttpRequest::Call::Request, connection.contentLength);
+    } else {
+        connection.state = HttpRequest::State::Body;
+    }
+}
+
+void HttpServer::bodyProgress(HttpRequest& connection) {
+    if (routes[connection.route].body == nullptr) {
+        if (connection.inputUsed >= connection.contentLength) {
+            handOver(connection, HttpRequest::Call::Request, connection.contentLength);
+        }
+        return;
+    }
+    // Streamed bodies go over a full buffer at a time, or whatever ends the body
+    size_t remaining = connection.contentLength - connection.bodyRead;
+    if (connection.inputUsed >= remaining || connection.inputUsed == HTTP_INPUT_BYTES) {
+        handOver(connection, HttpRequest::Call::Body,
+                 connection.inputUsed < remaining ? connection.inputUsed : remaining);
+    }
+}
+
+void HttpServer::handOver(HttpRequest& connection, HttpRequest::Call call, size_t piece) {
+    connection.call = call;
+    connection.pieceLength = piece;
+    connection.state = HttpRequest::State::Core;
+    calls.push((uint8_t)indexOf(connection));
+}
+
+size_t HttpServer::dispatch() {
+    size_t handled = 0;
+    uint8_t index;
+    while (calls.pop(index)) {
+        HttpRequest& connection = slots[index];
+        const Route& route = routes[connection.route];
+        bool complete = connection.bodyRead + connection.pieceLength >= connection.contentLength;
+        switch (connection.call) {
+        case HttpRequest::Call::Request:
+            if (route.body != nullptr) {
+                route.body(connection, HttpBody::Start, connection.input, 0);
+                if (connection.pieceLength > 0) {
+                    route.body(connection, HttpBody::Data, connection.input, connection.pieceLength);
+                }
+            }
+            if (complete) {
+                runHandler(connection, route);
+            }
+            break;
+        case HttpRequest::Call::Body:
+            route.body(connection, HttpBody::Data, connection.input, connection.pieceLength);
+            if (complete) {
+                runHandler(connection, route);
+            }
+            break;
+        case HttpRequest::Call::More:
+            connection.responsePart++;
+            runHandler(connection, route);
+            break;
+        case HttpRequest::Call::Aborted:
+            route.body(connection, HttpBody::Aborted, nullptr, 0);
+            break;
+        }
+        replies.push(index);
+        handled++;
+    }
+    return handled;
+}
+
+void HttpServer::runHandler(HttpRequest& connection, const Route& route) {
+    connection.outputUsed = 0;
+    connection.outputSent = 0;
+    connection.wantsMore = false;
+    if (connection.chunked) {
+        connection.openChunk();
+    }
+    route.handler(connection);
+    if (connection.detached) {
+        return;
+    }
+    if (!connection.started) {
+        connection.respond(500, "application/json", "{\"error\":\"No response\"}");
+    }
+    if (connection.chunked) {
+        connection.closeChunk(!connection.wantsMore);
+    } else {
+        connection.wantsMore = false;
+    }
+    if (connection.overflowed) {
+        connection.overflowed = false;
+        truncated.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void HttpServer::returned(HttpRequest& connection, uint32_t now) {
+    if (connection.detached) {
+        // The socket is the handler's now
+        release(connection);
+        connection.fd = -1;
+        connection.state = HttpRequest::State::Free;
+        connection.inputUsed = 0;
+        open.fetch_sub(1, std::memory_order_relaxed);
+        return;
+    }
+
+    // The core is done with the body bytes it was given
+    if (connection.pieceLength > 0) {
+        memmove(connection.input, connection.input + connection.pieceLength,
+                connection.inputUsed - connection.pieceLength);
+        connection.inputUsed -= connection.pieceLength;
+        connection.bodyRead += connection.pieceLength;
+        connection.pieceLength = 0;
+    }
+    connection.lastActivityMs = now;
+    if (connection.call == HttpRequest::Call::Aborted) {
+        closeConnection(connection);
+    } else if (connection.outputUsed > 0) {
+        connection.state = HttpRequest::State::Sending;
+        transmit(connection, now);
+    } else if (connection.bodyRead < connection.contentLength) {
+        connection.state = HttpRequest::State::Body;
+        bodyProgress(connection);
+    } else if (connection.wantsMore) {
+        handOver(connection, HttpRequest::Call::More, 0);
+    } else {
+        finish(connection, now);
+    }
+}
+
+void HttpServer::transmit(HttpRequest& connection, uint32_t now) {
+    ssize_t n = ::send(connection.fd, connection.output + connection.outputSent,
+                       connection.outputUsed - connection.outputSent, MSG_NOSIGNAL);
+    if (n < 0) {
+        if (!wouldBlock()) {
+            drop(connection);
+        }
+        return;
+    }
+    connection.outputSent += (size_t)n;
+    connection.lastActivityMs = now;
+    if (connection.outputSent < connection.outputUsed) {
+        return;
+    }
+    connection.outputUsed = 0;
+    connection.outputSent = 0;
+    if (connection.wantsMore) {
+        handOver(connection, HttpRequest::Call::More, 0);
+    } else {
+        finish(connection, now);
+    }
+}
+
+void HttpServer::finish(HttpRequest& connection, uint32_t now) {
+    release(connection);
+    if (!connection.keepAlive) {
+        closeConnection(connection);
+        return;
+    }
+    connection.reset();
+    connection.state = HttpRequest::State::Head;
+    connection.lastActivityMs = now;
+    if (connection.inputUsed > 0) {
+        parseHead(connection, now);  // Pipelined behind the last one
+    }
+}
+
+void HttpServer::refuse(HttpRequest& connection, int code, const char* message, uint32_t now) {
+    refused.fetch_add(1, std::memory_order_relaxed);
+    char body[64];
+    snprintf(body, sizeof(body), "{\"error\":\"%s\"}", message);
+    connection.respond(code, "application/json", body);
+    connection.outputSent = 0;
+    connection.state = HttpRequest::State::Sending;
+    connection.lastActivityMs = now;
+}
+
+// The client went away, failed or stalled
+void HttpServer::drop(HttpRequest& connection) {
+    if (connection.state == HttpRequest::State::Body && connection.holdsRoute) {
+        // Its body handler has started and must hear that the rest is not coming
+        handOver(connection, HttpRequest::Call::Aborted, 0);
+        return;
+    }
+    closeConnection(connection);
+}
+
+void HttpServer::closeConnection(HttpRequest& connection) {
+    release(connection);
+    if (connection.fd >= 0) {
+        ::close(connection.fd);
+        open.fetch_sub(1, std::memory_order_relaxed);
+    }
+    connection.fd = -1;
+    connection.state = HttpRequest::State::Free;
+    connection.inputUsed = 0;
+}
+
+// Let the next request waiting for this connection's route have it
+void HttpServer::release(HttpRequest& connection) {
+    if (!connection.holdsRoute) {
+        return;
+    }
+    connection.holdsRoute = false;
+    routes[connection.route].busy = false;
+    for (size_t i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+        if (slots[i].state == HttpRequest::State::Waiting && slots[i].route == connection.route) {
+            start(slots[i]);
+            return;
+        }
+    }
+}
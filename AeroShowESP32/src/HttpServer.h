@@ -0,0 +1,236 @@
+#ifndef HTTP_SERVER_H
+#define HTTP_SERVER_H
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include "Hal.h"
+#include "SampleRing.h"
+
+// Event-driven HTTP/1.1 server for the control API. One task calls serve(),
+// which waits on every socket at once and only reads or writes what a
+// socket is ready for, so a slow or stalled client holds its own connection
+// slot and nothing else. Handlers never run in that task: a request that
+// has arrived is passed to the control core through a message queue,
+// dispatch() on loop() runs its handler, which writes the response into the
+// connection's buffer, and the connection goes back through a second queue
+// for serve() to send. A connection belongs to one side at a time, so
+// neither needs a lock. Plain BSD sockets (lwIP on the device) and no heap,
+// so the server is load tested on the host.
+
+// Connections served at once (1-8); further clients wait in the listen
+// backlog, and an idle keep-alive connection is closed to make room
+#ifndef HTTP_MAX_CONNECTIONS
+#define HTTP_MAX_CONNECTIONS 4
+#endif
+static_assert(HTTP_MAX_CONNECTIONS >= 1 && HTTP_MAX_CONNECTIONS <= 8, "HTTP_MAX_CONNECTIONS must be 1-8");
+
+const size_t HTTP_MAX_ROUTES = 12;
+
+// Request head, or body bytes not yet handed to the core: one TCP segment
+// on WiFi. Routes without a body handler get their body whole, so it must
+// fit here (413 otherwise).
+const size_t HTTP_INPUT_BYTES = 1436;
+
+// Response bytes per part; a handler with more to send asks for another part
+const size_t HTTP_OUTPUT_BYTES = 3072;
+
+// Path and query of a request (414 if longer)
+const size_t HTTP_TARGET_CHARS = 128;
+
+// A keep-alive connection with no request, or a request or response that
+// makes no progress, is closed after this long
+const uint32_t HTTP_IDLE_TIMEOUT_MS = 10000;
+
+// Longest serve() sleeps while the core holds a connection, so its reply is
+// picked up promptly
+const uint32_t HTTP_REPLY_POLL_MS = 1;
+
+enum class HttpMethod : uint8_t { Get, Post, Other };
+
+// Body handler events
+enum class HttpBody : uint8_t {
+    Start,    // Before the first byte
+    Data,     // The next piece
+    Aborted   // The client went away or stalled; the request handler will not run
+};
+
+class HttpRequest;
+
+// Runs on the core once the request and its body have arrived
+typedef void (*HttpHandler)(HttpRequest& request);
+
+// Runs on the core for each piece of a streamed body
+typedef void (*HttpBodyHandler)(HttpRequest& request, HttpBody event, const char* data, size_t length);
+
+// One connection and the request it is serving, as handlers see it
+class HttpRequest {
+public:
+    HttpRequest();
+
+    HttpMethod method() const { return requestMethod; }
+    const char* path() const { return target; }
+
+    // Query argument, URL-decoded into value; false if absent
+    bool arg(const char* name, char* value, size_t size) const;
+    bool hasArg(const char* name) const;
+
+    // The body, for routes without a body handler (part 0 only)
+    const char* body() const { return input; }
+    size_t bodyLength() const { return contentLength; }
+
+    // The whole response at once, with a Content-Length
+    void respond(int code, const char* contentType, const char* body);
+
+    // A streamed response: begin(), then write(), print() or format(). The
+    // response ends when the handler returns, unless it calls more(): then
+    // the handler runs again with part() one higher once this part is sent.
+    void begin(int code, const char* contentType);
+    size_t write(const char* data, size_t length);
+    size_t print(const char* text);
+    size_t format(const char* format, ...) __attribute__((format(printf, 2, 3)));
+    size_t vformat(const char* format, va_list args);
+    void more() { wantsMore = true; }
+    uint32_t part() const { return responsePart; }
+
+    // Take the socket over (an event stream); the server forgets it and
+    // the caller must close it
+    int detach();
+
+private:
+    friend class HttpServer;
+
+    enum class State : uint8_t {
+        Free,
+        Head,     // Reading the request head, or idle between keep-alive requests
+        Waiting,  // Head read; its route is busy with another streamed body
+        Body,     // Reading the body
+        Core,     // With the core, which may use every field
+        Sending   // Writing the response or a part of it
+    };
+
+    // What dispatch() is to do with the connection
+    enum class Call : uint8_t { Request, Body, More, Aborted };
+
+    void reset();
+    void appendHead(int code, const char* contentType, long length);
+    void append(const char* data, size_t length);
+    void openChunk();
+    void closeChunk(bool last);
+    const char* findArg(const char* name) const;
+
+    int fd;
+    State state;
+    Call call;
+    uint32_t lastActivityMs;
+
+    // The request
+    uint8_t route;
+    HttpMethod requestMethod;
+    char target[HTTP_TARGET_CHARS];
+    const char* query;          // In target, nullptr without one
+    bool keepAlive;
+    bool expectContinue;
+    bool holdsRoute;            // Its route takes one streamed body at a time
+    uint32_t contentLength;
+    uint32_t bodyRead;          // Body bytes the core has had
+    char input[HTTP_INPUT_BYTES];
+    size_t inputUsed;
+    size_t pieceLength;         // Bytes at the front of input this call is about
+
+    // The response
+    char output[HTTP_OUTPUT_BYTES];
+    size_t outputUsed;
+    size_t outputSent;
+    size_t chunkStart;          // Where the open chunk's size goes
+    uint32_t responsePart;
+    bool started;
+    bool chunked;
+    bool wantsMore;
+    bool overflowed;            // Writes that did not fit were dropped
+    bool detached;
+};
+
+class HttpServer {
+public:
+    explicit HttpServer(Clock& clock);
+    ~HttpServer();
+
+    // Routes are added before begin(). A route with a body handler gets the
+    // body in pieces as it arrives and serves one request at a time; others
+    // wait until it is done.
+    bool on(const char* path, HttpMethod method, HttpHandler handler, HttpBodyHandler body = nullptr);
+
+    // Listen on every interface; port 0 picks a free one (see getPort())
+    bool begin(uint16_t port);
+    void end();
+    uint16_t getPort() const { return port; }
+
+    // Server task: accept, read and write whatever is ready, waiting up to
+    // waitMs for something to be
+    void serve(uint32_t waitMs);
+
+    // Control core: run the handlers of requests that have arrived and hand
+    // their connections back. Returns the number of calls handled.
+    size_t dispatch();
+
+    // Counters, safe to read from either side
+    uint32_t getConnections() const { return connections.load(std::memory_order_relaxed); }
+    uint32_t getOpen() const { return open.load(std::memory_order_relaxed); }
+    uint32_t getRequests() const { return requests.load(std::memory_order_relaxed); }
+    uint32_t getRefused() const { return refused.load(std::memory_order_relaxed); }
+    uint32_t getTimeouts() const { return timeouts.load(std::memory_order_relaxed); }
+    uint32_t getEvicted() const { return evicted.load(std::memory_order_relaxed); }
+    uint32_t getTruncated() const { return truncated.load(std::memory_order_relaxed); }
+
+private:
+    struct Route {
+        const char* path;
+        HttpMethod method;
+        HttpHandler handler;
+        HttpBodyHandler body;
+        bool busy;  // A streamed body is in progress (server task only)
+    };
+
+    static const uint8_t NO_ROUTE = 0xff;
+
+    void acceptClient(uint32_t now);
+    bool canAccept() const;
+    void receive(HttpRequest& connection, uint32_t now);
+    void parseHead(HttpRequest& connection, uint32_t now);
+    void start(HttpRequest& connection);
+    void bodyProgress(HttpRequest& connection);
+    void transmit(HttpRequest& connection, uint32_t now);
+    void returned(HttpRequest& connection, uint32_t now);
+    void finish(HttpRequest& connection, uint32_t now);
+    void refuse(HttpRequest& connection, int code, const char* message, uint32_t now);
+    void drop(HttpRequest& connection);
+    void closeConnection(HttpRequest& connection);
+    void release(HttpRequest& connection);
+    void handOver(HttpRequest& connection, HttpRequest::Call call, size_t piece);
+    void runHandler(HttpRequest& connection, const Route& route);
+    size_t indexOf(const HttpRequest& connection) const { return (size_t)(&connection - slots); }
+
+    Clock& clock;
+    int listener;
+    uint16_t port;
+    Route routes[HTTP_MAX_ROUTES];
+    size_t routeCount;
+    HttpRequest slots[HTTP_MAX_CONNECTIONS];
+
+    // Connection indexes: server to core with a call, and back when done.
+    // Each connection is in at most one, so pushes never fail.
+    SampleRing<uint8_t, 8> calls;
+    SampleRing<uint8_t, 8> replies;
+
+    std::atomic<uint32_t> connections{0};  // Accepted since begin()
+    std::atomic<uint32_t> open{0};
+    std::atomic<uint32_t> requests{0};
+    std::atomic<uint32_t> refused{0};      // Answered by the server itself: 4xx or 5xx
+    std::atomic<uint32_t> timeouts{0};
+    std::atomic<uint32_t> evicted{0};      // Idle keep-alive connections closed for a new client
+    std::atomic<uint32_t> truncated{0};    // Response parts that did not fit HTTP_OUTPUT_BYTES
+};
+
+#endif // HTTP_SERVER_H
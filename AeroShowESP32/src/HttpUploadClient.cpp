@@ -0,0 +1,188 @@
+#include "HttpUploadClient.h"
+
+// How long to wait for the server before giving up on a request
+static const uint32_t RESPONSE_TIMEOUT_MS = 5000;
+
+HttpUploadClient::HttpUploadClient() : port(80) {
+    host[0] = '\0';
+    basePath[0] = '\0';
+}
+
+bool HttpUploadClient::setBaseUrl(const char* url) {
+    const char* prefix = "http://";
+    if (strncmp(url, prefix, strlen(prefix)) != 0) {
+        return false;
+    }
+    const char* hostStart = url + strlen(prefix);
+    const char* pathStart = strchr(hostStart, '/');
+    if (pathStart == nullptr) {
+        pathStart = hostStart + strlen(hostStart);
+    }
+
+    const char* portStart = (const char*)memchr(hostStart, ':', pathStart - hostStart);
+    const char* hostEnd = portStart ? portStart : pathStart;
+    size_t hostLength = hostEnd - hostStart;
+    if (hostLength == 0 || hostLength >= sizeof(host) || strlen(pathStart) >= sizeof(basePath)) {
+        return false;
+    }
+
+    memcpy(host, hostStart, hostLength);
+    host[hostLength] = '\0';
+    port = portStart ? (uint16_t)atoi(portStart + 1) : 80;
+    strcpy(basePath, *pathStart ? pathStart : "/");
+
+    stop();
+    return true;
+}
+
+bool HttpUploadClient::ensureConnected() {
+    if (client.connected()) {
+        return true;
+    }
+    client.stop();
+    if (!client.connect(host, port)) {
+        return false;
+    }
+    client.setNoDelay(true);
+    return true;
+}
+
+ChunkedWriter* HttpUploadClient::beginPost(const char* pathSuffix, const char* contentType,
+                                           const char* contentEncoding) {
+    if (host[0] == '\0' || !ensureConnected()) {
+        return nullptr;
+    }
+
+    char head[384];
+    int length = snprintf(head, sizeof(head),
+                          "POST %s%s HTTP/1.1\r\n"
+                          "Host: %s\r\n"
+                          "Content-Type: %s\r\n"
+                          "%s%s%s"
+                          "Transfer-Encoding: chunked\r\n"
+                          "Connection: keep-alive\r\n"
+                          "\r\n",
+                          basePath, pathSuffix, host, contentType,
+                          contentEncoding != nullptr ? "Content-Encoding: " : "",
+                          contentEncoding != nullptr ? contentEncoding : "",
+                          contentEncoding != nullptr ? "\r\n" : "");
+    if (length <= 0 || (size_t)length >= sizeof(head) ||
+        client.write((const uint8_t*)head, length) != (size_t)length) {
+        // A stale keep-alive socket fails here; the caller retries on a new one
+        client.stop();
+        return nullptr;
+    }
+
+    writer.begin(&client);
+    return &writer;
+}
+
+int HttpUploadClient::finishPost() {
+    if (!writer.finish()) {
+        client.stop();
+        return HTTPC_ERROR_SEND_PAYLOAD_FAILED;
+    }
+    int status = readResponse();
+    if (status < 0) {
+        client.stop();
+    }
+    return status;
+}
+
+void HttpUploadClient::stop() {
+    client.stop();
+}
+
+bool HttpUploadClient::readLine(char* line, size_t size) {
+    size_t n = 0;
+    unsigned long start = millis();
+    while (millis() - start < RESPONSE_TIMEOUT_MS) {
+        int c = client.read();
+        if (c < 0) {
+            if (!client.connected()) {
+                return false;
+            }
+            vTaskDelay(1);
+            continue;
+        }
+        if (c == '\n') {
+            line[n] = '\0';
+            return true;
+        }
+        if (c != '\r' && n + 1 < size) {
+            line[n++] = (char)c;
+        }
+    }
+    return false;
+}
+
+bool HttpUploadClient::skipBytes(long count) {
+    unsigned long start = millis();
+    while (count > 0 && millis() - start < RESPONSE_TIMEOUT_MS) {
+        if (client.read() >= 0) {
+            count--;
+        } else if (!client.connected()) {
+            return false;
+        } else {
+            vTaskDelay(1);
+        }
+    }
+    return count == 0;
+}
+
+int HttpUploadClient::readResponse() {
+    char line[128];
+    if (!readLine(line, sizeof(line))) {
+        return HTTPC_ERROR_READ_TIMEOUT;
+    }
+
+    int status = 0;
+    if (sscanf(line, "HTTP/%*d.%*d %d", &status) != 1) {
+        return HTTPC_ERROR_NO_HTTP_SERVER;
+    }
+
+    long contentLength = 0;
+    bool chunked = false;
+    bool closeAfter = false;
+    for (;;) {
+        if (!readLine(line, sizeof(line))) {
+            return HTTPC_ERROR_CONNECTION_LOST;
+        }
+        if (line[0] == '\0') {
+            break;
+        }
+        if (strncasecmp(line, "Content-Length:", 15) == 0) {
+            contentLength = atol(line + 15);
+        } else if (strncasecmp(line, "Transfer-Encoding:", 18) == 0 && strstr(line, "chunked")) {
+            chunked = true;
+        } else if (strncasecmp(line, "Connection:", 11) == 0 && strstr(line, "close")) {
+            closeAfter = true;
+        }
+    }
+
+    // Discard the body so the next request starts on a clean stream
+    if (chunked) {
+        for (;;) {
+            if (!readLine(line, sizeof(line))) {
+                return HTTPC_ERROR_CONNECTION_LOST;
+            }
+            long size = strtol(line, nullptr, 16);
+            if (size == 0) {
+                // Skip optional trailers up to the final blank line
+                while (readLine(line, sizeof(line)) && line[0] != '\0') {
+                }
+                break;
+            }
+            if (!skipBytes(size + 2)) {  // Chunk data plus its CRLF
+                return HTTPC_ERROR_CONNECTION_LOST;
+            }
+        }
+    } else if (!skipBytes(contentLength)) {
+        return HTTPC_ERROR_CONNECTION_LOST;
+    }
+
+    if (closeAfter) {
+        client.stop();
+    }
+    return status;
+}
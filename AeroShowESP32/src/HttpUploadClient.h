@@ -0,0 +1,45 @@
+#ifndef HTTP_UPLOAD_CLIENT_H
+#define HTTP_UPLOAD_CLIENT_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <HTTPClient.h>
+#include "ChunkedWriter.h"
+
+// Minimal HTTP/1.1 client for streamed uploads. Requests are sent with a
+// chunked body over one persistent connection; the response body is read
+// and discarded so the connection can carry the next request.
+// Only plain http:// URLs are supported.
+class HttpUploadClient {
+public:
+    HttpUploadClient();
+
+    // Parse http://host[:port]/path; request paths are appended to it
+    bool setBaseUrl(const char* url);
+
+    // Send the request head and return the writer for the body, or nullptr
+    // if the connection could not be made. A contentEncoding (e.g. "gzip")
+    // is declared in the head; the caller writes the body already encoded.
+    ChunkedWriter* beginPost(const char* pathSuffix, const char* contentType, const char* contentEncoding = nullptr);
+
+    // Terminate the body and read the response.
+    // Returns the HTTP status code or a negative HTTPC_ERROR_* value.
+    int finishPost();
+
+    // Drop the connection
+    void stop();
+
+private:
+    bool ensureConnected();
+    int readResponse();
+    bool readLine(char* line, size_t size);
+    bool skipBytes(long count);
+
+    WiFiClient client;
+    ChunkedWriter writer;
+    char host[64];
+    uint16_t port;
+    char basePath[128];
+};
+
+#endif // HTTP_UPLOAD_CLIENT_H
@@ -0,0 +1,43 @@
+#ifndef I2C_BUS_H
+#define I2C_BUS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Bus clock the firmware sets: -DI2C_CLOCK_HZ=<rate>. The INA260s and the
+// SSD1306 all take fast mode; at the Wire default of 100 kHz four INA260s
+// polled at 1 kHz would need more than the whole bus.
+#ifndef I2C_CLOCK_HZ
+#define I2C_CLOCK_HZ 400000
+#endif
+
+// Bit times on the wire, start/stop conditions included: a register read
+// is a pointer write, a repeated start and two data bytes, a write is the
+// pointer and two data bytes, and a plain transfer is address plus payload
+const uint32_t I2C_REGISTER_READ_BITS = 48;
+const uint32_t I2C_REGISTER_WRITE_BITS = 38;
+
+inline uint32_t i2cTransferBits(size_t bytes) {
+    return (uint32_t)(9 * (bytes + 1) + 2);
+}
+
+// Bus time of bits at clockHz, rounded up
+inline uint32_t i2cBitsMicros(uint32_t bits, uint32_t clockHz) {
+    return (uint32_t)(((uint64_t)bits * 1000000 + clockHz - 1) / clockHz);
+}
+
+// Register-level access to 16-bit I2C devices. Drivers talk to this
+// interface instead of Wire so they can run against a fake bus on the host.
+class I2CBus {
+public:
+    virtual ~I2CBus() {}
+
+    // Write one big-endian 16-bit register
+    virtual bool writeRegister16(uint8_t address, uint8_t reg, uint16_t value) = 0;
+
+    // Read count big-endian 16-bit registers, listed in regs, as one burst.
+    // Values are only meaningful if the whole burst succeeded.
+    virtual bool readRegisters16(uint8_t address, const uint8_t* regs, uint16_t* values, size_t count) = 0;
+};
+
+#endif // I2C_BUS_H
@@ -0,0 +1,82 @@
+#ifndef INA260_DECODE_H
+#define INA260_DECODE_H
+
+#include <stdint.h>
+
+// Register map and fixed-scale decoding for the INA260. Kept free of
+// Arduino calls so register values captured from a real or fake bus can be
+// decoded on the host.
+
+const uint8_t INA260_DEFAULT_ADDRESS = 0x40;
+
+// Register addresses (all registers are 16 bits, MSB first)
+const uint8_t INA260_REG_CONFIG = 0x00;
+const uint8_t INA260_REG_CURRENT = 0x01;
+const uint8_t INA260_REG_BUS_VOLTAGE = 0x02;
+const uint8_t INA260_REG_POWER = 0x03;
+const uint8_t INA260_REG_MASK_ENABLE = 0x06;
+const uint8_t INA260_REG_ALERT_LIMIT = 0x07;
+const uint8_t INA260_REG_MANUFACTURER_ID = 0xFE;
+const uint8_t INA260_REG_DIE_ID = 0xFF;
+
+const uint16_t INA260_MANUFACTURER_ID = 0x5449;  // "TI"
+const uint16_t INA260_DIE_ID_MASK = 0xFFF0;      // Low nibble is the revision
+const uint16_t INA260_DIE_ID = 0x2270;
+
+// Configuration register fields
+const uint16_t INA260_CONFIG_RESET = 0x8000;
+const uint8_t INA260_MODE_CONTINUOUS = 0x07;  // Current and bus voltage, continuous
+
+// Mask/Enable register bits
+const uint16_t INA260_MASK_CONVERSION_READY_ALERT = 0x0400;  // CNVR: ALERT follows conversion ready
+const uint16_t INA260_MASK_CONVERSION_READY_FLAG = 0x0008;   // CVRF: cleared by reading Mask/Enable
+const uint16_t INA260_MASK_ALERT_POLARITY = 0x0002;          // APOL: 1 = active high
+const uint16_t INA260_MASK_ALERT_LATCH = 0x0001;             // LEN: hold ALERT until Mask/Enable is read
+
+// Samples averaged per reading (AVG field)
+enum class INA260Averaging : uint8_t {
+    Avg1 = 0, Avg4, Avg16, Avg64, Avg128, Avg256, Avg512, Avg1024
+};
+
+// Conversion time per channel (VBUSCT / ISHCT fields)
+enum class INA260ConversionTime : uint8_t {
+    Us140 = 0, Us204, Us332, Us588, Us1100, Us2116, Us4156, Us8244
+};
+
+// LSB sizes from the datasheet
+const float INA260_CURRENT_LSB_MA = 1.25f;
+const float INA260_VOLTAGE_LSB_V = 0.00125f;
+const float INA260_POWER_LSB_MW = 10.0f;
+
+// Build the configuration register value
+inline uint16_t ina260ConfigWord(INA260Averaging averaging, INA260ConversionTime busTime,
+                                 INA260ConversionTime currentTime, uint8_t mode = INA260_MODE_CONTINUOUS) {
+    return (uint16_t)(((uint16_t)averaging & 0x07) << 9 | ((uint16_t)busTime & 0x07) << 6 |
+                      ((uint16_t)currentTime & 0x07) << 3 | (mode & 0x07));
+}
+
+// Time between conversion-ready events for a configuration, in microseconds
+inline uint32_t ina260ConversionPeriodMicros(INA260Averaging averaging, INA260ConversionTime busTime,
+                                             INA260ConversionTime currentTime) {
+    static const uint16_t timesUs[] = {140, 204, 332, 588, 1100, 2116, 4156, 8244};
+    static const uint16_t averages[] = {1, 4, 16, 64, 128, 256, 512, 1024};
+    return (uint32_t)(timesUs[(uint8_t)busTime & 0x07] + timesUs[(uint8_t)currentTime & 0x07]) *
+           averages[(uint8_t)averaging & 0x07];
+}
+
+// Current register is two's complement, in mA
+inline float ina260DecodeCurrent(uint16_t raw) {
+    return (int16_t)raw * INA260_CURRENT_LSB_MA;
+}
+
+// Bus voltage register is unsigned, in V
+inline float ina260DecodeVoltage(uint16_t raw) {
+    return raw * INA260_VOLTAGE_LSB_V;
+}
+
+// Power register is unsigned, in mW
+inline float ina260DecodePower(uint16_t raw) {
+    return raw * INA260_POWER_LSB_MW;
+}
+
+#endif // INA260_DECODE_H
@@ -0,0 +1,150 @@
+#include "INA260Driver.h"
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#define INA260_MICROS() micros()
+#else
+#include <chrono>
+static uint32_t INA260_MICROS() {
+    using namespace std::chrono;
+    return (uint32_t)duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+#endif
+
+#ifndef IRAM_ATTR
+#define IRAM_ATTR
+#endif
+
+// Registers read per conversion, in order
+static const uint8_t DATA_REGISTERS[] = {INA260_REG_CURRENT, INA260_REG_BUS_VOLTAGE, INA260_REG_POWER};
+// Mask/Enable last: reading it re-arms ALERT, so it must not come before
+// the data it releases
+static const uint8_t ALERT_BURST_REGISTERS[] = {INA260_REG_CURRENT, INA260_REG_BUS_VOLTAGE, INA260_REG_POWER,
+                                                INA260_REG_MASK_ENABLE};
+
+// Missed alert edges are recovered by polling after this many quiet periods
+static const uint32_t ALERT_STALL_PERIODS = 4;
+
+INA260Driver::INA260Driver(I2CBus& bus, uint8_t address, int alertPin)
+    : bus(bus), address(address), alertPin(alertPin), ready(false), periodMicros(0), lastReadMicros(0),
+      alertMicros(0), alertCount(0), seenAlertCount(0), readingCount(0), errorCount(0), lateCount(0) {
+}
+
+bool INA260Driver::begin(INA260Averaging averaging, INA260ConversionTime busTime,
+                         INA260ConversionTime currentTime) {
+    ready = false;
+
+    static const uint8_t idRegisters[] = {INA260_REG_MANUFACTURER_ID, INA260_REG_DIE_ID};
+    uint16_t ids[2];
+    if (!bus.readRegisters16(address, idRegisters, ids, 2) || ids[0] != INA260_MANUFACTURER_ID ||
+        (ids[1] & INA260_DIE_ID_MASK) != INA260_DIE_ID) {
+        return false;
+    }
+
+    // Latch ALERT until Mask/Enable is read, so every conversion gives a fresh edge
+    uint16_t maskEnable = alertPin >= 0 ? (INA260_MASK_CONVERSION_READY_ALERT | INA260_MASK_ALERT_LATCH) : 0;
+    if (!bus.writeRegister16(address, INA260_REG_CONFIG, INA260_CONFIG_RESET) ||
+        !bus.writeRegister16(address, INA260_REG_CONFIG, ina260ConfigWord(averaging, busTime, currentTime)) ||
+        !bus.writeRegister16(address, INA260_REG_MASK_ENABLE, maskEnable)) {
+        return false;
+    }
+
+    periodMicros = ina260ConversionPeriodMicros(averaging, busTime, currentTime);
+    lastReadMicros = INA260_MICROS();
+    seenAlertCount = alertCount;
+
+#ifdef ARDUINO
+    if (alertPin >= 0) {
+        // ALERT is open drain and active low
+        pinMode(alertPin, INPUT_PULLUP);
+        attachInterruptArg(digitalPinToInterrupt(alertPin), onAlert, this, FALLING);
+    }
+#endif
+
+    ready = true;
+    return true;
+}
+
+bool INA260Driver::readLatest(INA260Reading& reading) {
+    if (!ready) {
+        return false;
+    }
+
+    if (alertPin >= 0) {
+        // The ISR stores the time before bumping the count, so re-check the count
+        uint32_t count;
+        uint32_t timestamp;
+        do {
+            count = alertCount;
+            timestamp = alertMicros;
+        } while (count != alertCount);
+
+        if (count != seenAlertCount) {
+            seenAlertCount = count;
+            uint16_t values[4];
+            if (!bus.readRegisters16(address, ALERT_BURST_REGISTERS, values, 4)) {
+                errorCount++;
+                return false;
+            }
+
+            // A conversion that finished before Mask/Enable was read did so
+            // with ALERT still latched and raised no edge; its data is what
+            // the registers hold now, so read it again, stamped with when it
+            // was due
+            uint32_t late = INA260_MICROS() - timestamp;
+            if (late >= periodMicros) {
+                lateCount++;
+                return readData(timestamp + late / periodMicros * periodMicros, reading);
+            }
+            decode(values, timestamp, reading);
+            lastReadMicros = timestamp;
+            readingCount++;
+            return true;
+        }
+
+        // A failed burst can leave ALERT latched low; fall back to polling until it clears
+        if (INA260_MICROS() - lastReadMicros < periodMicros * ALERT_STALL_PERIODS) {
+            return false;
+        }
+    }
+
+    uint16_t maskEnable;
+    static const uint8_t maskRegister = INA260_REG_MASK_ENABLE;
+    if (!bus.readRegisters16(address, &maskRegister, &maskEnable, 1)) {
+        errorCount++;
+        return false;
+    }
+    if ((maskEnable & INA260_MASK_CONVERSION_READY_FLAG) == 0) {
+        return false;
+    }
+    return readData(INA260_MICROS(), reading);
+}
+
+bool INA260Driver::readData(uint32_t timestampMicros, INA260Reading& reading) {
+    uint16_t values[3];
+    if (!bus.readRegisters16(address, DATA_REGISTERS, values, 3)) {
+        errorCount++;
+        return false;
+    }
+    decode(values, timestampMicros, reading);
+    lastReadMicros = timestampMicros;
+    readingCount++;
+    return true;
+}
+
+uint32_t INA260Driver::getAgeMicros(const INA260Reading& reading) const {
+    return INA260_MICROS() - reading.timestampMicros;
+}
+
+void INA260Driver::decode(const uint16_t* values, uint32_t timestampMicros, INA260Reading& reading) {
+    reading.current = ina260DecodeCurrent(values[0]);
+    reading.voltage = ina260DecodeVoltage(values[1]);
+    reading.power = ina260DecodePower(values[2]);
+    reading.timestampMicros = timestampMicros;
+}
+
+void IRAM_ATTR INA260Driver::onAlert(void* arg) {
+    INA260Driver* driver = static_cast<INA260Driver*>(arg);
+    driver->alertMicros = INA260_MICROS();
+    driver->alertCount = driver->alertCount + 1;
+}
@@ -0,0 +1,76 @@
+#ifndef INA260_DRIVER_H
+#define INA260_DRIVER_H
+
+#include <stdint.h>
+#include "I2CBus.h"
+#include "INA260Decode.h"
+
+// One conversion result, tagged with the time it became ready
+struct INA260Reading {
+    float voltage = 0.0f;  // V
+    float current = 0.0f;  // mA
+    float power = 0.0f;    // mW
+    uint32_t timestampMicros = 0;
+};
+
+// INA260 driver running continuous conversions. With an ALERT pin, the
+// conversion-ready interrupt records when each conversion finished and
+// readLatest() only touches the bus when there is something new. Without
+// one it polls the conversion-ready flag instead. Either way voltage,
+// current and power come from the same conversion in one register burst.
+//
+// The INA260 register pointer does not auto-increment, so a "burst" is a
+// run of pointer-write/read pairs issued back to back.
+class INA260Driver {
+public:
+    INA260Driver(I2CBus& bus, uint8_t address = INA260_DEFAULT_ADDRESS, int alertPin = -1);
+
+    // Check the device IDs, reset it and start continuous conversions
+    bool begin(INA260Averaging averaging = INA260Averaging::Avg4,
+               INA260ConversionTime busTime = INA260ConversionTime::Us332,
+               INA260ConversionTime currentTime = INA260ConversionTime::Us332);
+
+    // Read the newest conversion if one finished since the last call; never waits
+    bool readLatest(INA260Reading& reading);
+
+    // Decode a burst of current, bus voltage and power registers
+    static void decode(const uint16_t* values, uint32_t timestampMicros, INA260Reading& reading);
+
+    // How long ago reading's conversion finished, for callers on another clock
+    uint32_t getAgeMicros(const INA260Reading& reading) const;
+
+    bool isReady() const { return ready; }
+    uint32_t getConversionPeriodMicros() const { return periodMicros; }
+
+    // Conversions read since begin(), and bursts that failed on the bus
+    uint32_t getReadingCount() const { return readingCount; }
+    uint32_t getErrorCount() const { return errorCount; }
+    // Alert bursts that finished after the next conversion and read again for it
+    uint32_t getLateCount() const { return lateCount; }
+
+#ifndef ARDUINO
+    // No interrupt is attached off the device; stands in for an ALERT edge
+    void raiseAlert() { onAlert(this); }
+#endif
+
+private:
+    static void onAlert(void* arg);
+    bool readData(uint32_t timestampMicros, INA260Reading& reading);
+
+    I2CBus& bus;
+    uint8_t address;
+    int alertPin;
+    bool ready;
+    uint32_t periodMicros;
+    uint32_t lastReadMicros;
+
+    volatile uint32_t alertMicros;
+    volatile uint32_t alertCount;
+    uint32_t seenAlertCount;
+
+    uint32_t readingCount;
+    uint32_t errorCount;
+    uint32_t lateCount;
+};
+
+#endif // INA260_DRIVER_H
@@ -0,0 +1,91 @@
+#ifndef JSON_ARENA_H
+#define JSON_ARENA_H
+
+#include <ArduinoJson.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// ArduinoJson allocator over a fixed buffer, for parsing request bodies
+// without touching the heap. Blocks are bumped off the front of the arena
+// and are only released together by reset(). A document that does not fit
+// fails to parse with DeserializationError::NoMemory. Call reset() only
+// when no document is still using the arena.
+template <size_t Size>
+class JsonArena : public ArduinoJson::Allocator {
+public:
+    void* allocate(size_t size) override {
+        size_t needed = blockSize(size);
+        if (needed > Size - used) {
+            return nullptr;
+        }
+        newest = used;
+        used += needed;
+        if (used > highWater) {
+            highWater = used;
+        }
+        return store(buffer + newest, size);
+    }
+
+    // Space comes back only with reset()
+    void deallocate(void*) override {}
+
+    void* reallocate(void* ptr, size_t newSize) override {
+        if (ptr == nullptr) {
+            return allocate(newSize);
+        }
+
+        uint8_t* block = static_cast<uint8_t*>(ptr) - HEADER_BYTES;
+        size_t oldSize;
+        memcpy(&oldSize, block, sizeof(oldSize));
+
+        // The newest block can grow or shrink in place
+        if (block == buffer + newest) {
+            size_t needed = blockSize(newSize);
+            if (needed > Size - newest) {
+                return nullptr;
+            }
+            used = newest + needed;
+            if (used > highWater) {
+                highWater = used;
+            }
+            return store(block, newSize);
+        }
+
+        void* moved = allocate(newSize);
+        if (moved != nullptr) {
+            memcpy(moved, ptr, oldSize < newSize ? oldSize : newSize);
+        }
+        return moved;
+    }
+
+    void reset() {
+        used = 0;
+        newest = 0;
+    }
+
+    size_t getUsed() const { return used; }
+    size_t getHighWater() const { return highWater; }
+    static constexpr size_t capacity() { return Size; }
+
+private:
+    // Each block is prefixed with its size so reallocate() can copy it
+    static const size_t HEADER_BYTES = 8;
+    static const size_t ALIGNMENT = 8;
+
+    static size_t blockSize(size_t size) {
+        return (HEADER_BYTES + size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+    }
+
+    static void* store(uint8_t* block, size_t size) {
+        memcpy(block, &size, sizeof(size));
+        return block + HEADER_BYTES;
+    }
+
+    alignas(ALIGNMENT) uint8_t buffer[Size];
+    size_t used = 0;
+    size_t newest = 0;  // Offset of the most recent block
+    size_t highWater = 0;
+};
+
+#endif // JSON_ARENA_H
@@ -0,0 +1,69 @@
+#include "LittleFsFiles.h"
+
+LittleFsFiles::LittleFsFiles(fs::FS& fs) : fs(fs), fileAppending(false) {
+    filePath[0] = '\0';
+}
+
+bool LittleFsFiles::makeDirectory(const char* path) {
+    return fs.exists(path) || fs.mkdir(path);
+}
+
+bool LittleFsFiles::list(const char* directory, const std::function<void(const char*)>& visit) {
+    File dir = fs.open(directory);
+    if (!dir || !dir.isDirectory()) {
+        return false;
+    }
+    for (File entry = dir.openNextFile(); entry; entry = dir.openNextFile()) {
+        const char* name = strrchr(entry.name(), '/');
+        visit(name ? name + 1 : entry.name());
+    }
+    return true;
+}
+
+bool LittleFsFiles::size(const char* path, uint32_t& bytes) {
+    File& handle = use(path, false);
+    if (!handle) {
+        return false;
+    }
+    bytes = handle.size();
+    return true;
+}
+
+size_t LittleFsFiles::read(const char* path, uint32_t offset, uint8_t* buffer, size_t length) {
+    File& handle = use(path, false);
+    if (!handle || (handle.position() != offset && !handle.seek(offset))) {
+        return 0;
+    }
+    return handle.read(buffer, length);
+}
+
+size_t LittleFsFiles::append(const char* path, const uint8_t* data, size_t length) {
+    File& handle = use(path, true);
+    return handle ? handle.write(data, length) : 0;
+}
+
+bool LittleFsFiles::commit() {
+    // LittleFS only makes appended data part of the file when it is closed
+    file.close();
+    return true;
+}
+
+bool LittleFsFiles::rename(const char* from, const char* to) {
+    file.close();
+    return fs.rename(from, to);
+}
+
+bool LittleFsFiles::remove(const char* path) {
+    file.close();
+    return fs.remove(path);
+}
+
+File& LittleFsFiles::use(const char* path, bool appending) {
+    if (!file || fileAppending != appending || strcmp(filePath, path) != 0) {
+        file.close();
+        file = fs.open(path, appending ? "a" : "r");
+        strlcpy(filePath, path, sizeof(filePath));
+        fileAppending = appending;
+    }
+    return file;
+}
@@ -0,0 +1,33 @@
+#ifndef LITTLE_FS_FILES_H
+#define LITTLE_FS_FILES_H
+
+#include <Arduino.h>
+#include <FS.h>
+#include "FlashFiles.h"
+
+// FlashFiles over an Arduino filesystem. The last file used stays open,
+// so the spool's header, payload and CRC reads of one segment, and the
+// many small writes of one record, don't each pay for an open.
+class LittleFsFiles : public FlashFiles {
+public:
+    explicit LittleFsFiles(fs::FS& fs);
+
+    bool makeDirectory(const char* path) override;
+    bool list(const char* directory, const std::function<void(const char*)>& visit) override;
+    bool size(const char* path, uint32_t& bytes) override;
+    size_t read(const char* path, uint32_t offset, uint8_t* buffer, size_t length) override;
+    size_t append(const char* path, const uint8_t* data, size_t length) override;
+    bool commit() override;
+    bool rename(const char* from, const char* to) override;
+    bool remove(const char* path) override;
+
+private:
+    File& use(const char* path, bool appending);
+
+    fs::FS& fs;
+    File file;
+    char filePath[48];
+    bool fileAppending;
+};
+
+#endif // LITTLE_FS_FILES_H
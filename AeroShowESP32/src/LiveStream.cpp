@@ -0,0 +1,215 @@
+#include "LiveStream.h"
+#include <errno.h>
+#include <stdio.h>
+#include <unistd.h>
+#ifdef ARDUINO
+#include <Arduino.h>
+#include <lwip/sockets.h>
+#else
+#include <sys/socket.h>
+#endif
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+LiveStream::LiveStream(Clock& clock) : clock(clock) {
+    for (size_t i = 0; i < LIVE_MAX_SUBSCRIBERS; i++) {
+        subscribers[i].active = false;
+    }
+}
+
+bool LiveStream::subscribe(int fd, float rateHz, LiveMode mode, uint8_t channel) {
+    for (size_t i = 0; i < LIVE_MAX_SUBSCRIBERS; i++) {
+        Subscriber& subscriber = subscribers[i];
+        if (subscriber.active) {
+            continue;
+        }
+
+        rateHz = rateHz < LIVE_MIN_RATE_HZ ? LIVE_MIN_RATE_HZ : rateHz > LIVE_MAX_RATE_HZ ? LIVE_MAX_RATE_HZ : rateHz;
+
+        subscriber.fd = fd;
+        subscriber.mode = mode;
+        subscriber.channel = channel;
+        subscriber.intervalMs = (unsigned long)(1000.0f / rateHz);
+        subscriber.lastEventMs = clock.millis();
+        subscriber.window.reset();
+        subscriber.sentEvents = 0;
+        subscriber.droppedEvents = 0;
+        subscriber.maxLatencyMs = 0;
+
+        subscriber.pendingLength = snprintf(subscriber.pending, sizeof(subscriber.pending),
+                                            "HTTP/1.1 200 OK\r\n"
+                                            "Content-Type: text/event-stream\r\n"
+                                            "Cache-Control: no-cache\r\n"
+                                            "Connection: keep-alive\r\n"
+                                            "Access-Control-Allow-Origin: *\r\n"
+                                            "\r\n"
+                                            "retry: 2000\n\n");
+        subscriber.pendingOffset = 0;
+        subscriber.active = true;
+        flushPending(subscriber);
+        return true;
+    }
+    return false;
+}
+
+void LiveStream::publish(const SensorData& sample) {
+    for (size_t i = 0; i < LIVE_MAX_SUBSCRIBERS; i++) {
+        if (subscribers[i].active && subscribers[i].channel == sample.channel) {
+            subscribers[i].window.add(sample);
+        }
+    }
+}
+
+void LiveStream::service() {
+    unsigned long now = clock.millis();
+
+    for (size_t i = 0; i < LIVE_MAX_SUBSCRIBERS; i++) {
+        Subscriber& subscriber = subscribers[i];
+        if (!subscriber.active) {
+            continue;
+        }
+        if (!connected(subscriber) || !flushPending(subscriber)) {
+            close(subscriber);
+            continue;
+        }
+
+        unsigned long sinceLast = now - subscriber.lastEventMs;
+        bool haveData = subscriber.window.count > 0;
+        if (!(haveData && sinceLast >= subscriber.intervalMs) && sinceLast < LIVE_KEEPALIVE_MS) {
+            continue;
+        }
+        subscriber.lastEventMs = now;
+
+        if (subscriber.pendingOffset < subscriber.pendingLength) {
+            // Client still behind on the previous event: keep aggregating
+            if (haveData) {
+                subscriber.droppedEvents++;
+            }
+            continue;
+        }
+
+        subscriber.pendingLength = formatEvent(subscriber, now);
+        subscriber.pendingOffset = 0;
+        if (!flushPending(subscriber)) {
+            close(subscriber);
+        }
+    }
+}
+
+size_t LiveStream::formatEvent(Subscriber& subscriber, unsigned long now) {
+    LiveWindow& window = subscriber.window;
+    int length;
+
+    if (window.count == 0) {
+        length = snprintf(subscriber.pending, sizeof(subscriber.pending), ": keepalive\n\n");
+    } else {
+        uint32_t timestampMs = (uint32_t)(window.last.timestamp_us / 1000);
+        uint32_t latencyMs = now - timestampMs;
+        if (latencyMs > subscriber.maxLatencyMs) {
+            subscriber.maxLatencyMs = latencyMs;
+        }
+
+        if (subscriber.mode == LiveMode::MinMax) {
+            float n = (float)window.count;
+            length = snprintf(subscriber.pending, sizeof(subscriber.pending),
+                              "event: sample\n"
+                              "data: {\"ch\":%u,\"t\":%lu,\"n\":%u,\"age_ms\":%u,\"dropped\":%u,"
+                              "\"load_cell\":[%.1f,%.1f,%.1f],"
+                              "\"voltage\":[%.3f,%.3f,%.3f],"
+                              "\"current\":[%.1f,%.1f,%.1f],"
+                              "\"speed\":%.3f}\n\n",
+                              (unsigned)subscriber.channel, (unsigned long)timestampMs, (unsigned)window.count,
+                              (unsigned)latencyMs, (unsigned)subscriber.droppedEvents,
+                              window.loadCell.minValue, window.loadCell.sum / n, window.loadCell.maxValue,
+                              window.voltage.minValue, window.voltage.sum / n, window.voltage.maxValue,
+                              window.current.minValue, window.current.sum / n, window.current.maxValue,
+                              window.last.speed);
+        } else {
+            length = snprintf(subscriber.pending, sizeof(subscriber.pending),
+                              "event: sample\n"
+                              "data: {\"ch\":%u,\"t\":%lu,\"n\":%u,\"age_ms\":%u,\"dropped\":%u,"
+                              "\"load_cell\":%.1f,\"voltage\":%.3f,\"current\":%.1f,\"speed\":%.3f}\n\n",
+                              (unsigned)subscriber.channel, (unsigned long)timestampMs, (unsigned)window.count,
+                              (unsigned)latencyMs, (unsigned)subscriber.droppedEvents,
+                              window.last.load_cell, window.last.voltage, window.last.current,
+                              window.last.speed);
+        }
+        subscriber.sentEvents++;
+    }
+
+    window.reset();
+    if (length < 0) {
+        return 0;
+    }
+    return (size_t)length < sizeof(subscriber.pending) ? (size_t)length : sizeof(subscriber.pending) - 1;
+}
+
+bool LiveStream::connected(Subscriber& subscriber) {
+    // Subscribers have nothing to say; anything they send is discarded, and
+    // a read of zero is the client closing its end
+    char discard[64];
+    for (;;) {
+        int received = recv(subscriber.fd, discard, sizeof(discard), MSG_DONTWAIT);
+        if (received == 0) {
+            return false;
+        }
+        if (received < 0) {
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+        }
+    }
+}
+
+bool LiveStream::flushPending(Subscriber& subscriber) {
+    while (subscriber.pendingOffset < subscriber.pendingLength) {
+        int sent = send(subscriber.fd, subscriber.pending + subscriber.pendingOffset,
+                        subscriber.pendingLength - subscriber.pendingOffset, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (sent < 0) {
+            // Socket buffer full is fine, anything else means the client is gone
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        subscriber.pendingOffset += sent;
+    }
+    return true;
+}
+
+void LiveStream::close(Subscriber& subscriber) {
+#ifdef ARDUINO
+    Serial.printf("Live: subscriber closed after %u events (%u dropped, max latency %ums)\n",
+                  (unsigned)subscriber.sentEvents, (unsigned)subscriber.droppedEvents,
+                  (unsigned)subscriber.maxLatencyMs);
+#endif
+    ::close(subscriber.fd);
+    subscriber.active = false;
+}
+
+size_t LiveStream::getSubscriberCount() const {
+    size_t count = 0;
+    for (size_t i = 0; i < LIVE_MAX_SUBSCRIBERS; i++) {
+        if (subscribers[i].active) {
+            count++;
+        }
+    }
+    return count;
+}
+
+uint32_t LiveStream::getDroppedEvents() const {
+    uint32_t total = 0;
+    for (size_t i = 0; i < LIVE_MAX_SUBSCRIBERS; i++) {
+        if (subscribers[i].active) {
+            total += subscribers[i].droppedEvents;
+        }
+    }
+    return total;
+}
+
+uint32_t LiveStream::getSentEvents() const {
+    uint32_t total = 0;
+    for (size_t i = 0; i < LIVE_MAX_SUBSCRIBERS; i++) {
+        if (subscribers[i].active) {
+            total += subscribers[i].sentEvents;
+        }
+    }
+    return total;
+}
@@ -0,0 +1,105 @@
+#ifndef LIVE_STREAM_H
+#define LIVE_STREAM_H
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "Hal.h"
+#include "SensorData.h"
+
+const size_t LIVE_MAX_SUBSCRIBERS = 4;
+const size_t LIVE_EVENT_BUFFER_SIZE = 320;
+const float LIVE_DEFAULT_RATE_HZ = 10.0f;
+const float LIVE_MIN_RATE_HZ = 0.5f;
+const float LIVE_MAX_RATE_HZ = 100.0f;
+const unsigned long LIVE_KEEPALIVE_MS = 15000;
+
+// How a subscriber's samples are reduced to its requested rate
+enum class LiveMode : uint8_t {
+    Decimate,  // Newest sample of each interval
+    MinMax     // Min, mean and max of every sample in the interval
+};
+
+// Running min/mean/max of one channel over an aggregation window
+struct LiveChannel {
+    float minValue;
+    float maxValue;
+    float sum;
+
+    void reset() { minValue = INFINITY; maxValue = -INFINITY; sum = 0.0f; }
+    void add(float value) {
+        if (value < minValue) minValue = value;
+        if (value > maxValue) maxValue = value;
+        sum += value;
+    }
+};
+
+// Everything seen by one subscriber since its last event
+struct LiveWindow {
+    uint32_t count;
+    SensorData last;
+    LiveChannel loadCell;
+    LiveChannel voltage;
+    LiveChannel current;
+
+    void reset() { count = 0; loadCell.reset(); voltage.reset(); current.reset(); }
+    void add(const SensorData& sample) {
+        count++;
+        last = sample;
+        loadCell.add(sample.load_cell);
+        voltage.add(sample.voltage);
+        current.add(sample.current);
+    }
+};
+
+// Server-Sent Events push of live samples. Each subscriber gets its own
+// rate and reduction; writes never block, and an event that cannot be sent
+// because the client is behind is folded into the next one and counted.
+// Subscribers are plain sockets, as HttpRequest::detach() hands them over,
+// so the stream runs on the host against local clients too.
+class LiveStream {
+public:
+    explicit LiveStream(Clock& clock);
+
+    // Adopt a connected socket as a subscriber to one rig channel and send
+    // the SSE response head; the socket is closed when the subscriber goes.
+    // False, with the socket left open, when every slot is taken.
+    bool subscribe(int fd, float rateHz, LiveMode mode, uint8_t channel = 0);
+
+    // Feed one sample to the windows of its channel's subscribers (cheap, no I/O)
+    void publish(const SensorData& sample);
+
+    // Send due events and drop closed clients; never blocks
+    void service();
+
+    size_t getSubscriberCount() const;
+    uint32_t getDroppedEvents() const;
+    uint32_t getSentEvents() const;
+
+private:
+    struct Subscriber {
+        bool active;
+        int fd;
+        LiveMode mode;
+        uint8_t channel;
+        unsigned long intervalMs;
+        unsigned long lastEventMs;
+        LiveWindow window;
+        char pending[LIVE_EVENT_BUFFER_SIZE];
+        size_t pendingLength;
+        size_t pendingOffset;
+        uint32_t sentEvents;
+        uint32_t droppedEvents;
+        uint32_t maxLatencyMs;
+    };
+
+    bool connected(Subscriber& subscriber);
+    bool flushPending(Subscriber& subscriber);
+    size_t formatEvent(Subscriber& subscriber, unsigned long now);
+    void close(Subscriber& subscriber);
+
+    Clock& clock;
+    Subscriber subscribers[LIVE_MAX_SUBSCRIBERS];
+};
+
+#endif // LIVE_STREAM_H
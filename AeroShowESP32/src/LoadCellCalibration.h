@@ -0,0 +1,169 @@
+#ifndef LOAD_CELL_CALIBRATION_H
+#define LOAD_CELL_CALIBRATION_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "LoadCellFilter.h"
+
+// Counts to grams through known weights. Pure code, so calibrations can be
+// checked on the host and the stored record decoded anywhere.
+
+// Known weights one channel can hold
+const size_t LOAD_CELL_MAX_POINTS = 8;
+
+// A known weight and the tared reading it gave
+struct LoadCellPoint {
+    int32_t counts = 0;
+    int32_t milligrams = 0;
+};
+
+// Piecewise linear through (0, 0) and every point, extended beyond the
+// outermost points along the end segments. Without points it is one gram
+// per count, as before calibration existed.
+class LoadCellCalibration {
+public:
+    LoadCellCalibration() { clear(); }
+
+    void clear() {
+        pointCount = 0;
+        rebuild();
+    }
+
+    // False when full, at zero counts, or at the counts of an existing point
+    bool addPoint(int32_t counts, int32_t milligrams) {
+        if (pointCount >= LOAD_CELL_MAX_POINTS || counts == 0) {
+            return false;
+        }
+        for (size_t i = 0; i < pointCount; i++) {
+            if (points[i].counts == counts) {
+                return false;
+            }
+        }
+        points[pointCount].counts = counts;
+        points[pointCount].milligrams = milligrams;
+        pointCount++;
+        rebuild();
+        return true;
+    }
+
+    size_t count() const { return pointCount; }
+    const LoadCellPoint& operator[](size_t i) const { return points[i]; }
+    bool calibrated() const { return pointCount > 0; }
+
+    // Tared counts with LOAD_CELL_FRACTION_BITS fractional bits to mg
+    int32_t toMilligrams(int64_t countsFixed) const {
+        if (knotCount < 2) {
+            return (int32_t)((countsFixed * 1000) >> LOAD_CELL_FRACTION_BITS);
+        }
+        size_t segment = 0;
+        while (segment + 2 < knotCount && countsFixed >= ((int64_t)knots[segment + 1].counts << LOAD_CELL_FRACTION_BITS)) {
+            segment++;
+        }
+        int64_t from = (int64_t)knots[segment].counts << LOAD_CELL_FRACTION_BITS;
+        return knots[segment].milligrams + (int32_t)(((countsFixed - from) * slopes[segment]) >> (16 + LOAD_CELL_FRACTION_BITS));
+    }
+
+    float toGrams(float counts) const {
+        float scaled = counts * (float)(1 << LOAD_CELL_FRACTION_BITS);
+        return (float)toMilligrams((int64_t)(scaled < 0.0f ? scaled - 0.5f : scaled + 0.5f)) / 1000.0f;
+    }
+
+private:
+    // Sort the points with the origin into knots and precompute each
+    // segment's slope in mg per count (Q16), so conversion never divides
+    void rebuild() {
+        knotCount = 0;
+        if (pointCount == 0) {
+            return;
+        }
+        knots[knotCount++] = LoadCellPoint();
+        for (size_t i = 0; i < pointCount; i++) {
+            knots[knotCount++] = points[i];
+        }
+        for (size_t i = 1; i < knotCount; i++) {
+            LoadCellPoint knot = knots[i];
+            size_t j = i;
+            while (j > 0 && knots[j - 1].counts > knot.counts) {
+                knots[j] = knots[j - 1];
+                j--;
+            }
+            knots[j] = knot;
+        }
+        for (size_t i = 0; i + 1 < knotCount; i++) {
+            int64_t rise = (int64_t)knots[i + 1].milligrams - knots[i].milligrams;
+            int64_t run = (int64_t)knots[i + 1].counts - knots[i].counts;
+            slopes[i] = (rise * 65536) / run;
+        }
+    }
+
+    LoadCellPoint points[LOAD_CELL_MAX_POINTS];  // In the order they were added
+    size_t pointCount = 0;
+    LoadCellPoint knots[LOAD_CELL_MAX_POINTS + 1];
+    int64_t slopes[LOAD_CELL_MAX_POINTS];
+    size_t knotCount = 0;
+};
+
+// Everything that turns one channel's conversions into grams
+struct LoadCellSettings {
+    LoadCellFilterConfig filter;
+    LoadCellCalibration calibration;
+    float tare = 0.0f;  // Filtered counts at zero load; taken at boot, never stored
+};
+
+// Stored form of the filter and calibration: fixed layout, little endian
+const uint8_t LOAD_CELL_RECORD_VERSION = 1;
+const size_t LOAD_CELL_RECORD_BYTES = 1 + 1 + 1 + 1 + 4 + 4 + 1 + LOAD_CELL_MAX_POINTS * 8;
+
+inline void loadCellPutU32(uint8_t* out, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        out[i] = (uint8_t)(value >> (8 * i));
+    }
+}
+
+inline uint32_t loadCellGetU32(const uint8_t* in) {
+    return (uint32_t)in[0] | ((uint32_t)in[1] << 8) | ((uint32_t)in[2] << 16) | ((uint32_t)in[3] << 24);
+}
+
+inline size_t loadCellEncodeRecord(const LoadCellSettings& settings, uint8_t* out) {
+    memset(out, 0, LOAD_CELL_RECORD_BYTES);
+    out[0] = LOAD_CELL_RECORD_VERSION;
+    out[1] = settings.filter.medianWindow;
+    out[2] = settings.filter.emaShift;
+    out[3] = settings.filter.kalman ? 1 : 0;
+    loadCellPutU32(out + 4, settings.filter.processNoise);
+    loadCellPutU32(out + 8, settings.filter.measurementNoise);
+    out[12] = (uint8_t)settings.calibration.count();
+    for (size_t i = 0; i < settings.calibration.count(); i++) {
+        loadCellPutU32(out + 13 + 8 * i, (uint32_t)settings.calibration[i].counts);
+        loadCellPutU32(out + 17 + 8 * i, (uint32_t)settings.calibration[i].milligrams);
+    }
+    return LOAD_CELL_RECORD_BYTES;
+}
+
+// False on a short, unknown or inconsistent record; settings are then untouched
+inline bool loadCellDecodeRecord(const uint8_t* in, size_t length, LoadCellSettings& settings) {
+    if (length != LOAD_CELL_RECORD_BYTES || in[0] != LOAD_CELL_RECORD_VERSION || in[12] > LOAD_CELL_MAX_POINTS) {
+        return false;
+    }
+    LoadCellFilterConfig filter;
+    filter.medianWindow = in[1];
+    filter.emaShift = in[2];
+    filter.kalman = in[3] != 0;
+    filter.processNoise = loadCellGetU32(in + 4);
+    filter.measurementNoise = loadCellGetU32(in + 8);
+    LoadCellCalibration calibration;
+    for (size_t i = 0; i < in[12]; i++) {
+        if (!calibration.addPoint((int32_t)loadCellGetU32(in + 13 + 8 * i), (int32_t)loadCellGetU32(in + 17 + 8 * i))) {
+            return false;
+        }
+    }
+    if (!filter.valid()) {
+        return false;
+    }
+    settings.filter = filter;
+    settings.calibration = calibration;
+    return true;
+}
+
+#endif // LOAD_CELL_CALIBRATION_H
@@ -0,0 +1,128 @@
+#ifndef LOAD_CELL_FILTER_H
+#define LOAD_CELL_FILTER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Filter chain for HX711 conversions: median spike rejection, then an
+// exponential moving average, then an optional scalar Kalman stage. All
+// integer arithmetic, so it costs the same on the ESP32 as on the host and
+// recorded traces filter bit for bit the same in both places.
+
+// Fractional bits of the filter state; outputs keep sub-count resolution
+const int LOAD_CELL_FRACTION_BITS = 8;
+
+// Widest median window
+const uint8_t LOAD_CELL_MAX_MEDIAN = 7;
+
+// Largest EMA shift (smoothing factor 2^-shift)
+const uint8_t LOAD_CELL_MAX_EMA_SHIFT = 8;
+
+struct LoadCellFilterConfig {
+    uint8_t medianWindow = 3;  // Odd, 1 disables, at most LOAD_CELL_MAX_MEDIAN
+    uint8_t emaShift = 2;      // 0 disables, at most LOAD_CELL_MAX_EMA_SHIFT
+    bool kalman = false;
+    uint32_t processNoise = 4;        // Kalman Q, counts^2 per conversion
+    uint32_t measurementNoise = 400;  // Kalman R, counts^2
+
+    bool operator==(const LoadCellFilterConfig& other) const {
+        return medianWindow == other.medianWindow && emaShift == other.emaShift && kalman == other.kalman &&
+               processNoise == other.processNoise && measurementNoise == other.measurementNoise;
+    }
+
+    bool valid() const {
+        return medianWindow >= 1 && medianWindow <= LOAD_CELL_MAX_MEDIAN && (medianWindow & 1) &&
+               emaShift <= LOAD_CELL_MAX_EMA_SHIFT && measurementNoise > 0;
+    }
+};
+
+class LoadCellFilter {
+public:
+    // Invalid configurations are ignored
+    void configure(const LoadCellFilterConfig& newConfig) {
+        if (newConfig.valid()) {
+            config = newConfig;
+        }
+        reset();
+    }
+
+    const LoadCellFilterConfig& getConfig() const { return config; }
+
+    // Forget the history; the next conversion primes every stage
+    void reset() {
+        windowCount = 0;
+        windowHead = 0;
+        primed = false;
+    }
+
+    // Feed one conversion, in counts
+    void add(int32_t counts) {
+        // Median of the last medianWindow conversions (fewer while filling)
+        window[windowHead] = counts;
+        windowHead = (uint8_t)((windowHead + 1) % config.medianWindow);
+        if (windowCount < config.medianWindow) {
+            windowCount++;
+        }
+        // Multiplied, not shifted: counts below the tare are negative
+        int64_t z = (int64_t)median() * ((int64_t)1 << LOAD_CELL_FRACTION_BITS);
+
+        if (!primed) {
+            ema = z;
+            estimate = z;
+            variance = (uint64_t)config.measurementNoise << LOAD_CELL_FRACTION_BITS;
+            primed = true;
+            return;
+        }
+
+        if (config.emaShift > 0) {
+            ema += (z - ema) / ((int64_t)1 << config.emaShift);
+        } else {
+            ema = z;
+        }
+
+        if (config.kalman) {
+            // Constant-value model: predict, then blend by the gain (Q16)
+            variance += (uint64_t)config.processNoise << LOAD_CELL_FRACTION_BITS;
+            uint64_t noise = (uint64_t)config.measurementNoise << LOAD_CELL_FRACTION_BITS;
+            int64_t gain = (int64_t)((variance << 16) / (variance + noise));
+            estimate += ((ema - estimate) * gain) / 65536;
+            variance = (variance * (uint64_t)(65536 - gain)) >> 16;
+        } else {
+            estimate = ema;
+        }
+    }
+
+    bool ready() const { return primed; }
+
+    // Filtered value with LOAD_CELL_FRACTION_BITS fractional bits
+    int64_t valueFixed() const { return estimate; }
+
+    // Filtered value in counts
+    float value() const { return (float)estimate / (float)(1 << LOAD_CELL_FRACTION_BITS); }
+
+private:
+    int32_t median() const {
+        int32_t sorted[LOAD_CELL_MAX_MEDIAN];
+        for (uint8_t i = 0; i < windowCount; i++) {
+            int32_t x = window[i];
+            uint8_t j = i;
+            while (j > 0 && sorted[j - 1] > x) {
+                sorted[j] = sorted[j - 1];
+                j--;
+            }
+            sorted[j] = x;
+        }
+        return sorted[windowCount / 2];
+    }
+
+    LoadCellFilterConfig config;
+    int32_t window[LOAD_CELL_MAX_MEDIAN];
+    uint8_t windowCount = 0;
+    uint8_t windowHead = 0;
+    bool primed = false;
+    int64_t ema = 0;
+    int64_t estimate = 0;
+    uint64_t variance = 0;  // Kalman error variance, counts^2 with fraction bits
+};
+
+#endif // LOAD_CELL_FILTER_H
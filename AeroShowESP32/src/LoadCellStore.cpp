@@ -0,0 +1,38 @@
+#include "LoadCellStore.h"
+#include <stdio.h>
+
+static const char* const LOAD_CELL_NAMESPACE = "loadcell";
+
+bool LoadCellStore::begin() {
+    ready = preferences.begin(LOAD_CELL_NAMESPACE, false);
+    return ready;
+}
+
+void LoadCellStore::keyFor(uint8_t channel, char* key) {
+    snprintf(key, 8, "ch%u", (unsigned)channel);
+}
+
+bool LoadCellStore::load(uint8_t channel, LoadCellSettings& settings) {
+    char key[8];
+    keyFor(channel, key);
+    if (!ready || preferences.getBytesLength(key) != LOAD_CELL_RECORD_BYTES) {
+        return false;
+    }
+    uint8_t record[LOAD_CELL_RECORD_BYTES];
+    preferences.getBytes(key, record, sizeof(record));
+    return loadCellDecodeRecord(record, sizeof(record), settings);
+}
+
+bool LoadCellStore::save(uint8_t channel, const LoadCellSettings& settings) {
+    char key[8];
+    keyFor(channel, key);
+    uint8_t record[LOAD_CELL_RECORD_BYTES];
+    size_t length = loadCellEncodeRecord(settings, record);
+    return ready && preferences.putBytes(key, record, length) == length;
+}
+
+bool LoadCellStore::erase(uint8_t channel) {
+    char key[8];
+    keyFor(channel, key);
+    return ready && preferences.remove(key);
+}
@@ -0,0 +1,25 @@
+#ifndef LOAD_CELL_STORE_H
+#define LOAD_CELL_STORE_H
+
+#include <Preferences.h>
+#include "LoadCellCalibration.h"
+
+// Filter and calibration per channel in NVS, one fixed-size record each
+// (see loadCellEncodeRecord). Only loop() and setup() use it.
+class LoadCellStore {
+public:
+    bool begin();
+
+    // False (and settings untouched) when nothing valid is stored
+    bool load(uint8_t channel, LoadCellSettings& settings);
+    bool save(uint8_t channel, const LoadCellSettings& settings);
+    bool erase(uint8_t channel);
+
+private:
+    static void keyFor(uint8_t channel, char* key);
+
+    Preferences preferences;
+    bool ready = false;
+};
+
+#endif // LOAD_CELL_STORE_H
@@ -0,0 +1,58 @@
+#ifndef LOG_RING_H
+#define LOG_RING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// The most recent log lines, kept in a fixed arena of fixed-size records.
+// Appending copies into the oldest record, so the ring never touches the
+// heap; lines longer than a record are truncated. Not synchronized: one
+// task appends and reads.
+template <size_t Records, size_t RecordSize>
+class LogRing {
+    static_assert(Records > 0 && RecordSize > 1, "LogRing needs at least one record of one character");
+
+public:
+    void append(const char* line) {
+        char* record = records[next];
+        size_t length = strnlen(line, RecordSize - 1);
+        memcpy(record, line, length);
+        record[length] = '\0';
+
+        next = (next + 1) % Records;
+        if (count < Records) {
+            count++;
+        }
+        total++;
+    }
+
+    // Visit the stored lines oldest first
+    template <typename Visitor>
+    void forEach(Visitor visit) const {
+        size_t first = (next + Records - count) % Records;
+        for (size_t i = 0; i < count; i++) {
+            visit(records[(first + i) % Records]);
+        }
+    }
+
+    // The index'th stored line, oldest first (index < size())
+    const char* line(size_t index) const { return records[(next + Records - count + index) % Records]; }
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    // Lines appended since boot, including those already overwritten
+    uint32_t getTotal() const { return total; }
+
+    static constexpr size_t capacity() { return Records; }
+    static constexpr size_t recordSize() { return RecordSize; }
+
+private:
+    char records[Records][RecordSize];
+    size_t next = 0;
+    size_t count = 0;
+    uint32_t total = 0;
+};
+
+#endif // LOG_RING_H
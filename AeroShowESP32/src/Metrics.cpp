@@ -0,0 +1,93 @@
+#include "Metrics.h"
+
+LatencyHistogram* LatencyHistogram::first = nullptr;
+
+LatencyHistogram::LatencyHistogram(const char* name, const char* help, bool exported)
+    : name(name), help(help), next(nullptr), count(0), sumMicros(0), maxMicros(0) {
+    for (size_t i = 0; i <= METRICS_LATENCY_BUCKETS; i++) {
+        buckets[i] = 0;
+    }
+    // Histograms are globals, so registration happens before setup()
+    if (exported) {
+        next = first;
+        first = this;
+    }
+}
+
+void LatencyHistogram::record(uint32_t cycles) {
+    // The CPU clock is fixed once the firmware is running
+    static const uint32_t cyclesPerMicro = getCpuFrequencyMhz();
+    recordMicros(cycles / cyclesPerMicro);
+}
+
+void LatencyHistogram::recordMicros(uint32_t micros) {
+    // Bucket i holds values up to 2^i us
+    size_t bucket = micros <= 1 ? 0 : 32 - __builtin_clz(micros - 1);
+    if (bucket > METRICS_LATENCY_BUCKETS) {
+        bucket = METRICS_LATENCY_BUCKETS;
+    }
+
+    buckets[bucket] = buckets[bucket] + 1;
+    count = count + 1;
+    sumMicros = sumMicros + micros;
+    if (micros > maxMicros) {
+        maxMicros = micros;
+    }
+}
+
+size_t LatencyHistogram::exportedCount() {
+    size_t count = 0;
+    for (const LatencyHistogram* histogram = first; histogram != nullptr; histogram = histogram->next) {
+        count++;
+    }
+    return count;
+}
+
+bool LatencyHistogram::writeOne(Print& out, size_t index) {
+    const LatencyHistogram* histogram = first;
+    for (; histogram != nullptr && index > 0; index--) {
+        histogram = histogram->next;
+    }
+    if (histogram == nullptr) {
+        return false;
+    }
+    histogram->write(out);
+    return true;
+}
+
+void LatencyHistogram::write(Print& out) const {
+    out.printf("# HELP aeroshow_%s_seconds %s\n", name, help);
+    out.printf("# TYPE aeroshow_%s_seconds histogram\n", name);
+
+    // Prometheus buckets are cumulative
+    uint32_t cumulative = 0;
+    for (size_t i = 0; i < METRICS_LATENCY_BUCKETS; i++) {
+        cumulative += buckets[i];
+        out.printf("aeroshow_%s_seconds_bucket{le=\"%g\"} %u\n", name, (double)(1UL << i) * 1e-6,
+                   (unsigned)cumulative);
+    }
+    out.printf("aeroshow_%s_seconds_bucket{le=\"+Inf\"} %u\n", name, (unsigned)count);
+    out.printf("aeroshow_%s_seconds_sum %.6f\n", name, (double)sumMicros * 1e-6);
+    out.printf("aeroshow_%s_seconds_count %u\n", name, (unsigned)count);
+    out.printf("aeroshow_%s_max_seconds %.6f\n", name, (double)maxMicros * 1e-6);
+}
+
+uint32_t metricsMeasureOverheadCycles() {
+    static LatencyHistogram probe("metrics_probe", "Overhead probe", false);
+    const int iterations = 64;
+
+    uint32_t start = ESP.getCycleCount();
+    for (int i = 0; i < iterations; i++) {
+        ScopedTimer timer(probe);
+    }
+    return (ESP.getCycleCount() - start) / iterations;
+}
+
+void metricsWriteGauge(Print& out, const char* name, const char* help, double value) {
+    out.printf("# HELP aeroshow_%s %s\n# TYPE aeroshow_%s gauge\naeroshow_%s %g\n", name, help, name, name, value);
+}
+
+void metricsWriteCounter(Print& out, const char* name, const char* help, uint32_t value) {
+    out.printf("# HELP aeroshow_%s %s\n# TYPE aeroshow_%s counter\naeroshow_%s %u\n", name, help, name, name,
+               (unsigned)value);
+}
@@ -0,0 +1,98 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <Arduino.h>
+
+// Hot-path instrumentation. Build with -DMETRICS_ENABLED=0 to compile every
+// METRICS_TIME() out and drop the /metrics route.
+#ifndef METRICS_ENABLED
+#define METRICS_ENABLED 1
+#endif
+
+// Histogram bucket upper bounds are powers of two microseconds, 1us to 2^19us (~0.5s)
+const size_t METRICS_LATENCY_BUCKETS = 20;
+
+// Fixed-bucket latency histogram fed with CPU cycle counts, or with
+// microseconds for spans too long to count in cycles. Each histogram
+// should be recorded from one task only; the exporter tolerates reading a
+// histogram mid-update.
+class LatencyHistogram {
+public:
+    // Exported histograms are listed by writeOne()
+    LatencyHistogram(const char* name, const char* help, bool exported = true);
+
+    void record(uint32_t cycles);
+    void recordMicros(uint32_t micros);
+
+    uint32_t getCount() const { return count; }
+    uint32_t getMaxMicros() const { return maxMicros; }
+
+    // Write the index'th registered histogram in Prometheus text format,
+    // one per call so a response can be sent in parts; false past the last
+    static bool writeOne(Print& out, size_t index);
+    static size_t exportedCount();
+
+private:
+    void write(Print& out) const;
+
+    const char* name;
+    const char* help;
+    LatencyHistogram* next;
+    volatile uint32_t buckets[METRICS_LATENCY_BUCKETS + 1];  // Last one is +Inf
+    volatile uint32_t count;
+    volatile uint64_t sumMicros;
+    volatile uint32_t maxMicros;
+
+    static LatencyHistogram* first;
+};
+
+// Records the lifetime of a scope into a histogram
+class ScopedTimer {
+public:
+    explicit ScopedTimer(LatencyHistogram& histogram) : histogram(histogram), start(ESP.getCycleCount()) {}
+    ~ScopedTimer() { histogram.record(ESP.getCycleCount() - start); }
+
+private:
+    LatencyHistogram& histogram;
+    uint32_t start;
+};
+
+// Records the time between successive calls, e.g. a loop period
+class PeriodTimer {
+public:
+    explicit PeriodTimer(LatencyHistogram& histogram) : histogram(histogram), last(0), started(false) {}
+
+    void tick() {
+        uint32_t now = ESP.getCycleCount();
+        if (started) {
+            histogram.record(now - last);
+        }
+        last = now;
+        started = true;
+    }
+
+private:
+    LatencyHistogram& histogram;
+    uint32_t last;
+    bool started;
+};
+
+// Cycles one METRICS_TIME() costs, measured at startup
+uint32_t metricsMeasureOverheadCycles();
+
+// Prometheus text helpers for one-off gauges and counters
+void metricsWriteGauge(Print& out, const char* name, const char* help, double value);
+void metricsWriteCounter(Print& out, const char* name, const char* help, uint32_t value);
+
+#define METRICS_CONCAT_INNER(a, b) a##b
+#define METRICS_CONCAT(a, b) METRICS_CONCAT_INNER(a, b)
+
+#if METRICS_ENABLED
+#define METRICS_TIME(histogram) ScopedTimer METRICS_CONCAT(metricsTimer, __LINE__)(histogram)
+#define METRICS_TICK(periodTimer) (periodTimer).tick()
+#else
+#define METRICS_TIME(histogram)
+#define METRICS_TICK(periodTimer)
+#endif
+
+#endif // METRICS_H
@@ -0,0 +1,217 @@
+#include "MotionEngine.h"
+
+MotionEngine::MotionEngine(ESCController& motor, Clock& clock)
+    : motor(motor), clock(clock), source(nullptr), windowBase(0), windowStartMicros(0),
+      updateHz(MOTION_DEFAULT_UPDATE_HZ), lastMicros(0), elapsedMicros(0), running(false), setpoint(0.0f),
+      packedPoint(1), updates(0), underruns(0) {
+#ifdef ARDUINO
+    timer = nullptr;
+#endif
+}
+
+bool MotionEngine::begin(uint32_t rateHz) {
+    updateHz = rateHz > 0 ? rateHz : MOTION_DEFAULT_UPDATE_HZ;
+#ifdef ARDUINO
+    esp_timer_create_args_t args = {};
+    args.callback = timerEntry;
+    args.arg = this;
+    args.dispatch_method = ESP_TIMER_TASK;
+    args.name = "motion";
+    return esp_timer_create(&args, &timer) == ESP_OK;
+#else
+    return true;
+#endif
+}
+
+bool MotionEngine::start(const MotionProfile& newProfile) {
+    stop();
+
+    std::lock_guard<std::mutex> guard(lock);
+    profile = newProfile;
+    source = nullptr;
+    return play();
+}
+
+bool MotionEngine::start(SegmentSource& newSource) {
+    stop();
+
+    std::lock_guard<std::mutex> guard(lock);
+    profile.clear(0.0f);
+    source = &newSource;
+    fill();
+    return play();
+}
+
+bool MotionEngine::follow(const MotionProfile& next) {
+    stopTimer();
+
+    std::lock_guard<std::mutex> guard(lock);
+    profile = next;
+    profile.setStartSetpoint(setpoint);
+    source = nullptr;
+    if (!play()) {
+        running = false;
+        motor.stop();
+        setpoint = 0.0f;
+        return false;
+    }
+    return true;
+}
+
+bool MotionEngine::follow(SegmentSource& next) {
+    stopTimer();
+
+    std::lock_guard<std::mutex> guard(lock);
+    profile.clear(setpoint);
+    source = &next;
+    fill();
+    if (!play()) {
+        running = false;
+        motor.stop();
+        setpoint = 0.0f;
+        return false;
+    }
+    return true;
+}
+
+void MotionEngine::refill() {
+    if (source == nullptr || !running) {
+        return;
+    }
+    // Every segment before the one in progress has played. Only the timer
+    // moves that on; the window's length changes here alone.
+    size_t played = (packedPoint >> 2) - windowBase;
+    size_t room = MOTION_MAX_SEGMENTS - (profile.count() - played);
+    if (room < MOTION_REFILL_SEGMENTS) {
+        return;
+    }
+
+    // Read ahead outside the lock, so a slow source never holds up the timer
+    ProfileSegment staged[MOTION_REFILL_SEGMENTS];
+    size_t count = 0;
+    bool more = true;
+    while (count < MOTION_REFILL_SEGMENTS) {
+        if (!source->next(staged[count])) {
+            more = false;
+            break;
+        }
+        count++;
+    }
+
+    std::lock_guard<std::mutex> guard(lock);
+    windowStartMicros += profile.dropFront(played) * 1000;
+    windowBase += played;
+    for (size_t i = 0; i < count; i++) {
+        profile.add(staged[i]);
+    }
+    if (!more) {
+        source = nullptr;
+    }
+}
+
+void MotionEngine::stop() {
+    stopTimer();
+    // Waits for an update already in progress, so the motor is stopped last
+    std::lock_guard<std::mutex> guard(lock);
+    running = false;
+    motor.stop();
+    setpoint = 0.0f;
+}
+
+void MotionEngine::stopTimer() {
+#ifdef ARDUINO
+    if (timer != nullptr) {
+        esp_timer_stop(timer);
+    }
+#endif
+}
+
+// Read the source until the window is full; called with the lock held and
+// the timer stopped
+void MotionEngine::fill() {
+    ProfileSegment segment;
+    while (source != nullptr && profile.count() < MOTION_MAX_SEGMENTS) {
+        if (!source->next(segment)) {
+            source = nullptr;
+            break;
+        }
+        profile.add(segment);
+    }
+}
+
+// Start the profile just copied in or filled; called with the lock held
+bool MotionEngine::play() {
+    elapsedMicros = 0;
+    lastMicros = clock.micros();
+    windowBase = 0;
+    windowStartMicros = 0;
+
+    ProfilePoint point = profile.evaluate(0);
+    point.done = point.done && source == nullptr;
+    publish(point);
+    if (point.done) {
+        return false;
+    }
+
+    // The first setpoint goes out now rather than one period later
+    motor.setSpeed(point.setpoint);
+    running = true;
+#ifdef ARDUINO
+    if (timer != nullptr) {
+        esp_timer_start_periodic(timer, 1000000 / updateHz);
+    }
+#endif
+    return true;
+}
+
+void MotionEngine::update() {
+    std::lock_guard<std::mutex> guard(lock);
+    if (!running) {
+        return;
+    }
+
+    uint32_t now = clock.micros();
+    elapsedMicros += (uint32_t)(now - lastMicros);
+    lastMicros = now;
+
+    ProfilePoint point = profile.evaluate(elapsedMicros - windowStartMicros);
+    if (point.done && source != nullptr) {
+        // The window played out before refill() caught up: hold the last
+        // target with the clock stopped at the window's end, so the next
+        // segment plays from its start rather than partway through
+        elapsedMicros = windowStartMicros + profile.durationMs() * 1000;
+        point.done = false;
+        underruns++;
+    }
+    point.segment += windowBase;
+    motor.setSpeed(point.setpoint);
+    publish(point);
+    updates++;
+
+    // Hold the last target until stop(); the timer has nothing more to do
+    if (point.done) {
+        running = false;
+#ifdef ARDUINO
+        esp_timer_stop(timer);
+#endif
+    }
+}
+
+ProfilePoint MotionEngine::getPoint() const {
+    uint32_t packed = packedPoint;
+    ProfilePoint point;
+    point.setpoint = setpoint;
+    point.segment = packed >> 2;
+    point.holding = (packed & 2) != 0;
+    point.done = (packed & 1) != 0;
+    return point;
+}
+
+void MotionEngine::publish(const ProfilePoint& point) {
+    setpoint = point.setpoint;
+    packedPoint = ((uint32_t)point.segment << 2) | (point.holding ? 2u : 0u) | (point.done ? 1u : 0u);
+}
+
+void MotionEngine::timerEntry(void* arg) {
+    static_cast<MotionEngine*>(arg)->update();
+}
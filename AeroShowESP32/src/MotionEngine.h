@@ -0,0 +1,112 @@
+#ifndef MOTION_ENGINE_H
+#define MOTION_ENGINE_H
+
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include "Hal.h"
+#include "ESCController.h"
+#include "MotionProfile.h"
+
+#ifdef ARDUINO
+#include <esp_timer.h>
+#endif
+
+// Output rate while a profile plays. 50 Hz servo PWM only shows every
+// fourth update, but faster ESC protocols can use them all.
+const uint32_t MOTION_DEFAULT_UPDATE_HZ = 200;
+
+// Played segments are dropped and the next ones read from a SegmentSource
+// once there is room for this many, so long plans stream through a fixed
+// window
+const size_t MOTION_REFILL_SEGMENTS = MOTION_MAX_SEGMENTS / 2;
+
+// Plays a MotionProfile into an ESCController at a fixed rate. On the
+// device an esp_timer calls update(), so ramps keep running while loop()
+// serves HTTP and the sampling task keeps sampling. Off-target there is no
+// timer and the caller drives update() itself.
+//
+// Plans longer than a profile play from a SegmentSource: the engine holds
+// a window of MOTION_MAX_SEGMENTS and refill() moves it along. The source
+// is only read from start(), follow() and refill(), never from the timer,
+// so it may read flash.
+//
+// While a profile plays the engine is the only writer of the motor; other
+// tasks follow it through getSetpoint() and getPoint().
+class MotionEngine {
+public:
+    MotionEngine(ESCController& motor, Clock& clock);
+
+    // Create the update timer
+    bool begin(uint32_t updateHz = MOTION_DEFAULT_UPDATE_HZ);
+
+    // Copy the profile and play it from now; false if it has no segments
+    bool start(const MotionProfile& newProfile);
+
+    // Play segments from source from now; it must outlive the playback
+    bool start(SegmentSource& source);
+
+    // Play the next profile from the current setpoint without stopping the
+    // motor in between; the first segment ramps from wherever the last one
+    // left off. Stops the motor if it has no segments.
+    bool follow(const MotionProfile& next);
+    bool follow(SegmentSource& source);
+
+    // Drop played segments and read the next ones from the source. Call
+    // from the task that started playback, often enough that the window
+    // never runs dry; a no-op for a plain profile.
+    void refill();
+
+    // Stop playing and stop the motor
+    void stop();
+
+    // Evaluate the profile now and write the motor (the timer's job on the device)
+    void update();
+
+    bool isRunning() const { return running; }
+
+    // Setpoint last written to the motor (0.0 to 1.0)
+    float getSetpoint() const { return setpoint; }
+
+    // Segment and phase as of the last update; segments count from the
+    // start of the plan, not of the window
+    ProfilePoint getPoint() const;
+
+    uint32_t getUpdates() const { return updates; }
+
+    // Updates that found the window played out with the source not yet
+    // done; the setpoint holds and the plan's clock stops until refill()
+    // catches up
+    uint32_t getUnderruns() const { return underruns; }
+    uint32_t getUpdateHz() const { return updateHz; }
+
+private:
+    static void timerEntry(void* arg);
+    void stopTimer();
+    bool play();
+    void fill();
+    void publish(const ProfilePoint& point);
+
+    ESCController& motor;
+    Clock& clock;
+    MotionProfile profile;  // The window being played
+    SegmentSource* source;  // Where the window's next segments come from, nullptr once read out
+    size_t windowBase;      // Plan segment the window starts with
+    uint64_t windowStartMicros;  // Elapsed time at which it starts
+    uint32_t updateHz;
+    uint32_t lastMicros;
+    uint64_t elapsedMicros;  // Accumulated, so micros() may wrap mid-profile
+    std::mutex lock;
+
+    std::atomic<bool> running;
+    std::atomic<float> setpoint;
+    std::atomic<uint32_t> packedPoint;  // Segment << 2 | holding << 1 | done
+    std::atomic<uint32_t> updates;
+    std::atomic<uint32_t> underruns;
+
+#ifdef ARDUINO
+    esp_timer_handle_t timer;
+#endif
+};
+
+#endif // MOTION_ENGINE_H
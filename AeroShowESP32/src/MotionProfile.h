@@ -0,0 +1,185 @@
+#ifndef MOTION_PROFILE_H
+#define MOTION_PROFILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Throttle setpoint profiles for motor tests. Pure math, no Arduino calls,
+// so profiles can be evaluated and checked on the host.
+
+// Segments a profile can hold
+const size_t MOTION_MAX_SEGMENTS = 64;
+
+// Share of a trapezoidal ramp spent accelerating (and again decelerating)
+const float MOTION_TRAPEZOID_ACCEL_FRACTION = 0.25f;
+
+// How a segment moves from the previous setpoint to its target
+enum class RampShape : uint8_t {
+    Step,       // Jump at the start of the segment; rampMs is then settling time
+    Linear,     // Constant rate
+    Trapezoid,  // Constant acceleration, cruise, constant deceleration
+    SCurve      // Smooth in rate and acceleration (quintic smootherstep)
+};
+
+// Ramp to target over rampMs, then hold it for holdMs
+struct ProfileSegment {
+    float target = 0.0f;
+    uint32_t rampMs = 0;
+    uint32_t holdMs = 0;
+    RampShape shape = RampShape::Linear;
+};
+
+// Where a profile is at a given time
+struct ProfilePoint {
+    float setpoint = 0.0f;
+    size_t segment = 0;    // Segment in progress; equals count() once done
+    bool holding = false;  // In the hold part of the segment
+    bool done = false;     // Past the end; setpoint is the last target
+};
+
+// Fraction of a ramp covered at progress u in [0, 1]
+inline float rampFraction(RampShape shape, float u) {
+    if (u <= 0.0f) {
+        return shape == RampShape::Step ? 1.0f : 0.0f;
+    }
+    if (u >= 1.0f) {
+        return 1.0f;
+    }
+
+    switch (shape) {
+    case RampShape::Step:
+        return 1.0f;
+    case RampShape::Linear:
+        return u;
+    case RampShape::Trapezoid: {
+        const float f = MOTION_TRAPEZOID_ACCEL_FRACTION;
+        const float peak = 1.0f / (1.0f - f);  // Cruise rate so the area is 1
+        if (u < f) {
+            return peak * u * u / (2.0f * f);
+        }
+        if (u > 1.0f - f) {
+            float r = 1.0f - u;
+            return 1.0f - peak * r * r / (2.0f * f);
+        }
+        return peak * (u - f / 2.0f);
+    }
+    case RampShape::SCurve:
+        return u * u * u * (u * (u * 6.0f - 15.0f) + 10.0f);
+    }
+    return u;
+}
+
+// Parse the names used in test requests; false if unknown
+inline bool parseRampShape(const char* name, RampShape& shape) {
+    if (strcmp(name, "step") == 0) {
+        shape = RampShape::Step;
+    } else if (strcmp(name, "linear") == 0) {
+        shape = RampShape::Linear;
+    } else if (strcmp(name, "trapezoid") == 0) {
+        shape = RampShape::Trapezoid;
+    } else if (strcmp(name, "s_curve") == 0) {
+        shape = RampShape::SCurve;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Segments of a plan too long to hold in one MotionProfile, in order
+class SegmentSource {
+public:
+    virtual ~SegmentSource() {}
+
+    // The next segment; false once there are no more
+    virtual bool next(ProfileSegment& segment) = 0;
+};
+
+// A sequence of segments starting from an initial setpoint
+class MotionProfile {
+public:
+    void clear(float startSetpoint = 0.0f) {
+        start = startSetpoint;
+        segmentCount = 0;
+        totalMs = 0;
+    }
+
+    // Returns false once MOTION_MAX_SEGMENTS are defined
+    bool add(const ProfileSegment& segment) {
+        if (segmentCount >= MOTION_MAX_SEGMENTS) {
+            return false;
+        }
+        segments[segmentCount++] = segment;
+        totalMs += segment.rampMs + segment.holdMs;
+        return true;
+    }
+
+    // Setpoint the first segment ramps from
+    void setStartSetpoint(float setpoint) { start = setpoint; }
+
+    // Forget the first count segments once they have played; the profile
+    // then starts from the last one's target. Returns their length in ms.
+    uint64_t dropFront(size_t count) {
+        if (count > segmentCount) {
+            count = segmentCount;
+        }
+        uint64_t droppedMs = 0;
+        for (size_t i = 0; i < count; i++) {
+            droppedMs += segments[i].rampMs + segments[i].holdMs;
+        }
+        if (count > 0) {
+            start = segments[count - 1].target;
+            memmove(segments, segments + count, (segmentCount - count) * sizeof(ProfileSegment));
+            segmentCount -= count;
+            totalMs -= droppedMs;
+        }
+        return droppedMs;
+    }
+
+    size_t count() const { return segmentCount; }
+    const ProfileSegment& operator[](size_t i) const { return segments[i]; }
+    float startSetpoint() const { return start; }
+    uint64_t durationMs() const { return totalMs; }
+
+    // Setpoint at elapsedMicros since the profile started
+    ProfilePoint evaluate(uint64_t elapsedMicros) const {
+        ProfilePoint point;
+        float from = start;
+        uint64_t segmentStart = 0;
+
+        for (size_t i = 0; i < segmentCount; i++) {
+            const ProfileSegment& segment = segments[i];
+            uint64_t rampMicros = (uint64_t)segment.rampMs * 1000;
+            uint64_t segmentMicros = rampMicros + (uint64_t)segment.holdMs * 1000;
+
+            if (elapsedMicros < segmentStart + segmentMicros) {
+                uint64_t into = elapsedMicros - segmentStart;
+                point.segment = i;
+                if (into < rampMicros && segment.shape != RampShape::Step) {
+                    float u = (float)into / (float)rampMicros;
+                    point.setpoint = from + (segment.target - from) * rampFraction(segment.shape, u);
+                } else {
+                    point.setpoint = segment.target;
+                    point.holding = into >= rampMicros;
+                }
+                return point;
+            }
+
+            from = segment.target;
+            segmentStart += segmentMicros;
+        }
+
+        point.setpoint = from;
+        point.segment = segmentCount;
+        point.done = true;
+        return point;
+    }
+
+private:
+    ProfileSegment segments[MOTION_MAX_SEGMENTS];
+    size_t segmentCount = 0;
+    float start = 0.0f;
+    uint64_t totalMs = 0;
+};
+
+#endif // MOTION_PROFILE_H
@@ -0,0 +1,696 @@
+#include "PlanParser.h"
+#include <stdlib.h>
+#include <string.h>
+
+namespace {
+
+const char* const MISSING_FIELDS = "Missing or invalid required fields";
+const char* const INVALID_PROFILE = "Invalid speed profile";
+const char* const INVALID_CHANNEL = "Invalid channel";
+const char* const INVALID_JSON = "Invalid JSON";
+const char* const TOO_LARGE = "Request too large";
+
+int hexDigit(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+}  // namespace
+
+PlanParser::PlanParser()
+    : job(nullptr), spill(nullptr), rigChannels(0), active(false), tooLarge(false), error(nullptr), bytes(0),
+      lex(Lex::Value), keyString(false), tokenLength(0), tokenOverflow(false), unicode(0), unicodeDigits(0),
+      number(0.0), depth(0), arrayLevels(0), channelEntries(0), current(entries), channelsSeen(false),
+      badChannel(false), hasTestId(false), testIdTooLong(false), badFormat(false), badOverflow(false),
+      badSummaryOnly(false), badPriority(false), badKeepSpinning(false), spillUsed(0), spillCreated(false) {
+    token[0] = '\0';
+}
+
+void PlanParser::begin(TestJob& target, size_t channels, PlanSpill* planSpill, uint32_t planId) {
+    job = &target;
+    *job = TestJob();
+    job->plan.id = planId;
+    spill = planSpill;
+    rigChannels = channels;
+    active = true;
+    tooLarge = false;
+    error = nullptr;
+    bytes = 0;
+
+    lex = Lex::Value;
+    depth = 0;
+    arrayLevels = 0;
+    for (size_t i = 0; i <= RIG_MAX_CHANNELS; i++) {
+        entries[i] = Entry();
+    }
+    channelEntries = 0;
+    current = entries;
+    channelsSeen = false;
+    badChannel = false;
+    hasTestId = false;
+    testIdTooLong = false;
+    badFormat = false;
+    badOverflow = false;
+    badSummaryOnly = false;
+    badPriority = false;
+    badKeepSpinning = false;
+    spillUsed = 0;
+    spillCreated = false;
+}
+
+bool PlanParser::feed(const char* data, size_t length) {
+    if (!active) {
+        return false;
+    }
+    bytes += length;
+    for (size_t i = 0; i < length && error == nullptr; i++) {
+        consume(data[i]);
+    }
+    return error == nullptr;
+}
+
+const char* PlanParser::finish() {
+    if (!active) {
+        tooLarge = false;
+        return "No data received";
+    }
+    active = false;
+
+    // A bare number as the whole body only ends here
+    if (error == nullptr && lex == Lex::Scalar) {
+        endScalar();
+    }
+    if (error == nullptr && bytes == 0) {
+        fail("No data received");
+    }
+    if (error == nullptr && lex != Lex::End) {
+        fail(INVALID_JSON);
+    }
+    if (error == nullptr && spillCreated) {
+        flushSpill();
+    }
+    if (spillCreated && !spill->close()) {
+        fail(TOO_LARGE, true);
+    }
+    if (error == nullptr) {
+        error = validate();
+    }
+    if (error != nullptr) {
+        discard();
+    }
+    return error;
+}
+
+void PlanParser::abort() {
+    if (!active) {
+        return;
+    }
+    active = false;
+    if (spillCreated) {
+        spill->close();
+    }
+    discard();
+}
+
+void PlanParser::discard() {
+    if (spillCreated) {
+        spill->remove(job->plan.id);
+        spillCreated = false;
+    }
+    job->plan.stepCount = 0;
+}
+
+void PlanParser::fail(const char* message, bool large) {
+    if (error == nullptr) {
+        error = message;
+        tooLarge = large;
+    }
+}
+
+void PlanParser::consume(char c) {
+    switch (lex) {
+    case Lex::String:
+        if (c == '"') {
+            token[tokenLength] = '\0';
+            if (keyString) {
+                keys[depth - 1] = tokenOverflow ? Field::Unknown : classify(token);
+                lex = Lex::Colon;
+            } else {
+                lex = depth == 0 ? Lex::End : Lex::AfterValue;
+                value(Kind::String);
+            }
+        } else if (c == '\\') {
+            lex = Lex::Escape;
+        } else if ((uint8_t)c < 0x20) {
+            fail(INVALID_JSON);
+        } else {
+            putChar(c);
+        }
+        return;
+
+    case Lex::Escape: {
+        static const char FROM[] = "\"\\/bfnrt";
+        static const char TO[] = "\"\\/\b\f\n\r\t";
+        const char* at = c == '\0' ? nullptr : strchr(FROM, c);
+        if (c == 'u') {
+            unicode = 0;
+            unicodeDigits = 0;
+            lex = Lex::Unicode;
+        } else if (at == nullptr) {
+            fail(INVALID_JSON);
+        } else {
+            putChar(TO[at - FROM]);
+            lex = Lex::String;
+        }
+        return;
+    }
+
+    case Lex::Unicode: {
+        int digit = hexDigit(c);
+        if (digit < 0) {
+            fail(INVALID_JSON);
+            return;
+        }
+        unicode = (unicode << 4) | (uint32_t)digit;
+        if (++unicodeDigits < 4) {
+            return;
+        }
+        // UTF-8; surrogate halves are kept as they are
+        if (unicode < 0x80) {
+            putChar((char)unicode);
+        } else if (unicode < 0x800) {
+            putChar((char)(0xc0 | (unicode >> 6)));
+            putChar((char)(0x80 | (unicode & 0x3f)));
+        } else {
+            putChar((char)(0xe0 | (unicode >> 12)));
+            putChar((char)(0x80 | ((unicode >> 6) & 0x3f)));
+            putChar((char)(0x80 | (unicode & 0x3f)));
+        }
+        lex = Lex::String;
+        return;
+    }
+
+    case Lex::Scalar:
+        if ((c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || c == '-' || c == '+' || c == '.' || c == 'E') {
+            putChar(c);
+            return;
+        }
+        // c follows the value
+        endScalar();
+        if (error != nullptr) {
+            return;
+        }
+        break;
+
+    default:
+        break;
+    }
+
+    if (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+        return;
+    }
+
+    switch (lex) {
+    case Lex::FirstValue:
+        if (c == ']') {
+            close(true);
+            return;
+        }
+        // Fall through
+    case Lex::Value:
+        if (c == '{' || c == '[') {
+            open(c == '[');
+        } else if (c == '"') {
+            startToken(false);
+            lex = Lex::String;
+        } else if (c == '-' || (c >= '0' && c <= '9') || c == 't' || c == 'f' || c == 'n') {
+            startToken(false);
+            putChar(c);
+            lex = Lex::Scalar;
+        } else {
+            fail(INVALID_JSON);
+        }
+        return;
+
+    case Lex::FirstKey:
+        if (c == '}') {
+            close(false);
+            return;
+        }
+        // Fall through
+    case Lex::Key:
+        if (c == '"') {
+            startToken(true);
+            lex = Lex::String;
+        } else {
+            fail(INVALID_JSON);
+        }
+        return;
+
+    case Lex::Colon:
+        if (c == ':') {
+            lex = Lex::Value;
+        } else {
+            fail(INVALID_JSON);
+        }
+        return;
+
+    case Lex::AfterValue:
+        if (c == ',') {
+            lex = (arrayLevels >> (depth - 1)) & 1 ? Lex::Value : Lex::Key;
+        } else if (c == ']' || c == '}') {
+            close(c == ']');
+        } else {
+            fail(INVALID_JSON);
+        }
+        return;
+
+    default:
+        // Only whitespace may follow the document
+        fail(INVALID_JSON);
+        return;
+    }
+}
+
+void PlanParser::startToken(bool key) {
+    keyString = key;
+    tokenLength = 0;
+    tokenOverflow = false;
+}
+
+void PlanParser::putChar(char c) {
+    if (tokenLength < sizeof(token) - 1) {
+        token[tokenLength++] = c;
+    } else {
+        tokenOverflow = true;
+    }
+}
+
+void PlanParser::endScalar() {
+    token[tokenLength] = '\0';
+    lex = depth == 0 ? Lex::End : Lex::AfterValue;
+    if (tokenOverflow) {
+        fail(INVALID_JSON);
+        return;
+    }
+
+    Kind kind = Kind::Number;
+    if (strcmp(token, "true") == 0) {
+        kind = Kind::True;
+    } else if (strcmp(token, "false") == 0) {
+        kind = Kind::False;
+    } else if (strcmp(token, "null") == 0) {
+        kind = Kind::Null;
+    } else {
+        char* end = nullptr;
+        number = strtod(token, &end);
+        if (strspn(token, "0123456789-+.eE") != tokenLength || end != token + tokenLength) {
+            fail(INVALID_JSON);
+            return;
+        }
+    }
+    value(kind);
+}
+
+void PlanParser::open(bool array) {
+    if (depth >= PLAN_PARSE_MAX_DEPTH) {
+        fail(INVALID_JSON);
+        return;
+    }
+
+    // What the new container is from where it sits; anything the plan
+    // does not use is skipped, with what it contains
+    Frame parent = frame();
+    Field key = depth == 0 ? Field::Unknown : keys[depth - 1];
+    bool profile = parent == Frame::Root || parent == Frame::Entry;
+    Frame next = Frame::Skip;
+    if (depth == 0) {
+        next = array ? Frame::Skip : Frame::Root;
+    } else if (profile && array && key == Field::Speeds) {
+        next = Frame::Speeds;
+    } else if (profile && array && key == Field::Segments) {
+        next = Frame::Segments;
+    } else if (parent == Frame::Root && array && key == Field::Channels) {
+        next = Frame::Channels;
+    } else if (parent == Frame::Channels && !array && channelEntries < RIG_MAX_CHANNELS) {
+        next = Frame::Entry;
+    } else if (parent == Frame::Segments && !array) {
+        next = Frame::Segment;
+    } else {
+        // A container where the plan expects a plain value
+        value(Kind::Container);
+    }
+
+    switch (next) {
+    case Frame::Root:
+        current = &entries[0];
+        break;
+    case Frame::Channels:
+        channelsSeen = true;
+        break;
+    case Frame::Entry:
+        current = &entries[++channelEntries];
+        break;
+    case Frame::Speeds:
+        current->hasSpeeds = true;
+        current->speedsFirst = job->plan.stepCount;
+        current->speedsCount = 0;
+        break;
+    case Frame::Segments:
+        current->hasSegments = true;
+        current->segmentsFirst = job->plan.stepCount;
+        current->segmentsCount = 0;
+        current->segmentsMs = 0;
+        break;
+    case Frame::Segment:
+        pending = Pending();
+        break;
+    default:
+        break;
+    }
+
+    frames[depth] = next;
+    keys[depth] = Field::Unknown;
+    if (array) {
+        arrayLevels |= (uint16_t)(1u << depth);
+    } else {
+        arrayLevels &= (uint16_t)~(1u << depth);
+    }
+    depth++;
+    lex = array ? Lex::FirstValue : Lex::FirstKey;
+}
+
+void PlanParser::close(bool array) {
+    if (depth == 0 || (((arrayLevels >> (depth - 1)) & 1) != 0) != array) {
+        fail(INVALID_JSON);
+        return;
+    }
+    Frame closing = frames[depth - 1];
+    depth--;
+    lex = depth == 0 ? Lex::End : Lex::AfterValue;
+
+    if (closing == Frame::Segment) {
+        closeSegment();
+    } else if (closing == Frame::Entry) {
+        current = &entries[0];
+    }
+}
+
+void PlanParser::value(Kind kind) {
+    switch (frame()) {
+    case Frame::Root:
+        rootValue(kind);
+        break;
+    case Frame::Entry:
+        entryValue(*current, kind);
+        break;
+    case Frame::Speeds: {
+        float speed = kind == Kind::Number ? (float)number : -1.0f;
+        if (speed < 0.0f || speed > 1.0f) {
+            current->badSpeeds = true;
+            break;
+        }
+        PlanStep step = PlanStep::stepped(speed);
+        if (current->speedsCount == 0) {
+            current->firstSpeed = step.target();
+        }
+        appendStep(current->speedsCount, step);
+        break;
+    }
+    case Frame::Channels:
+        // Not an object, or more entries than the rig has channels
+        badChannel = true;
+        break;
+    case Frame::Segments:
+        current->badSegments = true;
+        break;
+    case Frame::Segment:
+        segmentValue(kind);
+        break;
+    default:
+        break;
+    }
+}
+
+void PlanParser::rootValue(Kind kind) {
+    int64_t priority = 0;
+    switch (keys[depth - 1]) {
+    case Field::TestId:
+        hasTestId = kind == Kind::String;
+        testIdTooLong = hasTestId && (tokenOverflow || tokenLength >= sizeof(job->testId));
+        if (hasTestId && !testIdTooLong) {
+            memcpy(job->testId, token, tokenLength + 1);
+        }
+        break;
+    case Field::Format:
+        // "json" (default) or "binary"
+        badFormat = kind != Kind::Null &&
+                    (kind != Kind::String || (strcmp(token, "json") != 0 && strcmp(token, "binary") != 0));
+        job->format = kind == Kind::String && strcmp(token, "binary") == 0 ? TelemetryFormat::Binary
+                                                                           : TelemetryFormat::Json;
+        break;
+    case Field::Overflow:
+        // "drop_newest" (default), "overwrite_oldest" or "block"
+        job->overflow = OverflowPolicy::DropNewest;
+        badOverflow = kind != Kind::Null && (kind != Kind::String || !parseOverflowPolicy(token, job->overflow));
+        break;
+    case Field::SummaryOnly:
+        badSummaryOnly = kind != Kind::Null && kind != Kind::True && kind != Kind::False;
+        job->summaryOnly = kind == Kind::True;
+        break;
+    case Field::Priority:
+        badPriority = kind != Kind::Null && !integer(kind, -128, 127, priority);
+        job->priority = (int8_t)priority;
+        break;
+    case Field::KeepSpinning:
+        badKeepSpinning = kind != Kind::Null && kind != Kind::True && kind != Kind::False;
+        job->keepSpinning = kind == Kind::True;
+        break;
+    default:
+        entryValue(entries[0], kind);
+        break;
+    }
+}
+
+void PlanParser::entryValue(Entry& target, Kind kind) {
+    int64_t n = 0;
+    switch (keys[depth - 1]) {
+    case Field::Channel:
+        target.channel = integer(kind, -1, 255, n) ? (int32_t)n : -1;
+        break;
+    case Field::RampDelay:
+        target.hasRampDelay = integer(kind, INT32_MIN, INT32_MAX, n);
+        if (target.hasRampDelay && n < 0) {
+            target.badSpeeds = true;
+        }
+        target.holdMs = (uint32_t)(n > 0 ? n : 0);
+        break;
+    case Field::RampMs:
+        if (kind != Kind::Null && !integer(kind, 0, UINT32_MAX, n)) {
+            target.badSpeeds = true;
+        }
+        target.rampMs = (uint32_t)n;
+        break;
+    case Field::RampShape:
+        if (kind != Kind::Null && (kind != Kind::String || !parseRampShape(token, target.shape))) {
+            target.badSpeeds = true;
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+void PlanParser::segmentValue(Kind kind) {
+    int64_t n = 0;
+    switch (keys[depth - 1]) {
+    case Field::Speed:
+        pending.speed = kind == Kind::Number ? (float)number : -1.0f;
+        break;
+    case Field::RampMs:
+        pending.bad = pending.bad || (kind != Kind::Null && !integer(kind, 0, PLAN_MAX_RAMP_MS, n));
+        pending.rampMs = (uint32_t)n;
+        break;
+    case Field::HoldMs:
+        pending.bad = pending.bad || (kind != Kind::Null && !integer(kind, 0, PLAN_MAX_HOLD_MS, n));
+        pending.holdMs = (uint32_t)n;
+        break;
+    case Field::Shape:
+        if (kind != Kind::Null && (kind != Kind::String || !parseRampShape(token, pending.shape))) {
+            pending.bad = true;
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+void PlanParser::closeSegment() {
+    if (pending.bad || !(pending.speed >= 0.0f && pending.speed <= 1.0f)) {
+        current->badSegments = true;
+        return;
+    }
+    current->segmentsMs += pending.rampMs + pending.holdMs;
+    appendStep(current->segmentsCount, PlanStep::segment(pending.speed, pending.rampMs, pending.holdMs, pending.shape));
+}
+
+bool PlanParser::integer(Kind kind, int64_t min, int64_t max, int64_t& result) const {
+    if (kind != Kind::Number || strpbrk(token, ".eE") != nullptr || number < (double)min || number > (double)max) {
+        return false;
+    }
+    result = (int64_t)number;
+    return true;
+}
+
+// Steps go to RAM first and to the spill once RAM is full
+void PlanParser::appendStep(uint32_t& count, const PlanStep& step) {
+    TestPlan& plan = job->plan;
+    if (plan.stepCount >= PLAN_MAX_STEPS) {
+        fail(TOO_LARGE, true);
+        return;
+    }
+    if (plan.stepCount < PLAN_RAM_STEPS) {
+        plan.steps[plan.stepCount] = step;
+    } else {
+        if (!spillCreated) {
+            if (spill == nullptr || !spill->create(plan.id)) {
+                fail(TOO_LARGE, true);
+                return;
+            }
+            spillCreated = true;
+        }
+        spillBuffer[spillUsed++] = step;
+        if (spillUsed == PLAN_SPILL_STEPS && !flushSpill()) {
+            return;
+        }
+    }
+    plan.stepCount++;
+    count++;
+}
+
+bool PlanParser::flushSpill() {
+    if (spillUsed > 0 && !spill->append(spillBuffer, spillUsed)) {
+        // Most likely the filesystem is full
+        fail(TOO_LARGE, true);
+        return false;
+    }
+    spillUsed = 0;
+    return true;
+}
+
+// Same checks, in the same order, as the request format has always had
+const char* PlanParser::validate() {
+    if (!hasTestId) {
+        return MISSING_FIELDS;
+    }
+    if (testIdTooLong) {
+        return "test_id too long";
+    }
+
+    // A profile at the top level drives channel 0; "channels" lists
+    // {channel, <profile>} for any of the rig's channels instead
+    const char* profileError = nullptr;
+    if (!channelsSeen) {
+        profileError = buildChannel(entries[0], 0);
+    } else if (channelEntries == 0 && !badChannel) {
+        profileError = MISSING_FIELDS;
+    } else {
+        for (size_t i = 1; i <= channelEntries && profileError == nullptr; i++) {
+            int32_t channel = entries[i].channel;
+            if (channel < 0 || (size_t)channel >= rigChannels || job->active[channel]) {
+                profileError = INVALID_CHANNEL;
+            } else {
+                profileError = buildChannel(entries[i], channel);
+            }
+        }
+        if (profileError == nullptr && badChannel) {
+            profileError = INVALID_CHANNEL;
+        }
+    }
+    if (profileError != nullptr) {
+        return profileError;
+    }
+
+    if (badFormat) {
+        return "Unsupported format";
+    }
+    if (badOverflow) {
+        return "Unsupported overflow policy";
+    }
+    if (badSummaryOnly) {
+        return "summary_only must be a boolean";
+    }
+    if (badPriority) {
+        return "priority must be an integer from -128 to 127";
+    }
+    if (badKeepSpinning) {
+        return "keep_spinning must be a boolean";
+    }
+    job->rampDelay = channelsSeen ? entries[1].holdMs : entries[0].holdMs;
+    return nullptr;
+}
+
+// A profile is either "speeds" + "ramp_delay" or a list of "segments".
+// Speeds give the classic stepped test: a linear ramp from standstill to
+// the first speed, then ramp_delay ms at each speed, with optional
+// "ramp_ms" and "ramp_shape" for the moves between steps.
+const char* PlanParser::buildChannel(const Entry& entry, int32_t channel) {
+    if (!entry.hasSegments && !(entry.hasSpeeds && entry.hasRampDelay)) {
+        return MISSING_FIELDS;
+    }
+
+    PlanChannel& out = job->plan.channels[channel];
+    out = PlanChannel();
+    if (entry.hasSegments) {
+        if (entry.badSegments || entry.segmentsCount == 0) {
+            return INVALID_PROFILE;
+        }
+        out.first = entry.segmentsFirst;
+        out.count = entry.segmentsCount;
+        out.durationMs = entry.segmentsMs;
+    } else {
+        if (entry.badSpeeds) {
+            return INVALID_PROFILE;
+        }
+        out.first = entry.speedsFirst;
+        out.count = entry.speedsCount;
+        out.holdMs = entry.holdMs;
+        out.rampMs = entry.rampMs;
+        out.shape = entry.shape;
+        if (out.count > 0) {
+            out.durationMs = (uint64_t)out.count * out.holdMs + (uint64_t)(out.count - 1) * out.rampMs +
+                             (entry.firstSpeed > 0.0f ? PLAN_INITIAL_RAMP_MS : 0);
+        }
+    }
+    job->active[channel] = true;
+    return nullptr;
+}
+
+PlanParser::Field PlanParser::classify(const char* key) {
+    struct Name {
+        const char* name;
+        Field field;
+    };
+    static const Name NAMES[] = {
+        {"test_id", Field::TestId}, {"format", Field::Format}, {"overflow", Field::Overflow},
+        {"summary_only", Field::SummaryOnly}, {"priority", Field::Priority},
+        {"keep_spinning", Field::KeepSpinning}, {"channels", Field::Channels}, {"channel", Field::Channel},
+        {"speeds", Field::Speeds}, {"ramp_delay", Field::RampDelay}, {"ramp_ms", Field::RampMs},
+        {"ramp_shape", Field::RampShape}, {"segments", Field::Segments}, {"speed", Field::Speed},
+        {"hold_ms", Field::HoldMs}, {"shape", Field::Shape},
+    };
+    for (size_t i = 0; i < sizeof(NAMES) / sizeof(NAMES[0]); i++) {
+        if (strcmp(key, NAMES[i].name) == 0) {
+            return NAMES[i].field;
+        }
+    }
+    return Field::Unknown;
+}
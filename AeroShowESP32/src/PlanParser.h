@@ -0,0 +1,157 @@
+#ifndef PLAN_PARSER_H
+#define PLAN_PARSER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "TestJobQueue.h"
+#include "TestPlan.h"
+
+// Streaming parser for /motor/control bodies. The body is fed in whatever
+// pieces the server reads it in and each speed or segment goes straight
+// into the job's step table, so a request never has to fit in RAM: memory
+// is this object and the TestJob, whatever the plan's length. Accepts
+// exactly what the request format documents and reports the same errors.
+// Pure code, so parsing is checked and timed on the host.
+
+// Deepest nesting accepted, as ArduinoJson's default
+const size_t PLAN_PARSE_MAX_DEPTH = 10;
+
+// Longest string kept; test_id is the longest that matters
+const size_t PLAN_PARSE_TOKEN_CHARS = 64;
+
+// Steps written to the spill at a time
+const size_t PLAN_SPILL_STEPS = 32;
+
+class PlanParser {
+public:
+    PlanParser();
+
+    // Parse a new body into job. rigChannels bounds "channel"; steps past
+    // PLAN_RAM_STEPS go to spill under planId, or make the plan too large
+    // if spill is nullptr.
+    void begin(TestJob& job, size_t rigChannels, PlanSpill* spill, uint32_t planId);
+
+    // The next piece of the body; false once the body is known to be bad
+    bool feed(const char* data, size_t length);
+
+    // End of the body. Returns nullptr with the job ready to queue, or an
+    // error message; a refused plan's spill is removed.
+    const char* finish();
+
+    // The body was cut short: drop the job and its spill
+    void abort();
+
+    // Between begin() and finish() or abort()
+    bool isActive() const { return active; }
+
+    // The last plan failed for its size rather than its content (HTTP 413)
+    bool isTooLarge() const { return tooLarge; }
+
+    uint32_t getBytes() const { return bytes; }
+
+private:
+    enum class Lex : uint8_t {
+        Value, FirstValue, Key, FirstKey, Colon, AfterValue, String, Escape, Unicode, Scalar, End
+    };
+    enum class Frame : uint8_t { Skip, Root, Channels, Entry, Speeds, Segments, Segment };
+    enum class Kind : uint8_t { String, Number, True, False, Null, Container };
+    enum class Field : uint8_t {
+        Unknown, TestId, Format, Overflow, SummaryOnly, Priority, KeepSpinning, Channels, Channel,
+        Speeds, RampDelay, RampMs, RampShape, Segments, Speed, HoldMs, Shape
+    };
+
+    // A profile as the request gives it: the top level or one "channels" entry
+    struct Entry {
+        int32_t channel = -1;
+        bool hasSpeeds = false;
+        bool hasSegments = false;
+        bool hasRampDelay = false;
+        bool badSpeeds = false;     // A bad speed, ramp_delay, ramp_ms or ramp_shape
+        bool badSegments = false;   // A bad segment
+        uint32_t holdMs = 0;
+        uint32_t rampMs = 0;
+        ::RampShape shape = ::RampShape::Linear;
+        uint32_t speedsFirst = 0;
+        uint32_t speedsCount = 0;
+        float firstSpeed = 0.0f;    // As quantized
+        uint32_t segmentsFirst = 0;
+        uint32_t segmentsCount = 0;
+        uint64_t segmentsMs = 0;
+    };
+
+    // Segment object being read
+    struct Pending {
+        float speed = -1.0f;
+        uint32_t rampMs = 0;
+        uint32_t holdMs = 0;
+        ::RampShape shape = ::RampShape::Linear;
+        bool bad = false;
+    };
+
+    void consume(char c);
+    void open(bool array);
+    void close(bool array);
+    void endScalar();
+    void value(Kind kind);
+    void entryValue(Entry& entry, Kind kind);
+    void rootValue(Kind kind);
+    void segmentValue(Kind kind);
+    void closeSegment();
+    void appendStep(uint32_t& count, const PlanStep& step);
+    bool flushSpill();
+    void startToken(bool key);
+    void putChar(char c);
+    bool integer(Kind kind, int64_t min, int64_t max, int64_t& result) const;
+    const char* validate();
+    const char* buildChannel(const Entry& entry, int32_t channel);
+    void fail(const char* message, bool large = false);
+    void discard();
+
+    Frame frame() const { return depth == 0 ? Frame::Skip : frames[depth - 1]; }
+    static Field classify(const char* key);
+
+    TestJob* job;
+    PlanSpill* spill;
+    size_t rigChannels;
+    bool active;
+    bool tooLarge;
+    const char* error;
+    uint32_t bytes;
+
+    // Lexer
+    Lex lex;
+    bool keyString;
+    char token[PLAN_PARSE_TOKEN_CHARS];
+    size_t tokenLength;
+    bool tokenOverflow;
+    uint32_t unicode;
+    uint8_t unicodeDigits;
+    double number;  // The last Number value
+
+    // Where the parser is: a frame and the key it is under per level
+    uint8_t depth;
+    uint16_t arrayLevels;  // Bit n set if level n + 1 is an array
+    Frame frames[PLAN_PARSE_MAX_DEPTH];
+    Field keys[PLAN_PARSE_MAX_DEPTH];
+
+    // What the body has said so far
+    Entry entries[RIG_MAX_CHANNELS + 1];  // Top level, then "channels" entries
+    size_t channelEntries;
+    Entry* current;  // The profile being read
+    bool channelsSeen;
+    bool badChannel;  // A "channels" element that is not an object, or too many
+    Pending pending;
+    bool hasTestId;
+    bool testIdTooLong;
+    bool badFormat;
+    bool badOverflow;
+    bool badSummaryOnly;
+    bool badPriority;
+    bool badKeepSpinning;
+
+    PlanStep spillBuffer[PLAN_SPILL_STEPS];
+    size_t spillUsed;
+    bool spillCreated;
+};
+
+#endif // PLAN_PARSER_H
@@ -0,0 +1,101 @@
+#include "PlanStore.h"
+
+PlanStore::PlanStore(fs::FS& fs, const char* directory)
+    : fs(fs), directory(directory), ready(false), readerPlan(0), spilledPlans(0), stepsWritten(0) {
+}
+
+bool PlanStore::begin() {
+    if (!fs.exists(directory) && !fs.mkdir(directory)) {
+        return false;
+    }
+
+    // No job survives a restart, so neither does its plan
+    char path[48];
+    for (bool removed = true; removed;) {
+        removed = false;
+        File dir = fs.open(directory);
+        if (!dir || !dir.isDirectory()) {
+            return false;
+        }
+        for (File entry = dir.openNextFile(); entry; entry = dir.openNextFile()) {
+            const char* name = strrchr(entry.name(), '/');
+            name = name ? name + 1 : entry.name();
+            snprintf(path, sizeof(path), "%s/%s", directory, name);
+            entry.close();
+            removed = fs.remove(path);
+            if (removed) {
+                break;
+            }
+        }
+    }
+
+    ready = true;
+    return true;
+}
+
+bool PlanStore::create(uint32_t planId) {
+    if (!ready) {
+        return false;
+    }
+    char path[48];
+    planPath(planId, path, sizeof(path));
+    writer = fs.open(path, "w");
+    if (!writer) {
+        return false;
+    }
+    spilledPlans++;
+    return true;
+}
+
+bool PlanStore::append(const PlanStep* steps, size_t count) {
+    size_t bytes = count * sizeof(PlanStep);
+    if (!writer || writer.write((const uint8_t*)steps, bytes) != bytes) {
+        return false;
+    }
+    stepsWritten += count;
+    return true;
+}
+
+bool PlanStore::close() {
+    if (!writer) {
+        return false;
+    }
+    writer.close();
+    return true;
+}
+
+size_t PlanStore::read(uint32_t planId, uint32_t index, PlanStep* steps, size_t count) {
+    if (!ready) {
+        return 0;
+    }
+    if (!reader || readerPlan != planId) {
+        char path[48];
+        planPath(planId, path, sizeof(path));
+        reader.close();
+        reader = fs.open(path, "r");
+        readerPlan = planId;
+        if (!reader) {
+            return 0;
+        }
+    }
+    if (!reader.seek(index * sizeof(PlanStep))) {
+        return 0;
+    }
+    return reader.read((uint8_t*)steps, count * sizeof(PlanStep)) / sizeof(PlanStep);
+}
+
+void PlanStore::remove(uint32_t planId) {
+    if (!ready) {
+        return;
+    }
+    if (reader && readerPlan == planId) {
+        reader.close();
+    }
+    char path[48];
+    planPath(planId, path, sizeof(path));
+    fs.remove(path);
+}
+
+void PlanStore::planPath(uint32_t planId, char* path, size_t size) const {
+    snprintf(path, size, "%s/%lu.bin", directory, (unsigned long)planId);
+}
@@ -0,0 +1,42 @@
+#ifndef PLAN_STORE_H
+#define PLAN_STORE_H
+
+#include <Arduino.h>
+#include <FS.h>
+#include "TestPlan.h"
+
+// Steps of plans too long for a job's RAM table, one file per plan on a
+// flash filesystem. Written while a /motor/control body streams in and read
+// back a few steps at a time as the motion engines need them. Both happen
+// on loop(), so there is no locking.
+class PlanStore : public PlanSpill {
+public:
+    PlanStore(fs::FS& fs, const char* directory = "/plans");
+
+    // Create the directory and remove plans left from before a restart
+    bool begin();
+
+    bool create(uint32_t planId) override;
+    bool append(const PlanStep* steps, size_t count) override;
+    bool close() override;
+    size_t read(uint32_t planId, uint32_t index, PlanStep* steps, size_t count) override;
+    void remove(uint32_t planId) override;
+
+    uint32_t getSpilledPlans() const { return spilledPlans; }
+    uint32_t getStepsWritten() const { return stepsWritten; }
+
+private:
+    void planPath(uint32_t planId, char* path, size_t size) const;
+
+    fs::FS& fs;
+    const char* directory;
+    bool ready;
+    File writer;
+    File reader;          // Kept open between reads of the same plan
+    uint32_t readerPlan;
+
+    uint32_t spilledPlans;
+    uint32_t stepsWritten;
+};
+
+#endif // PLAN_STORE_H
@@ -0,0 +1,44 @@
+#include "SamplePacer.h"
+
+SamplePacer::SamplePacer() : timer(nullptr), task(nullptr), wakeups(0) {
+}
+
+bool SamplePacer::begin() {
+    task = xTaskGetCurrentTaskHandle();
+    esp_timer_create_args_t args = {};
+    args.callback = timerEntry;
+    args.arg = this;
+    args.dispatch_method = ESP_TIMER_TASK;
+    args.name = "sampling";
+    return esp_timer_create(&args, &timer) == ESP_OK;
+}
+
+void SamplePacer::armAt(uint64_t dueMicros) {
+    if (timer == nullptr) {
+        return;
+    }
+    esp_timer_stop(timer);  // Fails harmlessly when nothing is armed
+    int64_t wait = (int64_t)(dueMicros - (uint64_t)esp_timer_get_time());
+    if (wait <= 0) {
+        xTaskNotifyGive(task);
+        return;
+    }
+    esp_timer_start_once(timer, (uint64_t)wait);
+}
+
+void SamplePacer::cancel() {
+    if (timer != nullptr) {
+        esp_timer_stop(timer);
+    }
+}
+
+bool SamplePacer::wait(uint32_t timeoutMs) {
+    TickType_t ticks = pdMS_TO_TICKS(timeoutMs);
+    return ulTaskNotifyTake(pdTRUE, ticks > 0 ? ticks : 1) > 0;
+}
+
+void SamplePacer::timerEntry(void* arg) {
+    SamplePacer* pacer = static_cast<SamplePacer*>(arg);
+    pacer->wakeups++;
+    xTaskNotifyGive(pacer->task);
+}
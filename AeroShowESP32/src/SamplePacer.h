@@ -0,0 +1,38 @@
+#ifndef SAMPLE_PACER_H
+#define SAMPLE_PACER_H
+
+#include <Arduino.h>
+#include <esp_timer.h>
+
+// Wakes one task at absolute esp_timer times from a one-shot timer, so the
+// sampling task runs at each rig deadline instead of on the 1 ms FreeRTOS
+// tick. Deadlines come from TestRig, which keeps them drift free; the pacer
+// only has to be on time for each.
+class SamplePacer {
+public:
+    SamplePacer();
+
+    // Create the timer; wakeups go to the calling task
+    bool begin();
+
+    // Wake the task at dueMicros (esp_timer_get_time()), replacing any
+    // wakeup already armed. A time already past wakes it at once.
+    void armAt(uint64_t dueMicros);
+
+    void cancel();
+
+    // Block until the armed wakeup or timeoutMs, whichever comes first.
+    // True if the timer woke the task.
+    bool wait(uint32_t timeoutMs);
+
+    uint32_t getWakeups() const { return wakeups; }
+
+private:
+    static void timerEntry(void* arg);
+
+    esp_timer_handle_t timer;
+    TaskHandle_t task;
+    volatile uint32_t wakeups;
+};
+
+#endif // SAMPLE_PACER_H
@@ -0,0 +1,142 @@
+#ifndef SAMPLE_RING_H
+#define SAMPLE_RING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#define SAMPLE_RING_WAIT() vTaskDelay(1)
+#else
+#include <thread>
+#define SAMPLE_RING_WAIT() std::this_thread::yield()
+#endif
+
+// What push() does when the ring is full
+enum class OverflowPolicy : uint8_t {
+    DropNewest,       // Reject the new item
+    OverwriteOldest,  // Discard the oldest queued item to make room
+    Block             // Wait for the consumer to free a slot
+};
+
+// Parse the names used in test requests; false if unknown
+inline bool parseOverflowPolicy(const char* name, OverflowPolicy& policy) {
+    if (strcmp(name, "drop_newest") == 0) {
+        policy = OverflowPolicy::DropNewest;
+    } else if (strcmp(name, "overwrite_oldest") == 0) {
+        policy = OverflowPolicy::OverwriteOldest;
+    } else if (strcmp(name, "block") == 0) {
+        policy = OverflowPolicy::Block;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Lock-free single-producer/single-consumer ring buffer with static storage.
+// Exactly one task may call push() and exactly one other task may call pop().
+// Head and tail are free-running counters, so Capacity must be a power of two.
+//
+// With OverwriteOldest the producer may advance the tail itself. pop() copies
+// the slot first and then claims it with a compare-and-swap on the tail, so a
+// copy that raced with an overwrite is discarded and retried.
+template <typename T, size_t Capacity>
+class SampleRing {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0,
+                  "SampleRing capacity must be a power of two");
+
+public:
+    // Producer side: returns false only if the item was not stored (DropNewest)
+    bool push(const T& item) {
+        size_t h = head.load(std::memory_order_relaxed);
+        size_t t = tail.load(std::memory_order_acquire);
+
+        while (h - t >= Capacity) {
+            OverflowPolicy current = policy.load(std::memory_order_relaxed);
+            if (current == OverflowPolicy::DropNewest) {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            if (current == OverflowPolicy::OverwriteOldest) {
+                // If the consumer got there first the CAS fails and there is room anyway
+                if (tail.compare_exchange_strong(t, t + 1, std::memory_order_acq_rel)) {
+                    overwritten.fetch_add(1, std::memory_order_relaxed);
+                }
+                t = tail.load(std::memory_order_acquire);
+                continue;
+            }
+            blocked.fetch_add(1, std::memory_order_relaxed);
+            SAMPLE_RING_WAIT();
+            t = tail.load(std::memory_order_acquire);
+        }
+
+        buffer[h & (Capacity - 1)] = item;
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side: returns false when there is nothing to read
+    bool pop(T& item) {
+        size_t t = tail.load(std::memory_order_acquire);
+        for (;;) {
+            if (t == head.load(std::memory_order_acquire)) {
+                return false;
+            }
+            item = buffer[t & (Capacity - 1)];
+            if (tail.compare_exchange_strong(t, t + 1, std::memory_order_acq_rel)) {
+                return true;
+            }
+            // The producer overwrote this slot; t now holds the new tail
+        }
+    }
+
+    // Consumer side: discard everything queued
+    void clear() {
+        T discarded;
+        while (pop(discarded)) {
+        }
+    }
+
+    // Number of items currently queued (a snapshot, safe from either side)
+    size_t size() const {
+        size_t t = tail.load(std::memory_order_acquire);
+        size_t queued = head.load(std::memory_order_acquire) - t;
+        return queued < Capacity ? queued : Capacity;
+    }
+
+    bool empty() const {
+        return size() == 0;
+    }
+
+    static constexpr size_t capacity() {
+        return Capacity;
+    }
+
+    // Best changed while the producer is idle
+    void setPolicy(OverflowPolicy newPolicy) { policy.store(newPolicy, std::memory_order_relaxed); }
+    OverflowPolicy getPolicy() const { return policy.load(std::memory_order_relaxed); }
+
+    // Overflow counters since the last resetCounters()
+    uint32_t getDropped() const { return dropped.load(std::memory_order_relaxed); }
+    uint32_t getOverwritten() const { return overwritten.load(std::memory_order_relaxed); }
+    uint32_t getBlocked() const { return blocked.load(std::memory_order_relaxed); }
+
+    void resetCounters() {
+        dropped.store(0, std::memory_order_relaxed);
+        overwritten.store(0, std::memory_order_relaxed);
+        blocked.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    T buffer[Capacity];
+    std::atomic<size_t> head{0};  // Next slot to write (producer owned)
+    std::atomic<size_t> tail{0};  // Next slot to read (advanced by the consumer, or by the producer on overwrite)
+    std::atomic<OverflowPolicy> policy{OverflowPolicy::DropNewest};
+    std::atomic<uint32_t> dropped{0};      // Items rejected by DropNewest
+    std::atomic<uint32_t> overwritten{0};  // Items discarded by OverwriteOldest
+    std::atomic<uint32_t> blocked{0};      // Waits taken under Block
+};
+
+#endif // SAMPLE_RING_H
@@ -0,0 +1,31 @@
+#ifndef SENSOR_DATA_H
+#define SENSOR_DATA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Motor channels (ESC, load cell and power monitor each) one controller can drive
+const size_t RIG_MAX_CHANNELS = 4;
+
+// One acquisition sample as buffered and uploaded during a test. The ring
+// and every upload batch hold these by the hundred, so fields are ordered
+// widest first to leave no padding.
+struct SensorData {
+  uint64_t timestamp_us = 0;    // esp_timer_get_time() when the sample was taken
+  uint64_t power_timestamp_us = 0;  // timestamp_us clock when the INA260 conversion voltage and
+                                    // current came from finished, 0 if none yet
+  uint32_t jitter_us = 0;       // How long after its deadline the sample was taken
+  float load_cell = 0.0f;       // Tared load cell counts
+  float voltage = 0.0f;         // Bus voltage in V
+  float current = 0.0f;         // Current in mA
+  float speed = 0.0f;           // Commanded speed (0.0 to 1.0)
+  float rpm = 0.0f;             // Rotor RPM reported by the ESC (bidirectional DShot)
+  uint32_t rpm_timestamp = 0;   // millis() of the ESC reply rpm came from, 0 if none yet
+                                // (millis() and timestamp_us / 1000 are the same clock)
+  uint16_t missed = 0;          // Deadlines of this channel skipped just before this one
+  uint8_t channel = 0;          // Motor channel the sample belongs to
+};
+
+static_assert(sizeof(SensorData) <= 48, "SensorData is held in the sample ring and every upload batch");
+
+#endif // SENSOR_DATA_H
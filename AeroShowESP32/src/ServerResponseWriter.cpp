@@ -0,0 +1,25 @@
+#include "ServerResponseWriter.h"
+#include <stdarg.h>
+
+ServerResponseWriter::ServerResponseWriter(HttpRequest& request) : request(request) {
+}
+
+void ServerResponseWriter::begin(int code, const char* contentType) {
+    request.begin(code, contentType);
+}
+
+size_t ServerResponseWriter::write(uint8_t value) {
+    return request.write((const char*)&value, 1);
+}
+
+size_t ServerResponseWriter::write(const uint8_t* buffer, size_t size) {
+    return request.write((const char*)buffer, size);
+}
+
+size_t ServerResponseWriter::format(const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    size_t n = request.vformat(format, args);
+    va_end(args);
+    return n;
+}
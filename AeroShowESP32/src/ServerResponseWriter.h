@@ -0,0 +1,28 @@
+#ifndef SERVER_RESPONSE_WRITER_H
+#define SERVER_RESPONSE_WRITER_H
+
+#include <Arduino.h>
+#include "HttpServer.h"
+
+// Print adapter over an HttpServer response, so the metrics writers and
+// anything else built on Print can write a page part straight into the
+// connection's output buffer.
+class ServerResponseWriter : public Print {
+public:
+    explicit ServerResponseWriter(HttpRequest& request);
+
+    // Start a streamed response; only in the first part
+    void begin(int code, const char* contentType);
+
+    size_t write(uint8_t value) override;
+    size_t write(const uint8_t* buffer, size_t size) override;
+
+    // printf() into the output buffer; Print::printf() falls back to the
+    // heap for anything over 64 characters
+    size_t format(const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+private:
+    HttpRequest& request;
+};
+
+#endif // SERVER_RESPONSE_WRITER_H
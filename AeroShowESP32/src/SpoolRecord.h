@@ -0,0 +1,57 @@
+#ifndef SPOOL_RECORD_H
+#define SPOOL_RECORD_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "Crc32.h"
+
+// On-flash framing for spooled upload batches. Each record is a fixed
+// header followed by the payload; the CRC covers the payload so a record
+// torn by power loss is detected and skipped. Little endian throughout.
+//
+//   magic   u16  SPOOL_RECORD_MAGIC
+//   flags   u8   SPOOL_FLAG_*
+//   pad     u8   0
+//   length  u32  payload bytes
+//   crc     u32  CRC-32 of the payload
+
+const uint16_t SPOOL_RECORD_MAGIC = 0x5053;  // "SP"
+const size_t SPOOL_RECORD_HEADER_BYTES = 12;
+const uint32_t SPOOL_MAX_RECORD_BYTES = 64 * 1024;
+
+// Payload flags
+const uint8_t SPOOL_FLAG_TELEMETRY_FRAME = 0x01;  // Payload is a TelemetryFrame
+
+struct SpoolRecordHeader {
+    uint8_t flags = 0;
+    uint32_t length = 0;
+    uint32_t crc = 0;
+};
+
+inline void spoolEncodeHeader(const SpoolRecordHeader& header, uint8_t* out) {
+    out[0] = (uint8_t)SPOOL_RECORD_MAGIC;
+    out[1] = (uint8_t)(SPOOL_RECORD_MAGIC >> 8);
+    out[2] = header.flags;
+    out[3] = 0;
+    for (int i = 0; i < 4; i++) {
+        out[4 + i] = (uint8_t)(header.length >> (8 * i));
+        out[8 + i] = (uint8_t)(header.crc >> (8 * i));
+    }
+}
+
+// Returns false if the bytes cannot be the start of a record
+inline bool spoolDecodeHeader(const uint8_t* in, SpoolRecordHeader& header) {
+    if (in[0] != (uint8_t)SPOOL_RECORD_MAGIC || in[1] != (uint8_t)(SPOOL_RECORD_MAGIC >> 8) || in[3] != 0) {
+        return false;
+    }
+    header.flags = in[2];
+    header.length = 0;
+    header.crc = 0;
+    for (int i = 0; i < 4; i++) {
+        header.length |= (uint32_t)in[4 + i] << (8 * i);
+        header.crc |= (uint32_t)in[8 + i] << (8 * i);
+    }
+    return header.length > 0 && header.length <= SPOOL_MAX_RECORD_BYTES;
+}
+
+#endif // SPOOL_RECORD_H
@@ -0,0 +1,316 @@
+#include "SpoolStore.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef ARDUINO
+#include <Arduino.h>
+#endif
+
+static const uint32_t SPOOL_INDEX_MAGIC = 0x58495053;  // "SPIX"
+static const size_t SPOOL_COPY_CHUNK = 256;
+
+// Sink that only measures length and CRC of what is written to it
+class CrcCounter : public ByteSink {
+public:
+    uint32_t crc = 0;
+    uint32_t length = 0;
+
+    bool put(const uint8_t* data, size_t size) override {
+        crc = crc32Update(crc, data, size);
+        length += size;
+        return true;
+    }
+};
+
+// Sink appending to one file
+class AppendSink : public ByteSink {
+public:
+    AppendSink(FlashFiles& files, const char* path) : files(files), path(path) {}
+
+    bool put(const uint8_t* data, size_t size) override {
+        return files.append(path, data, size) == size;
+    }
+
+private:
+    FlashFiles& files;
+    const char* path;
+};
+
+static void putU32(uint8_t* out, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        out[i] = (uint8_t)(value >> (8 * i));
+    }
+}
+
+static uint32_t getU32(const uint8_t* in) {
+    return (uint32_t)in[0] | ((uint32_t)in[1] << 8) | ((uint32_t)in[2] << 16) | ((uint32_t)in[3] << 24);
+}
+
+SpoolStore::SpoolStore(FlashFiles& files, const char* directory)
+    : files(files), directory(directory), ready(false), readSegment(1), readOffset(0),
+      writeSegment(1), writeOffset(0), appendedRecords(0), consumedRecords(0), discardedSegments(0) {
+}
+
+bool SpoolStore::begin() {
+    if (!files.makeDirectory(directory)) {
+        return false;
+    }
+
+    // Find the oldest and newest segment on flash
+    uint32_t firstSegment = 0;
+    uint32_t lastSegment = 0;
+    bool listed = files.list(directory, [&firstSegment, &lastSegment](const char* name) {
+        char* end;
+        uint32_t segment = strtoul(name, &end, 10);
+        if (segment == 0 || strcmp(end, ".seg") != 0) {
+            return;
+        }
+        if (firstSegment == 0 || segment < firstSegment) {
+            firstSegment = segment;
+        }
+        if (segment > lastSegment) {
+            lastSegment = segment;
+        }
+    });
+    if (!listed) {
+        return false;
+    }
+
+    if (lastSegment == 0) {
+        readSegment = writeSegment = 1;
+        readOffset = writeOffset = 0;
+    } else {
+        writeSegment = lastSegment;
+        writeOffset = scanValidLength(lastSegment);
+
+        char path[48];
+        uint32_t fileSize;
+        segmentPath(lastSegment, path, sizeof(path));
+        if (files.size(path, fileSize) && fileSize > writeOffset) {
+            // Torn tail from a power loss: leave it for the reader to skip
+#ifdef ARDUINO
+            Serial.printf("Spool: segment %u has %u torn bytes\n", (unsigned)lastSegment,
+                          (unsigned)(fileSize - writeOffset));
+#endif
+            writeSegment++;
+            writeOffset = 0;
+        }
+
+        if (!loadIndex() || readSegment < firstSegment || readSegment > writeSegment) {
+            readSegment = firstSegment;
+            readOffset = 0;
+        }
+    }
+
+    ready = true;
+#ifdef ARDUINO
+    Serial.printf("Spool: read %u:%u, write %u:%u\n", (unsigned)readSegment, (unsigned)readOffset,
+                  (unsigned)writeSegment, (unsigned)writeOffset);
+#endif
+    return true;
+}
+
+bool SpoolStore::append(uint8_t flags, const PayloadWriter& writePayload) {
+    if (!ready) {
+        return false;
+    }
+
+    CrcCounter counter;
+    writePayload(counter);
+    if (counter.length == 0 || counter.length > SPOOL_MAX_RECORD_BYTES) {
+        return false;
+    }
+
+    uint32_t recordBytes = SPOOL_RECORD_HEADER_BYTES + counter.length;
+    if (writeOffset > 0 && writeOffset + recordBytes > SPOOL_SEGMENT_BYTES) {
+        writeSegment++;
+        writeOffset = 0;
+        enforceRetention();
+    }
+
+    SpoolRecordHeader header;
+    header.flags = flags;
+    header.length = counter.length;
+    header.crc = counter.crc;
+    uint8_t headerBytes[SPOOL_RECORD_HEADER_BYTES];
+    spoolEncodeHeader(header, headerBytes);
+
+    char path[48];
+    segmentPath(writeSegment, path, sizeof(path));
+    AppendSink sink(files, path);
+    sink.put(headerBytes, sizeof(headerBytes));
+    writePayload(sink);
+    files.commit();
+
+    // Check what actually reached flash; on a short write start a new segment
+    uint32_t size;
+    if (!files.size(path, size) || size != writeOffset + recordBytes) {
+        writeSegment++;
+        writeOffset = 0;
+        return false;
+    }
+
+    writeOffset += recordBytes;
+    appendedRecords++;
+    return true;
+}
+
+bool SpoolStore::peek(SpoolRecordInfo& info) {
+    if (!ready) {
+        return false;
+    }
+
+    while (hasPending()) {
+        char path[48];
+        uint32_t fileSize;
+        segmentPath(readSegment, path, sizeof(path));
+
+        if (files.size(path, fileSize) && validateRecord(path, fileSize, readOffset, info.header)) {
+            info.segment = readSegment;
+            info.offset = readOffset;
+            return true;
+        }
+
+        if (readSegment >= writeSegment) {
+            return false;
+        }
+        // End of segment or a torn record: everything after it in this segment is lost
+        advanceToSegment(readSegment + 1);
+    }
+    return false;
+}
+
+size_t SpoolStore::readPayload(const SpoolRecordInfo& info, uint8_t* buffer, size_t size) {
+    char path[48];
+    segmentPath(info.segment, path, sizeof(path));
+    return files.read(path, info.offset + SPOOL_RECORD_HEADER_BYTES, buffer,
+                      size < info.header.length ? size : info.header.length);
+}
+
+bool SpoolStore::copyPayload(const SpoolRecordInfo& info, ByteSink& out) {
+    char path[48];
+    segmentPath(info.segment, path, sizeof(path));
+
+    uint8_t chunk[SPOOL_COPY_CHUNK];
+    uint32_t offset = info.offset + SPOOL_RECORD_HEADER_BYTES;
+    uint32_t remaining = info.header.length;
+    while (remaining > 0) {
+        size_t n = files.read(path, offset, chunk, remaining < sizeof(chunk) ? remaining : sizeof(chunk));
+        if (n == 0 || !out.put(chunk, n)) {
+            return false;
+        }
+        offset += n;
+        remaining -= n;
+    }
+    return true;
+}
+
+void SpoolStore::consume(const SpoolRecordInfo& info) {
+    readSegment = info.segment;
+    readOffset = info.offset + SPOOL_RECORD_HEADER_BYTES + info.header.length;
+    consumedRecords++;
+    saveIndex();
+}
+
+bool SpoolStore::hasPending() {
+    return readSegment < writeSegment || readOffset < writeOffset;
+}
+
+void SpoolStore::segmentPath(uint32_t segment, char* path, size_t size) const {
+    snprintf(path, size, "%s/%08u.seg", directory, (unsigned)segment);
+}
+
+bool SpoolStore::validateRecord(const char* path, uint32_t fileSize, uint32_t offset, SpoolRecordHeader& header) {
+    uint8_t headerBytes[SPOOL_RECORD_HEADER_BYTES];
+    if (offset + SPOOL_RECORD_HEADER_BYTES > fileSize ||
+        files.read(path, offset, headerBytes, sizeof(headerBytes)) != sizeof(headerBytes) ||
+        !spoolDecodeHeader(headerBytes, header) ||
+        offset + SPOOL_RECORD_HEADER_BYTES + header.length > fileSize) {
+        return false;
+    }
+
+    uint8_t chunk[SPOOL_COPY_CHUNK];
+    uint32_t crc = 0;
+    offset += SPOOL_RECORD_HEADER_BYTES;
+    uint32_t remaining = header.length;
+    while (remaining > 0) {
+        size_t n = files.read(path, offset, chunk, remaining < sizeof(chunk) ? remaining : sizeof(chunk));
+        if (n == 0) {
+            return false;
+        }
+        crc = crc32Update(crc, chunk, n);
+        offset += n;
+        remaining -= n;
+    }
+    return crc == header.crc;
+}
+
+uint32_t SpoolStore::scanValidLength(uint32_t segment) {
+    char path[48];
+    uint32_t fileSize;
+    segmentPath(segment, path, sizeof(path));
+    if (!files.size(path, fileSize)) {
+        return 0;
+    }
+
+    uint32_t offset = 0;
+    SpoolRecordHeader header;
+    while (validateRecord(path, fileSize, offset, header)) {
+        offset += SPOOL_RECORD_HEADER_BYTES + header.length;
+    }
+    return offset;
+}
+
+void SpoolStore::advanceToSegment(uint32_t segment) {
+    char path[48];
+    segmentPath(readSegment, path, sizeof(path));
+    files.remove(path);
+    readSegment = segment;
+    readOffset = 0;
+    saveIndex();
+}
+
+bool SpoolStore::loadIndex() {
+    char path[48];
+    snprintf(path, sizeof(path), "%s/index", directory);
+    uint8_t bytes[16];
+    if (files.read(path, 0, bytes, sizeof(bytes)) != sizeof(bytes)) {
+        return false;
+    }
+    if (getU32(bytes) != SPOOL_INDEX_MAGIC || getU32(bytes + 12) != crc32(bytes, 12)) {
+        return false;
+    }
+    readSegment = getU32(bytes + 4);
+    readOffset = getU32(bytes + 8);
+    return true;
+}
+
+bool SpoolStore::saveIndex() {
+    uint8_t bytes[16];
+    putU32(bytes, SPOOL_INDEX_MAGIC);
+    putU32(bytes + 4, readSegment);
+    putU32(bytes + 8, readOffset);
+    putU32(bytes + 12, crc32(bytes, 12));
+
+    // Write the new cursor beside the old one, then swap it in
+    char tempPath[48];
+    char path[48];
+    snprintf(tempPath, sizeof(tempPath), "%s/index.tmp", directory);
+    snprintf(path, sizeof(path), "%s/index", directory);
+
+    files.remove(tempPath);
+    if (files.append(tempPath, bytes, sizeof(bytes)) != sizeof(bytes) || !files.commit()) {
+        return false;
+    }
+    return files.rename(tempPath, path);
+}
+
+void SpoolStore::enforceRetention() {
+    while (writeSegment - readSegment + 1 > SPOOL_MAX_SEGMENTS) {
+#ifdef ARDUINO
+        Serial.printf("Spool: full, discarding segment %u\n", (unsigned)readSegment);
+#endif
+        discardedSegments++;
+        advanceToSegment(readSegment + 1);
+    }
+}
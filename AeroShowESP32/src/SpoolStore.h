@@ -0,0 +1,84 @@
+#ifndef SPOOL_STORE_H
+#define SPOOL_STORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <functional>
+#include "FlashFiles.h"
+#include "GzipEncoder.h"
+#include "SpoolRecord.h"
+
+// Segment size and retention: the oldest segment is discarded when full
+const uint32_t SPOOL_SEGMENT_BYTES = 32 * 1024;
+const uint32_t SPOOL_MAX_SEGMENTS = 32;
+
+// Location of one record inside the spool
+struct SpoolRecordInfo {
+    uint32_t segment = 0;
+    uint32_t offset = 0;
+    SpoolRecordHeader header;
+};
+
+// Append-only store-and-forward spool on a flash filesystem.
+//
+// Records are appended to numbered segment files. The read cursor lives in
+// a small index file that is rewritten through a temporary file and a
+// rename, so it is never half written. After a power loss, begin()
+// re-validates the newest segment. Appends then continue in a fresh
+// segment past any torn tail, and the reader skips the torn record. Flash
+// is reached through FlashFiles, so the same code runs on the host against
+// a file-backed stand-in that can lose power.
+class SpoolStore {
+public:
+    // Streams a payload; called twice per append (to size/CRC it, then to write it)
+    typedef std::function<void(ByteSink&)> PayloadWriter;
+
+    SpoolStore(FlashFiles& files, const char* directory = "/spool");
+
+    // Recover cursors from flash
+    bool begin();
+
+    // Append one record; returns false if the filesystem write failed
+    bool append(uint8_t flags, const PayloadWriter& writePayload);
+
+    // Locate the oldest valid record without consuming it
+    bool peek(SpoolRecordInfo& info);
+
+    // Read the first bytes of a record's payload
+    size_t readPayload(const SpoolRecordInfo& info, uint8_t* buffer, size_t size);
+
+    // Stream a record's payload to out in small pieces
+    bool copyPayload(const SpoolRecordInfo& info, ByteSink& out);
+
+    // Mark a record as delivered and persist the read cursor
+    void consume(const SpoolRecordInfo& info);
+
+    bool hasPending();
+
+    uint32_t getAppendedRecords() const { return appendedRecords; }
+    uint32_t getConsumedRecords() const { return consumedRecords; }
+    uint32_t getDiscardedSegments() const { return discardedSegments; }
+
+private:
+    void segmentPath(uint32_t segment, char* path, size_t size) const;
+    bool validateRecord(const char* path, uint32_t fileSize, uint32_t offset, SpoolRecordHeader& header);
+    uint32_t scanValidLength(uint32_t segment);
+    void advanceToSegment(uint32_t segment);
+    bool loadIndex();
+    bool saveIndex();
+    void enforceRetention();
+
+    FlashFiles& files;
+    const char* directory;
+    bool ready;
+    uint32_t readSegment;
+    uint32_t readOffset;
+    uint32_t writeSegment;
+    uint32_t writeOffset;
+
+    uint32_t appendedRecords;
+    uint32_t consumedRecords;
+    uint32_t discardedSegments;
+};
+
+#endif // SPOOL_STORE_H
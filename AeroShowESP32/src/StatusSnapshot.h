@@ -0,0 +1,86 @@
+#ifndef STATUS_SNAPSHOT_H
+#define STATUS_SNAPSHOT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include "SensorData.h"
+
+// One rig channel as the sampling task last saw it
+struct ChannelStatus {
+    float speed = 0.0f;
+    float rpm = 0.0f;           // From ESC telemetry, 0 without it
+    float voltage = 0.0f;       // V
+    float current = 0.0f;       // mA
+    float power = 0.0f;         // mW
+    float loadCell = 0.0f;      // Raw counts, tare not applied
+    float tare = 0.0f;
+    float grams = 0.0f;         // Filtered, tared and calibrated
+    bool loadCellReady = false;
+    uint32_t samples = 0;       // Samples taken this test
+    uint32_t missed = 0;        // Sample deadlines skipped this test
+    uint32_t maxLatenessUs = 0; // Latest a sample was taken after its deadline this test
+};
+
+// Sensor-side state the sampling task publishes for status pages, so
+// request handlers never touch the sensors themselves
+struct StatusSnapshot {
+    uint32_t timestampMs = 0;
+    bool testRunning = false;
+    size_t channelCount = 0;
+    ChannelStatus channels[RIG_MAX_CHANNELS];
+    uint32_t samplesTaken = 0;  // Samples pushed this test, all channels
+    uint32_t samplesQueued = 0;
+    uint32_t samplesDropped = 0;
+    uint32_t samplesOverwritten = 0;
+};
+
+// Single-writer, many-reader cell for a small struct (a sequence lock).
+// publish() never waits. read() copies the value and retries if a
+// publish overlapped the copy, so readers always see one whole snapshot.
+// Readers spin while a publish is in progress, so they must not be able to
+// preempt the writer on its own core.
+template <typename T>
+class SnapshotCell {
+public:
+    // Writer side
+    void publish(const T& snapshot) {
+        uint32_t seq = sequence.load(std::memory_order_relaxed);
+        sequence.store(seq + 1, std::memory_order_relaxed);  // Odd: write in progress
+        std::atomic_thread_fence(std::memory_order_release);
+        value = snapshot;
+        sequence.store(seq + 2, std::memory_order_release);
+    }
+
+    // Reader side: false until the first publish()
+    bool read(T& snapshot) const {
+        for (;;) {
+            uint32_t before = sequence.load(std::memory_order_acquire);
+            if (before == 0) {
+                return false;
+            }
+            if (before & 1) {
+                continue;
+            }
+            snapshot = value;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (sequence.load(std::memory_order_relaxed) == before) {
+                return true;
+            }
+            retries.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    // Snapshots published since boot
+    uint32_t getPublished() const { return sequence.load(std::memory_order_relaxed) / 2; }
+
+    // Reads that had to start over because a publish overlapped them
+    uint32_t getRetries() const { return retries.load(std::memory_order_relaxed); }
+
+private:
+    T value;
+    std::atomic<uint32_t> sequence{0};
+    mutable std::atomic<uint32_t> retries{0};
+};
+
+#endif // STATUS_SNAPSHOT_H
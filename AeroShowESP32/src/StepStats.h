@@ -0,0 +1,281 @@
+#ifndef STEP_STATS_H
+#define STEP_STATS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <math.h>
+#include "LoadCellCalibration.h"
+#include "SensorData.h"
+
+// One-pass statistics for the samples of a test step. Everything here is
+// constant memory and free of Arduino calls, so results can be checked on
+// the host against a reference computed from the raw samples.
+
+// Welford's running mean and variance, plus min/max
+class RunningStats {
+public:
+    void reset() {
+        n = 0;
+        meanValue = 0.0f;
+        m2 = 0.0f;
+        minValue = 0.0f;
+        maxValue = 0.0f;
+    }
+
+    void add(float x) {
+        n++;
+        float delta = x - meanValue;
+        meanValue += delta / n;
+        m2 += delta * (x - meanValue);
+        if (n == 1 || x < minValue) {
+            minValue = x;
+        }
+        if (n == 1 || x > maxValue) {
+            maxValue = x;
+        }
+    }
+
+    uint32_t count() const { return n; }
+    float mean() const { return meanValue; }
+    float min() const { return minValue; }
+    float max() const { return maxValue; }
+
+    // Sample variance (n - 1 denominator)
+    float variance() const { return n > 1 ? m2 / (n - 1) : 0.0f; }
+    float stddev() const { return sqrtf(variance()); }
+
+private:
+    uint32_t n = 0;
+    float meanValue = 0.0f;
+    float m2 = 0.0f;
+    float minValue = 0.0f;
+    float maxValue = 0.0f;
+};
+
+// P-square streaming quantile estimator (Jain & Chlamtac): five markers
+// track the minimum, p/2, p, (1+p)/2 and the maximum, and are nudged
+// towards their ideal positions with a piecewise-parabolic fit.
+class P2Quantile {
+public:
+    explicit P2Quantile(float p = 0.5f) : p(p) {
+        reset();
+    }
+
+    void reset() {
+        n = 0;
+    }
+
+    void add(float x) {
+        if (n < 5) {
+            // Keep the first five observations sorted; they seed the markers
+            int i = (int)n;
+            while (i > 0 && heights[i - 1] > x) {
+                heights[i] = heights[i - 1];
+                i--;
+            }
+            heights[i] = x;
+            n++;
+            if (n == 5) {
+                for (int m = 0; m < 5; m++) {
+                    positions[m] = m;
+                }
+                desired[0] = 0.0f;
+                desired[1] = 2.0f * p;
+                desired[2] = 4.0f * p;
+                desired[3] = 2.0f + 2.0f * p;
+                desired[4] = 4.0f;
+                increments[0] = 0.0f;
+                increments[1] = p / 2.0f;
+                increments[2] = p;
+                increments[3] = (1.0f + p) / 2.0f;
+                increments[4] = 1.0f;
+            }
+            return;
+        }
+
+        // Find the cell x falls into, extending the extremes if needed
+        int k;
+        if (x < heights[0]) {
+            heights[0] = x;
+            k = 0;
+        } else if (x >= heights[4]) {
+            heights[4] = x;
+            k = 3;
+        } else {
+            k = 0;
+            while (x >= heights[k + 1]) {
+                k++;
+            }
+        }
+
+        for (int m = k + 1; m < 5; m++) {
+            positions[m]++;
+        }
+        for (int m = 0; m < 5; m++) {
+            desired[m] += increments[m];
+        }
+
+        for (int m = 1; m < 4; m++) {
+            float d = desired[m] - positions[m];
+            if ((d >= 1.0f && positions[m + 1] - positions[m] > 1) ||
+                (d <= -1.0f && positions[m - 1] - positions[m] < -1)) {
+                int s = d >= 0.0f ? 1 : -1;
+                float candidate = parabolic(m, s);
+                if (heights[m - 1] < candidate && candidate < heights[m + 1]) {
+                    heights[m] = candidate;
+                } else {
+                    heights[m] = linear(m, s);
+                }
+                positions[m] += s;
+            }
+        }
+        n++;
+    }
+
+    uint32_t count() const { return n; }
+
+    // Current estimate; exact while five or fewer values have been seen
+    float value() const {
+        if (n == 0) {
+            return 0.0f;
+        }
+        if (n <= 5) {
+            return heights[(size_t)lroundf(p * (n - 1))];
+        }
+        return heights[2];
+    }
+
+private:
+    float parabolic(int m, int s) const {
+        float below = positions[m] - positions[m - 1];
+        float above = positions[m + 1] - positions[m];
+        return heights[m] + (float)s / (positions[m + 1] - positions[m - 1]) *
+                                ((below + s) * (heights[m + 1] - heights[m]) / above +
+                                 (above - s) * (heights[m] - heights[m - 1]) / below);
+    }
+
+    float linear(int m, int s) const {
+        return heights[m] + s * (heights[m + s] - heights[m]) / (positions[m + s] - positions[m]);
+    }
+
+    float p;
+    uint32_t n;
+    float heights[5];
+    int32_t positions[5];
+    float desired[5];
+    float increments[5];
+};
+
+// Reduced view of one channel over a step
+struct ChannelSummary {
+    float mean = 0.0f;
+    float stddev = 0.0f;
+    float min = 0.0f;
+    float max = 0.0f;
+    float p50 = 0.0f;
+    float p95 = 0.0f;
+};
+
+class ChannelStats {
+public:
+    ChannelStats() : median(0.5f), upper(0.95f) {}
+
+    void reset() {
+        stats.reset();
+        median.reset();
+        upper.reset();
+    }
+
+    void add(float x) {
+        stats.add(x);
+        median.add(x);
+        upper.add(x);
+    }
+
+    ChannelSummary summarize() const {
+        ChannelSummary summary;
+        summary.mean = stats.mean();
+        summary.stddev = stats.stddev();
+        summary.min = stats.min();
+        summary.max = stats.max();
+        summary.p50 = median.value();
+        summary.p95 = upper.value();
+        return summary;
+    }
+
+private:
+    RunningStats stats;
+    P2Quantile median;
+    P2Quantile upper;
+};
+
+// Everything the ingest side needs about one speed step
+struct StepSummary {
+    uint16_t step = 0;
+    uint8_t channel = 0;         // Motor channel the step ran on
+    float speed = 0.0f;          // Commanded speed (0.0 to 1.0)
+    uint32_t startMs = 0;        // millis() when the step began
+    uint32_t durationMs = 0;
+    uint32_t samples = 0;
+    ChannelSummary thrust;       // g
+    ChannelSummary voltage;      // V
+    ChannelSummary current;      // mA
+    ChannelSummary power;        // W
+    float gramsPerWatt = 0.0f;   // Mean thrust over mean power
+};
+
+// Aggregates the samples of the current step; begin() starts a step and
+// finish() closes it and returns its summary.
+class StepAggregator {
+public:
+    // Thrust is the tared load cell reading through the channel's calibration
+    void begin(uint16_t step, float speed, uint32_t startMs,
+               const LoadCellCalibration& loadCellCalibration = LoadCellCalibration(), uint8_t channel = 0) {
+        summary = StepSummary();
+        summary.step = step;
+        summary.channel = channel;
+        summary.speed = speed;
+        summary.startMs = startMs;
+        calibration = loadCellCalibration;
+        thrust.reset();
+        voltage.reset();
+        current.reset();
+        power.reset();
+        running = true;
+    }
+
+    void add(const SensorData& sample) {
+        if (!running) {
+            return;
+        }
+        thrust.add(calibration.toGrams(sample.load_cell));
+        voltage.add(sample.voltage);
+        current.add(sample.current);
+        power.add(sample.voltage * sample.current / 1000.0f);
+        summary.samples++;
+    }
+
+    bool active() const { return running; }
+
+    StepSummary finish(uint32_t endMs) {
+        running = false;
+        summary.durationMs = endMs - summary.startMs;
+        summary.thrust = thrust.summarize();
+        summary.voltage = voltage.summarize();
+        summary.current = current.summarize();
+        summary.power = power.summarize();
+        summary.gramsPerWatt = summary.power.mean > 0.0f ? summary.thrust.mean / summary.power.mean : 0.0f;
+        return summary;
+    }
+
+private:
+    StepSummary summary;
+    ChannelStats thrust;
+    ChannelStats voltage;
+    ChannelStats current;
+    ChannelStats power;
+    LoadCellCalibration calibration;
+    bool running = false;
+};
+
+#endif // STEP_STATS_H
@@ -0,0 +1,373 @@
+#include "TelemetryFrame.h"
+#include <math.h>
+#include <string.h>
+
+size_t telemetryWriteVarint(uint8_t* out, uint32_t value) {
+    size_t n = 0;
+    while (value >= 0x80) {
+        out[n++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    out[n++] = (uint8_t)value;
+    return n;
+}
+
+uint32_t telemetryZigZag(int32_t value) {
+    return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+int32_t telemetryUnZigZag(uint32_t value) {
+    return (int32_t)((value >> 1) ^ (~(value & 1) + 1));
+}
+
+int32_t telemetryToFixed(float value, float scale) {
+    float scaled = value * scale;
+    if (isnan(scaled)) {
+        return 0;
+    }
+    if (scaled >= 2147483520.0f) {
+        return INT32_MAX;
+    }
+    if (scaled <= -2147483648.0f) {
+        return INT32_MIN;
+    }
+    return (int32_t)lroundf(scaled);
+}
+
+// Wrapping difference, so any pair of int32 values round-trips exactly
+static uint32_t encodeDelta(int32_t value, int32_t& last) {
+    int32_t delta = (int32_t)((uint32_t)value - (uint32_t)last);
+    last = value;
+    return telemetryZigZag(delta);
+}
+
+static int32_t applyDelta(uint32_t encoded, int32_t& last) {
+    last = (int32_t)((uint32_t)last + (uint32_t)telemetryUnZigZag(encoded));
+    return last;
+}
+
+static size_t writeU32(uint8_t* out, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        out[i] = (uint8_t)(value >> (8 * i));
+    }
+    return 4;
+}
+
+static size_t writeU64(uint8_t* out, uint64_t value) {
+    writeU32(out, (uint32_t)value);
+    writeU32(out + 4, (uint32_t)(value >> 32));
+    return 8;
+}
+
+static size_t writeFloat(uint8_t* out, float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return writeU32(out, bits);
+}
+
+static size_t writeChannel(uint8_t* out, const ChannelSummary& channel) {
+    size_t n = 0;
+    n += writeFloat(out + n, channel.mean);
+    n += writeFloat(out + n, channel.stddev);
+    n += writeFloat(out + n, channel.min);
+    n += writeFloat(out + n, channel.max);
+    n += writeFloat(out + n, channel.p50);
+    n += writeFloat(out + n, channel.p95);
+    return n;
+}
+
+size_t TelemetryEncoder::encodeHeader(uint8_t* out, const char* testId, uint64_t baseTimestampUs,
+                                      uint32_t sampleCount, uint8_t flags,
+                                      uint32_t droppedSamples, uint32_t overwrittenSamples,
+                                      uint32_t summaryCount) {
+    size_t n = 0;
+    memcpy(out, TELEMETRY_MAGIC, sizeof(TELEMETRY_MAGIC));
+    n += sizeof(TELEMETRY_MAGIC);
+    out[n++] = TELEMETRY_VERSION;
+    out[n++] = flags;
+
+    size_t idLength = testId ? strlen(testId) : 0;
+    if (idLength > TELEMETRY_MAX_TEST_ID) {
+        idLength = TELEMETRY_MAX_TEST_ID;
+    }
+    out[n++] = (uint8_t)idLength;
+    memcpy(out + n, testId, idLength);
+    n += idLength;
+
+    n += writeU64(out + n, baseTimestampUs);
+    n += telemetryWriteVarint(out + n, sampleCount);
+    n += telemetryWriteVarint(out + n, droppedSamples);
+    n += telemetryWriteVarint(out + n, overwrittenSamples);
+    n += telemetryWriteVarint(out + n, summaryCount);
+
+    for (size_t i = 0; i < TELEMETRY_MAX_CHANNELS; i++) {
+        last[i] = TelemetryChannelState();
+        last[i].deadline = baseTimestampUs;
+    }
+    return n;
+}
+
+size_t TelemetryEncoder::encodeSample(uint8_t* out, const SensorData& sample) {
+    size_t n = 0;
+    // Channels past the frame's limit are folded into the last one
+    size_t channel = sample.channel < TELEMETRY_MAX_CHANNELS ? sample.channel : TELEMETRY_MAX_CHANNELS - 1;
+    TelemetryChannelState& state = last[channel];
+    n += telemetryWriteVarint(out + n, (uint32_t)channel);
+
+    // Deadlines of a paced channel are evenly spaced, so the change in spacing is usually zero
+    uint32_t jitter = sample.jitter_us < TELEMETRY_MAX_JITTER_US ? sample.jitter_us : TELEMETRY_MAX_JITTER_US;
+    uint64_t deadline = sample.timestamp_us - jitter;
+    int32_t interval = (int32_t)(int64_t)(deadline - state.deadline);
+    n += telemetryWriteVarint(out + n, telemetryZigZag((int32_t)((uint32_t)interval - (uint32_t)state.interval)));
+    state.deadline = deadline;
+    state.interval = interval;
+
+    n += telemetryWriteVarint(out + n, encodeDelta(telemetryToFixed(sample.load_cell, TELEMETRY_LOAD_CELL_SCALE), state.loadCell));
+    n += telemetryWriteVarint(out + n, encodeDelta(telemetryToFixed(sample.voltage, TELEMETRY_VOLTAGE_SCALE), state.voltage));
+    n += telemetryWriteVarint(out + n, encodeDelta(telemetryToFixed(sample.current, TELEMETRY_CURRENT_SCALE), state.current));
+    n += telemetryWriteVarint(out + n, encodeDelta(telemetryToFixed(sample.speed, TELEMETRY_SPEED_SCALE), state.speed));
+    n += telemetryWriteVarint(out + n, encodeDelta(telemetryToFixed(sample.rpm, TELEMETRY_RPM_SCALE), state.rpm));
+    uint32_t timestampMs = (uint32_t)(sample.timestamp_us / 1000);
+    uint32_t rpmTimestamp = sample.rpm_timestamp;
+    n += telemetryWriteVarint(out + n, rpmTimestamp == 0 ? 0 : timestampMs - rpmTimestamp + 1);
+    n += telemetryWriteVarint(out + n, (jitter << 1) | (sample.missed > 0 ? 1 : 0));
+    if (sample.missed > 0) {
+        n += telemetryWriteVarint(out + n, sample.missed);
+    }
+
+    // Conversions finish a steady period apart, and most samples repeat the last one
+    uint32_t power = 0;
+    if (sample.power_timestamp_us != state.power) {
+        uint64_t previous = state.power != 0 ? state.power : deadline;
+        int32_t powerInterval = (int32_t)(int64_t)(sample.power_timestamp_us - previous);
+        power = telemetryZigZag((int32_t)((uint32_t)powerInterval - (uint32_t)state.powerInterval)) + 1;
+        state.power = sample.power_timestamp_us;
+        state.powerInterval = powerInterval;
+    }
+    n += telemetryWriteVarint(out + n, power);
+    return n;
+}
+
+size_t TelemetryEncoder::encodeSummary(uint8_t* out, const StepSummary& summary) {
+    size_t n = 0;
+    n += telemetryWriteVarint(out + n, summary.step);
+    n += telemetryWriteVarint(out + n, summary.channel);
+    n += writeU32(out + n, summary.startMs);
+    n += telemetryWriteVarint(out + n, summary.durationMs);
+    n += telemetryWriteVarint(out + n, summary.samples);
+    n += writeFloat(out + n, summary.speed);
+    n += writeFloat(out + n, summary.gramsPerWatt);
+    n += writeChannel(out + n, summary.thrust);
+    n += writeChannel(out + n, summary.voltage);
+    n += writeChannel(out + n, summary.current);
+    n += writeChannel(out + n, summary.power);
+    return n;
+}
+
+TelemetryDecoder::TelemetryDecoder(const uint8_t* data, size_t length)
+    : data(data), length(length), position(0), version(0), lastTimestamp(0) {
+}
+
+bool TelemetryDecoder::readByte(uint8_t& value) {
+    if (position >= length) {
+        return false;
+    }
+    value = data[position++];
+    return true;
+}
+
+bool TelemetryDecoder::readVarint(uint32_t& value) {
+    value = 0;
+    for (size_t i = 0; i < TELEMETRY_MAX_VARINT_BYTES; i++) {
+        uint8_t byte;
+        if (!readByte(byte)) {
+            return false;
+        }
+        value |= (uint32_t)(byte & 0x7F) << (7 * i);
+        if ((byte & 0x80) == 0) {
+            // The fifth byte may only carry the top 4 bits
+            return i < 4 || byte <= 0x0F;
+        }
+    }
+    return false;
+}
+
+bool TelemetryDecoder::readU32(uint32_t& value) {
+    value = 0;
+    for (int i = 0; i < 4; i++) {
+        uint8_t byte;
+        if (!readByte(byte)) {
+            return false;
+        }
+        value |= (uint32_t)byte << (8 * i);
+    }
+    return true;
+}
+
+bool TelemetryDecoder::readU64(uint64_t& value) {
+    uint32_t low;
+    uint32_t high;
+    if (!readU32(low) || !readU32(high)) {
+        return false;
+    }
+    value = ((uint64_t)high << 32) | low;
+    return true;
+}
+
+bool TelemetryDecoder::readFloat(float& value) {
+    uint32_t bits;
+    if (!readU32(bits)) {
+        return false;
+    }
+    memcpy(&value, &bits, sizeof(value));
+    return true;
+}
+
+bool TelemetryDecoder::readChannel(ChannelSummary& channel) {
+    return readFloat(channel.mean) && readFloat(channel.stddev) && readFloat(channel.min) &&
+           readFloat(channel.max) && readFloat(channel.p50) && readFloat(channel.p95);
+}
+
+bool TelemetryDecoder::readHeader(TelemetryHeader& header) {
+    uint8_t magic[4];
+    for (int i = 0; i < 4; i++) {
+        if (!readByte(magic[i]) || magic[i] != TELEMETRY_MAGIC[i]) {
+            return false;
+        }
+    }
+    if (!readByte(header.version) || header.version < TELEMETRY_MIN_VERSION || header.version > TELEMETRY_VERSION) {
+        return false;
+    }
+    if (!readByte(header.flags)) {
+        return false;
+    }
+
+    uint8_t idLength;
+    if (!readByte(idLength) || length - position < idLength) {
+        return false;
+    }
+    memcpy(header.testId, data + position, idLength);
+    header.testId[idLength] = '\0';
+    position += idLength;
+
+    uint32_t baseMs = 0;
+    if (header.version >= 6 ? !readU64(header.baseTimestampUs) : !readU32(baseMs)) {
+        return false;
+    }
+    if (header.version < 6) {
+        header.baseTimestampUs = (uint64_t)baseMs * 1000;
+    }
+    if (!readVarint(header.sampleCount)) {
+        return false;
+    }
+    header.droppedSamples = 0;
+    header.overwrittenSamples = 0;
+    header.summaryCount = 0;
+    if (header.version >= 2 &&
+        (!readVarint(header.droppedSamples) || !readVarint(header.overwrittenSamples))) {
+        return false;
+    }
+    if (header.version >= 3 && !readVarint(header.summaryCount)) {
+        return false;
+    }
+
+    version = header.version;
+    lastTimestamp = baseMs;
+    for (size_t i = 0; i < TELEMETRY_MAX_CHANNELS; i++) {
+        last[i] = TelemetryChannelState();
+        last[i].deadline = header.baseTimestampUs;
+    }
+    return true;
+}
+
+bool TelemetryDecoder::readSample(SensorData& sample) {
+    uint32_t channel = 0;
+    if (version >= 5 && (!readVarint(channel) || channel >= TELEMETRY_MAX_CHANNELS)) {
+        return false;
+    }
+    TelemetryChannelState& state = last[channel];
+
+    uint32_t fields[9] = {0};
+    int fieldCount = version >= 6 ? 8 : version >= 4 ? 7 : 5;
+    for (int i = 0; i < fieldCount; i++) {
+        if (!readVarint(fields[i])) {
+            return false;
+        }
+    }
+    if ((fields[7] & 1) && (!readVarint(fields[8]) || fields[8] == 0 || fields[8] > UINT16_MAX)) {
+        return false;
+    }
+    fields[7] >>= 1;
+    uint32_t power = 0;
+    if (version >= 7 && !readVarint(power)) {
+        return false;
+    }
+
+    uint32_t timestampMs;
+    if (version >= 6) {
+        state.interval = (int32_t)((uint32_t)state.interval + (uint32_t)telemetryUnZigZag(fields[0]));
+        state.deadline += (uint64_t)(int64_t)state.interval;
+        sample.timestamp_us = state.deadline + fields[7];
+        timestampMs = (uint32_t)(sample.timestamp_us / 1000);
+    } else {
+        lastTimestamp += fields[0];
+        timestampMs = lastTimestamp;
+        sample.timestamp_us = (uint64_t)lastTimestamp * 1000;
+    }
+    sample.jitter_us = fields[7];
+    sample.missed = (uint16_t)fields[8];
+    sample.channel = (uint8_t)channel;
+    sample.load_cell = applyDelta(fields[1], state.loadCell) / TELEMETRY_LOAD_CELL_SCALE;
+    sample.voltage = applyDelta(fields[2], state.voltage) / TELEMETRY_VOLTAGE_SCALE;
+    sample.current = applyDelta(fields[3], state.current) / TELEMETRY_CURRENT_SCALE;
+    sample.speed = applyDelta(fields[4], state.speed) / TELEMETRY_SPEED_SCALE;
+    sample.rpm = applyDelta(fields[5], state.rpm) / TELEMETRY_RPM_SCALE;
+    sample.rpm_timestamp = fields[6] == 0 ? 0 : timestampMs - (fields[6] - 1);
+    if (power != 0) {
+        uint64_t previous = state.power != 0 ? state.power : state.deadline;
+        state.powerInterval = (int32_t)((uint32_t)state.powerInterval + (uint32_t)telemetryUnZigZag(power - 1));
+        state.power = previous + (uint64_t)(int64_t)state.powerInterval;
+    }
+    sample.power_timestamp_us = state.power;
+    return true;
+}
+
+bool TelemetryDecoder::readSummary(StepSummary& summary) {
+    uint32_t step;
+    uint32_t channel = 0;
+    if (!readVarint(step) || step > UINT16_MAX ||
+        (version >= 5 && (!readVarint(channel) || channel >= TELEMETRY_MAX_CHANNELS)) || !readU32(summary.startMs) ||
+        !readVarint(summary.durationMs) || !readVarint(summary.samples)) {
+        return false;
+    }
+    summary.step = (uint16_t)step;
+    summary.channel = (uint8_t)channel;
+    return readFloat(summary.speed) && readFloat(summary.gramsPerWatt) && readChannel(summary.thrust) &&
+           readChannel(summary.voltage) && readChannel(summary.current) && readChannel(summary.power);
+}
+
+size_t telemetryEncodeBatch(const char* testId, const SensorData* samples, size_t count,
+                            uint8_t flags, std::vector<uint8_t>& out,
+                            uint32_t droppedSamples, uint32_t overwrittenSamples,
+                            const StepSummary* summaries, size_t summaryCount) {
+    TelemetryEncoder encoder;
+    uint8_t scratch[TELEMETRY_MAX_HEADER_BYTES];
+    uint64_t baseTimestampUs = count > 0 ? samples[0].timestamp_us : 0;
+    static_assert(TELEMETRY_MAX_SUMMARY_BYTES <= TELEMETRY_MAX_HEADER_BYTES, "Scratch must fit a summary");
+
+    out.clear();
+    out.reserve(TELEMETRY_MAX_HEADER_BYTES + count * 8);
+
+    size_t n = encoder.encodeHeader(scratch, testId, baseTimestampUs, (uint32_t)count, flags,
+                                    droppedSamples, overwrittenSamples, (uint32_t)summaryCount);
+    out.insert(out.end(), scratch, scratch + n);
+    for (size_t i = 0; i < count; i++) {
+        n = encoder.encodeSample(scratch, samples[i]);
+        out.insert(out.end(), scratch, scratch + n);
+    }
+    for (size_t i = 0; i < summaryCount; i++) {
+        n = encoder.encodeSummary(scratch, summaries[i]);
+        out.insert(out.end(), scratch, scratch + n);
+    }
+    return out.size();
+}
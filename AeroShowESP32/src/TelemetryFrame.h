@@ -0,0 +1,168 @@
+#ifndef TELEMETRY_FRAME_H
+#define TELEMETRY_FRAME_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "SensorData.h"
+#include "StepStats.h"
+
+// Compact binary upload format for SensorData batches.
+//
+// Frame layout (all multi-byte integers little endian):
+//   magic          4 bytes  "ASTF"
+//   version        u8       TELEMETRY_VERSION
+//   flags          u8       TELEMETRY_FLAG_*
+//   test id        u8 length + bytes (not NUL terminated)
+//   base timestamp u32      ms, timestamp of the first sample (before v6)
+//                  u64      us, timestamp of the first sample (v6+)
+//   sample count   varint
+//   dropped        varint   samples lost to ring overflow so far in the test (v2+)
+//   overwritten    varint   samples overwritten in the ring so far (v2+)
+//   summary count  varint   step summaries after the samples (v3+)
+//   samples        per sample, each field a varint:
+//                    motor channel (v5+)
+//                    timing: before v6 the timestamp delta (ms, unsigned);
+//                    from v6 the sample's deadline (timestamp - jitter, us)
+//                    as a zigzag change in the interval between deadlines
+//                    of its channel, so a steady rate costs one byte
+//                    load_cell, voltage, current, speed as zigzag deltas of
+//                    fixed-point values (see TELEMETRY_*_SCALE)
+//                    rpm as a zigzag delta, then rpm age: 0 without an
+//                    ESC reading, else timestamp - rpm_timestamp + 1 ms (v4+)
+//                    jitter (us) shifted left by one, the low bit set when
+//                    a missed deadline count follows as another varint (v6+)
+//                    power conversion (v7+): 0 when voltage and current
+//                    are from the conversion the channel's previous sample
+//                    carried, or from none yet; else the zigzag change in
+//                    the interval between the channel's conversions (us)
+//                    plus one, the first taken against the sample's deadline
+//   summaries      per step summary (v3+):
+//                    step varint, channel varint (v5+), start ms u32, duration ms varint,
+//                    sample count varint, then f32 speed, grams per watt
+//                    and mean/stddev/min/max/p50/p95 of thrust, voltage,
+//                    current and power
+//
+// Before v6 the timestamp delta is taken against the previous sample. Channel
+// values are deltas against the previous sample of the same motor channel
+// (zero for its first, whose deadline is taken against the base timestamp),
+// so a steady signal costs one byte per value even with several motor
+// channels interleaved. Deadlines of one channel within a frame must be
+// less than 35 minutes apart, and so must its conversions, which once
+// present stay present. This file has no Arduino dependencies and is
+// meant to be shared with the ingest side.
+
+const uint8_t TELEMETRY_MAGIC[4] = {'A', 'S', 'T', 'F'};
+const uint8_t TELEMETRY_VERSION = 7;
+const uint8_t TELEMETRY_MIN_VERSION = 1;  // Oldest version the decoder accepts
+const char TELEMETRY_CONTENT_TYPE[] = "application/x-aeroshow-telemetry";
+
+// Header flags
+const uint8_t TELEMETRY_FLAG_LOAD_CELL_READY = 0x01;
+
+// Fixed-point scales: stored value = round(channel * scale)
+const float TELEMETRY_LOAD_CELL_SCALE = 10.0f;   // 0.1 count
+const float TELEMETRY_VOLTAGE_SCALE = 1000.0f;   // 1 mV
+const float TELEMETRY_CURRENT_SCALE = 10.0f;     // 0.1 mA
+const float TELEMETRY_SPEED_SCALE = 10000.0f;    // 0.01 %
+const float TELEMETRY_RPM_SCALE = 1.0f;          // 1 RPM
+
+// Motor channels a frame can carry
+const size_t TELEMETRY_MAX_CHANNELS = RIG_MAX_CHANNELS;
+
+const size_t TELEMETRY_MAX_TEST_ID = 255;
+const size_t TELEMETRY_MAX_VARINT_BYTES = 5;
+const size_t TELEMETRY_MAX_HEADER_BYTES = 4 + 1 + 1 + 1 + TELEMETRY_MAX_TEST_ID + 8 + 4 * TELEMETRY_MAX_VARINT_BYTES;
+const size_t TELEMETRY_MAX_SAMPLE_BYTES = 11 * TELEMETRY_MAX_VARINT_BYTES;
+const uint32_t TELEMETRY_MAX_JITTER_US = 0x7FFFFFFF;  // Larger jitter is clamped
+const size_t TELEMETRY_MAX_SUMMARY_BYTES = 4 + 4 * TELEMETRY_MAX_VARINT_BYTES + (2 + 4 * 6) * 4;
+
+enum class TelemetryFormat : uint8_t {
+    Json,
+    Binary
+};
+
+struct TelemetryHeader {
+    uint8_t version = 0;
+    uint8_t flags = 0;
+    char testId[TELEMETRY_MAX_TEST_ID + 1] = {0};
+    uint64_t baseTimestampUs = 0;  // Frames before v6 carry ms, scaled here
+    uint32_t sampleCount = 0;
+    uint32_t droppedSamples = 0;
+    uint32_t overwrittenSamples = 0;
+    uint32_t summaryCount = 0;
+};
+
+// Previous fixed-point values of one motor channel, for the deltas
+struct TelemetryChannelState {
+    int32_t loadCell = 0;
+    int32_t voltage = 0;
+    int32_t current = 0;
+    int32_t speed = 0;
+    int32_t rpm = 0;
+    uint64_t deadline = 0;  // us (v6+)
+    int32_t interval = 0;   // us between the last two deadlines (v6+)
+    uint64_t power = 0;          // us, conversion the last sample carried, 0 if none (v7+)
+    int32_t powerInterval = 0;   // us between the last two conversions (v7+)
+};
+
+// Incremental encoder. Call encodeHeader() once, then encodeSample() for
+// exactly sampleCount samples and encodeSummary() for exactly summaryCount
+// summaries; each call writes into a caller buffer that must hold
+// TELEMETRY_MAX_HEADER_BYTES / _SAMPLE_BYTES / _SUMMARY_BYTES.
+class TelemetryEncoder {
+public:
+    // baseTimestampUs is normally the first sample's timestamp_us
+    size_t encodeHeader(uint8_t* out, const char* testId, uint64_t baseTimestampUs,
+                        uint32_t sampleCount, uint8_t flags,
+                        uint32_t droppedSamples = 0, uint32_t overwrittenSamples = 0,
+                        uint32_t summaryCount = 0);
+    size_t encodeSample(uint8_t* out, const SensorData& sample);
+    size_t encodeSummary(uint8_t* out, const StepSummary& summary);
+
+private:
+    TelemetryChannelState last[TELEMETRY_MAX_CHANNELS];
+};
+
+// Decoder over a complete frame in memory. Returns false on truncated or
+// malformed input, or on an unsupported version.
+class TelemetryDecoder {
+public:
+    TelemetryDecoder(const uint8_t* data, size_t length);
+
+    bool readHeader(TelemetryHeader& header);
+    bool readSample(SensorData& sample);
+    bool readSummary(StepSummary& summary);
+
+    // True once every byte of the frame has been consumed
+    bool atEnd() const { return position == length; }
+
+private:
+    bool readByte(uint8_t& value);
+    bool readVarint(uint32_t& value);
+    bool readU32(uint32_t& value);
+    bool readU64(uint64_t& value);
+    bool readFloat(float& value);
+    bool readChannel(ChannelSummary& channel);
+
+    const uint8_t* data;
+    size_t length;
+    size_t position;
+    uint8_t version;
+    uint32_t lastTimestamp;  // ms, before v6
+    TelemetryChannelState last[TELEMETRY_MAX_CHANNELS];
+};
+
+// Encode a whole batch into out (cleared first); returns the frame size
+size_t telemetryEncodeBatch(const char* testId, const SensorData* samples, size_t count,
+                            uint8_t flags, std::vector<uint8_t>& out,
+                            uint32_t droppedSamples = 0, uint32_t overwrittenSamples = 0,
+                            const StepSummary* summaries = nullptr, size_t summaryCount = 0);
+
+// Varint helpers, exposed for the streaming writers
+size_t telemetryWriteVarint(uint8_t* out, uint32_t value);
+uint32_t telemetryZigZag(int32_t value);
+int32_t telemetryUnZigZag(uint32_t value);
+int32_t telemetryToFixed(float value, float scale);
+
+#endif // TELEMETRY_FRAME_H
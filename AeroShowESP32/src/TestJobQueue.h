@@ -0,0 +1,284 @@
+#ifndef TEST_JOB_QUEUE_H
+#define TEST_JOB_QUEUE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "SampleRing.h"
+#include "SensorData.h"
+#include "TelemetryFrame.h"
+#include "TestPlan.h"
+
+// Validated motor test plans waiting to run, and the one running. Requests
+// are queued instead of refused while a test runs, and run back to back,
+// highest priority first and in arrival order within a priority. Fixed
+// storage and no Arduino calls, so the queue semantics are checked on the
+// host.
+
+// A test as /motor/control describes it, ready to start
+struct TestJob {
+    uint32_t id = 0;        // Assigned by the queue, never 0
+    char testId[64] = "";   // Same size as SampleBatch::testId
+    int8_t priority = 0;    // Higher runs first
+    bool keepSpinning = false;  // Hand the motors straight to a compatible next job
+    bool active[RIG_MAX_CHANNELS] = {};  // Channels with a profile
+    TestPlan plan;
+    uint32_t rampDelay = 0;
+    TelemetryFormat format = TelemetryFormat::Json;
+    OverflowPolicy overflow = OverflowPolicy::DropNewest;
+    bool summaryOnly = false;
+
+    // The next job drives exactly the channels this one does, so with
+    // keepSpinning the motors go from this job's last setpoints into its
+    // first segments without stopping
+    bool compatibleWith(const TestJob& next) const {
+        for (size_t i = 0; i < RIG_MAX_CHANNELS; i++) {
+            if (active[i] != next.active[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+enum class JobState : uint8_t {
+    Unknown,    // Never queued, or too long ago to remember
+    Queued,
+    Running,
+    Done,
+    Cancelled
+};
+
+inline const char* jobStateName(JobState state) {
+    switch (state) {
+    case JobState::Queued:
+        return "queued";
+    case JobState::Running:
+        return "running";
+    case JobState::Done:
+        return "done";
+    case JobState::Cancelled:
+        return "cancelled";
+    default:
+        return "unknown";
+    }
+}
+
+enum class JobPushResult : uint8_t {
+    Queued,
+    Full,
+    Duplicate  // A queued or running job already has this test ID
+};
+
+// Capacity jobs can wait while one runs; the last History finished jobs
+// are remembered for status requests
+template <size_t Capacity, size_t History = 8>
+class TestJobQueue {
+    static_assert(Capacity >= 1 && History >= 1, "TestJobQueue needs room for a job and its history");
+
+public:
+    TestJobQueue() : nextId(1), nextSequence(0), runningSlot(NONE), historyCount(0), completed(0), cancelled(0) {
+        for (size_t i = 0; i <= Capacity; i++) {
+            states[i] = JobState::Unknown;
+        }
+    }
+
+    // Copy a job in and give it an ID
+    JobPushResult push(const TestJob& job, uint32_t& id) {
+        if (findSlot(job.testId) != NONE) {
+            return JobPushResult::Duplicate;
+        }
+        if (size() >= Capacity) {
+            return JobPushResult::Full;
+        }
+        size_t slot = 0;
+        while (states[slot] != JobState::Unknown) {
+            slot++;
+        }
+        jobs[slot] = job;
+        jobs[slot].id = id = nextId++;
+        if (nextId == 0) {
+            nextId = 1;
+        }
+        sequence[slot] = nextSequence++;
+        states[slot] = JobState::Queued;
+        return JobPushResult::Queued;
+    }
+
+    // The job that would start next, or nullptr
+    const TestJob* next() const {
+        size_t slot = slotAt(0);
+        return slot == NONE ? nullptr : &jobs[slot];
+    }
+
+    // Make the next job the running one. The pointer stays valid until
+    // finishRunning(). Returns nullptr if a job is running or none is queued.
+    const TestJob* startNext() {
+        if (runningSlot != NONE) {
+            return nullptr;
+        }
+        size_t slot = slotAt(0);
+        if (slot == NONE) {
+            return nullptr;
+        }
+        states[slot] = JobState::Running;
+        runningSlot = slot;
+        return &jobs[slot];
+    }
+
+    const TestJob* running() const { return runningSlot == NONE ? nullptr : &jobs[runningSlot]; }
+
+    // The running job ended (Done) or was stopped (Cancelled); frees its slot
+    void finishRunning(JobState how) {
+        if (runningSlot == NONE) {
+            return;
+        }
+        remember(jobs[runningSlot].id, how);
+        states[runningSlot] = JobState::Unknown;
+        runningSlot = NONE;
+    }
+
+    // Drop a queued job. For the running job this only reports it through
+    // wasRunning; the caller stops the test and then calls finishRunning().
+    bool cancel(uint32_t id, bool& wasRunning) {
+        wasRunning = false;
+        for (size_t slot = 0; slot <= Capacity; slot++) {
+            if (states[slot] == JobState::Unknown || jobs[slot].id != id) {
+                continue;
+            }
+            if (states[slot] == JobState::Running) {
+                wasRunning = true;
+                return true;
+            }
+            remember(id, JobState::Cancelled);
+            states[slot] = JobState::Unknown;
+            return true;
+        }
+        return false;
+    }
+
+    // The queued or running job with this ID, or nullptr
+    const TestJob* find(uint32_t id) const {
+        for (size_t slot = 0; slot <= Capacity; slot++) {
+            if (states[slot] != JobState::Unknown && jobs[slot].id == id) {
+                return &jobs[slot];
+            }
+        }
+        return nullptr;
+    }
+
+    // ID of the queued or running job with this test ID, 0 if none
+    uint32_t findId(const char* testId) const {
+        size_t slot = findSlot(testId);
+        return slot == NONE ? 0 : jobs[slot].id;
+    }
+
+    // Where a job is; position is its place in the queue (0 runs next)
+    JobState stateOf(uint32_t id, size_t* position = nullptr) const {
+        for (size_t i = 0; i < size(); i++) {
+            if (jobs[slotAt(i)].id == id) {
+                if (position != nullptr) {
+                    *position = i;
+                }
+                return JobState::Queued;
+            }
+        }
+        if (runningSlot != NONE && jobs[runningSlot].id == id) {
+            return JobState::Running;
+        }
+        for (size_t i = 0; i < historyCount; i++) {
+            if (historyIds[i] == id) {
+                return historyStates[i];
+            }
+        }
+        return JobState::Unknown;
+    }
+
+    // Queued jobs in the order they will run
+    size_t size() const {
+        size_t count = 0;
+        for (size_t slot = 0; slot <= Capacity; slot++) {
+            count += states[slot] == JobState::Queued ? 1 : 0;
+        }
+        return count;
+    }
+    const TestJob& at(size_t position) const { return jobs[slotAt(position)]; }
+
+    bool full() const { return size() >= Capacity; }
+    size_t capacity() const { return Capacity; }
+    uint32_t getCompleted() const { return completed; }
+    uint32_t getCancelled() const { return cancelled; }
+
+private:
+    static const size_t NONE = (size_t)-1;
+
+    // Slot of the queued job at a position: by priority, then arrival
+    size_t slotAt(size_t position) const {
+        size_t previous = NONE;
+        for (size_t n = 0; n <= position; n++) {
+            size_t best = NONE;
+            for (size_t slot = 0; slot <= Capacity; slot++) {
+                if (states[slot] != JobState::Queued || (previous != NONE && !before(previous, slot))) {
+                    continue;
+                }
+                if (best == NONE || before(slot, best)) {
+                    best = slot;
+                }
+            }
+            if (best == NONE) {
+                return NONE;
+            }
+            previous = best;
+        }
+        return previous;
+    }
+
+    bool before(size_t a, size_t b) const {
+        if (jobs[a].priority != jobs[b].priority) {
+            return jobs[a].priority > jobs[b].priority;
+        }
+        return sequence[a] < sequence[b];
+    }
+
+    size_t findSlot(const char* testId) const {
+        for (size_t slot = 0; slot <= Capacity; slot++) {
+            if (states[slot] != JobState::Unknown && strcmp(jobs[slot].testId, testId) == 0) {
+                return slot;
+            }
+        }
+        return NONE;
+    }
+
+    // Newest first; the oldest entry falls off
+    void remember(uint32_t id, JobState how) {
+        if (how == JobState::Done) {
+            completed++;
+        } else {
+            cancelled++;
+        }
+        size_t count = historyCount < History ? historyCount + 1 : History;
+        for (size_t i = count - 1; i > 0; i--) {
+            historyIds[i] = historyIds[i - 1];
+            historyStates[i] = historyStates[i - 1];
+        }
+        historyIds[0] = id;
+        historyStates[0] = how;
+        historyCount = count;
+    }
+
+    // One slot more than Capacity, for the running job
+    TestJob jobs[Capacity + 1];
+    JobState states[Capacity + 1];  // Unknown marks a free slot
+    uint32_t sequence[Capacity + 1];
+    uint32_t nextId;
+    uint32_t nextSequence;
+    size_t runningSlot;
+
+    uint32_t historyIds[History];
+    JobState historyStates[History];
+    size_t historyCount;
+    uint32_t completed;
+    uint32_t cancelled;
+};
+
+#endif // TEST_JOB_QUEUE_H
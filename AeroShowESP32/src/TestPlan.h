@@ -0,0 +1,182 @@
+#ifndef TEST_PLAN_H
+#define TEST_PLAN_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "MotionProfile.h"
+#include "SensorData.h"
+
+// Motor test plans as a compact step table. Each step is a quantized
+// target and its timing in 8 bytes; a job keeps the first PLAN_RAM_STEPS in
+// RAM and the rest go to a PlanSpill (a flash file on the device), so a plan
+// of tens of thousands of steps costs the same RAM as a short one. Pure
+// code, so plans can be built and played back on the host.
+
+// Steps each job holds in RAM, shared by its channels
+const size_t PLAN_RAM_STEPS = 128;
+
+// Most steps one plan may have, RAM and spill together (512 KB of flash)
+const uint32_t PLAN_MAX_STEPS = 65536;
+
+// Ramp from standstill to the first speed of a stepped plan
+const uint32_t PLAN_INITIAL_RAMP_MS = 3000;
+
+// Throttle code for full speed; 0.0 to 1.0 maps onto 0 to this
+const uint16_t PLAN_THROTTLE_FULL = 65535;
+
+// Longest ramp and hold one step can encode
+const uint32_t PLAN_MAX_RAMP_MS = 0xffff;
+const uint32_t PLAN_MAX_HOLD_MS = 0xffffff;  // About 4.6 hours
+
+// One step of a plan
+struct PlanStep {
+    uint16_t throttle = 0;  // Target, 0 to PLAN_THROTTLE_FULL
+    uint16_t rampMs = 0;
+    uint32_t timing = 0;    // Hold ms in the low 24 bits, shape in bits 24-25, STEPPED
+
+    // Timing comes from the channel's ramp_delay, ramp_ms and ramp_shape,
+    // which may follow the speeds in the request
+    static const uint32_t STEPPED = 1u << 31;
+
+    static PlanStep segment(float target, uint32_t rampMs, uint32_t holdMs, RampShape shape) {
+        PlanStep step;
+        step.throttle = quantize(target);
+        step.rampMs = (uint16_t)rampMs;
+        step.timing = (holdMs & PLAN_MAX_HOLD_MS) | ((uint32_t)shape << 24);
+        return step;
+    }
+
+    static PlanStep stepped(float target) {
+        PlanStep step;
+        step.throttle = quantize(target);
+        step.timing = STEPPED;
+        return step;
+    }
+
+    static uint16_t quantize(float target) {
+        return (uint16_t)(target * PLAN_THROTTLE_FULL + 0.5f);
+    }
+
+    float target() const { return (float)throttle / PLAN_THROTTLE_FULL; }
+    uint32_t holdMs() const { return timing & PLAN_MAX_HOLD_MS; }
+    RampShape shape() const { return (RampShape)((timing >> 24) & 3); }
+    bool isStepped() const { return (timing & STEPPED) != 0; }
+};
+
+static_assert(sizeof(PlanStep) == 8, "PlanStep is stored on flash as 8 bytes");
+
+// Steps past a job's RAM table, stored per plan. Steps are appended in
+// order between create() and close(), then read back by index (0 is the
+// first step that did not fit in RAM).
+class PlanSpill {
+public:
+    virtual ~PlanSpill() {}
+
+    virtual bool create(uint32_t planId) = 0;
+    virtual bool append(const PlanStep* steps, size_t count) = 0;
+    virtual bool close() = 0;
+
+    // Steps read, fewer than count past the end or on an error
+    virtual size_t read(uint32_t planId, uint32_t index, PlanStep* steps, size_t count) = 0;
+
+    virtual void remove(uint32_t planId) = 0;
+};
+
+// One channel's part of a plan: a run of steps in the table, and the
+// timing stepped plans take from the request
+struct PlanChannel {
+    uint32_t first = 0;
+    uint32_t count = 0;
+    uint32_t holdMs = 0;  // ramp_delay
+    uint32_t rampMs = 0;
+    RampShape shape = RampShape::Linear;
+    uint64_t durationMs = 0;
+
+    // The index'th step as the motion engine plays it
+    ProfileSegment resolve(uint32_t index, const PlanStep& step) const {
+        ProfileSegment segment;
+        segment.target = step.target();
+        if (!step.isStepped()) {
+            segment.rampMs = step.rampMs;
+            segment.holdMs = step.holdMs();
+            segment.shape = step.shape();
+        } else if (index == 0) {
+            segment.rampMs = segment.target > 0.0f ? PLAN_INITIAL_RAMP_MS : 0;
+            segment.holdMs = holdMs;
+            segment.shape = RampShape::Linear;
+        } else {
+            segment.rampMs = rampMs;
+            segment.holdMs = holdMs;
+            segment.shape = shape;
+        }
+        return segment;
+    }
+};
+
+// The step table of one job
+struct TestPlan {
+    uint32_t id = 0;         // Names the plan's spill
+    uint32_t stepCount = 0;  // In RAM and spill together
+    PlanChannel channels[RIG_MAX_CHANNELS];
+    PlanStep steps[PLAN_RAM_STEPS];
+
+    bool spilled() const { return stepCount > PLAN_RAM_STEPS; }
+};
+
+// Steps read from a spill at a time
+const size_t PLAN_READ_STEPS = 16;
+
+// Plays one channel of a plan into a MotionEngine, reading spilled steps a
+// few at a time
+class PlanReader : public SegmentSource {
+public:
+    PlanReader() : plan(nullptr), channel(nullptr), spill(nullptr), index(0), bufferFirst(0), bufferCount(0) {}
+
+    // spill may be nullptr if the plan never spilled
+    void begin(const TestPlan& testPlan, size_t channelIndex, PlanSpill* planSpill) {
+        plan = &testPlan;
+        channel = &testPlan.channels[channelIndex];
+        spill = planSpill;
+        index = 0;
+        bufferFirst = 0;
+        bufferCount = 0;
+    }
+
+    bool next(ProfileSegment& segment) override {
+        if (channel == nullptr || index >= channel->count) {
+            return false;
+        }
+        uint32_t at = channel->first + index;
+        if (at < PLAN_RAM_STEPS) {
+            segment = channel->resolve(index++, plan->steps[at]);
+            return true;
+        }
+
+        // Past RAM: refill the buffer from the spill when it runs out
+        at -= PLAN_RAM_STEPS;
+        if (at < bufferFirst || at >= bufferFirst + bufferCount) {
+            uint32_t left = channel->first + channel->count - PLAN_RAM_STEPS - at;
+            bufferFirst = at;
+            size_t want = left < PLAN_READ_STEPS ? left : PLAN_READ_STEPS;
+            bufferCount = spill == nullptr ? 0 : spill->read(plan->id, at, buffer, want);
+            if (bufferCount == 0) {
+                return false;
+            }
+        }
+        segment = channel->resolve(index++, buffer[at - bufferFirst]);
+        return true;
+    }
+
+    uint32_t getPosition() const { return index; }
+
+private:
+    const TestPlan* plan;
+    const PlanChannel* channel;
+    PlanSpill* spill;
+    uint32_t index;  // Next step, counted within the channel
+    PlanStep buffer[PLAN_READ_STEPS];
+    uint32_t bufferFirst;
+    size_t bufferCount;
+};
+
+#endif // TEST_PLAN_H
@@ -0,0 +1,149 @@
+#include "TestRig.h"
+#include <algorithm>
+
+RigChannel::RigChannel(uint8_t index, ESCController& motor, MotionEngine& motion, LoadCellInput& loadCell,
+                       INA260Driver& power)
+    : index(index), motor(motor), motion(motion), loadCell(loadCell), power(power), powerReady(false),
+      loadCellUpdateMs(0), loadCellReady(false), appliedSettings(0) {
+    filter.configure(settings.filter);
+}
+
+void RigChannel::refresh(uint32_t nowMs) {
+    // The INA260 driver only touches the bus when a new conversion is ready
+    if (powerReady) {
+        power.readLatest(lastPower);
+    }
+
+    // Take up settings published since the last refresh; a new filter starts over
+    if (pendingSettings.getPublished() != appliedSettings) {
+        appliedSettings = pendingSettings.getPublished();
+        pendingSettings.read(settings);
+        if (!(settings.filter == filter.getConfig())) {
+            filter.configure(settings.filter);
+        }
+    }
+
+    // Every conversion goes through the filter; the value stays valid while fresh
+    HX711Reading reading;
+    bool converted = false;
+    while (loadCell.read(reading)) {
+        filter.add(reading.value);
+        converted = true;
+    }
+    if (converted) {
+        loadCellUpdateMs = nowMs;
+        loadCellReady = true;
+    } else if (nowMs - loadCellUpdateMs >= RIG_LOAD_CELL_TIMEOUT_MS) {
+        loadCellReady = false;
+    }
+}
+
+SensorData RigChannel::sample(uint64_t nowMicros) const {
+    SensorData reading;
+    reading.timestamp_us = nowMicros;
+    reading.channel = index;
+    reading.voltage = lastPower.voltage;
+    reading.current = lastPower.current;
+    if (power.getReadingCount() > 0) {
+        reading.power_timestamp_us = nowMicros - power.getAgeMicros(lastPower);
+    }
+    reading.load_cell = getLoadCell() - settings.tare;
+
+    // Commanded speed (0.0-1.0), following the motion profile
+    reading.speed = motion.getSetpoint();
+
+    // Rotor speed, when the ESC reports it
+    EscRpmReading rpm;
+    if (motor.readRpm(rpm)) {
+        reading.rpm = rpm.rpm;
+        reading.rpm_timestamp = rpm.timestampMs;
+    }
+    return reading;
+}
+
+TestRig::TestRig(Clock& clock) : clock(clock), count(0), rateHz(RIG_DEFAULT_SAMPLE_HZ) {
+}
+
+bool TestRig::addChannel(RigChannel& channel) {
+    if (count >= RIG_MAX_CHANNELS) {
+        return false;
+    }
+    channels[count++] = &channel;
+    restart();
+    return true;
+}
+
+void TestRig::setSampleRateHz(uint32_t hz) {
+    rateHz = hz > 0 ? hz : RIG_DEFAULT_SAMPLE_HZ;
+    restart();
+}
+
+void TestRig::restart() {
+    uint64_t now = clock.micros64();
+    for (size_t i = 0; i < count; i++) {
+        schedule[i] = Schedule();
+        schedule[i].startMicros = now + (uint64_t)1000000 * i / ((uint64_t)rateHz * count);
+    }
+}
+
+size_t TestRig::poll(SensorData* out, size_t capacity) {
+    size_t taken = 0;
+    bool served[RIG_MAX_CHANNELS] = {false};
+
+    while (taken < capacity) {
+        // Earliest deadline among the channels that are due now
+        uint64_t now = clock.micros64();
+        int next = -1;
+        uint64_t earliest = 0;
+        for (size_t i = 0; i < count; i++) {
+            uint64_t due = deadline(schedule[i], schedule[i].next);
+            if (!served[i] && due <= now && (next < 0 || due < earliest)) {
+                next = (int)i;
+                earliest = due;
+            }
+        }
+        if (next < 0) {
+            break;
+        }
+
+        // The sample belongs to the oldest deadline still within a period of
+        // the last one that passed; older ones are skipped, not made up. A
+        // channel that falls behind stays due for the deadline after, so on
+        // an overloaded bus every channel keeps its turn.
+        Schedule& slot = schedule[next];
+        uint64_t last = (now - slot.startMicros) * rateHz / 1000000;
+        uint64_t index = std::max<uint64_t>(slot.next, last > 0 ? last - 1 : 0);
+        uint64_t skipped = index - slot.next;
+        uint64_t lateness = std::min<uint64_t>(now - earliest, UINT32_MAX);
+        if (lateness > slot.maxLatenessMicros) {
+            slot.maxLatenessMicros = (uint32_t)lateness;
+        }
+        slot.missed += (uint32_t)skipped;
+        slot.next = index + 1;
+        slot.samples++;
+
+        RigChannel& channel = *channels[next];
+        channel.refresh(clock.millis());
+        SensorData& reading = out[taken++];
+        reading = channel.sample(now);
+        reading.jitter_us = (uint32_t)std::min<uint64_t>(now - deadline(slot, index), UINT32_MAX);
+        reading.missed = (uint16_t)std::min<uint64_t>(skipped, UINT16_MAX);
+        served[next] = true;
+    }
+    return taken;
+}
+
+uint64_t TestRig::getNextDueMicros() const {
+    uint64_t earliest = UINT64_MAX;
+    for (size_t i = 0; i < count; i++) {
+        earliest = std::min(earliest, deadline(schedule[i], schedule[i].next));
+    }
+    return earliest;
+}
+
+void TestRig::refreshAll() {
+    uint32_t nowMs = clock.millis();
+    for (size_t i = 0; i < count; i++) {
+        channels[i]->refresh(nowMs);
+    }
+}
@@ -0,0 +1,139 @@
+#ifndef TEST_RIG_H
+#define TEST_RIG_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "ESCController.h"
+#include "Hal.h"
+#include "INA260Driver.h"
+#include "LoadCellCalibration.h"
+#include "LoadCellFilter.h"
+#include "MotionEngine.h"
+#include "SensorData.h"
+#include "StatusSnapshot.h"
+
+// A load cell reading older than this is reported as not ready
+const uint32_t RIG_LOAD_CELL_TIMEOUT_MS = 1000;
+
+// Default per-channel sample rate
+const uint32_t RIG_DEFAULT_SAMPLE_HZ = 1000;
+
+// One motor channel: its ESC and motion engine, load cell and power
+// monitor. Sensor state lives here and is only touched by the sampling
+// task; other tasks change the load cell settings through configure().
+class RigChannel {
+public:
+    RigChannel(uint8_t index, ESCController& motor, MotionEngine& motion, LoadCellInput& loadCell,
+               INA260Driver& power);
+
+    uint8_t getIndex() const { return index; }
+    ESCController& getMotor() { return motor; }
+    MotionEngine& getMotion() { return motion; }
+    const MotionEngine& getMotion() const { return motion; }
+    INA260Driver& getPowerMonitor() { return power; }
+
+    // An INA260 that failed begin() is never read and reports zeros
+    void setPowerReady(bool ready) { powerReady = ready; }
+    bool isPowerReady() const { return powerReady; }
+
+    // Take whatever the sensors have new; never waits
+    void refresh(uint32_t nowMs);
+
+    // Sample from the newest readings with the tare applied, stamped with
+    // nowMicros (Clock::micros64()); call refresh() first
+    SensorData sample(uint64_t nowMicros) const;
+
+    // Filtered load cell counts, tare not applied; 0 while stale
+    float getLoadCell() const { return loadCellReady ? filter.value() : 0.0f; }
+    bool isLoadCellReady() const { return loadCellReady; }
+    const INA260Reading& getPower() const { return lastPower; }
+
+    // Filtered load with the tare and calibration applied
+    float getGrams() const { return settings.calibration.toGrams(getLoadCell() - settings.tare); }
+
+    // New filter, calibration and tare. Callable from any one task: the
+    // settings are published and taken up by the next refresh().
+    void configure(const LoadCellSettings& newSettings) { pendingSettings.publish(newSettings); }
+
+    // Settings in effect; sampling task side
+    const LoadCellSettings& getSettings() const { return settings; }
+
+private:
+    uint8_t index;
+    ESCController& motor;
+    MotionEngine& motion;
+    LoadCellInput& loadCell;
+    INA260Driver& power;
+    bool powerReady;
+    INA260Reading lastPower;
+    LoadCellFilter filter;
+    uint32_t loadCellUpdateMs;
+    bool loadCellReady;
+    LoadCellSettings settings;
+    SnapshotCell<LoadCellSettings> pendingSettings;
+    uint32_t appliedSettings;  // Publishes of pendingSettings taken up so far
+};
+
+// The motor channels of one controller and the acquisition schedule that
+// shares the sensors' buses between them. Every channel has the same
+// sample rate; their deadlines are staggered across the period so reads
+// interleave instead of bunching up, and poll() serves the earliest
+// deadline first so no channel can starve the others.
+class TestRig {
+public:
+    explicit TestRig(Clock& clock);
+
+    // False once RIG_MAX_CHANNELS are registered
+    bool addChannel(RigChannel& channel);
+
+    size_t channelCount() const { return count; }
+    RigChannel& channel(size_t i) { return *channels[i]; }
+    const RigChannel& channel(size_t i) const { return *channels[i]; }
+
+    void setSampleRateHz(uint32_t hz);
+    uint32_t getSampleRateHz() const { return rateHz; }
+
+    // Start a new schedule from now and zero the per-channel counters
+    void restart();
+
+    // Take every sample that is due, earliest deadline first, at most one
+    // per channel and call. Each sample carries how late it was taken and
+    // how many of its channel's deadlines were skipped before it. Returns
+    // the number written to out.
+    size_t poll(SensorData* out, size_t capacity);
+
+    // Earliest pending deadline (Clock::micros64()), for waking the next poll
+    uint64_t getNextDueMicros() const;
+
+    // Refresh every channel's sensors outside a test, for status pages
+    void refreshAll();
+
+    // Schedule accounting since restart()
+    uint32_t getSamples(size_t i) const { return schedule[i].samples; }
+    uint32_t getMissed(size_t i) const { return schedule[i].missed; }  // Deadlines skipped
+    uint32_t getMaxLatenessMicros(size_t i) const { return schedule[i].maxLatenessMicros; }
+
+private:
+    // Deadline n of a channel is startMicros + ceil(n * 1e6 / rateHz): each
+    // one is computed from the start rather than from the previous one, so
+    // rates that do not divide a second never drift
+    struct Schedule {
+        uint64_t startMicros = 0;
+        uint64_t next = 0;  // Index of the next deadline
+        uint32_t samples = 0;
+        uint32_t missed = 0;
+        uint32_t maxLatenessMicros = 0;
+    };
+
+    uint64_t deadline(const Schedule& slot, uint64_t n) const {
+        return slot.startMicros + (n * 1000000 + rateHz - 1) / rateHz;
+    }
+
+    Clock& clock;
+    RigChannel* channels[RIG_MAX_CHANNELS];
+    Schedule schedule[RIG_MAX_CHANNELS];
+    size_t count;
+    uint32_t rateHz;
+};
+
+#endif // TEST_RIG_H
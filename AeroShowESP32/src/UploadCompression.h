@@ -0,0 +1,146 @@
+#ifndef UPLOAD_COMPRESSION_H
+#define UPLOAD_COMPRESSION_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "GzipEncoder.h"
+
+// Automatic gzip level for upload bodies. The upload task compresses and
+// sends in turn, so a batch costs its compression time plus the time to
+// send what comes out. The picker keeps running estimates of each level's
+// ratio and speed and of the uplink's throughput, and takes the level with
+// the smallest expected total: none on a fast link, more effort as the link
+// slows. Pure code, so the choice can be checked on the host.
+
+const uint8_t COMPRESSION_AUTO = 0xff;
+
+// Weight of each new measurement in the running estimates
+const float COMPRESSION_SMOOTHING = 0.25f;
+
+// Every this many batches the level next to the best is tried once, so its
+// estimate follows the data and the link
+const uint8_t COMPRESSION_EXPLORE_EVERY = 32;
+
+// Uplink throughput assumed before the first upload, bytes per ms
+const float COMPRESSION_UPLINK_SEED = 100.0f;
+
+struct CompressionEstimate {
+    float ratio;       // Raw bytes per byte sent
+    float bytesPerMs;  // Raw bytes compressed per ms of CPU, 0 for free
+};
+
+// Starting estimates per level for each upload format, from the native sim's
+// compression benchmark on a simulated test with the host's time per batch
+// scaled to a 240 MHz ESP32
+const CompressionEstimate COMPRESSION_SEED_JSON[GZIP_MAX_LEVEL + 1] = {
+    {1.0f, 0.0f}, {10.4f, 6300.0f}, {17.5f, 5400.0f}, {17.5f, 5400.0f}
+};
+const CompressionEstimate COMPRESSION_SEED_BINARY[GZIP_MAX_LEVEL + 1] = {
+    {1.0f, 0.0f}, {4.8f, 4600.0f}, {4.85f, 3500.0f}, {5.0f, 2700.0f}
+};
+
+class CompressionPicker {
+public:
+    // seeds holds GZIP_MAX_LEVEL + 1 estimates, level 0 first
+    explicit CompressionPicker(const CompressionEstimate* seeds)
+        : fixedLevel(COMPRESSION_AUTO), uplinkBytesPerMs(COMPRESSION_UPLINK_SEED), picks(0), exploreUp(true) {
+        for (uint8_t level = 0; level <= GZIP_MAX_LEVEL; level++) {
+            estimates[level] = seeds[level];
+            measured[level] = false;
+        }
+    }
+
+    // A fixed level, or COMPRESSION_AUTO
+    void setLevel(uint8_t level) {
+        fixedLevel = level == COMPRESSION_AUTO || level <= GZIP_MAX_LEVEL ? level : GZIP_MAX_LEVEL;
+    }
+
+    uint8_t getLevel() const { return fixedLevel; }
+
+    // Level for the next batch
+    uint8_t pick() {
+        if (fixedLevel != COMPRESSION_AUTO) {
+            return fixedLevel;
+        }
+        uint8_t best = getBest();
+        if (++picks % COMPRESSION_EXPLORE_EVERY != 0) {
+            return best;
+        }
+        exploreUp = !exploreUp;
+        if ((exploreUp && best < GZIP_MAX_LEVEL) || best == 0) {
+            return best + 1;
+        }
+        return best - 1;
+    }
+
+    // Level with the lowest expected cost per raw byte; lower levels win ties
+    uint8_t getBest() const {
+        uint8_t best = 0;
+        for (uint8_t level = 1; level <= GZIP_MAX_LEVEL; level++) {
+            if (cost(level) < cost(best)) {
+                best = level;
+            }
+        }
+        return best;
+    }
+
+    // Expected ms per raw byte at a level: compressing it plus sending the result
+    float cost(uint8_t level) const {
+        const CompressionEstimate& estimate = estimates[level];
+        float compressMs = estimate.bytesPerMs > 0.0f ? 1.0f / estimate.bytesPerMs : 0.0f;
+        return compressMs + 1.0f / (estimate.ratio * uplinkBytesPerMs);
+    }
+
+    // Fold in a completed upload: body bytes before and after encoding, CPU
+    // time in the encoder and time spent writing to and waiting on the socket
+    void record(uint8_t level, uint32_t rawBytes, uint32_t sentBytes, uint32_t compressMicros, uint32_t sendMicros) {
+        if (level > GZIP_MAX_LEVEL || rawBytes == 0 || sentBytes == 0) {
+            return;
+        }
+        if (level > 0) {
+            CompressionEstimate& estimate = estimates[level];
+            CompressionEstimate before = estimate;
+            if (!measured[level]) {
+                // The first measurement replaces the seed outright
+                estimate.ratio = (float)rawBytes / sentBytes;
+                if (compressMicros > 0) {
+                    estimate.bytesPerMs = rawBytes * 1000.0f / compressMicros;
+                }
+                measured[level] = true;
+            } else {
+                smooth(estimate.ratio, (float)rawBytes / sentBytes);
+                if (compressMicros > 0) {
+                    smooth(estimate.bytesPerMs, rawBytes * 1000.0f / compressMicros);
+                }
+            }
+
+            // Levels not tried yet keep their seeded proportions to this one
+            for (uint8_t other = 1; other <= GZIP_MAX_LEVEL; other++) {
+                if (!measured[other]) {
+                    estimates[other].ratio *= estimate.ratio / before.ratio;
+                    estimates[other].bytesPerMs *= estimate.bytesPerMs / before.bytesPerMs;
+                }
+            }
+        }
+        if (sendMicros > 0) {
+            smooth(uplinkBytesPerMs, sentBytes * 1000.0f / sendMicros);
+        }
+    }
+
+    const CompressionEstimate& getEstimate(uint8_t level) const { return estimates[level]; }
+    float getUplinkBytesPerMs() const { return uplinkBytesPerMs; }
+
+private:
+    static void smooth(float& value, float sample) {
+        value += (sample - value) * COMPRESSION_SMOOTHING;
+    }
+
+    CompressionEstimate estimates[GZIP_MAX_LEVEL + 1];
+    bool measured[GZIP_MAX_LEVEL + 1];
+    uint8_t fixedLevel;
+    float uplinkBytesPerMs;
+    uint8_t picks;
+    bool exploreUp;
+};
+
+#endif // UPLOAD_COMPRESSION_H
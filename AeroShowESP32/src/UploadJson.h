@@ -0,0 +1,34 @@
+#ifndef UPLOAD_JSON_H
+#define UPLOAD_JSON_H
+
+#include <stddef.h>
+#include <stdio.h>
+#include "SensorData.h"
+
+// Line buffer that fits any one formatted sample
+const size_t UPLOAD_JSON_LINE_SIZE = 384;
+
+// Format one sample of the JSON upload body ("data" array element, with the
+// separating comma unless it is the first). Returns the bytes written to
+// line, truncated to fit. Shared with the host build so compression can be
+// measured on real upload bodies.
+inline size_t formatJsonSample(char* line, size_t size, const SensorData& reading, bool loadCellReady,
+                               bool first) {
+    int n = snprintf(line, size,
+                     "%s{\"channel\":%u,\"timestamp\":%lu,\"timestamp_us\":%llu,\"jitter_us\":%lu,\"missed\":%u,"
+                     "\"ina260\":{\"voltage_v\":%.3f,\"current_ma\":%.2f,\"timestamp_us\":%llu},"
+                     "\"load_cell\":{\"raw_value\":%.1f,\"is_ready\":%s},"
+                     "\"set_speed\":%.4f,\"rpm\":%.0f,\"rpm_timestamp\":%lu}",
+                     first ? "" : ",", (unsigned)reading.channel, (unsigned long)(reading.timestamp_us / 1000),
+                     (unsigned long long)reading.timestamp_us, (unsigned long)reading.jitter_us,
+                     (unsigned)reading.missed,
+                     reading.voltage, reading.current, (unsigned long long)reading.power_timestamp_us,
+                     reading.load_cell, loadCellReady ? "true" : "false",
+                     reading.speed, reading.rpm, (unsigned long)reading.rpm_timestamp);
+    if (n < 0) {
+        return 0;
+    }
+    return (size_t)n < size ? (size_t)n : size - 1;
+}
+
+#endif // UPLOAD_JSON_H
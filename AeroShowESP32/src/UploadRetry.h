@@ -0,0 +1,84 @@
+#ifndef UPLOAD_RETRY_H
+#define UPLOAD_RETRY_H
+
+#include <stdint.h>
+
+// Retry policy for failed POSTs: delay doubles from the initial value up to the cap
+const uint8_t UPLOAD_MAX_ATTEMPTS = 5;
+const uint32_t UPLOAD_RETRY_INITIAL_MS = 250;
+const uint32_t UPLOAD_RETRY_MAX_MS = 4000;
+
+// Store-and-forward: once a batch has exhausted its retries the uplink is
+// treated as down, and further batches go straight to the spool. Every
+// probe interval one batch is tried again. Spooled batches are replayed
+// oldest first, one per replay interval, and only when no live batch is
+// waiting.
+const uint32_t UPLOAD_PROBE_INTERVAL_MS = 5000;
+const uint32_t SPOOL_REPLAY_INTERVAL_MS = 500;
+
+// The upload task's retry and store-and-forward decisions, kept apart from
+// its HTTP and FreeRTOS calls so they can be run on the host in virtual
+// time. Times are millis().
+class UploadRetry {
+public:
+    UploadRetry() : spooling(false), down(false), nextProbeMs(0), lastReplayMs(0) {}
+
+    // Whether failed batches have a spool to go to
+    void setSpooling(bool enabled) { spooling = enabled; }
+
+    // Attempts to give a live batch now. Without a spool every batch gets
+    // them all; with one, a down uplink gets a single probe once the probe
+    // interval has passed and none before, so the batch is spooled at once.
+    uint8_t attempts(uint32_t nowMs) const {
+        if (!spooling || !down) {
+            return UPLOAD_MAX_ATTEMPTS;
+        }
+        return (int32_t)(nowMs - nextProbeMs) < 0 ? 0 : 1;
+    }
+
+    // Wait after failed attempt n (from 1) before the next one
+    static uint32_t backoffMs(uint8_t attempt) {
+        uint32_t delay = UPLOAD_RETRY_INITIAL_MS;
+        for (uint8_t i = 1; i < attempt && delay < UPLOAD_RETRY_MAX_MS; i++) {
+            delay *= 2;
+        }
+        return delay < UPLOAD_RETRY_MAX_MS ? delay : UPLOAD_RETRY_MAX_MS;
+    }
+
+    // Whether to try a batch again after failed attempt n of maxAttempts.
+    // With a spool, not while later batches wait behind it: they would back
+    // up into the sample ring and lose samples, where the spool keeps this
+    // one for replay.
+    bool retryAfter(uint8_t attempt, uint8_t maxAttempts, bool liveWaiting) const {
+        return attempt < maxAttempts && !(spooling && liveWaiting);
+    }
+
+    // A post went through
+    void succeeded() { down = false; }
+
+    // A batch used up its attempts, or a replay failed
+    void failed(uint32_t nowMs) {
+        down = true;
+        nextProbeMs = nowMs + UPLOAD_PROBE_INTERVAL_MS;
+    }
+
+    bool isDown() const { return down; }
+
+    // Whether to replay a spooled batch now: nothing live is waiting and the
+    // replay interval has passed. Starts the next interval when it says yes.
+    bool replayDue(uint32_t nowMs, bool liveWaiting) {
+        if (liveWaiting || nowMs - lastReplayMs < SPOOL_REPLAY_INTERVAL_MS) {
+            return false;
+        }
+        lastReplayMs = nowMs;
+        return true;
+    }
+
+private:
+    bool spooling;
+    volatile bool down;  // Also read by the status and metrics handlers
+    uint32_t nextProbeMs;
+    uint32_t lastReplayMs;
+};
+
+#endif // UPLOAD_RETRY_H
@@ -1,7 +1,8 @@
 #include "WiFiManager.h"
 #include <HTTPClient.h>
 
-WiFiManager::WiFiManager() : server(80) {
+WiFiManager::WiFiManager() : reportURL("") {
+    ipAddress[0] = '\0';
     // Constructor implementation
 }
 
@@ -22,28 +23,26 @@ bool WiFiManager::begin() {
     return false;
 }
 
-void WiFiManager::handleClient() {
-    server.handleClient();
-}
-
 bool WiFiManager::isConnected() {
     return WiFi.status() == WL_CONNECTED;
 }
 
-String WiFiManager::getIPAddress() {
-    return WiFi.localIP().toString();
+const char* WiFiManager::getIPAddress() {
+    IPAddress ip = WiFi.localIP();
+    snprintf(ipAddress, sizeof(ipAddress), "%u.%u.%u.%u", ip[0], ip[1], ip[2], ip[3]);
+    return ipAddress;
 }
 
-void WiFiManager::setReportURL(const String& url) {
-    reportURL = url;
+void WiFiManager::setReportURL(const char* url) {
+    reportURL = url != nullptr ? url : "";
 }
 
-bool WiFiManager::connectToWiFi(const String& ssid, const String& password, int maxRetries) {
+bool WiFiManager::connectToWiFi(const char* ssid, const char* password, int maxRetries) {
     int retryCount = 0;
     
     while (retryCount < maxRetries) {
-        Serial.printf("Connecting to %s...\n", ssid.c_str());
-        WiFi.begin(ssid.c_str(), password.c_str());
+        Serial.printf("Connecting to %s...\n", ssid);
+        WiFi.begin(ssid, password);
 
         int attempts = 0;
         while (attempts < 20) { // 10 seconds timeout (20 * 500ms)
@@ -66,17 +65,17 @@ bool WiFiManager::connectToWiFi(const String& ssid, const String& password, int
 }
 
 void WiFiManager::reportDeviceInfo() {
-    if (reportURL.length() == 0) return;
+    if (strlen(reportURL) == 0) return;
     
     HTTPClient http;
     http.begin(reportURL);
     http.addHeader("Content-Type", "application/json");
     
-    String json = "{\"device_id\":\"" + String(ESP.getEfuseMac(), HEX) + 
-                  "\",\"ip\":\"" + WiFi.localIP().toString() + 
-                  "\",\"ssid\":\"" + WiFi.SSID() + "\"}";
+    char json[160];
+    int length = snprintf(json, sizeof(json), "{\"device_id\":\"%llx\",\"ip\":\"%s\",\"ssid\":\"%s\"}",
+                          (unsigned long long)ESP.getEfuseMac(), getIPAddress(), WiFi.SSID().c_str());
     
-    int httpResponseCode = http.POST(json);
+    int httpResponseCode = http.POST((uint8_t*)json, min((size_t)length, sizeof(json) - 1));
     
     if (httpResponseCode > 0) {
         Serial.printf("Device info sent. Response code: %d\n", httpResponseCode);
@@ -86,19 +85,3 @@ void WiFiManager::reportDeviceInfo() {
     
     http.end();
 }
-
-void WiFiManager::handleRoot() {
-    String html = "<html><body>";
-    html += "<h1>WiFi Configuration</h1>";
-    html += "<form method='post' action='/setwifi'>";
-    html += "SSID: <input type='text' name='ssid'><br>";
-    html += "Password: <input type='password' name='password'><br>";
-    html += "<input type='submit' value='Save'>";
-    html += "</form></body></html>";
-    
-    server.send(200, "text/html", html);
-}
-
-void WiFiManager::handleNotFound() {
-    server.send(404, "text/plain", "Not found");
-}
@@ -2,7 +2,6 @@
 #define WIFI_MANAGER_H
 
 #include <WiFi.h>
-#include <WebServer.h>
 #include <Preferences.h>
 #include <HTTPClient.h>
 
@@ -14,42 +13,31 @@ public:
     // Initialize the WiFi manager
     bool begin();
     
-    // Handle client connections
-    void handleClient();
-    
     // Check if connected to WiFi
     bool isConnected();
     
-    // Get current IP address
-    String getIPAddress();
+    // Get current IP address (dotted quad, valid until the next call)
+    const char* getIPAddress();
     
     // Get MAC address
     String getMacAddress();
     
     // Set the report URL
-    void setReportURL(const String& url);
-    
-    // Get the WebServer instance
-    WebServer& getServer() { return server; }
+    void setReportURL(const char* url);
 
 private:
-    // Web server instance
-    WebServer server;
-    
     // Preferences for persistent storage
     Preferences preferences;
     
     // Report URL for sending device info
-    String reportURL;
+    const char* reportURL;
+    
+    // Backing store for getIPAddress()
+    char ipAddress[16];
     
     // Connection handling
-    bool connectToWiFi(const String& ssid, const String& password, int maxRetries = 5);
+    bool connectToWiFi(const char* ssid, const char* password, int maxRetries = 5);
     void reportDeviceInfo();
-    
-    // Web server handlers
-    void handleRoot();
-    void handleSetWiFi();
-    void handleNotFound();
 };
 
 #endif // WIFI_MANAGER_H
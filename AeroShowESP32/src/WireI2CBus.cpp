@@ -0,0 +1,32 @@
+#include "WireI2CBus.h"
+
+WireI2CBus::WireI2CBus(TwoWire& wire) : wire(wire), errorCount(0) {
+}
+
+bool WireI2CBus::writeRegister16(uint8_t address, uint8_t reg, uint16_t value) {
+    wire.beginTransmission(address);
+    wire.write(reg);
+    wire.write((uint8_t)(value >> 8));
+    wire.write((uint8_t)(value & 0xFF));
+    if (wire.endTransmission() != 0) {
+        errorCount++;
+        return false;
+    }
+    return true;
+}
+
+bool WireI2CBus::readRegisters16(uint8_t address, const uint8_t* regs, uint16_t* values, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        // Keep the bus between pointer write and read (repeated start)
+        wire.beginTransmission(address);
+        wire.write(regs[i]);
+        if (wire.endTransmission(false) != 0 || wire.requestFrom(address, (uint8_t)2) != 2) {
+            errorCount++;
+            return false;
+        }
+        uint16_t high = wire.read();
+        uint16_t low = wire.read();
+        values[i] = (uint16_t)(high << 8 | low);
+    }
+    return true;
+}
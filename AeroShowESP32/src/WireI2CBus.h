@@ -0,0 +1,26 @@
+#ifndef WIRE_I2C_BUS_H
+#define WIRE_I2C_BUS_H
+
+#include <Arduino.h>
+#include <Wire.h>
+#include "I2CBus.h"
+
+// I2CBus over an Arduino TwoWire. Each register read is a pointer write
+// followed by a repeated-start read, which the ESP32 core performs under
+// the Wire lock, so other Wire users (the display) cannot split it.
+class WireI2CBus : public I2CBus {
+public:
+    explicit WireI2CBus(TwoWire& wire = Wire);
+
+    bool writeRegister16(uint8_t address, uint8_t reg, uint16_t value) override;
+    bool readRegisters16(uint8_t address, const uint8_t* regs, uint16_t* values, size_t count) override;
+
+    // Transactions that ended in a NACK or short read
+    uint32_t getErrorCount() const { return errorCount; }
+
+private:
+    TwoWire& wire;
+    volatile uint32_t errorCount;
+};
+
+#endif // WIRE_I2C_BUS_H
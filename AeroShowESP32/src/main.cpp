@@ -1,11 +1,37 @@
 #include <WiFi.h>
-#include <WebServer.h>
 #include <HTTPClient.h>
 #include <ArduinoJson.h>
 #include "ESCController.h"  // Replace ESP32Servo with our ESCController
+#include "EscOutputs.h"
+#include "ArduinoHal.h"
+#include "MotionEngine.h"
+#include "SampleRing.h"
+#include "HX711Reader.h"
+#include "SensorData.h"
+#include "TelemetryFrame.h"
+#include "StepStats.h"
+#include "BatchUploader.h"
+#include "LiveStream.h"
+#include "DisplayRenderer.h"
+#include "Metrics.h"
+#include "HttpServer.h"
+#include "ServerResponseWriter.h"
+#include "SpoolStore.h"
+#include "LittleFsFiles.h"
+#include <LittleFS.h>
 #include <Wire.h>
-#include <Adafruit_INA260.h>
-#include <vector>
+#include "WireI2CBus.h"
+#include "INA260Driver.h"
+#include "LogRing.h"
+#include "StatusSnapshot.h"
+#include "TestRig.h"
+#include "SamplePacer.h"
+#include "LoadCellStore.h"
+#include "JsonArena.h"
+#include "TestJobQueue.h"
+#include "PlanParser.h"
+#include "PlanStore.h"
+#include <stdarg.h>
 #include <WiFiManager.h>
 #define XSTR(x) #x
 #define STR(x) XSTR(x)
@@ -13,66 +39,124 @@
 #include <Adafruit_SSD1306.h>
 #include <ArduinoOTA.h>
 
-// Pin definitions
-#define ESC_PIN 18          // PWM pin for ESC control
-const int HX711_DT_PIN = 4;   // Data pin
-const int HX711_SCK_PIN = 5;  // Clock pin
+// Motor channels on this controller, each with its own ESC, load cell and
+// INA260: -DRIG_CHANNELS=<1-4>. Every channel is sampled at RIG_SAMPLE_HZ.
+#ifndef RIG_CHANNELS
+#define RIG_CHANNELS 1
+#endif
+#ifndef RIG_SAMPLE_HZ
+#define RIG_SAMPLE_HZ 1000
+#endif
+static_assert(RIG_CHANNELS >= 1 && RIG_CHANNELS <= RIG_MAX_CHANNELS, "RIG_CHANNELS must be 1-4");
+
+// Pin definitions, one column per channel. The INA260s share the I2C bus
+// (A0/A1 strapped per channel); only channel 0 has its alert line wired.
+const int ESC_PINS[RIG_MAX_CHANNELS] = {18, 25, 26, 27};       // ESC signal
+const int HX711_DT_PINS[RIG_MAX_CHANNELS] = {4, 32, 34, 36};   // Data pin
+const int HX711_SCK_PINS[RIG_MAX_CHANNELS] = {5, 33, 13, 14};  // Clock pin
+const int HX711_RATE_PINS[RIG_MAX_CHANNELS] = {23, -1, -1, -1};  // Driven high for 80 SPS, -1 if strapped
+const uint8_t INA260_ADDRESSES[RIG_MAX_CHANNELS] = {0x40, 0x41, 0x44, 0x45};
+const int INA260_ALERT_PINS[RIG_MAX_CHANNELS] = {19, -1, -1, -1};  // Conversion-ready interrupt (open drain)
+
+// Channel n uses LEDC channel n, RMT channel n to send and RMT channel n + 4
+// for bidirectional DShot replies
+const rmt_channel_t ESC_RMT_RX_CHANNEL_BASE = RMT_CHANNEL_4;
+
+// ESC protocol and command rate can be overridden with
+// -DESC_PROTOCOL=<Pwm|OneShot125|Multishot|DShot150|DShot300|DShot600> and
+// -DESC_COMMAND_HZ=<rate> (0 picks the protocol default, PWM is always 50 Hz)
+#ifndef ESC_PROTOCOL
+#define ESC_PROTOCOL Pwm
+#endif
+#ifndef ESC_COMMAND_HZ
+#define ESC_COMMAND_HZ 0
+#endif
+// DShot only: -DESC_BIDIRECTIONAL=1 asks the ESC for eRPM after every frame,
+// converted to RPM with the motor's pole count
+#ifndef ESC_BIDIRECTIONAL
+#define ESC_BIDIRECTIONAL 0
+#endif
+#ifndef ESC_MOTOR_POLES
+#define ESC_MOTOR_POLES 14
+#endif
+const EscProtocol escProtocol = EscProtocol::ESC_PROTOCOL;
 
 // Global objects
-ESCController motor(ESC_PIN);  // Replace Servo with ESCController
-Adafruit_INA260 ina260 = Adafruit_INA260();
-bool ina260Ready = false;
+ArduinoClock systemClock;
+// The motor channels and their acquisition schedule; channels are built
+// and added in setup(), after which only the sampling task polls them
+TestRig rig(systemClock);
+// Set per channel when built, for metrics
+RmtDShotOutput* dshotOutputs[RIG_MAX_CHANNELS] = {};
+HX711Reader* loadCells[RIG_MAX_CHANNELS] = {};
+// Motion updates follow the ESC command rate between these bounds
+const uint32_t MOTION_UPDATE_HZ = 200;
+const uint32_t MOTION_MAX_UPDATE_HZ = 1000;
+WireI2CBus i2cBus(Wire);
 WiFiManager wifiManager;
 
-// Load cell state
-float lastValidLoadCellValue = 0.0f;
-unsigned long lastLoadCellUpdate = 0;
-const unsigned long LOAD_CELL_TIMEOUT = 10; // Consider value stale after 1 second
-float loadCellTareValue = 0.0f;
+// Load cell filter and calibration per channel, kept in NVS. This is the
+// loop() side copy; changes reach the sampling task through configure().
+LoadCellStore loadCellStore;
+LoadCellSettings loadCellSettings[RIG_MAX_CHANNELS];
+// Conversions the filters get before the boot tare is taken (16 at 80 SPS)
+const uint32_t LOAD_CELL_TARE_SETTLE_MS = 200;
+
+// ~2.7ms per reading: 4 averages of 332us bus voltage + 332us current
+const INA260Averaging INA260_AVERAGING = INA260Averaging::Avg4;
+const INA260ConversionTime INA260_CONVERSION_TIME = INA260ConversionTime::Us332;
 
 // Test control variables
-bool testRunning = false;
-String currentTestId = "";
+volatile bool testRunning = false;  // Read by the sampling task
+char currentTestId[64] = "";  // Same size as SampleBatch::testId
 unsigned long lastDataSend = 0;
 const unsigned long DATA_SEND_INTERVAL = 10; // Send data every 100ms
-bool b_loadCellReady = false;
-float currentSpeed = 0.0;  // Track current motor speed (0.0 to 1.0)
 
-// Non-blocking test state
+// Non-blocking test state; the speed profiles themselves live in the motion engines
 struct TestState {
-  std::vector<float> speeds;
-  int currentSpeedIndex = 0;
-  unsigned long speedStartTime = 0;
+  bool active[RIG_MAX_CHANNELS] = {};  // Channels with a profile in this test
+  int currentStep[RIG_MAX_CHANNELS] = {-1, -1, -1, -1};  // Segment whose hold is being measured, -1 while ramping
   int rampDelay = 0;
-  
-  void setSpeeds(JsonArray jsonSpeeds) {
-    speeds.clear();
-    for (JsonVariant speed : jsonSpeeds) {
-      speeds.push_back(speed.as<float>());
-    }
-  }
+  TelemetryFormat uploadFormat = TelemetryFormat::Json;
+  bool summaryOnly = false;  // Upload per-step summaries but no raw samples
 } testState;
 
-// Serial data storage
-const int SERIAL_BUFFER_SIZE = 100;  // Store last 100 lines
-String serialBuffer[SERIAL_BUFFER_SIZE];
-int bufferIndex = 0;
-
-
-// Buffer structures and timing variables for batch processing
-const size_t MAX_SAMPLES = 200;  // Adjust based on available RAM
+// Tests waiting to run: /motor/control queues a test instead of refusing it
+// while another runs, and the next one starts as soon as the rig is free.
+// -DJOB_QUEUE_CAPACITY=<n> sets how many can wait, each held in full (at
+// most 1.25 KB, almost all of it the plan).
+#ifndef JOB_QUEUE_CAPACITY
+#define JOB_QUEUE_CAPACITY 4
+#endif
+static_assert(sizeof(TestJob) <= 1280, "A queued job outgrew the size quoted above");
+TestJobQueue<JOB_QUEUE_CAPACITY> jobQueue;
+TestJob requestJob;  // Parsed from the current /motor/control request
+const TestJob* currentJob = nullptr;  // The running job, owned by jobQueue
+
+// /motor/control bodies are parsed as they arrive. Steps past a job's RAM
+// table go to flash and are read back as the motion engines play them.
+PlanParser planParser;
+bool queueFullAtStart = false;  // The current request's body is being ignored
+PlanStore planStore(LittleFS);
+bool planStoreReady = false;
+uint32_t nextPlanId = 1;
+PlanReader planReaders[RIG_MAX_CHANNELS];
+
+// Last lines logged, shown on the root page. Fixed records, so logging
+// never allocates; longer lines are truncated in the ring (not on Serial).
+// Only setup(), loop() and the handlers they run may log.
+const size_t LOG_RING_LINES = 100;
+const size_t LOG_LINE_CHARS = 120;
+LogRing<LOG_RING_LINES, LOG_LINE_CHARS> logRing;
+
+// Parse buffer for the small request bodies (/loadcell, /jobs/cancel), reset per request
+const size_t REQUEST_JSON_ARENA_BYTES = 8192;
+JsonArena<REQUEST_JSON_ARENA_BYTES> requestArena;
+
+
+// Timing for batch processing (batch sizes live in BatchUploader.h)
 const unsigned long SEND_INTERVAL_MS = 2000;  // Send every 2 seconds
 
-struct SensorData {
-  unsigned long timestamp = 0;
-  float load_cell = 0.0f;
-  float voltage = 0.0f;
-  float current = 0.0f;
-  float speed = 0.0f;
-  
-  SensorData() : timestamp(millis()), load_cell(0), voltage(0), current(0), speed(0) {}
-};
-
 // Try both common resolutions for 0.91" displays
 #define SCREEN_WIDTH 128
 #define SCREEN_HEIGHT 32  // Try changing this to 64 if 32 doesn't work
@@ -83,50 +167,137 @@ struct SensorData {
 #define SCREEN_ADDRESS_1 0x3C
 #define SCREEN_ADDRESS_2 0x3D
 
-Adafruit_SSD1306 display(SCREEN_WIDTH, SCREEN_HEIGHT, &Wire, OLED_RESET);
-
-
-std::vector<SensorData> sensorBuffer;
+// The library sets its own clock for each transfer and another after it;
+// both are the bus clock, or the INA260s would be left at 100 kHz
+Adafruit_SSD1306 display(SCREEN_WIDTH, SCREEN_HEIGHT, &Wire, OLED_RESET, I2C_CLOCK_HZ, I2C_CLOCK_HZ);
+bool displayReady = false;
+
+// Draws the display off the sampling path; lowest priority, so it runs when loop() yields
+DisplayRenderer displayRenderer(display, SCREEN_ADDRESS_1, Wire);
+const BaseType_t DISPLAY_TASK_CORE = 1;
+const UBaseType_t DISPLAY_TASK_PRIORITY = 0;
+
+
+// Batch being filled by loop(); earlier batches are posted by the uploader task
+BatchUploader uploader;
+SampleBatch* currentBatch = nullptr;
+// Statistics for each channel's speed step in progress, fed from drainSampleRing()
+StepAggregator stepStats[RIG_MAX_CHANNELS];
+
+#if METRICS_ENABLED
+// Hot-path latency histograms, exported at /metrics
+LatencyHistogram loopPeriodHistogram("loop_period", "Time between loop() iterations");
+LatencyHistogram samplePeriodHistogram("sample_period", "Time between sampling task iterations");
+LatencyHistogram rigPollHistogram("rig_poll", "TestRig::poll() duration, all due channels");
+LatencyHistogram sampleJitterHistogram("sample_jitter", "Time from a sample's deadline to taking it");
+LatencyHistogram showTextHistogram("show_text", "showText() duration");
+LatencyHistogram httpDispatchHistogram("http_dispatch", "HttpServer dispatch() duration, handlers included");
+LatencyHistogram drainHistogram("drain_sample_ring", "drainSampleRing() duration");
+LatencyHistogram sendBufferedHistogram("send_buffered_data", "sendBufferedData() duration");
+PeriodTimer loopPeriod(loopPeriodHistogram);
+PeriodTimer samplePeriod(samplePeriodHistogram);
+uint32_t metricsOverheadCycles = 0;
+#endif
+// Batches that could not be delivered are kept on flash and replayed later
+LittleFsFiles spoolFiles(LittleFS);
+SpoolStore spool(spoolFiles);
 unsigned long lastSendTime = 0;
+const BaseType_t UPLOAD_TASK_CORE = 1;
+const UBaseType_t UPLOAD_TASK_PRIORITY = 1;
+// Upload bodies are gzipped at a level picked per batch from the measured
+// uplink; -DUPLOAD_GZIP_LEVEL=<0-3> fixes it instead (0 sends them plain)
+#ifndef UPLOAD_GZIP_LEVEL
+#define UPLOAD_GZIP_LEVEL -1
+#endif
+
+// Server-Sent Events subscribers on /live
+LiveStream liveStream(systemClock);
+
+// The control API. Its task waits on every connection at once and passes
+// requests that have arrived to loop(), which runs the handlers in
+// httpServer.dispatch(); a slow client only ever holds its own connection.
+HttpServer httpServer(systemClock);
+const BaseType_t HTTP_TASK_CORE = 1;
+const UBaseType_t HTTP_TASK_PRIORITY = 1;
+// Longest the task sleeps when no socket is ready
+const uint32_t HTTP_TASK_WAIT_MS = 50;
+// Log lines per part of the root page
+const size_t ROOT_LOG_LINES_PER_PART = 20;
+
+// Samples flow from the sampling task to loop() through a lock-free ring,
+// so acquisition keeps running while loop() is busy with HTTP or the display.
+// 256 samples are 12 KB of static RAM and cover 256 ms of one channel at
+// 1 kHz, 64 ms of four. Capacity can be overridden with
+// -DSAMPLE_RING_CAPACITY=<power of two>.
+#ifndef SAMPLE_RING_CAPACITY
+#define SAMPLE_RING_CAPACITY 256
+#endif
+SampleRing<SensorData, SAMPLE_RING_CAPACITY> sampleRing;
+TaskHandle_t samplingTaskHandle = nullptr;
+const BaseType_t SAMPLING_TASK_CORE = 0;     // Keep acquisition off the loop() core
+const UBaseType_t SAMPLING_TASK_PRIORITY = 2;
+// Wakes the sampling task at each rig deadline during a test
+SamplePacer samplePacer;
+// Set by the sampling task, which never logs; loop() reports it
+volatile bool samplePacerFailed = false;
+// Longest the sampling task catches up without blocking, so the idle task can feed the watchdog
+const uint32_t SAMPLING_MAX_BUSY_MS = 10;
+
+// The sampling task owns the sensors and publishes what the status pages
+// and the display need, so request handlers never do sensor I/O
+SnapshotCell<StatusSnapshot> statusCell;
+const uint32_t STATUS_PUBLISH_INTERVAL_MS = 100;
+
+// OTA hostname, also shown on the root page
+const char* const OTA_HOSTNAME = "ESP32-OTA";
 
 // Function prototypes
 void setupWebServer();
 void setupSensors();
 void setupESC();
-void handleMotorControl();
-void handleRoot();
-void startMotorTest(JsonDocument& config);
+void handleMotorControl(HttpRequest& request);
+void handleMotorControlBody(HttpRequest& request, HttpBody event, const char* data, size_t length);
+void handleRoot(HttpRequest& request);
+void handleLive(HttpRequest& request);
+void handleStatus(HttpRequest& request);
+void handleMetrics(HttpRequest& request);
+void handleLoadCell(HttpRequest& request);
+void handleJobs(HttpRequest& request);
+void handleJobCancel(HttpRequest& request);
+void releasePlan(const TestPlan& plan);
+void startNextJob();
+void startMotorTest(const TestJob& job, bool handover);
 void updateMotorTest();
-void runMotorTest(JsonDocument& config);
-float readLoadCell();
-bool isLoadCellReady();
-float readINA260Voltage();
-float readINA260Current();
+void finishMotorTest(JobState how);
+void finishStep(size_t channel);
+void runMotorTest(const char* body);
+void setupRig();
+void publishStatus(StatusSnapshot& status, bool running);
+StatusSnapshot readStatus();
 void sendBufferedData();
-void resetHX711();
-long readHX711();
-void addToSerialBuffer(String line);
-String getSerialOutput();
-void log(String message);
-void showText(String text, int line, bool clear);
+void log(const char* message);
+void logf(const char* format, ...) __attribute__((format(printf, 1, 2)));
+void showText(const char* text, int line, bool clear);
+void showTextf(int line, const char* format, ...) __attribute__((format(printf, 2, 3)));
 void configureOTA();
+void startSamplingTask();
+void samplingTask(void* parameter);
+void httpTask(void* parameter);
+void drainSampleRing();
 
 
 void configureOTA() {
   // Configure OTA
-  ArduinoOTA.setHostname("ESP32-OTA");
+  ArduinoOTA.setHostname(OTA_HOSTNAME);
   // ArduinoOTA.setPort(8080);
   ArduinoOTA.setMdnsEnabled(false);
 
   ArduinoOTA.onStart([]() {
-    String type;
-    if (ArduinoOTA.getCommand() == U_FLASH) {
-      type = "sketch";
-    } else {
-      type = "filesystem";
-    }
-    log("Start OTA update: " + type);
-    showText("Start OTA update: " + type, 1, true);
+    const char* type = ArduinoOTA.getCommand() == U_FLASH ? "sketch" : "filesystem";
+    char text[DISPLAY_LINE_CHARS + 1];
+    snprintf(text, sizeof(text), "Start OTA update: %s", type);
+    logf("Start OTA update: %s", type);
+    showText(text, 1, true);
   });
 
   ArduinoOTA.onEnd([]() {
@@ -136,11 +307,11 @@ void configureOTA() {
   });
 
   ArduinoOTA.onProgress([](unsigned int progress, unsigned int total) {
-    log(String("Progress: %u%%\r", (progress / (total / 100))));
+    logf("Progress: %u%%", progress / (total / 100));
   });
 
   ArduinoOTA.onError([](ota_error_t error) {
-    log(String("Error[%u]: ", error));
+    logf("Error[%u]: ", error);
     if (error == OTA_AUTH_ERROR) {
       log("Auth Failed");
       showText("OTA Auth Failed", 1, true);
@@ -163,22 +334,25 @@ void configureOTA() {
   log("OTA Ready"); 
 }
 
-const int TEXT_HEIGHT = 8;
-void showText(String text = "", int line = 0, bool clear = false) {
-  if (clear) {
-    display.clearDisplay();
-  }
-  // Clear just this line by drawing a black rectangle over it
-  display.fillRect(0, line * TEXT_HEIGHT, SCREEN_WIDTH, TEXT_HEIGHT, SSD1306_BLACK);
-  display.setTextSize(1);
-  display.setTextColor(SSD1306_WHITE);
-  display.setCursor(0, line * TEXT_HEIGHT);
-  display.println(text);
-  display.display();
+// Only updates the renderer's text model; the panel catches up on its next frame
+void showText(const char* text = "", int line = 0, bool clear = false) {
+  METRICS_TIME(showTextHistogram);
+  displayRenderer.setLine(line, text, clear);
+}
+
+// Formatted showText(); anything past the panel width is cut off anyway
+void showTextf(int line, const char* format, ...) {
+  char text[DISPLAY_LINE_CHARS + 1];
+  va_list args;
+  va_start(args, format);
+  vsnprintf(text, sizeof(text), format, args);
+  va_end(args);
+  showText(text, line);
 }
 
 void setupDisplay(){
   if(display.begin(SSD1306_SWITCHCAPVCC, SCREEN_ADDRESS_1)) {
+    displayReady = true;
     display.clearDisplay();
     display.setTextSize(1);
     display.setTextColor(SSD1306_WHITE);
@@ -234,29 +408,29 @@ void drawLogo() {
 }
 
 void showOK() {
-  display.clearDisplay();
-  display.setTextSize(3);
-  display.setTextColor(SSD1306_WHITE);
-  display.setCursor(0, 0);
-  display.println("OK");
-  display.display();
+  displayRenderer.showBanner("OK", 3);
   delay(5000);
-  display.clearDisplay();
+  displayRenderer.clear();
 }
 
 void setup() {
   Serial.begin(115200);
   delay(1000); // Give time for serial to initialize
 
-  // Initialize I2C with specific pins for ESP32
+  // Initialize I2C with specific pins for ESP32, shared by the display and the INA260s
   Wire.begin(21, 22); // SDA=21, SCL=22 for ESP32
+  Wire.setClock(I2C_CLOCK_HZ);
   setupDisplay();
   drawLogo();
+  // From here on only the render task talks to the display
+  if (displayReady && !displayRenderer.begin(DISPLAY_TASK_PRIORITY, DISPLAY_TASK_CORE)) {
+    log("Error: Could not start display task");
+  }
  
   // Initial debug output
   log("\n=== AeroShow ESP32 Starting ===");
   log("Debug output initialized");
-  log(String("Free heap: ") + String(ESP.getFreeHeap()) + " bytes");
+  logf("Free heap: %u bytes", ESP.getFreeHeap());
   log("ESP32 Motor Control & Sensor System Starting...");
 
   wifiManager.setReportURL(REPORT_URL);
@@ -275,23 +449,63 @@ void setup() {
     }
   }
   
+  setupRig();
   setupSensors();
   setupESC();
   setupWebServer();
   
-  loadCellTareValue = readLoadCell();
-  log(String("Load cell tare value: ") + String(loadCellTareValue));
+  // Stored filter and calibration, then a tare once the filters have settled
+  if (!loadCellStore.begin()) {
+    log("Error: Could not open load cell calibration store");
+  }
+  for (size_t i = 0; i < rig.channelCount(); i++) {
+    if (loadCellStore.load(i, loadCellSettings[i])) {
+      logf("Channel %u load cell calibration loaded (%u points)", (unsigned)i,
+           (unsigned)loadCellSettings[i].calibration.count());
+    }
+    rig.channel(i).configure(loadCellSettings[i]);
+  }
+  delay(LOAD_CELL_TARE_SETTLE_MS);
+  rig.refreshAll();
+  for (size_t i = 0; i < rig.channelCount(); i++) {
+    loadCellSettings[i].tare = rig.channel(i).getLoadCell();
+    rig.channel(i).configure(loadCellSettings[i]);
+    logf("Channel %u load cell tare value: %.2f", (unsigned)i, loadCellSettings[i].tare);
+  }
 
   log("System ready!");
-  log(String("IP Address: ") + String(wifiManager.getIPAddress()));
+  logf("IP Address: %s", wifiManager.getIPAddress());
 
   showOK();
-  showText("IP:" + String(wifiManager.getIPAddress()));
+  showTextf(0, "IP:%s", wifiManager.getIPAddress());
 
   if (strlen(DATA_URL) == 0) {
     showText("DATA wont send", 2);
   }
   configureOTA();
+
+  bool filesystemReady = LittleFS.begin(true);
+  if (filesystemReady && spool.begin()) {
+    uploader.setSpool(&spool);
+    log(spool.hasPending() ? "Spool ready, replaying stored batches" : "Spool ready");
+  } else {
+    log("Error: Could not mount spool filesystem, failed batches will be dropped");
+  }
+  planStoreReady = filesystemReady && planStore.begin();
+  if (!planStoreReady) {
+    logf("Error: Could not open plan store, test plans are limited to %u steps", (unsigned)PLAN_RAM_STEPS);
+  }
+  
+  uploader.setCompression(UPLOAD_GZIP_LEVEL < 0 ? COMPRESSION_AUTO : (uint8_t)UPLOAD_GZIP_LEVEL);
+  if (!uploader.begin(DATA_URL, UPLOAD_TASK_PRIORITY, UPLOAD_TASK_CORE)) {
+    log("Error: Could not start uploader task");
+  }
+  
+#if METRICS_ENABLED
+  metricsOverheadCycles = metricsMeasureOverheadCycles();
+  logf("Metrics overhead: %u cycles per timed scope", metricsOverheadCycles);
+#endif
+  startSamplingTask();
 }
 
 bool led_state = true;
@@ -299,6 +513,7 @@ long led_millis = millis();
 long OK_BLINK_RATE = 1000;
 
 void loop() {
+  METRICS_TICK(loopPeriod);
 
   ArduinoOTA.handle();  // CRITICAL: This must run frequently!
 
@@ -308,13 +523,23 @@ void loop() {
     led_millis = millis();
   }  
 
-  static unsigned long lastLoopDebug = 0;
-  if (millis() - lastLoopDebug > 5000) {  // Every 5 seconds
-    lastLoopDebug = millis();
+  {
+    METRICS_TIME(httpDispatchHistogram);
+    httpServer.dispatch();
+  }
+  liveStream.service();
+  
+  // Logging can block on the serial port, so the sampling task leaves it to us
+  static bool pacerFailureLogged = false;
+  if (samplePacerFailed && !pacerFailureLogged) {
+    pacerFailureLogged = true;
+    log("Error: Could not create sampling timer, pacing on the tick");
   }
   
-  WebServer& server = wifiManager.getServer();
-  server.handleClient();
+  // Queued tests start as soon as the rig is free
+  if (!testRunning) {
+    startNextJob();
+  }
   
   // Update motor test state if running
   if (testRunning) {
@@ -323,574 +548,1116 @@ void loop() {
   
   static unsigned long lastDebugOutput = 0;
   if (testRunning) {
-    // Collect sensor data as fast as possible
-    SensorData reading;
-    reading.timestamp = millis();
-    
-    // Read INA260
-    reading.voltage = readINA260Voltage();
-    reading.current = readINA260Current();
+    // Samples are taken by samplingTask(); here we only move them into the batch
+    drainSampleRing();
     
-    // Always try to read the load cell, the function will handle retries and timeouts
-    reading.load_cell = readLoadCell() - loadCellTareValue;
+    if (currentBatch == nullptr) {
+      // Every batch is still uploading, samples wait in the ring meanwhile
+      if (millis() - lastDebugOutput > 1000) {
+        lastDebugOutput = millis();
+        logf("All batches in flight, waiting... (%u queued, %u dropped, %u overwritten)",
+             (unsigned)sampleRing.size(), sampleRing.getDropped(), sampleRing.getOverwritten());
+      }
+    }
     
-    // Add current speed (0.0-1.0) to the reading
-    reading.speed = currentSpeed;
+    // Reflect upload results from the uploader task on the display
+    static uint32_t shownSent = 0;
+    static uint32_t shownFailed = 0;
+    static uint32_t shownSpooled = 0;
+    if (uploader.getFailedBatches() != shownFailed) {
+      shownFailed = uploader.getFailedBatches();
+      showText("Buffer send error", 3);
+    } else if (uploader.getSpooledBatches() != shownSpooled) {
+      shownSpooled = uploader.getSpooledBatches();
+      showText("Buffer spooled", 3);
+    } else if (uploader.getSentBatches() != shownSent) {
+      shownSent = uploader.getSentBatches();
+      showText("Buffer send success", 3);
+    }
     
-    // Debug: Print buffer status
-    static unsigned long lastBufferDebug = 0;
-    if (millis() - lastBufferDebug > 1000) {
-      lastBufferDebug = millis();
+    // Hand the batch over when it is full or the send interval has passed
+    if ((currentBatch != nullptr && currentBatch->full()) || millis() - lastSendTime >= SEND_INTERVAL_MS) {
+      sendBufferedData();
+      lastSendTime = millis();
+    }
+  }
+  else{
+    showTextf(3, "Voltage: %.2f", readStatus().channels[0].voltage);
+  }
+  
+  delay(1);  // Small delay to prevent watchdog issues
+}
+
+void startSamplingTask() {
+  BaseType_t created = xTaskCreatePinnedToCore(
+    samplingTask, "sampling", 4096, nullptr,
+    SAMPLING_TASK_PRIORITY, &samplingTaskHandle, SAMPLING_TASK_CORE);
+  
+  if (created == pdPASS) {
+    logf("Sampling task started on core %d", (int)SAMPLING_TASK_CORE);
+  } else {
+    log("Error: Could not start sampling task");
+  }
+}
+
+// Producer: the only writer of sampleRing, and once started the only task
+// that reads the sensors. During a test the pacer wakes it at each rig
+// deadline and the rig hands out the channels that are due; between tests
+// it refreshes them at the status interval so the status pages stay current.
+void samplingTask(void* parameter) {
+  StatusSnapshot status;
+  unsigned long lastStatusTime = 0;
+  unsigned long awakeSince = millis();
+  bool wasRunning = false;
+  SensorData readings[RIG_MAX_CHANNELS];
+  
+  if (!samplePacer.begin()) {
+    samplePacerFailed = true;
+  }
+  
+  for (;;) {
+    METRICS_TICK(samplePeriod);
+    bool running = testRunning;
+    if (running && !wasRunning) {
+      // Deadlines start from the first pass that sees the test
+      status.samplesTaken = 0;
+      rig.restart();
     }
+    wasRunning = running;
     
-    // Add to buffer if we haven't reached max samples
-    if (sensorBuffer.size() < MAX_SAMPLES) {
-      sensorBuffer.push_back(reading);
-      
-      // Debug output every second
-      if (millis() - lastDebugOutput > 1000) {
-        lastDebugOutput = millis();
+    if (running) {
+      size_t taken;
+      {
+        METRICS_TIME(rigPollHistogram);
+        taken = rig.poll(readings, RIG_MAX_CHANNELS);
       }
-    } else {
-      // Buffer full, waiting to send
-      if (millis() - lastDebugOutput > 1000) {
-        lastDebugOutput = millis();
-        log("Buffer full, waiting to send...");
+      
+      // Overflow handling and accounting follow the ring's policy
+      for (size_t i = 0; i < taken; i++) {
+        sampleRing.push(readings[i]);
+#if METRICS_ENABLED
+        sampleJitterHistogram.recordMicros(readings[i].jitter_us);
+#endif
       }
+      status.samplesTaken += taken;
     }
     
-    // Check if it's time to send data
-    if (millis() - lastSendTime >= SEND_INTERVAL_MS) {
-      if (!sensorBuffer.empty()) {
-        sendBufferedData();
-        sensorBuffer.clear();
+    if (millis() - lastStatusTime >= STATUS_PUBLISH_INTERVAL_MS) {
+      lastStatusTime = millis();
+      if (!running) {
+        rig.refreshAll();
       }
-      
-      lastSendTime = millis();
+      publishStatus(status, running);
+    }
+    
+    if (!running) {
+      samplePacer.cancel();
+      samplePacer.wait(STATUS_PUBLISH_INTERVAL_MS);
+      awakeSince = millis();
+    } else if (rig.getNextDueMicros() > (uint64_t)esp_timer_get_time()) {
+      samplePacer.armAt(rig.getNextDueMicros());
+      samplePacer.wait(STATUS_PUBLISH_INTERVAL_MS);
+      awakeSince = millis();
+    } else if (millis() - awakeSince >= SAMPLING_MAX_BUSY_MS) {
+      // Behind on every pass: take a tick off now and then
+      vTaskDelay(1);
+      awakeSince = millis();
     }
   }
-  else{
-    float voltage = readINA260Voltage();
-    showText("Voltage: " + String(voltage, 2), 3);
+}
+
+// Called from the sampling task only
+void publishStatus(StatusSnapshot& status, bool running) {
+  status.timestampMs = millis();
+  status.testRunning = running;
+  status.channelCount = rig.channelCount();
+  for (size_t i = 0; i < rig.channelCount(); i++) {
+    RigChannel& channel = rig.channel(i);
+    ChannelStatus& out = status.channels[i];
+    out.speed = channel.getMotion().getSetpoint();
+    EscRpmReading rpm;
+    out.rpm = channel.getMotor().readRpm(rpm) ? rpm.rpm : 0.0f;
+    out.voltage = channel.getPower().voltage;
+    out.current = channel.getPower().current;
+    out.power = channel.getPower().power;
+    out.loadCell = channel.getLoadCell();
+    out.tare = channel.getSettings().tare;
+    out.grams = channel.getGrams();
+    out.loadCellReady = channel.isLoadCellReady();
+    out.samples = rig.getSamples(i);
+    out.missed = rig.getMissed(i);
+    out.maxLatenessUs = rig.getMaxLatenessMicros(i);
+  }
+  status.samplesQueued = sampleRing.size();
+  status.samplesDropped = sampleRing.getDropped();
+  status.samplesOverwritten = sampleRing.getOverwritten();
+  statusCell.publish(status);
+}
+
+// Latest published snapshot; all zero until the sampling task has started
+StatusSnapshot readStatus() {
+  StatusSnapshot status;
+  statusCell.read(status);
+  return status;
+}
+
+// Consumer: the only reader of sampleRing, called from loop()
+void drainSampleRing() {
+  METRICS_TIME(drainHistogram);
+  if (currentBatch == nullptr) {
+    currentBatch = uploader.acquire(currentTestId, testState.uploadFormat);
+    if (currentBatch == nullptr) {
+      return;
+    }
   }
   
-  delay(1);  // Small delay to prevent watchdog issues
+  SensorData sample;
+  while (!currentBatch->full() && sampleRing.pop(sample)) {
+    stepStats[sample.channel].add(sample);
+    liveStream.publish(sample);
+    if (!testState.summaryOnly) {
+      currentBatch->samples[currentBatch->count++] = sample;
+    }
+  }
+  // Ready only while every channel's load cell is
+  StatusSnapshot status = readStatus();
+  bool loadCellsReady = status.channelCount > 0;
+  for (size_t i = 0; i < status.channelCount; i++) {
+    loadCellsReady = loadCellsReady && status.channels[i].loadCellReady;
+  }
+  currentBatch->loadCellReady = loadCellsReady;
+  currentBatch->droppedSamples = sampleRing.getDropped();
+  currentBatch->overwrittenSamples = sampleRing.getOverwritten();
 }
 
-void log(String message) {
+void log(const char* message) {
   Serial.println(message);
-  if (message.length() < 200) {
-    addToSerialBuffer(message);
-  }else{
-    addToSerialBuffer(message.substring(0, 200));
-  }
+  logRing.append(message);
 }
 
-void addToSerialBuffer(String line) {
-  serialBuffer[bufferIndex] = line;
-  bufferIndex = (bufferIndex + 1) % SERIAL_BUFFER_SIZE;
+// Formats on the stack, so log lines never allocate
+void logf(const char* format, ...) {
+  char message[256];
+  va_list args;
+  va_start(args, format);
+  vsnprintf(message, sizeof(message), format, args);
+  va_end(args);
+  log(message);
 }
 
 void setupSensors() {
   log("Initializing sensors...");
+  logf(" - I2C at %lu kHz", (unsigned long)(I2C_CLOCK_HZ / 1000));
   
-  // Initialize I2C for INA260
-  Wire.begin();
-  log(" - I2C initialized");
-  
-  // Initialize INA260
-  log(" - Initializing INA260...");
-  if (ina260.begin()) {
-    log(" - INA260 initialized successfully");
-    ina260Ready = true;
-  } else {
-    log("Error: Could not find INA260 chip");
-    ina260Ready = false;
-    //while (1); // Halt if INA260 not found
+  for (size_t i = 0; i < rig.channelCount(); i++) {
+    RigChannel& channel = rig.channel(i);
+    
+    // Initialize INA260
+    logf(" - Initializing channel %u INA260 at 0x%02X...", (unsigned)i, INA260_ADDRESSES[i]);
+    INA260Driver& ina260 = channel.getPowerMonitor();
+    if (ina260.begin(INA260_AVERAGING, INA260_CONVERSION_TIME, INA260_CONVERSION_TIME)) {
+      logf(" - INA260 initialized successfully, new reading every %luus",
+           (unsigned long)ina260.getConversionPeriodMicros());
+      channel.setPowerReady(true);
+    } else {
+      log("Error: Could not find INA260 chip");
+      channel.setPowerReady(false);
+    }
+    
+    // Initialize HX711 (readings arrive via the DT data-ready interrupt)
+    logf(" - Initializing channel %u HX711...", (unsigned)i);
+    if (!loadCells[i]->begin()) {
+      log("Error: Could not create HX711 reading queue");
+      continue;
+    }
+    
+    // Test HX711: a conversion takes 12.5ms at 80 SPS (100ms at 10), so one should arrive quickly
+    HX711Reading reading;
+    if (loadCells[i]->waitForReading(reading, 500)) {
+      log(" - HX711 initialized successfully");
+    } else {
+      log(" - HX711 not responding");
+    }
   }
-  
-  // Initialize HX711 pins
-  log(" - Initializing HX711...");
-  pinMode(HX711_DT_PIN, INPUT);
-  pinMode(HX711_SCK_PIN, OUTPUT);
-  digitalWrite(HX711_SCK_PIN, LOW);
-  
-  // Reset HX711
-  resetHX711();
-  delay(100);
-  
-  // Test HX711
-  if (digitalRead(HX711_DT_PIN) == LOW) {
-    log(" - HX711 initialized successfully");
-  } else {
-    log(" - HX711 not responding");
+}
+
+// Output for the configured ESC protocol on one channel. Only the selected
+// one is built; the others never touch their pins.
+template <size_t Channel>
+ThrottleOutput& selectEscOutput() {
+  if (escIsDShot(escProtocol)) {
+    static RmtDShotOutput dshot(ESC_PINS[Channel], (rmt_channel_t)Channel, escProtocol, ESC_COMMAND_HZ);
+    if (ESC_BIDIRECTIONAL) {
+      dshot.enableTelemetry((rmt_channel_t)(ESC_RMT_RX_CHANNEL_BASE + Channel), ESC_MOTOR_POLES);
+    }
+    dshotOutputs[Channel] = &dshot;
+    return dshot;
   }
+  if (escProtocol != EscProtocol::Pwm) {
+    static LedcPulseOutput pulses(ESC_PINS[Channel], (uint8_t)Channel, escProtocol, ESC_COMMAND_HZ);
+    return pulses;
+  }
+  static ServoPwmOutput servo(ESC_PINS[Channel]);
+  static PwmThrottleOutput pwm(servo);
+  return pwm;
+}
+
+// Everything one motor channel owns. Static locals, so channels past
+// RIG_CHANNELS are never constructed and never claim their pins.
+template <size_t Channel>
+RigChannel& buildChannel() {
+  static ESCController motor(selectEscOutput<Channel>(), systemClock);
+  // Plays test profiles into the ESC from an esp_timer, so ramps never block loop()
+  static MotionEngine motion(motor, systemClock);
+  static HX711Reader loadCell(HX711_DT_PINS[Channel], HX711_SCK_PINS[Channel], HX711_PULSES_GAIN_A128,
+                              HX711_RATE_PINS[Channel]);
+  static INA260Driver ina260(i2cBus, INA260_ADDRESSES[Channel], INA260_ALERT_PINS[Channel]);
+  static RigChannel channel(Channel, motor, motion, loadCell, ina260);
+  loadCells[Channel] = &loadCell;
+  return channel;
+}
+
+void setupRig() {
+  typedef RigChannel& (*ChannelBuilder)();
+  static const ChannelBuilder builders[RIG_MAX_CHANNELS] = {
+    buildChannel<0>, buildChannel<1>, buildChannel<2>, buildChannel<3>,
+  };
+  for (size_t i = 0; i < RIG_CHANNELS; i++) {
+    rig.addChannel(builders[i]());
+  }
+  rig.setSampleRateHz(RIG_SAMPLE_HZ);
+  logf("Rig: %u channel(s) at %u Hz each", (unsigned)rig.channelCount(), (unsigned)rig.getSampleRateHz());
 }
 
 void setupESC() {
   log("Initializing ESC controller...");
   
-  // The ESCController's initialize() method handles all calibration
-  if (motor.initialize()) {
-    log("ESC initialized successfully!");
-  } else {
-    log("ESC initialization failed!");
+  for (size_t i = 0; i < rig.channelCount(); i++) {
+    ESCController& motor = rig.channel(i).getMotor();
+    
+    // The ESCController's initialize() method handles all calibration
+    if (motor.initialize()) {
+      logf("Channel %u ESC initialized successfully!", (unsigned)i);
+    } else {
+      logf("Channel %u ESC initialization failed!", (unsigned)i);
+    }
+    
+    logf("ESC protocol %s at %u Hz", STR(ESC_PROTOCOL), (unsigned)motor.getCommandRateHz());
+    uint32_t motionHz = motor.getCommandRateHz();
+    motionHz = motionHz < MOTION_UPDATE_HZ ? MOTION_UPDATE_HZ : (motionHz > MOTION_MAX_UPDATE_HZ ? MOTION_MAX_UPDATE_HZ : motionHz);
+    if (!rig.channel(i).getMotion().begin(motionHz)) {
+      log("Error: Could not create motion profile timer");
+    }
   }
 }
 
 void setupWebServer() {
   log("Setting up web server...");
   
-  // Get the server instance from WiFiManager
-  WebServer& server = wifiManager.getServer();
-  
-  server.on("/", HTTP_GET, handleRoot);
+  httpServer.on("/", HttpMethod::Get, handleRoot);
 
   log(" - Root handler registered");
   
-  // Set up motor control endpoint
-  server.on("/motor/control", HTTP_POST, handleMotorControl);
+  // Same snapshot as the root page, as JSON
+  httpServer.on("/status", HttpMethod::Get, handleStatus);
+  log(" - Status endpoint registered");
+  
+  // Set up motor control endpoint; the body is parsed as it is read
+  httpServer.on("/motor/control", HttpMethod::Post, handleMotorControl, handleMotorControlBody);
   log(" - Motor control endpoint registered");
   
-  // Start the server on all interfaces
-  server.begin(80);
-  log(String("Web server started on http://") + wifiManager.getIPAddress() + ":80");
-}
-
-String getSerialOutput() {
-  String output = "";
+  // Queued and running tests (/jobs?job_id=<id> for one), and cancelling them
+  httpServer.on("/jobs", HttpMethod::Get, handleJobs);
+  httpServer.on("/jobs/cancel", HttpMethod::Post, handleJobCancel);
+  log(" - Job queue endpoints registered");
   
-  // Get lines in chronological order
-  for (int i = 0; i < SERIAL_BUFFER_SIZE; i++) {
-    int idx = (bufferIndex + i) % SERIAL_BUFFER_SIZE;
-    if (serialBuffer[idx].length() > 0) {
-      output += serialBuffer[idx] + "<br>";
-    }
-  }
+  // Load cell tare, calibration points and filter, per channel
+  httpServer.on("/loadcell", HttpMethod::Post, handleLoadCell);
+  log(" - Load cell endpoint registered");
   
-  if (output.length() == 0) {
-    output = "No serial data captured yet...";
-  }
+  // Live telemetry push: /live?rate=<Hz>&mode=minmax|decimate&channel=<n>
+  httpServer.on("/live", HttpMethod::Get, handleLive);
+  log(" - Live stream endpoint registered");
+  
+#if METRICS_ENABLED
+  // Prometheus text format
+  httpServer.on("/metrics", HttpMethod::Get, handleMetrics);
+  log(" - Metrics endpoint registered");
+#endif
   
-  return output;
+  // Start the server on all interfaces, then its task
+  if (!httpServer.begin(80)) {
+    log("Error: Could not listen on port 80");
+    return;
+  }
+  if (xTaskCreatePinnedToCore(httpTask, "http", 4096, nullptr, HTTP_TASK_PRIORITY, nullptr, HTTP_TASK_CORE) != pdPASS) {
+    log("Error: Could not start web server task");
+    return;
+  }
+  logf("Web server started on http://%s:80, %u connections", wifiManager.getIPAddress(),
+       (unsigned)HTTP_MAX_CONNECTIONS);
 }
 
-void handleRoot() {
-  String html = "<html><body>";
-  html += "<h1>ESP32 Motor Control System</h1>";
-  html += "<p>System Status: " + String(testRunning ? "Test Running" : "Ready") + "</p>";
-  html += "<p>Current Test ID: " + currentTestId + "</p>";
-  html += "<h2>Network Info:</h2>";
-  html += "<p>IP Address: " + WiFi.localIP().toString() + "</p>";
-  html += "<p>MAC Address: " + WiFi.macAddress() + "</p>";
-  html += "<p>RSSI: " + String(WiFi.RSSI()) + " dBm</p>";
-  html += "<h2>OTA Status:</h2>";
-  html += "<p>OTA Port: 3232 (default)</p>";
-  html += "<p>Hostname: " + String(ArduinoOTA.getHostname()) + "</p>";
-  html += "<h2>Sensor Readings:</h2>";
-  html += "<p>Load Cell: " + String(readLoadCell()) + "</p>";
-  html += "<p>INA260 Voltage: " + String(readINA260Voltage()) + "V</p>";
-  html += "<p>INA260 Current: " + String(readINA260Current()) + "mA</p>";
-  html += "<p>Serial: " + getSerialOutput() + "</p>";
-  html += "</body></html>";
-  
-  WebServer& server = wifiManager.getServer();
-  server.send(200, "text/html", html);
+// Only socket work happens here; handlers run on loop()
+void httpTask(void* parameter) {
+  for (;;) {
+    httpServer.serve(HTTP_TASK_WAIT_MS);
+  }
 }
 
-void handleMotorControl() {
-  WebServer& server = wifiManager.getServer();
-  if (server.hasArg("plain") == false) {
-    log("Error: No data received in motor control request");
-    server.send(400, "application/json", "{\"error\":\"No data received\"}");
+// Built from the status snapshot only: a browser refreshing this page
+// never touches the sensors or the test in progress. The log follows in
+// parts of ROOT_LOG_LINES_PER_PART lines; a line logged between parts may
+// show twice.
+void handleRoot(HttpRequest& request) {
+  ServerResponseWriter out(request);
+  if (request.part() > 0) {
+    // Log lines in chronological order, straight from the ring
+    size_t first = (request.part() - 1) * ROOT_LOG_LINES_PER_PART;
+    size_t end = min(first + ROOT_LOG_LINES_PER_PART, logRing.size());
+    for (size_t i = first; i < end; i++) {
+      out.print(logRing.line(i));
+      out.print("<br>");
+    }
+    if (end < logRing.size()) {
+      request.more();
+      return;
+    }
+    out.print("</p>");
+    out.print("</body></html>");
     return;
   }
   
-  String requestBody = server.arg("plain");
-  log(String("Received motor control request:") + requestBody);
-  
-  String body = server.arg("plain");
-  JsonDocument doc;
-  
-  DeserializationError error = deserializeJson(doc, body);
-  if (error) {
-    server.send(400, "application/json", "{\"error\":\"Invalid JSON\"}");
-    return;
+  StatusSnapshot status = readStatus();
+  out.begin(200, "text/html");
+  
+  uint8_t mac[6];
+  WiFi.macAddress(mac);
+  
+  out.print("<html><body>");
+  out.print("<h1>ESP32 Motor Control System</h1>");
+  out.format("<p>System Status: %s</p>", testRunning ? "Test Running" : "Ready");
+  out.format("<p>Current Test ID: %s</p>", currentTestId);
+  out.format("<p>Queued Tests: %u</p>", (unsigned)jobQueue.size());
+  out.print("<h2>Network Info:</h2>");
+  out.format("<p>IP Address: %s</p>", wifiManager.getIPAddress());
+  out.format("<p>MAC Address: %02X:%02X:%02X:%02X:%02X:%02X</p>", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+  out.format("<p>RSSI: %d dBm</p>", WiFi.RSSI());
+  out.print("<h2>OTA Status:</h2>");
+  out.print("<p>OTA Port: 3232 (default)</p>");
+  out.format("<p>Hostname: %s</p>", OTA_HOSTNAME);
+  out.format("<h2>Sensor Readings (%lums old):</h2>", (unsigned long)(millis() - status.timestampMs));
+  for (size_t i = 0; i < status.channelCount; i++) {
+    const ChannelStatus& channel = status.channels[i];
+    if (status.channelCount > 1) {
+      out.format("<h3>Channel %u</h3>", (unsigned)i);
+    }
+    out.format("<p>Load Cell: %.2f (%.1fg)%s</p>", channel.loadCell, channel.grams,
+               channel.loadCellReady ? "" : " (stale)");
+    out.format("<p>INA260 Voltage: %.2fV</p>", channel.voltage);
+    out.format("<p>INA260 Current: %.2fmA</p>", channel.current);
+    if (status.testRunning) {
+      out.format("<p>Samples: %lu (missed %lu)</p>", (unsigned long)channel.samples, (unsigned long)channel.missed);
+    }
   }
-  
-  // Check if required fields exist using the recommended is<T>() method
-  if (!doc["test_id"].is<String>() || !doc["speeds"].is<JsonArray>() || !doc["ramp_delay"].is<int>()) {
-    server.send(400, "application/json", "{\"error\":\"Missing or invalid required fields\"}");
-    return;
+  if (status.testRunning) {
+    out.format("<p>Samples taken: %lu, queued: %lu (dropped %lu, overwritten %lu)</p>",
+               (unsigned long)status.samplesTaken, (unsigned long)status.samplesQueued,
+               (unsigned long)status.samplesDropped, (unsigned long)status.samplesOverwritten);
+    out.format("<p>Live subscribers: %u (events sent %u, dropped %u)</p>",
+               (unsigned)liveStream.getSubscriberCount(), (unsigned)liveStream.getSentEvents(),
+               (unsigned)liveStream.getDroppedEvents());
   }
   
-  if (testRunning) {
-    server.send(409, "application/json", "{\"error\":\"Test already running\"}");
+  out.print("<p>Serial: ");
+  if (!logRing.empty()) {
+    request.more();
     return;
   }
-  
-  server.send(200, "application/json", "{\"status\":\"Test started - ESC will be initialized\"}");
-  
-  // Start the motor test (non-blocking)
-  log("\n=== Starting test from handleMotorControl ===");
-  log("Note: ESC will be re-initialized for this test");
-  startMotorTest(doc);
+  out.print("No serial data captured yet...");
+  out.print("</p>");
+  out.print("</body></html>");
 }
 
-void startMotorTest(JsonDocument& config) {
-  log("\n=== Starting Motor Test ===");
+// Compact machine-readable status, from the same snapshot as the root page
+void handleStatus(HttpRequest& request) {
+  StatusSnapshot status = readStatus();
+  ServerResponseWriter out(request);
+  out.begin(200, "application/json");
+  
+  out.format("{\"uptime_ms\":%lu,\"snapshot_age_ms\":%lu,\"test_running\":%s,\"test_id\":\"%s\",\"queued_jobs\":%u,",
+             (unsigned long)millis(), (unsigned long)(millis() - status.timestampMs),
+             testRunning ? "true" : "false", currentTestId, (unsigned)jobQueue.size());
+  // Channel 0 at the top level as before, then every channel
+  const ChannelStatus& primary = status.channels[0];
+  out.format("\"speed\":%.4f,\"rpm\":%.0f,\"ina260\":{\"voltage_v\":%.3f,\"current_ma\":%.2f,\"power_mw\":%.1f},",
+             primary.speed, primary.rpm, primary.voltage, primary.current, primary.power);
+  out.format("\"load_cell\":{\"raw_value\":%.1f,\"tare\":%.1f,\"is_ready\":%s},",
+             primary.loadCell, primary.tare, primary.loadCellReady ? "true" : "false");
+  out.print("\"channels\":[");
+  for (size_t i = 0; i < status.channelCount; i++) {
+    const ChannelStatus& channel = status.channels[i];
+    out.format("%s{\"channel\":%u,\"speed\":%.4f,\"rpm\":%.0f,"
+               "\"ina260\":{\"voltage_v\":%.3f,\"current_ma\":%.2f,\"power_mw\":%.1f},"
+               "\"load_cell\":{\"raw_value\":%.1f,\"tare\":%.1f,\"grams\":%.2f,\"is_ready\":%s},"
+               "\"samples\":%lu,\"missed\":%lu,\"max_late_us\":%lu}",
+               i == 0 ? "" : ",", (unsigned)i, channel.speed, channel.rpm, channel.voltage, channel.current,
+               channel.power, channel.loadCell, channel.tare, channel.grams, channel.loadCellReady ? "true" : "false",
+               (unsigned long)channel.samples, (unsigned long)channel.missed, (unsigned long)channel.maxLatenessUs);
+  }
+  out.print("],");
+  out.format("\"samples\":{\"taken\":%lu,\"queued\":%lu,\"dropped\":%lu,\"overwritten\":%lu},",
+             (unsigned long)status.samplesTaken, (unsigned long)status.samplesQueued,
+             (unsigned long)status.samplesDropped, (unsigned long)status.samplesOverwritten);
+  out.format("\"upload\":{\"pending\":%u,\"sent\":%lu,\"failed\":%lu,\"spooled\":%lu,\"uplink_down\":%s,"
+             "\"gzip_level\":%u},",
+             (unsigned)uploader.pending(), (unsigned long)uploader.getSentBatches(),
+             (unsigned long)uploader.getFailedBatches(), (unsigned long)uploader.getSpooledBatches(),
+             uploader.isUplinkDown() ? "true" : "false", (unsigned)uploader.getLastLevel());
+  out.format("\"live_subscribers\":%u}", (unsigned)liveStream.getSubscriberCount());
+}
 
-  // Initialize ESC first since battery may have been disconnected
-  log("Re-initializing ESC for new test...");
-  showText("Initializing ESC...", 1);
+void handleLive(HttpRequest& request) {
+  char value[16];
+  float rateHz = request.arg("rate", value, sizeof(value)) ? atof(value) : LIVE_DEFAULT_RATE_HZ;
+  LiveMode mode = request.arg("mode", value, sizeof(value)) && strcmp(value, "decimate") == 0 ? LiveMode::Decimate
+                                                                                               : LiveMode::MinMax;
+  long channel = request.arg("channel", value, sizeof(value)) ? atol(value) : 0;
+  if (channel < 0 || (size_t)channel >= rig.channelCount()) {
+    request.respond(400, "application/json", "{\"error\":\"Invalid channel\"}");
+    return;
+  }
+  // Checked first: once detached, the socket is no longer the server's to answer on
+  if (liveStream.getSubscriberCount() >= LIVE_MAX_SUBSCRIBERS) {
+    request.respond(503, "application/json", "{\"error\":\"Too many live subscribers\"}");
+    return;
+  }
   
-  log("ESC initialized successfully for test");
-  showText("ESC Ready", 1);
-  delay(1000);
+  // The stream writes its own headers and closes the socket when the client goes
+  liveStream.subscribe(request.detach(), rateHz, mode, (uint8_t)channel);
+  logf("Live subscriber connected to channel %ld at %.1f Hz", channel, rateHz);
+}
 
-  testRunning = true;
-  currentTestId = config["test_id"].as<String>();
-  testState.setSpeeds(config["speeds"]);
-  testState.rampDelay = config["ramp_delay"];
-  testState.currentSpeedIndex = 0;
-  testState.speedStartTime = millis();
-  
-  // Clear any old data
-  sensorBuffer.clear();
+#if METRICS_ENABLED
+// One histogram per part, then the gauges and counters in groups small
+// enough for a part each
+void handleMetrics(HttpRequest& request) {
+  ServerResponseWriter out(request);
+  if (request.part() == 0) {
+    out.begin(200, "text/plain; version=0.0.4");
+  }
+  if (LatencyHistogram::writeOne(out, request.part())) {
+    request.more();
+    return;
+  }
   
-  // Set the first speed from the test configuration
-  if (testState.speeds.size() > 0) {
-    float initialSpeed = testState.speeds[0];
-    
-    
-    // Calculate the microsecond range
-    // ESCController uses 1000-2000 microsecond range by default
-    const int MIN_PULSE = 1000;
-    const int MAX_PULSE = 2000;
-    const int PULSE_RANGE = MAX_PULSE - MIN_PULSE;
-    
-    // Calculate target pulse width for the initial speed
-    int targetPulse = MIN_PULSE + (int)(initialSpeed * PULSE_RANGE);
-    int startPulse = MIN_PULSE;  // Start at 0 speed (minimum pulse)
-    int pulseDifference = targetPulse - startPulse;
+  size_t group = request.part() - LatencyHistogram::exportedCount();
+  if (group == 0) {
+    metricsWriteGauge(out, "metrics_overhead_cycles", "CPU cycles added by one timed scope", metricsOverheadCycles);
+    metricsWriteGauge(out, "cpu_frequency_mhz", "CPU clock", getCpuFrequencyMhz());
+    metricsWriteGauge(out, "uptime_seconds", "Time since boot", millis() / 1000.0);
+    metricsWriteGauge(out, "heap_free_bytes", "Free heap", ESP.getFreeHeap());
+    metricsWriteGauge(out, "heap_min_free_bytes", "Lowest free heap since boot", ESP.getMinFreeHeap());
+    metricsWriteGauge(out, "test_running", "1 while a motor test runs", testRunning ? 1 : 0);
+    metricsWriteGauge(out, "test_jobs_queued", "Tests waiting to run", jobQueue.size());
+    metricsWriteCounter(out, "test_jobs_completed_total", "Queued tests run to the end", jobQueue.getCompleted());
+    metricsWriteCounter(out, "test_jobs_cancelled_total", "Queued or running tests cancelled", jobQueue.getCancelled());
+    metricsWriteCounter(out, "test_plans_spilled_total", "Test plans too long for RAM, kept on flash", planStore.getSpilledPlans());
+    metricsWriteCounter(out, "test_plan_steps_spilled_total", "Plan steps written to flash", planStore.getStepsWritten());
     
-    // Calculate timing for 1 second ramp
-    unsigned long rampStartTime = millis();
-    const unsigned long RAMP_DURATION = 3000; // 1 second in milliseconds
-
-    log("Ramping speed from 0 to " + String(initialSpeed) + " over " + String(RAMP_DURATION) + "ms...");
-    
-    // If we need to ramp up
-    if (pulseDifference > 0) {
-      // Calculate delay between increments to fit all steps in 1 second
-      float delayPerStep = (float)RAMP_DURATION / (float)pulseDifference;
-      
-      // Perform the ramp
-      for (int pulse = startPulse; pulse <= targetPulse; pulse++) {
-        // Convert pulse width back to 0.0-1.0 range for ESCController
-        float speed = (float)(pulse - MIN_PULSE) / (float)PULSE_RANGE;
-        motor.setSpeed(speed);
-        currentSpeed = speed;
-        
-        // Calculate when this step should occur
-        unsigned long targetTime = rampStartTime + (unsigned long)((pulse - startPulse) * delayPerStep);
-        
-        // Wait until it's time for this step
-        while (millis() < targetTime) {
-          // Small delay to prevent tight loop
-          delayMicroseconds(100);
-        }
+    metricsWriteGauge(out, "sample_ring_queued", "Samples waiting in the ring", sampleRing.size());
+    metricsWriteCounter(out, "samples_dropped_total", "Samples rejected by a full ring this test", sampleRing.getDropped());
+    metricsWriteCounter(out, "samples_overwritten_total", "Samples overwritten in the ring this test", sampleRing.getOverwritten());
+    metricsWriteCounter(out, "sample_ring_blocked_total", "Producer waits on a full ring this test", sampleRing.getBlocked());
+    request.more();
+    return;
+  }
+  
+  if (group == 1) {
+    // Device counters summed over the rig's channels
+    uint32_t rigSamples = 0, rigMissed = 0, rigMaxLateness = 0, hx711Readings = 0, hx711Overflow = 0, ina260Readings = 0, ina260Errors = 0, ina260Late = 0;
+    uint32_t motionUnderruns = 0;
+    uint32_t dshotFrames = 0, dshotDecoded = 0, dshotMissing = 0, dshotFraming = 0, dshotGcr = 0, dshotChecksum = 0;
+    bool dshot = false, bidirectional = false;
+    for (size_t i = 0; i < rig.channelCount(); i++) {
+      rigSamples += rig.getSamples(i);
+      rigMissed += rig.getMissed(i);
+      rigMaxLateness = max(rigMaxLateness, rig.getMaxLatenessMicros(i));
+      hx711Readings += loadCells[i]->getReadingCount();
+      hx711Overflow += loadCells[i]->getOverflowCount();
+      ina260Readings += rig.channel(i).getPowerMonitor().getReadingCount();
+      ina260Errors += rig.channel(i).getPowerMonitor().getErrorCount();
+      ina260Late += rig.channel(i).getPowerMonitor().getLateCount();
+      motionUnderruns += rig.channel(i).getMotion().getUnderruns();
+      if (dshotOutputs[i] != nullptr) {
+        dshot = true;
+        dshotFrames += dshotOutputs[i]->getFramesSent();
+      }
+      if (dshotOutputs[i] != nullptr && dshotOutputs[i]->isBidirectional()) {
+        const DShotReplyStats& replies = dshotOutputs[i]->getReplyStats();
+        bidirectional = true;
+        dshotDecoded += replies.getDecoded();
+        dshotMissing += replies.getMissing();
+        dshotFraming += replies.getFramingErrors();
+        dshotGcr += replies.getGcrErrors();
+        dshotChecksum += replies.getChecksumErrors();
       }
-      
-      log("Ramp complete! Final speed: " + String(initialSpeed));
-    } else {
-      // If initial speed is 0, just set it directly
-      motor.setSpeed(initialSpeed);
-      currentSpeed = initialSpeed;
-      log("Initial speed is 0, no ramping needed");
     }
-
-
-  } else {
-    motor.setSpeed(0.0);
-    currentSpeed = 0.0;
-    log("Warning: No speeds defined in test!");
+    metricsWriteGauge(out, "rig_channels", "Motor channels on this controller", rig.channelCount());
+    metricsWriteGauge(out, "rig_sample_rate_hz", "Target sample rate per channel", rig.getSampleRateHz());
+    metricsWriteCounter(out, "rig_samples_total", "Samples taken this test, all channels", rigSamples);
+    metricsWriteCounter(out, "rig_missed_deadlines_total", "Sample deadlines skipped this test, all channels", rigMissed);
+    metricsWriteGauge(out, "rig_max_lateness_seconds", "Latest a sample was taken after its deadline this test", rigMaxLateness / 1e6);
+    metricsWriteCounter(out, "rig_timer_wakeups_total", "Sampling task wakeups from the deadline timer", samplePacer.getWakeups());
+    metricsWriteCounter(out, "hx711_readings_total", "HX711 conversions clocked out", hx711Readings);
+    metricsWriteCounter(out, "hx711_overflow_total", "HX711 readings lost to a full queue", hx711Overflow);
+    metricsWriteCounter(out, "ina260_readings_total", "INA260 conversions read", ina260Readings);
+    metricsWriteCounter(out, "ina260_errors_total", "INA260 bursts that failed on the bus", ina260Errors);
+    metricsWriteCounter(out, "ina260_late_bursts_total", "INA260 alert bursts overtaken by the next conversion", ina260Late);
+    metricsWriteCounter(out, "i2c_errors_total", "I2C transactions that failed", i2cBus.getErrorCount());
+    metricsWriteCounter(out, "motion_underruns_total", "Motion updates that waited for plan steps, all channels", motionUnderruns);
+    if (dshot) {
+      metricsWriteCounter(out, "dshot_frames_total", "DShot frames sent to the ESCs", dshotFrames);
+    }
+    if (bidirectional) {
+      metricsWriteCounter(out, "dshot_replies_total", "eRPM replies decoded", dshotDecoded);
+      metricsWriteCounter(out, "dshot_reply_missing_total", "Frames with no eRPM reply", dshotMissing);
+      metricsWriteCounter(out, "dshot_reply_framing_errors_total", "eRPM replies with the wrong bit count", dshotFraming);
+      metricsWriteCounter(out, "dshot_reply_gcr_errors_total", "eRPM replies with invalid GCR codes", dshotGcr);
+      metricsWriteCounter(out, "dshot_reply_checksum_errors_total", "eRPM replies failing the checksum", dshotChecksum);
+    }
+    request.more();
+    return;
   }
   
-  // Start data collection
-  lastSendTime = millis();
+  if (group == 2) {
+    metricsWriteGauge(out, "upload_rtt_seconds", "Round trip of the last successful upload", uploader.getLastRoundTripMs() / 1000.0);
+    metricsWriteGauge(out, "upload_pending_batches", "Batches waiting for or in upload", uploader.pending());
+    metricsWriteCounter(out, "upload_sent_total", "Batches uploaded", uploader.getSentBatches());
+    metricsWriteCounter(out, "upload_failed_total", "Batches dropped after retries", uploader.getFailedBatches());
+    metricsWriteCounter(out, "upload_retries_total", "Upload retries", uploader.getRetries());
+    metricsWriteCounter(out, "upload_spooled_total", "Batches stored to flash", uploader.getSpooledBatches());
+    metricsWriteCounter(out, "upload_replayed_total", "Spooled batches delivered", uploader.getReplayedBatches());
+    metricsWriteCounter(out, "upload_raw_bytes_total", "Upload body bytes before gzip", uploader.getRawBytes());
+    metricsWriteCounter(out, "upload_body_bytes_total", "Upload body bytes sent", uploader.getSentBytes());
+    metricsWriteGauge(out, "upload_gzip_level", "Gzip level of the last upload, 0 for none", uploader.getLastLevel());
+    metricsWriteGauge(out, "upload_uplink_bytes_per_second", "Measured uplink throughput", uploader.getUplinkBytesPerMs() * 1000.0);
+    request.more();
+    return;
+  }
   
-  log(String("Test ID: ") + currentTestId);
-  log(String("Number of speed steps: ") + testState.speeds.size());
-  log(String("Ramp delay (ms): ") + testState.rampDelay);
-
-  showText("Starting Test with " + String(testState.rampDelay / 100, 2) + "s per step", 1);
-  delay(1000);
+  metricsWriteGauge(out, "live_subscribers", "Connected /live clients", liveStream.getSubscriberCount());
+  metricsWriteCounter(out, "live_events_sent_total", "Live events sent", liveStream.getSentEvents());
+  metricsWriteCounter(out, "live_events_dropped_total", "Live intervals skipped for slow clients", liveStream.getDroppedEvents());
+  metricsWriteCounter(out, "display_frames_total", "OLED frames rendered", displayRenderer.getFrames());
+  metricsWriteCounter(out, "display_bytes_total", "Framebuffer bytes sent to the OLED", displayRenderer.getBytesSent());
+  metricsWriteCounter(out, "status_snapshots_total", "Status snapshots published", statusCell.getPublished());
+  metricsWriteCounter(out, "status_read_retries_total", "Status reads that overlapped a publish", statusCell.getRetries());
+  
+  metricsWriteCounter(out, "http_connections_total", "Connections accepted", httpServer.getConnections());
+  metricsWriteGauge(out, "http_open_connections", "Connections open", httpServer.getOpen());
+  metricsWriteCounter(out, "http_requests_total", "Request heads read", httpServer.getRequests());
+  metricsWriteCounter(out, "http_refused_total", "Requests answered by the server with an error", httpServer.getRefused());
+  metricsWriteCounter(out, "http_timeouts_total", "Connections closed for making no progress", httpServer.getTimeouts());
+  metricsWriteCounter(out, "http_evicted_total", "Idle keep-alive connections closed for a new client", httpServer.getEvicted());
+  metricsWriteCounter(out, "http_responses_truncated_total", "Response parts cut short by the output buffer", httpServer.getTruncated());
 }
-
-void updateMotorTest() {
-  if (!testRunning || testState.currentSpeedIndex >= testState.speeds.size()) {
+#endif
+
+// Load cell settings for one channel; every change is stored in NVS.
+// {"channel":0} plus any of: "tare":true (zero at the current load),
+// "point_grams":<g> (the current load is a known weight), "clear_points":true,
+// "filter":{"median":<odd 1-7>,"ema_shift":<0-8>,"kalman":<bool>,
+// "process_noise":<Q>,"measurement_noise":<R>}. Replies with the settings.
+void handleLoadCell(HttpRequest& request) {
+  requestArena.reset();
+  JsonDocument doc(&requestArena);
+  if (deserializeJson(doc, request.body(), request.bodyLength())) {
+    request.respond(400, "application/json", "{\"error\":\"Invalid JSON\"}");
     return;
   }
   
-  // Calculate time remaining in current stage (in seconds)
-  unsigned long elapsedTime = millis() - testState.speedStartTime;
-  int millisRemaining = max(0, (int)((testState.rampDelay - elapsedTime)));
+  int channel = doc["channel"] | 0;
+  if (channel < 0 || (size_t)channel >= rig.channelCount()) {
+    request.respond(400, "application/json", "{\"error\":\"Invalid channel\"}");
+    return;
+  }
+  if (testRunning) {
+    request.respond(409, "application/json", "{\"error\":\"Test running\"}");
+    return;
+  }
   
-  // Update display more frequently for smooth countdown
-  static unsigned long lastDisplayUpdate = 0;
-  static int lastSpeedIndex = -1;
+  LoadCellSettings settings = loadCellSettings[channel];
+  JsonObjectConst filter = doc["filter"];
+  if (!filter.isNull()) {
+    settings.filter.medianWindow = filter["median"] | settings.filter.medianWindow;
+    settings.filter.emaShift = filter["ema_shift"] | settings.filter.emaShift;
+    settings.filter.kalman = filter["kalman"] | settings.filter.kalman;
+    settings.filter.processNoise = filter["process_noise"] | settings.filter.processNoise;
+    settings.filter.measurementNoise = filter["measurement_noise"] | settings.filter.measurementNoise;
+    if (!settings.filter.valid()) {
+      request.respond(400, "application/json", "{\"error\":\"Invalid filter\"}");
+      return;
+    }
+  }
+  if (doc["clear_points"] | false) {
+    settings.calibration.clear();
+  }
   
-  // Update every 50ms or when speed changes
-  if (millis() - lastDisplayUpdate >= 10 || testState.currentSpeedIndex != lastSpeedIndex) {
-    if (testState.currentSpeedIndex < testState.speeds.size()) {
-      float speedValue = testState.speeds[testState.currentSpeedIndex];
-      showText("Speed: " + String(speedValue, 2), 2);
+  // Tare and points use the filtered reading the sampling task last published
+  bool tare = doc["tare"] | false;
+  bool point = doc["point_grams"].is<float>();
+  if (tare || point) {
+    ChannelStatus status = readStatus().channels[channel];
+    if (!status.loadCellReady) {
+      request.respond(409, "application/json", "{\"error\":\"Load cell not ready\"}");
+      return;
+    }
+    if (tare) {
+      settings.tare = status.loadCell;
+    }
+    float counts = status.loadCell - settings.tare;
+    float grams = doc["point_grams"] | 0.0f;
+    if (point && !settings.calibration.addPoint((int32_t)lroundf(counts), (int32_t)lroundf(grams * 1000.0f))) {
+      request.respond(400, "application/json", "{\"error\":\"Point rejected (at zero, repeated or too many)\"}");
+      return;
     }
-    lastDisplayUpdate = millis();
-    lastSpeedIndex = testState.currentSpeedIndex;
   }
   
-  // Check if it's time to move to the next speed
-  if (millis() - testState.speedStartTime >= testState.rampDelay) {
-    testState.currentSpeedIndex++;
-    testState.speedStartTime = millis();
-    
-    if (testState.currentSpeedIndex < testState.speeds.size()) {
-      // Set next speed
-      float speedValue = testState.speeds[testState.currentSpeedIndex];
-      
-      log(">>> CHANGING SPEED: Index " + String(testState.currentSpeedIndex) + " = " + String(speedValue));
-      
-      // Display will be updated at the top of the next loop iteration
-      motor.setSpeed(speedValue);
-      currentSpeed = speedValue;
-    } else {
-      // Test complete
-      log("Test completed: " + currentTestId);
-      showText("Test Complete", 1);
-      showText(" ", 2);
+  loadCellSettings[channel] = settings;
+  rig.channel(channel).configure(settings);
+  if (!loadCellStore.save(channel, settings)) {
+    log("Error: Could not store load cell settings");
+  }
+  logf("Channel %d load cell: tare %.1f, %u calibration points, median %u, EMA 1/%u, Kalman %s", channel,
+       settings.tare, (unsigned)settings.calibration.count(), (unsigned)settings.filter.medianWindow,
+       1u << settings.filter.emaShift, settings.filter.kalman ? "on" : "off");
+  
+  ServerResponseWriter out(request);
+  out.begin(200, "application/json");
+  out.format("{\"channel\":%d,\"tare\":%.1f,\"filter\":{\"median\":%u,\"ema_shift\":%u,\"kalman\":%s,"
+             "\"process_noise\":%lu,\"measurement_noise\":%lu},\"points\":[",
+             channel, settings.tare, (unsigned)settings.filter.medianWindow, (unsigned)settings.filter.emaShift,
+             settings.filter.kalman ? "true" : "false", (unsigned long)settings.filter.processNoise,
+             (unsigned long)settings.filter.measurementNoise);
+  for (size_t i = 0; i < settings.calibration.count(); i++) {
+    out.format("%s{\"counts\":%ld,\"grams\":%.3f}", i == 0 ? "" : ",", (long)settings.calibration[i].counts,
+               settings.calibration[i].milligrams / 1000.0f);
+  }
+  out.print("]}");
+}
 
-      motor.stop();
-      testRunning = false;
-      
-      // Send any remaining data
-      if (!sensorBuffer.empty()) {
-        sendBufferedData();
-      }
-      
-      currentTestId = "";
+// The body arrives in pieces of up to HTTP_INPUT_BYTES and each goes
+// straight to the plan parser, so a plan of any length is never held whole
+void handleMotorControlBody(HttpRequest& request, HttpBody event, const char* data, size_t length) {
+  switch (event) {
+  case HttpBody::Start:
+    // A full queue refuses the test anyway; don't spill a plan for it. The
+    // refusal stands even if a job finishes before the body is in.
+    queueFullAtStart = jobQueue.full();
+    if (!queueFullAtStart) {
+      planParser.begin(requestJob, rig.channelCount(), planStoreReady ? &planStore : nullptr, nextPlanId++);
     }
+    break;
+  case HttpBody::Data:
+    if (!queueFullAtStart) {
+      planParser.feed(data, length);
+    }
+    break;
+  case HttpBody::Aborted:
+    planParser.abort();
+    break;
   }
 }
 
-
-void runMotorTest(JsonDocument& config) {
-  startMotorTest(config);
+// Runs once handleMotorControlBody() has seen the whole body
+void handleMotorControl(HttpRequest& request) {
+  if (queueFullAtStart) {
+    queueFullAtStart = false;
+    request.respond(503, "application/json", "{\"error\":\"Job queue full\"}");
+    return;
+  }
   
-  // This is the old blocking version - shouldn't be used anymore
-  while (testRunning) {
-    updateMotorTest();
-    delay(1);
+  // Malformed JSON, missing fields, speeds outside 0-1, an unknown shape, a
+  // channel the rig does not have, a bad option or more steps than fit
+  const char* planError = planParser.finish();
+  if (planError != nullptr) {
+    logf("Error: motor control request refused: %s", planError);
+    char response[96];
+    snprintf(response, sizeof(response), "{\"error\":\"%s\"}", planError);
+    request.respond(planParser.isTooLarge() ? 413 : 400, "application/json", response);
+    return;
   }
+  logf("Received motor control request: %s, %lu steps in %lu bytes%s", requestJob.testId,
+       (unsigned long)requestJob.plan.stepCount, (unsigned long)planParser.getBytes(),
+       requestJob.plan.spilled() ? " (spilled to flash)" : "");
+  
+  uint32_t jobId = 0;
+  JobPushResult result = jobQueue.push(requestJob, jobId);
+  if (result != JobPushResult::Queued) {
+    releasePlan(requestJob.plan);
+  }
+  if (result == JobPushResult::Duplicate) {
+    request.respond(409, "application/json", "{\"error\":\"test_id already queued or running\"}");
+    return;
+  }
+  if (result == JobPushResult::Full) {
+    request.respond(503, "application/json", "{\"error\":\"Job queue full\"}");
+    return;
+  }
+  logf("Queued test %s as job %lu, priority %d", requestJob.testId, (unsigned long)jobId, requestJob.priority);
+  
+  // On an idle rig it starts right away (non-blocking)
+  startNextJob();
+  
+  char response[128];
+  size_t position = 0;
+  if (jobQueue.stateOf(jobId, &position) == JobState::Running) {
+    snprintf(response, sizeof(response), "{\"status\":\"Test started - ESC will be initialized\",\"job_id\":%lu}",
+             (unsigned long)jobId);
+    request.respond(200, "application/json", response);
+  } else {
+    snprintf(response, sizeof(response), "{\"status\":\"queued\",\"job_id\":%lu,\"position\":%u}",
+             (unsigned long)jobId, (unsigned)position);
+    request.respond(202, "application/json", response);
+  }
+}
 
-  showText(" ", 1);
-  showText(" ", 2);
-  showText(" ", 3);
-
-  float voltage = readINA260Voltage();
-  showText("Voltage: " + String(voltage, 2), 3);
+// A finished, cancelled or refused job's steps on flash are no longer needed
+void releasePlan(const TestPlan& plan) {
+  if (plan.spilled()) {
+    planStore.remove(plan.id);
+  }
 }
 
-void sendBufferedData() {
-  if (sensorBuffer.empty() || currentTestId.isEmpty()) {
-    log("sendBufferedData: Buffer is empty or no test ID");
+// The running test and the queue in run order, or one job's state with ?job_id=<id>
+void handleJobs(HttpRequest& request) {
+  char value[12];
+  if (request.arg("job_id", value, sizeof(value))) {
+    uint32_t id = strtoul(value, nullptr, 10);
+    size_t position = 0;
+    JobState state = jobQueue.stateOf(id, &position);
+    if (state == JobState::Unknown) {
+      request.respond(404, "application/json", "{\"error\":\"Unknown job\"}");
+      return;
+    }
+    char response[96];
+    if (state == JobState::Queued) {
+      snprintf(response, sizeof(response), "{\"job_id\":%lu,\"state\":\"queued\",\"position\":%u}",
+               (unsigned long)id, (unsigned)position);
+    } else {
+      snprintf(response, sizeof(response), "{\"job_id\":%lu,\"state\":\"%s\"}", (unsigned long)id,
+               jobStateName(state));
+    }
+    request.respond(200, "application/json", response);
     return;
   }
   
-  // Check if DATA_URL is empty using strlen for C-style string
-  if (strlen(DATA_URL) == 0) {
-    log("sendBufferedData: No data URL configured");
+  ServerResponseWriter out(request);
+  out.begin(200, "application/json");
+  out.print("{\"running\":");
+  if (currentJob != nullptr) {
+    out.format("{\"job_id\":%lu,\"test_id\":\"%s\",\"priority\":%d,\"keep_spinning\":%s,\"steps\":%lu}",
+               (unsigned long)currentJob->id, currentJob->testId, currentJob->priority,
+               currentJob->keepSpinning ? "true" : "false", (unsigned long)currentJob->plan.stepCount);
+  } else {
+    out.print("null");
+  }
+  out.print(",\"queued\":[");
+  for (size_t i = 0; i < jobQueue.size(); i++) {
+    const TestJob& job = jobQueue.at(i);
+    out.format("%s{\"job_id\":%lu,\"test_id\":\"%s\",\"priority\":%d,\"keep_spinning\":%s,\"steps\":%lu,"
+               "\"position\":%u}",
+               i == 0 ? "" : ",", (unsigned long)job.id, job.testId, job.priority,
+               job.keepSpinning ? "true" : "false", (unsigned long)job.plan.stepCount, (unsigned)i);
+  }
+  out.format("],\"capacity\":%u,\"completed\":%lu,\"cancelled\":%lu}", (unsigned)jobQueue.capacity(),
+             (unsigned long)jobQueue.getCompleted(), (unsigned long)jobQueue.getCancelled());
+}
+
+// {"job_id":<id>} or {"test_id":"..."}: drop a queued test, or stop the
+// running one (its data so far is still uploaded)
+void handleJobCancel(HttpRequest& request) {
+  requestArena.reset();
+  JsonDocument doc(&requestArena);
+  if (deserializeJson(doc, request.body(), request.bodyLength())) {
+    request.respond(400, "application/json", "{\"error\":\"Invalid JSON\"}");
     return;
   }
   
-  log("Sending " + String(sensorBuffer.size()) + " data points to server...");
-  showText("Sending buffer", 3);
-  
-  HTTPClient http;
-  String url = DATA_URL + currentTestId;
-  
-  http.begin(url);
-  http.addHeader("Content-Type", "application/json");
-  
-  // Create JSON document with array of sensor readings
-  DynamicJsonDocument doc(16384);  // Allocate 16KB for the document
-  JsonArray data = doc.createNestedArray("data");
-  
-  // Add all buffered readings to the JSON array
-  for (const auto& reading : sensorBuffer) {
-    JsonObject point = data.createNestedObject();
-    point["timestamp"] = reading.timestamp;
-    
-    JsonObject ina260 = point.createNestedObject("ina260");
-    ina260["voltage_v"] = reading.voltage;
-    ina260["current_ma"] = reading.current;
-    
-    JsonObject loadCell = point.createNestedObject("load_cell");
-    loadCell["raw_value"] = reading.load_cell;
-    loadCell["is_ready"] = b_loadCellReady;
-    
-    point["set_speed"] = reading.speed;
+  uint32_t id = doc["job_id"] | 0u;
+  if (id == 0 && doc["test_id"].is<const char*>()) {
+    id = jobQueue.findId(doc["test_id"].as<const char*>());
+  }
+  const TestJob* job = jobQueue.find(id);
+  uint32_t planId = job != nullptr ? job->plan.id : 0;
+  bool spilled = job != nullptr && job->plan.spilled();
+  bool wasRunning = false;
+  if (id == 0 || !jobQueue.cancel(id, wasRunning)) {
+    request.respond(404, "application/json", "{\"error\":\"No such queued or running job\"}");
+    return;
   }
   
-  // Serialize and send
-  String jsonString;
-  serializeJson(doc, jsonString);
-  
-  log("Sending HTTP POST request...");
-  int httpResponseCode = http.POST(jsonString);
-  
-  if (httpResponseCode > 0) {
-    String response = http.getString();
-    log("Success! Sent " + String(sensorBuffer.size()) + " samples. Response: " + String(httpResponseCode));
-    showText("Buffer send success", 3);
+  if (wasRunning) {
+    logf("Test cancelled: %s", currentTestId);
+    showText("Test Cancelled", 1);
+    showText(" ", 2);
+    finishMotorTest(JobState::Cancelled);
   } else {
-    log("Error sending data: " + String(httpResponseCode));
-    log("Error details: " + String(http.errorToString(httpResponseCode).c_str()));
-    showText("Buffer send error", 3);
+    logf("Cancelled queued job %lu", (unsigned long)id);
+    if (spilled) {
+      planStore.remove(planId);
+    }
   }
-  
-  log("Closing HTTP connection");
-  http.end();
+  char response[96];
+  snprintf(response, sizeof(response), "{\"status\":\"cancelled\",\"job_id\":%lu,\"was_running\":%s}",
+           (unsigned long)id, wasRunning ? "true" : "false");
+  request.respond(200, "application/json", response);
 }
 
-void resetHX711() {
-  // Send 25+ clock pulses to reset
-  for (int i = 0; i < 30; i++) {
-    digitalWrite(HX711_SCK_PIN, HIGH);
-    delayMicroseconds(10);
-    digitalWrite(HX711_SCK_PIN, LOW);
-    delayMicroseconds(10);
+// Start the next queued test if the rig is free
+void startNextJob() {
+  if (testRunning) {
+    return;
   }
+  const TestJob* job = jobQueue.startNext();
+  if (job == nullptr) {
+    return;
+  }
+  currentJob = job;
+  startMotorTest(*job, false);
 }
 
-long readHX711() {
-  // Wait for HX711 to be ready (DT goes low)
-  unsigned long timeout = millis() + 1000; // 1 second timeout
-  while (digitalRead(HX711_DT_PIN) == HIGH && millis() < timeout) {
-    delayMicroseconds(10);
+// With handover the previous test's motors are still spinning and the
+// sampling task still running; each channel carries on from its setpoint
+void startMotorTest(const TestJob& job, bool handover) {
+  log("\n=== Starting Motor Test ===");
+
+  if (!handover) {
+    // Initialize ESC first since battery may have been disconnected
+    log("Re-initializing ESC for new test...");
+    showText("Initializing ESC...", 1);
+    
+    log("ESC initialized successfully for test");
+    showText("ESC Ready", 1);
   }
-  
-  if (millis() >= timeout) {
-    return 0; // Timeout
+
+  // Reset the ring while the sampling task is idle. In a handover it is
+  // sampling; what it queued since the last test ended belongs to this one.
+  sampleRing.setPolicy(job.overflow);
+  if (!handover) {
+    sampleRing.clear();
   }
-  
-  // Read 24 bits
-  long value = 0;
-  for (int i = 0; i < 24; i++) {
-    digitalWrite(HX711_SCK_PIN, HIGH);
-    delayMicroseconds(1);
-    
-    value = (value << 1) | digitalRead(HX711_DT_PIN);
-    
-    digitalWrite(HX711_SCK_PIN, LOW);
-    delayMicroseconds(1);
+  sampleRing.resetCounters();
+
+  strlcpy(currentTestId, job.testId, sizeof(currentTestId));
+  testState.rampDelay = job.rampDelay;
+  testState.uploadFormat = job.format;
+  testState.summaryOnly = job.summaryOnly;
+  for (size_t i = 0; i < RIG_MAX_CHANNELS; i++) {
+    testState.active[i] = job.active[i];
+    testState.currentStep[i] = -1;
   }
   
-  // Send one more pulse to set gain to 128 for next reading
-  digitalWrite(HX711_SCK_PIN, HIGH);
-  delayMicroseconds(1);
-  digitalWrite(HX711_SCK_PIN, LOW);
-  delayMicroseconds(1);
-  
-  // Convert from 24-bit unsigned to signed
-  if (value & 0x800000) {
-    value |= 0xFF000000; // Sign extend for 32-bit signed
+  // Clear any old data
+  if (currentBatch != nullptr) {
+    currentBatch->count = 0;
+    currentBatch->summaryCount = 0;
+    uploader.submit(currentBatch);  // Empty, so it goes straight back to the pool
+    currentBatch = nullptr;
   }
   
-  return value;
+  // The ramps play from the motion timers; steps are measured once each one settles.
+  // The sampling task restarts the schedule when it sees testRunning; wake it now.
+  lastSendTime = millis();
+  testRunning = true;
+  if (!handover && samplingTaskHandle != nullptr) {
+    xTaskNotifyGive(samplingTaskHandle);
+  }
+  logf("Test ID: %s (job %lu)", currentTestId, (unsigned long)job.id);
+  size_t steps = 0;
+  for (size_t i = 0; i < rig.channelCount(); i++) {
+    if (!testState.active[i]) {
+      continue;
+    }
+    const PlanChannel& plan = job.plan.channels[i];
+    MotionEngine& motion = rig.channel(i).getMotion();
+    if (handover) {
+      logf("Channel %u: carrying on from speed %.2f", (unsigned)i, motion.getSetpoint());
+    }
+    // The engine reads the channel's steps through its reader as it plays them
+    planReaders[i].begin(job.plan, i, planStoreReady ? &planStore : nullptr);
+    if (!(handover ? motion.follow(planReaders[i]) : motion.start(planReaders[i]))) {
+      logf("Warning: No speeds defined for channel %u!", (unsigned)i);
+      testState.active[i] = false;
+    }
+    logf("Channel %u: %lu speed steps, profile length %llums", (unsigned)i, (unsigned long)plan.count,
+         (unsigned long long)plan.durationMs);
+    steps = plan.count > steps ? plan.count : steps;
+  }
+
+  if (testState.rampDelay > 0) {
+    showTextf(1, "Starting Test with %.2fs per step", testState.rampDelay / 1000.0f);
+  } else {
+    showTextf(1, "Starting %u step test", (unsigned)steps);
+  }
 }
 
-bool isLoadCellReady() {
-  bool ready = (digitalRead(HX711_DT_PIN) == LOW);
-  static unsigned long lastPrint = 0;
-  static int readyCount = 0;
-  static int notReadyCount = 0;
+void updateMotorTest() {
+  if (!testRunning) {
+    return;
+  }
   
-  // Update counters
-  if (ready) {
-    readyCount++;
-  } else {
-    notReadyCount++;
+  // Update the display at most every 50ms
+  static unsigned long lastDisplayUpdate = 0;
+  if (millis() - lastDisplayUpdate >= 50) {
+    for (size_t i = 0; i < rig.channelCount(); i++) {
+      if (testState.active[i]) {
+        showTextf(2, "Speed: %.2f", rig.channel(i).getMotion().getSetpoint());
+        break;
+      }
+    }
+    lastDisplayUpdate = millis();
   }
   
-  // Print stats every 2 seconds
-  unsigned long now = millis();
-  if (now - lastPrint > 2000) {
-    lastPrint = now;
-    float readyPercent = (readyCount * 100.0) / (readyCount + notReadyCount);
-    readyCount = 0;
-    notReadyCount = 0;
+  // The test ends when every channel has played its profile
+  bool done = true;
+  for (size_t i = 0; i < rig.channelCount(); i++) {
+    if (!testState.active[i]) {
+      continue;
+    }
+    MotionEngine& motion = rig.channel(i).getMotion();
+    motion.refill();
+    ProfilePoint point = motion.getPoint();
+    
+    // A step is the hold part of a segment, so its statistics only cover the
+    // settled speed; while holding, the setpoint is the step's target
+    int holdingStep = point.holding ? (int)point.segment : -1;
+    if (holdingStep != testState.currentStep[i]) {
+      finishStep(i);
+      if (holdingStep >= 0) {
+        float speedValue = point.setpoint;
+        logf(">>> CHANGING SPEED: Channel %u index %d = %.2f", (unsigned)i, holdingStep, speedValue);
+        stepStats[i].begin(holdingStep, speedValue, millis(), loadCellSettings[i].calibration, (uint8_t)i);
+      }
+      testState.currentStep[i] = holdingStep;
+    }
+    done = done && point.done;
   }
   
-  return ready;
+  if (done) {
+    // Test complete
+    logf("Test completed: %s", currentTestId);
+    showText("Test Complete", 1);
+    showText(" ", 2);
+    finishMotorTest(JobState::Done);
+  }
 }
 
-float readLoadCell() {
-  static bool lastReadyState = false;
-  static unsigned long lastReadyCheck = 0;
-  static unsigned long lastReadAttempt = 0;
-  
-  // Only try to read every 20ms to avoid overwhelming the HX711
-  if (millis() - lastReadAttempt < 20) {
-    // If we have a recent valid reading, return it
-    if (millis() - lastLoadCellUpdate < LOAD_CELL_TIMEOUT) {
-      return lastValidLoadCellValue;
+// End the running test: stop the motors unless the next queued test asked
+// for and can take a handover, send what is left and release the job
+void finishMotorTest(JobState how) {
+  for (size_t i = 0; i < rig.channelCount(); i++) {
+    if (testState.active[i]) {
+      finishStep(i);
     }
-    return 0.0f;
   }
-  lastReadAttempt = millis();
   
-  // Only check ready state every 100ms to avoid blocking
-  if (millis() - lastReadyCheck > 100) {
-    lastReadyState = isLoadCellReady();
-    lastReadyCheck = millis();
+  const TestJob* next = jobQueue.next();
+  bool handover = how == JobState::Done && currentJob != nullptr && currentJob->keepSpinning &&
+                  next != nullptr && currentJob->compatibleWith(*next);
+  if (!handover) {
+    for (size_t i = 0; i < rig.channelCount(); i++) {
+      rig.channel(i).getMotion().stop();
+    }
+    testRunning = false;
   }
   
-  // Try to read the HX711
-  long rawValue = readHX711();
+  // Send any remaining data
+  drainSampleRing();
+  sendBufferedData();
   
-  // If we got a valid reading (non-zero) or the sensor is ready
-  if (rawValue != 0) {
-    lastValidLoadCellValue = (float)rawValue;
-    lastLoadCellUpdate = millis();
-    b_loadCellReady = true;
-    
-    return lastValidLoadCellValue;
+  currentTestId[0] = '\0';
+  if (currentJob != nullptr) {
+    releasePlan(currentJob->plan);
   }
+  jobQueue.finishRunning(how);
+  currentJob = nullptr;
   
-  // If we get here, reading failed
-  b_loadCellReady = false;
-  
-  // If we have a recent valid reading, return it even if the current read failed
-  if (millis() - lastLoadCellUpdate < LOAD_CELL_TIMEOUT) {
-    return lastValidLoadCellValue;
+  if (handover) {
+    currentJob = jobQueue.startNext();
+    logf("Handing the motors over to %s", currentJob->testId);
+    startMotorTest(*currentJob, true);
+  }
+}
+
+
+// Close the channel's step in progress and attach its summary to the current batch
+void finishStep(size_t channel) {
+  // Samples still in the ring were taken before the speed change
+  drainSampleRing();
+  if (!stepStats[channel].active()) {
+    return;
   }
   
-  return 0.0f;
+  StepSummary summary = stepStats[channel].finish(millis());
+  logf("Channel %u step %u: %lu samples, thrust %.1fg (p95 %.1f), power %.2fW, %.2f g/W",
+       (unsigned)summary.channel, (unsigned)summary.step, (unsigned long)summary.samples, summary.thrust.mean,
+       summary.thrust.p95, summary.power.mean, summary.gramsPerWatt);
+  
+  if (currentBatch == nullptr || currentBatch->summaryCount >= UPLOAD_BATCH_SUMMARIES) {
+    log("Warning: no free batch, step summary not uploaded");
+    return;
+  }
+  currentBatch->summaries[currentBatch->summaryCount++] = summary;
 }
 
-float readINA260Voltage() {
-  if (!ina260Ready) {
-    return 0.0f;
+void runMotorTest(const char* body) {
+  planParser.begin(requestJob, rig.channelCount(), planStoreReady ? &planStore : nullptr, nextPlanId++);
+  planParser.feed(body, strlen(body));
+  const char* error = planParser.finish();
+  uint32_t jobId = 0;
+  if (error == nullptr && jobQueue.push(requestJob, jobId) != JobPushResult::Queued) {
+    releasePlan(requestJob.plan);
+    error = "Job queue full or test_id in use";
+  }
+  if (error != nullptr) {
+    logf("Error: %s", error);
+    return;
+  }
+  startNextJob();
+  
+  // This is the old blocking version - shouldn't be used anymore
+  while (testRunning) {
+    updateMotorTest();
+    delay(1);
   }
-  float voltage = ina260.readBusVoltage() / 1000.0; // Convert mV to V
-  return voltage;
+
+  showText(" ", 1);
+  showText(" ", 2);
+  showText(" ", 3);
+
+  showTextf(3, "Voltage: %.2f", readStatus().channels[0].voltage);
 }
 
-float readINA260Current() {
-  if (!ina260Ready) {
-    return 0.0f;
+void sendBufferedData() {
+  METRICS_TIME(sendBufferedHistogram);
+  if (currentBatch == nullptr || currentBatch->empty()) {
+    return;
+  }
+  
+  // Check if DATA_URL is empty using strlen for C-style string
+  if (strlen(DATA_URL) == 0) {
+    log("sendBufferedData: No data URL configured");
+    currentBatch->count = 0;
+    currentBatch->summaryCount = 0;
+    return;
   }
-  return ina260.readCurrent(); // Returns current in mA
+  
+  // Non-blocking: the uploader task posts it while we fill the next batch
+  logf("Queueing %u data points, %u step summaries for upload (%u batches pending)",
+       (unsigned)currentBatch->count, (unsigned)currentBatch->summaryCount, (unsigned)uploader.pending());
+  showText("Sending buffer", 3);
+  uploader.submit(currentBatch);
+  currentBatch = nullptr;
 }
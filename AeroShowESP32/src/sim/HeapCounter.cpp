@@ -0,0 +1,28 @@
+#include "HeapCounter.h"
+#include <stdlib.h>
+#include <atomic>
+#include <new>
+
+// Counted from any thread: the HTTP checks run the server on threads of its own
+static std::atomic<size_t> allocations{0};
+
+size_t heapAllocations() {
+    return allocations.load();
+}
+
+void* operator new(size_t size) {
+    allocations.fetch_add(1);
+    void* block = malloc(size > 0 ? size : 1);
+    if (block == nullptr) {
+        throw std::bad_alloc();
+    }
+    return block;
+}
+
+void operator delete(void* block) noexcept {
+    free(block);
+}
+
+void operator delete(void* block, size_t) noexcept {
+    free(block);
+}
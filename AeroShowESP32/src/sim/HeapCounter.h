@@ -0,0 +1,10 @@
+#ifndef HEAP_COUNTER_H
+#define HEAP_COUNTER_H
+
+#include <stddef.h>
+
+// Every operator new in a native build goes through HeapCounter.cpp, so the
+// sim and the unit tests can check that a path never reaches the heap
+size_t heapAllocations();
+
+#endif // HEAP_COUNTER_H
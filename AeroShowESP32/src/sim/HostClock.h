@@ -0,0 +1,23 @@
+#ifndef HOST_CLOCK_H
+#define HOST_CLOCK_H
+
+#include <chrono>
+#include <thread>
+#include "../Hal.h"
+
+// The host's monotonic clock, for code that waits on real sockets
+class HostClock : public Clock {
+public:
+    uint32_t millis() override { return (uint32_t)(micros64() / 1000); }
+    uint32_t micros() override { return (uint32_t)micros64(); }
+    uint64_t micros64() override {
+        return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+                   std::chrono::steady_clock::now() - start).count();
+    }
+    void delay(uint32_t ms) override { std::this_thread::sleep_for(std::chrono::milliseconds(ms)); }
+
+private:
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+};
+
+#endif // HOST_CLOCK_H
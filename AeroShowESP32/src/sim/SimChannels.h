@@ -0,0 +1,57 @@
+#ifndef SIM_CHANNELS_H
+#define SIM_CHANNELS_H
+
+#include "../ESCController.h"
+#include "../INA260Driver.h"
+#include "../MotionEngine.h"
+#include "../TestRig.h"
+#include "SimClock.h"
+#include "SimHX711.h"
+#include "SimINA260.h"
+#include "SimRig.h"
+#include "SimSharedBus.h"
+
+// A one-channel rig on simulated time, its INA260 alone on the bus
+struct Rig {
+    SimClock clock;
+    SimRig model;
+    SimINA260 bus{clock, model};
+    SimHX711 loadCell{clock, model};
+    INA260Driver ina260{bus};
+    PwmThrottleOutput throttle{model};
+    ESCController motor{throttle, clock};
+    MotionEngine motion{motor, clock};
+    RigChannel channel{0, motor, motion, loadCell, ina260};
+
+    bool begin() {
+        channel.setPowerReady(ina260.begin());
+        return channel.isPowerReady();
+    }
+
+    // What the rig does per channel sample on the device
+    SensorData sample() {
+        channel.refresh(clock.millis());
+        return channel.sample(clock.micros64());
+    }
+};
+
+// One motor channel of a multi-channel rig, its INA260 on the shared bus
+struct SimChannel {
+    SimRig model;
+    SimINA260 device;
+    SimHX711 loadCell;
+    INA260Driver ina260;
+    PwmThrottleOutput throttle{model};
+    ESCController motor;
+    MotionEngine motion;
+    RigChannel channel;
+
+    SimChannel(uint8_t index, SimClock& clock, SimSharedBus& bus)
+        : device(clock, model, (uint8_t)(INA260_DEFAULT_ADDRESS + index)), loadCell(clock, model),
+          ina260(bus, (uint8_t)(INA260_DEFAULT_ADDRESS + index)), motor(throttle, clock), motion(motor, clock),
+          channel(index, motor, motion, loadCell, ina260) {
+        bus.attach(device);
+    }
+};
+
+#endif // SIM_CHANNELS_H
@@ -0,0 +1,20 @@
+#ifndef SIM_CLOCK_H
+#define SIM_CLOCK_H
+
+#include "../Hal.h"
+
+// Simulated time that only moves when told to; delay() advances it instantly
+class SimClock : public Clock {
+public:
+    uint32_t millis() override { return (uint32_t)(nowMicros / 1000); }
+    uint32_t micros() override { return (uint32_t)nowMicros; }
+    uint64_t micros64() override { return nowMicros; }
+    void delay(uint32_t ms) override { advanceMicros((uint64_t)ms * 1000); }
+
+    void advanceMicros(uint64_t us) { nowMicros += us; }
+
+private:
+    uint64_t nowMicros = 0;
+};
+
+#endif // SIM_CLOCK_H
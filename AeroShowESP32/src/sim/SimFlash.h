@@ -0,0 +1,116 @@
+#ifndef SIM_FLASH_H
+#define SIM_FLASH_H
+
+#include <dirent.h>
+#include <stdio.h>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "../FlashFiles.h"
+
+// A flash filesystem kept in a directory on the host, with a power switch.
+// After cutPowerAfter(n) only the next n bytes written reach the files: the
+// append that crosses the limit is torn there, and from then on every
+// operation fails until powerOn(). Appended bytes land as they are
+// written, so a cut leaves the torn tails a record-by-record flush would
+// leave on the device, the worst case for recovery.
+class SimFlash : public FlashFiles {
+public:
+    explicit SimFlash(const std::string& root) : root(root) {}
+
+    void cutPowerAfter(size_t bytes) {
+        powerBudget = bytes;
+        budgeted = true;
+    }
+
+    void powerOn() {
+        powered = true;
+        budgeted = false;
+    }
+
+    bool isPowered() const { return powered; }
+    uint64_t getBytesWritten() const { return bytesWritten; }
+
+    bool makeDirectory(const char* path) override {
+        struct stat info;
+        std::string full = root + path;
+        return powered && (stat(full.c_str(), &info) == 0 || mkdir(full.c_str(), 0755) == 0);
+    }
+
+    bool list(const char* directory, const std::function<void(const char*)>& visit) override {
+        DIR* dir = powered ? opendir((root + directory).c_str()) : nullptr;
+        if (dir == nullptr) {
+            return false;
+        }
+        for (struct dirent* entry = readdir(dir); entry != nullptr; entry = readdir(dir)) {
+            if (entry->d_name[0] != '.') {
+                visit(entry->d_name);
+            }
+        }
+        closedir(dir);
+        return true;
+    }
+
+    bool size(const char* path, uint32_t& bytes) override {
+        struct stat info;
+        if (!powered || stat((root + path).c_str(), &info) != 0) {
+            return false;
+        }
+        bytes = (uint32_t)info.st_size;
+        return true;
+    }
+
+    size_t read(const char* path, uint32_t offset, uint8_t* buffer, size_t length) override {
+        FILE* file = powered ? fopen((root + path).c_str(), "rb") : nullptr;
+        if (file == nullptr) {
+            return 0;
+        }
+        size_t n = fseek(file, offset, SEEK_SET) == 0 ? fread(buffer, 1, length, file) : 0;
+        fclose(file);
+        return n;
+    }
+
+    size_t append(const char* path, const uint8_t* data, size_t length) override {
+        FILE* file = powered ? fopen((root + path).c_str(), "ab") : nullptr;
+        if (file == nullptr) {
+            return 0;
+        }
+        size_t allowed = length;
+        if (budgeted && allowed >= powerBudget) {
+            allowed = powerBudget;
+            powered = false;
+        }
+        size_t n = fwrite(data, 1, allowed, file);
+        fclose(file);
+        powerBudget -= budgeted && powered ? n : 0;
+        bytesWritten += n;
+        return n;
+    }
+
+    bool commit() override { return powered; }
+
+    bool rename(const char* from, const char* to) override {
+        return spend() && ::rename((root + from).c_str(), (root + to).c_str()) == 0;
+    }
+
+    bool remove(const char* path) override {
+        return spend() && unlink((root + path).c_str()) == 0;
+    }
+
+private:
+    // Metadata changes are all or nothing, and need power left to happen
+    bool spend() {
+        if (powered && budgeted && powerBudget == 0) {
+            powered = false;
+        }
+        return powered;
+    }
+
+    std::string root;
+    bool powered = true;
+    bool budgeted = false;
+    size_t powerBudget = 0;
+    uint64_t bytesWritten = 0;
+};
+
+#endif // SIM_FLASH_H
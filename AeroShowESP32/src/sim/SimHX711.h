@@ -0,0 +1,55 @@
+#ifndef SIM_HX711_H
+#define SIM_HX711_H
+
+#include "../HX711Decode.h"
+#include "SimClock.h"
+#include "SimRig.h"
+
+// HX711 at its 80 SPS rate. Each conversion is shifted out as DT levels
+// and decoded with the same helpers the interrupt handler uses.
+class SimHX711 : public LoadCellInput {
+public:
+    static const uint32_t CONVERSION_MICROS = 12500;
+    static const uint32_t QUEUE_LENGTH = 16;  // HX711Reader's default; older conversions are lost
+
+    SimHX711(SimClock& clock, SimRig& rig, float countsPerGram = 420.0f, int32_t offset = 8000)
+        : clock(clock), rig(rig), countsPerGram(countsPerGram), offset(offset) {}
+
+    // Same contract as HX711Reader::read(): one conversion per call, oldest first
+    bool read(HX711Reading& reading) override {
+        uint32_t now = clock.micros();
+        uint32_t behind = now - lastConversionMicros;
+        if (behind < CONVERSION_MICROS) {
+            return false;
+        }
+        if (behind >= QUEUE_LENGTH * CONVERSION_MICROS) {
+            lastConversionMicros = now - behind % CONVERSION_MICROS - (QUEUE_LENGTH - 1) * CONVERSION_MICROS;
+        } else {
+            lastConversionMicros += CONVERSION_MICROS;
+        }
+
+        int32_t code = offset + (int32_t)(rig.thrustGrams() * countsPerGram);
+        if (code > HX711_MAX_CODE) {
+            code = HX711_MAX_CODE;
+        } else if (code < HX711_MIN_CODE) {
+            code = HX711_MIN_CODE;
+        }
+
+        uint8_t levels[HX711_DATA_BITS];
+        for (int i = 0; i < HX711_DATA_BITS; i++) {
+            levels[i] = ((uint32_t)code >> (HX711_DATA_BITS - 1 - i)) & 1;
+        }
+        reading.value = hx711DecodeBits(levels);
+        reading.timestampMicros = lastConversionMicros;
+        return true;
+    }
+
+private:
+    SimClock& clock;
+    SimRig& rig;
+    float countsPerGram;
+    int32_t offset;
+    uint32_t lastConversionMicros = 0;
+};
+
+#endif // SIM_HX711_H
@@ -0,0 +1,156 @@
+#ifndef SIM_HTTP_API_H
+#define SIM_HTTP_API_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include "../HttpServer.h"
+#include "../PlanParser.h"
+#include "../StatusSnapshot.h"
+#include "HostClock.h"
+#include "SimPlans.h"
+
+// The control API on loopback: the server task and loop()'s dispatch each
+// on a thread of their own, as on the device, with handlers standing in for
+// the firmware's. Handlers are plain functions, so one instance is current
+// at a time; it holds a plan spill, so give it static storage.
+struct SimHttpApi {
+    static const uint32_t SERVE_WAIT_MS = 50;  // HTTP_TASK_WAIT_MS
+
+    HostClock clock;
+    HttpServer server{clock};
+    SnapshotCell<StatusSnapshot> status;
+    ArraySpill planSpill;
+    PlanParser planParser;
+    TestJob planJob;
+    std::atomic<uint32_t> aborted{0};  // Streamed bodies cut short
+
+    // Register the routes and listen on port, 0 for any
+    bool begin(uint16_t port) {
+        current() = this;
+        server.on("/status", HttpMethod::Get, handleStatus);
+        server.on("/parts", HttpMethod::Get, handleParts);
+        server.on("/echo", HttpMethod::Get, handleEchoArg);
+        server.on("/echo", HttpMethod::Post, handleEchoBody);
+        server.on("/plan", HttpMethod::Post, handlePlan, handlePlanBody);
+        server.on("/stream", HttpMethod::Get, handleDetach);
+        if (!server.begin(port)) {
+            return false;
+        }
+        stop = false;
+        serveThread = std::thread([this]() {
+            while (!stop.load()) {
+                server.serve(SERVE_WAIT_MS);
+            }
+        });
+        // loop() dispatches once per iteration and then sleeps for a tick
+        coreThread = std::thread([this]() {
+            while (!stop.load()) {
+                server.dispatch();
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        });
+        return true;
+    }
+
+    void end() {
+        stop = true;
+        serveThread.join();
+        coreThread.join();
+        server.end();
+    }
+
+private:
+    static SimHttpApi*& current() {
+        static SimHttpApi* api = nullptr;
+        return api;
+    }
+
+    static void handleStatus(HttpRequest& request) {
+        StatusSnapshot status;
+        current()->status.read(status);
+        request.begin(200, "application/json");
+        request.format("{\"timestamp_ms\":%lu,\"samples\":{\"taken\":%lu,\"queued\":%lu},\"channels\":[",
+                       (unsigned long)status.timestampMs, (unsigned long)status.samplesTaken,
+                       (unsigned long)status.samplesQueued);
+        for (size_t i = 0; i < status.channelCount; i++) {
+            const ChannelStatus& channel = status.channels[i];
+            request.format("%s{\"channel\":%u,\"voltage_v\":%.3f,\"current_ma\":%.2f,\"load_cell\":%.1f}",
+                           i == 0 ? "" : ",", (unsigned)i, channel.voltage, channel.current, channel.loadCell);
+        }
+        request.print("]}");
+    }
+
+    // ?count=<n> parts of one line each
+    static void handleParts(HttpRequest& request) {
+        char value[8];
+        uint32_t count = request.arg("count", value, sizeof(value)) ? (uint32_t)atoi(value) : 1;
+        if (request.part() == 0) {
+            request.begin(200, "text/plain");
+        }
+        request.format("part %u\n", (unsigned)request.part());
+        if (request.part() + 1 < count) {
+            request.more();
+        }
+    }
+
+    static void handleEchoArg(HttpRequest& request) {
+        char value[32];
+        if (!request.arg("text", value, sizeof(value))) {
+            request.respond(400, "text/plain", "no text");
+            return;
+        }
+        request.respond(200, "text/plain", value);
+    }
+
+    static void handleEchoBody(HttpRequest& request) {
+        request.begin(200, "text/plain");
+        request.write(request.body(), request.bodyLength());
+    }
+
+    static void handlePlanBody(HttpRequest&, HttpBody event, const char* data, size_t length) {
+        SimHttpApi& api = *current();
+        switch (event) {
+        case HttpBody::Start:
+            api.planParser.begin(api.planJob, 2, &api.planSpill, 9);
+            break;
+        case HttpBody::Data:
+            api.planParser.feed(data, length);
+            break;
+        case HttpBody::Aborted:
+            api.planParser.abort();
+            api.aborted.fetch_add(1);
+            break;
+        }
+    }
+
+    static void handlePlan(HttpRequest& request) {
+        SimHttpApi& api = *current();
+        const char* error = api.planParser.finish();
+        char response[96];
+        if (error != nullptr) {
+            snprintf(response, sizeof(response), "{\"error\":\"%s\"}", error);
+            request.respond(400, "application/json", response);
+            return;
+        }
+        snprintf(response, sizeof(response), "{\"steps\":%lu}", (unsigned long)api.planJob.plan.stepCount);
+        request.respond(200, "application/json", response);
+    }
+
+    // As /live: the socket is taken over and written to directly
+    static void handleDetach(HttpRequest& request) {
+        int fd = request.detach();
+        send(fd, "detached\n", 9, MSG_NOSIGNAL);
+        close(fd);
+    }
+
+    std::atomic<bool> stop{false};
+    std::thread serveThread;
+    std::thread coreThread;
+};
+
+#endif // SIM_HTTP_API_H
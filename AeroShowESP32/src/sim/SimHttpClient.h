@@ -0,0 +1,164 @@
+#ifndef SIM_HTTP_CLIENT_H
+#define SIM_HTTP_CLIENT_H
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+// Blocking HTTP/1.1 client with fixed buffers, so the load test can hold the
+// whole process to no heap use
+struct HttpClient {
+    int fd = -1;
+    char input[8192];
+    size_t used = 0;
+    int status = 0;
+    bool closing = false;  // The response said Connection: close
+    char body[16384];
+    size_t bodyLength = 0;
+
+    bool open(uint16_t port) {
+        close();
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd < 0) {
+            return false;
+        }
+        struct timeval timeout = {3, 0};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        int yes = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+        struct sockaddr_in address;
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_port = htons(port);
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (connect(fd, (struct sockaddr*)&address, sizeof(address)) != 0) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close() {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        fd = -1;
+        used = 0;
+    }
+
+    bool sendAll(const char* data, size_t length) {
+        while (length > 0) {
+            ssize_t n = send(fd, data, length, MSG_NOSIGNAL);
+            if (n <= 0) {
+                return false;
+            }
+            data += n;
+            length -= (size_t)n;
+        }
+        return true;
+    }
+
+    bool sendHead(const char* method, const char* target, size_t contentLength) {
+        char head[256];
+        int n = snprintf(head, sizeof(head), "%s %s HTTP/1.1\r\nHost: sim\r\nContent-Length: %u\r\n\r\n", method,
+                         target, (unsigned)contentLength);
+        return sendAll(head, (size_t)n);
+    }
+
+    // False once the server closes, fails or stalls
+    bool fill() {
+        if (used == sizeof(input)) {
+            return false;
+        }
+        ssize_t n = recv(fd, input + used, sizeof(input) - used, 0);
+        if (n <= 0) {
+            return false;
+        }
+        used += (size_t)n;
+        return true;
+    }
+
+    // Bytes up to and including marker, reading as needed; 0 if it never comes
+    size_t find(const char* marker) {
+        size_t length = strlen(marker);
+        for (;;) {
+            for (size_t i = 0; i + length <= used; i++) {
+                if (memcmp(input + i, marker, length) == 0) {
+                    return i + length;
+                }
+            }
+            if (!fill()) {
+                return 0;
+            }
+        }
+    }
+
+    void consume(size_t n) {
+        memmove(input, input + n, used - n);
+        used -= n;
+    }
+
+    bool readBody(size_t length) {
+        while (used < length) {
+            if (!fill()) {
+                return false;
+            }
+        }
+        if (bodyLength + length >= sizeof(body)) {
+            return false;
+        }
+        memcpy(body + bodyLength, input, length);
+        bodyLength += length;
+        body[bodyLength] = '\0';
+        consume(length);
+        return true;
+    }
+
+    bool readResponse() {
+        bodyLength = 0;
+        body[0] = '\0';
+        size_t headEnd = find("\r\n\r\n");
+        if (headEnd == 0) {
+            return false;
+        }
+        input[headEnd - 1] = '\0';
+        status = 0;
+        sscanf(input, "HTTP/1.1 %d", &status);
+        bool chunked = strstr(input, "Transfer-Encoding: chunked") != nullptr;
+        closing = strstr(input, "Connection: close") != nullptr;
+        const char* length = strstr(input, "Content-Length: ");
+        size_t contentLength = length != nullptr ? strtoul(length + 16, nullptr, 10) : 0;
+        consume(headEnd);
+        if (!chunked) {
+            return readBody(contentLength);
+        }
+        for (;;) {
+            size_t lineEnd = find("\r\n");
+            if (lineEnd == 0) {
+                return false;
+            }
+            size_t size = strtoul(input, nullptr, 16);
+            consume(lineEnd);
+            if (size == 0) {
+                return find("\r\n") == 2 && (consume(2), true);
+            }
+            if (!readBody(size) || find("\r\n") != 2) {
+                return false;
+            }
+            consume(2);
+        }
+    }
+
+    bool exchange(const char* method, const char* target, const char* data = nullptr, size_t length = 0) {
+        return sendHead(method, target, length) && sendAll(data, length) && readResponse();
+    }
+};
+
+#endif // SIM_HTTP_CLIENT_H
@@ -0,0 +1,98 @@
+#ifndef SIM_INA260_H
+#define SIM_INA260_H
+
+#include "../I2CBus.h"
+#include "../INA260Decode.h"
+#include "SimClock.h"
+#include "SimRig.h"
+
+// Register-level INA260 on a fake I2C bus. Conversions complete on the
+// period the configuration register asks for, in simulated time, and the
+// data registers are filled from the rig model.
+class SimINA260 : public I2CBus {
+public:
+    SimINA260(SimClock& clock, SimRig& rig, uint8_t address = INA260_DEFAULT_ADDRESS)
+        : clock(clock), rig(rig), address(address) {}
+
+    bool writeRegister16(uint8_t address, uint8_t reg, uint16_t value) override {
+        transactions++;
+        if (address != this->address) {
+            return false;
+        }
+        if (reg == INA260_REG_CONFIG) {
+            config = value & ~INA260_CONFIG_RESET;
+            lastConversionMicros = clock.micros();
+        } else if (reg == INA260_REG_MASK_ENABLE) {
+            maskEnable = value;
+        }
+        return true;
+    }
+
+    bool readRegisters16(uint8_t address, const uint8_t* regs, uint16_t* values, size_t count) override {
+        if (address != this->address) {
+            transactions++;
+            return false;
+        }
+        convert();
+        for (size_t i = 0; i < count; i++) {
+            transactions++;
+            values[i] = readRegister(regs[i]);
+        }
+        return true;
+    }
+
+    // Register reads and writes seen, one per pointer/data pair
+    uint32_t getTransactions() const { return transactions; }
+    uint8_t getAddress() const { return address; }
+
+private:
+    uint16_t readRegister(uint8_t reg) {
+        switch (reg) {
+            case INA260_REG_CONFIG: return config;
+            case INA260_REG_CURRENT: return current;
+            case INA260_REG_BUS_VOLTAGE: return busVoltage;
+            case INA260_REG_POWER: return power;
+            case INA260_REG_MASK_ENABLE: {
+                // Reading Mask/Enable clears the conversion-ready flag
+                uint16_t value = maskEnable | (ready ? INA260_MASK_CONVERSION_READY_FLAG : 0);
+                ready = false;
+                return value;
+            }
+            case INA260_REG_MANUFACTURER_ID: return INA260_MANUFACTURER_ID;
+            case INA260_REG_DIE_ID: return INA260_DIE_ID;
+            default: return 0;
+        }
+    }
+
+    // Latch a new conversion if a period has passed
+    void convert() {
+        uint32_t period = ina260ConversionPeriodMicros((INA260Averaging)((config >> 9) & 0x07),
+                                                       (INA260ConversionTime)((config >> 6) & 0x07),
+                                                       (INA260ConversionTime)((config >> 3) & 0x07));
+        if (clock.micros() - lastConversionMicros < period) {
+            return;
+        }
+        lastConversionMicros = clock.micros();
+
+        float milliamps = rig.currentMilliamps();
+        float volts = rig.voltage();
+        current = (uint16_t)(int16_t)(milliamps / INA260_CURRENT_LSB_MA);
+        busVoltage = (uint16_t)(volts / INA260_VOLTAGE_LSB_V);
+        power = (uint16_t)(volts * milliamps / INA260_POWER_LSB_MW);
+        ready = true;
+    }
+
+    SimClock& clock;
+    SimRig& rig;
+    uint8_t address;
+    uint16_t config = 0x6127;  // Power-on default
+    uint16_t maskEnable = 0;
+    uint16_t current = 0;
+    uint16_t busVoltage = 0;
+    uint16_t power = 0;
+    bool ready = false;
+    uint32_t lastConversionMicros = 0;
+    uint32_t transactions = 0;
+};
+
+#endif // SIM_INA260_H
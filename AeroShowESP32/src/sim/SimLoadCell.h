@@ -0,0 +1,26 @@
+#ifndef SIM_LOAD_CELL_H
+#define SIM_LOAD_CELL_H
+
+#include <vector>
+#include "../HX711Decode.h"
+
+// Synthetic HX711 trace in counts: idle, a thrust step and a partial
+// release, with +/-30 counts of noise. With spikes it also carries the
+// glitches a marginal DT line produces: a flipped high bit and clamp codes.
+inline std::vector<int32_t> loadCellTrace(bool spikes) {
+    static const size_t SPIKES[] = {37, 120, 180, 251, 330};
+    std::vector<int32_t> trace(400);
+    uint32_t rng = 12345;
+    for (size_t i = 0; i < trace.size(); i++) {
+        rng = rng * 1664525u + 1013904223u;
+        int32_t noise = (int32_t)((rng >> 16) % 61) - 30;
+        trace[i] = 8000 + (i >= 100 ? 42000 : 0) - (i >= 250 ? 21000 : 0) + noise;
+    }
+    for (size_t k = 0; spikes && k < sizeof(SPIKES) / sizeof(SPIKES[0]); k++) {
+        size_t i = SPIKES[k];
+        trace[i] = k % 2 == 0 ? (trace[i] ^ 0x400000) : (k == 1 ? HX711_MAX_CODE : HX711_MIN_CODE);
+    }
+    return trace;
+}
+
+#endif // SIM_LOAD_CELL_H
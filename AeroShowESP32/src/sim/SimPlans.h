@@ -0,0 +1,73 @@
+#ifndef SIM_PLANS_H
+#define SIM_PLANS_H
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include "../PlanParser.h"
+
+// Stands in for the plan files on flash: one plan at a time in a fixed array
+struct ArraySpill : PlanSpill {
+    PlanStep steps[PLAN_MAX_STEPS];
+    size_t count = 0;
+    uint32_t id = 0;
+    bool exists = false;
+    size_t reads = 0;
+
+    bool create(uint32_t planId) override {
+        id = planId;
+        count = 0;
+        exists = true;
+        return true;
+    }
+    bool append(const PlanStep* in, size_t n) override {
+        if (count + n > PLAN_MAX_STEPS) {
+            return false;
+        }
+        memcpy(steps + count, in, n * sizeof(PlanStep));
+        count += n;
+        return true;
+    }
+    bool close() override { return true; }
+    size_t read(uint32_t planId, uint32_t index, PlanStep* out, size_t n) override {
+        if (!exists || planId != id || index >= count) {
+            return 0;
+        }
+        n = std::min(n, count - index);
+        memcpy(out, steps + index, n * sizeof(PlanStep));
+        reads++;
+        return n;
+    }
+    void remove(uint32_t planId) override {
+        if (planId == id) {
+            exists = false;
+        }
+    }
+};
+
+// Target of segment i of a planBody(), as the client sends it
+inline float planBodyTarget(size_t i) {
+    return (float)((i * 37) % 1000) / 999.0f;
+}
+
+// A plan of count segments as a client would send it, targets sweeping up
+// and down with four decimals
+inline std::string planBody(size_t count, bool segments) {
+    std::string body = segments ? "{\"test_id\":\"bench\",\"segments\":[" : "{\"test_id\":\"bench\",\"speeds\":[";
+    char item[96];
+    for (size_t i = 0; i < count; i++) {
+        float target = planBodyTarget(i);
+        if (segments) {
+            snprintf(item, sizeof(item), "%s{\"speed\":%.4f,\"ramp_ms\":%u,\"hold_ms\":%u,\"shape\":\"s_curve\"}",
+                     i == 0 ? "" : ",", target, (unsigned)(5 + i % 3), (unsigned)(5 + i % 5));
+        } else {
+            snprintf(item, sizeof(item), "%s%.4f", i == 0 ? "" : ",", target);
+        }
+        body += item;
+    }
+    body += segments ? "]}" : "],\"ramp_delay\":5,\"ramp_ms\":5,\"ramp_shape\":\"linear\"}";
+    return body;
+}
+
+#endif // SIM_PLANS_H
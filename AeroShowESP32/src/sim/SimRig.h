@@ -0,0 +1,54 @@
+#ifndef SIM_RIG_H
+#define SIM_RIG_H
+
+#include <stdint.h>
+#include "../Hal.h"
+
+// Deterministic model of the thrust stand: a motor and prop on a 4S pack,
+// driven by the pulse width written to the simulated ESC. Noise comes from
+// a fixed-seed xorshift generator, so every run produces the same samples.
+class SimRig : public PwmOutput {
+public:
+    explicit SimRig(uint32_t seed = 0x2545F491) : rngState(seed) {}
+
+    // PwmOutput: the ESC input
+    bool attach(int minPulseUs, int maxPulseUs) override {
+        minPulse = minPulseUs;
+        maxPulse = maxPulseUs;
+        return maxPulse > minPulse;
+    }
+    void writeMicroseconds(int pulseUs) override { pulse = pulseUs; }
+
+    float throttle() const {
+        float t = (float)(pulse - minPulse) / (float)(maxPulse - minPulse);
+        return t < 0.0f ? 0.0f : (t > 1.0f ? 1.0f : t);
+    }
+
+    // Thrust in grams: roughly quadratic in throttle
+    float thrustGrams() { return 1800.0f * throttle() * throttle() + noise(2.0f); }
+
+    // Current in mA: roughly cubic in throttle
+    float currentMilliamps() {
+        float t = throttle();
+        return 150.0f + 30000.0f * t * t * t + noise(40.0f);
+    }
+
+    // Pack voltage in V with internal resistance sag
+    float voltage() { return 16.8f - currentMilliamps() * 0.000012f + noise(0.005f); }
+
+    // Uniform noise in [-amplitude, amplitude]
+    float noise(float amplitude) {
+        rngState ^= rngState << 13;
+        rngState ^= rngState >> 17;
+        rngState ^= rngState << 5;
+        return amplitude * ((rngState & 0xFFFF) / 32767.5f - 1.0f);
+    }
+
+private:
+    int minPulse = 1000;
+    int maxPulse = 2000;
+    int pulse = 1000;
+    uint32_t rngState;
+};
+
+#endif // SIM_RIG_H
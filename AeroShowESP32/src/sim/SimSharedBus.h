@@ -0,0 +1,69 @@
+#ifndef SIM_SHARED_BUS_H
+#define SIM_SHARED_BUS_H
+
+#include <stddef.h>
+#include "../I2CBus.h"
+#include "SimClock.h"
+#include "SimINA260.h"
+
+// Several INA260s on one I2C bus, as on a multi-channel rig. Every
+// pointer/data pair holds the bus for as long as its bits take at clockHz,
+// in simulated time, so channels compete for it the way they do on the
+// device.
+class SimSharedBus : public I2CBus {
+public:
+    static const size_t MAX_DEVICES = 8;
+
+    SimSharedBus(SimClock& clock, uint32_t clockHz)
+        : clock(clock), readMicros(i2cBitsMicros(I2C_REGISTER_READ_BITS, clockHz)),
+          writeMicros(i2cBitsMicros(I2C_REGISTER_WRITE_BITS, clockHz)) {}
+
+    bool attach(SimINA260& device) {
+        if (count >= MAX_DEVICES) {
+            return false;
+        }
+        devices[count++] = &device;
+        return true;
+    }
+
+    bool writeRegister16(uint8_t address, uint8_t reg, uint16_t value) override {
+        hold(writeMicros);
+        SimINA260* device = find(address);
+        return device != nullptr && device->writeRegister16(address, reg, value);
+    }
+
+    bool readRegisters16(uint8_t address, const uint8_t* regs, uint16_t* values, size_t n) override {
+        hold((uint64_t)readMicros * n);
+        SimINA260* device = find(address);
+        return device != nullptr && device->readRegisters16(address, regs, values, n);
+    }
+
+    uint32_t getReadMicros() const { return readMicros; }
+
+    // Simulated time the bus has been busy
+    uint64_t getBusyMicros() const { return busyMicros; }
+
+private:
+    void hold(uint64_t micros) {
+        clock.advanceMicros(micros);
+        busyMicros += micros;
+    }
+
+    SimINA260* find(uint8_t address) {
+        for (size_t i = 0; i < count; i++) {
+            if (devices[i]->getAddress() == address) {
+                return devices[i];
+            }
+        }
+        return nullptr;
+    }
+
+    SimClock& clock;
+    uint32_t readMicros;
+    uint32_t writeMicros;
+    SimINA260* devices[MAX_DEVICES];
+    size_t count = 0;
+    uint64_t busyMicros = 0;
+};
+
+#endif // SIM_SHARED_BUS_H
@@ -0,0 +1,46 @@
+#ifndef SIM_UPLOADS_H
+#define SIM_UPLOADS_H
+
+#include <string.h>
+#include <vector>
+#include "../GzipEncoder.h"
+#include "../SensorData.h"
+#include "../TelemetryFrame.h"
+#include "../UploadJson.h"
+
+// Collects a compressed stream, or the body it stands for
+struct ByteVector : ByteSink {
+    std::vector<uint8_t> bytes;
+    bool put(const uint8_t* data, size_t length) override {
+        bytes.insert(bytes.end(), data, data + length);
+        return true;
+    }
+};
+
+// Upload bodies for a simulated test, batchSamples at a time, as
+// BatchUploader writes them (JSON without step summaries)
+inline std::vector<std::vector<uint8_t>> uploadBodies(const std::vector<SensorData>& samples, bool binary,
+                                                      size_t batchSamples) {
+    std::vector<std::vector<uint8_t>> bodies;
+    char line[UPLOAD_JSON_LINE_SIZE];
+    for (size_t i = 0; i < samples.size(); i += batchSamples) {
+        size_t n = i + batchSamples < samples.size() ? batchSamples : samples.size() - i;
+        std::vector<uint8_t> body;
+        if (binary) {
+            telemetryEncodeBatch("sim", &samples[i], n, TELEMETRY_FLAG_LOAD_CELL_READY, body);
+        } else {
+            const char* open = "{\"dropped\":0,\"overwritten\":0,\"data\":[";
+            body.assign(open, open + strlen(open));
+            for (size_t j = 0; j < n; j++) {
+                size_t length = formatJsonSample(line, sizeof(line), samples[i + j], true, j == 0);
+                body.insert(body.end(), line, line + length);
+            }
+            body.push_back(']');
+            body.push_back('}');
+        }
+        bodies.push_back(body);
+    }
+    return bodies;
+}
+
+#endif // SIM_UPLOADS_H
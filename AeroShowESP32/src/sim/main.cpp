@@ -0,0 +1,499 @@
+// Native entry point (pio run -e native): runs a stepped motor test through
+// the motion engine against the simulated rig and reports what the host
+// can measure but not judge: time per sample for the acquisition,
+// buffering and serialization stages, the load cell filter's cost per
+// conversion, gzip ratio and time per upload batch at each level, plan
+// parse throughput against plan length, sampling jitter with status
+// readers hammering the snapshot, and HTTP throughput and latency with 1 to
+// 16 clients alongside a 1 kHz sampling thread. Pass/fail checks live in
+// test/ and run with pio test -e native; this exits non-zero only when the
+// simulated rig or the loopback server cannot be set up.
+
+#ifndef PIO_UNIT_TESTING
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../GzipEncoder.h"
+#include "../LoadCellCalibration.h"
+#include "../LoadCellFilter.h"
+#include "../MotionProfile.h"
+#include "../PlanParser.h"
+#include "../SampleRing.h"
+#include "../SensorData.h"
+#include "../StatusSnapshot.h"
+#include "../StepStats.h"
+#include "../TelemetryFrame.h"
+#include "HeapCounter.h"
+#include "SimChannels.h"
+#include "SimHttpApi.h"
+#include "SimHttpClient.h"
+#include "SimLoadCell.h"
+#include "SimPlans.h"
+#include "SimUploads.h"
+
+static const float SPEEDS[] = {0.2f, 0.4f, 0.6f, 0.8f};
+static const uint32_t STEP_MS = 2000;
+static const uint32_t FIRST_RAMP_MS = 1000;
+static const uint32_t STEP_RAMP_MS = 200;
+static const uint32_t MOTION_UPDATE_EVERY = 5;  // Samples per engine update: 200 Hz at 1 kHz sampling
+static const uint32_t SAMPLE_PERIOD_US = 1000;
+static const size_t BATCH_SAMPLES = 256;  // UPLOAD_BATCH_CAPACITY
+static const int32_t COUNTS_PER_10G = 4200;  // SimHX711's 420 counts per gram
+static const size_t FILTER_BENCH_CONVERSIONS = 1000000;
+static const size_t JITTER_SAMPLES = 100000;
+static const uint32_t HTTP_LOAD_MS = 2000;  // Idle baseline
+static const size_t HTTP_LOAD_REQUESTS = 2400;  // Per run, shared between its clients
+static const size_t HTTP_LOAD_STEPS = 50;
+static const size_t HTTP_MAX_LOAD_CLIENTS = 16;
+static const size_t HTTP_LATENCIES = 100000;
+
+typedef std::chrono::steady_clock WallClock;
+
+// Timed results land here so the work behind them is not optimised away
+static volatile float sink;
+
+static double nanosSince(WallClock::time_point start) {
+    return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(WallClock::now() - start).count();
+}
+
+// Simulated test: the stepped profile /motor/control builds, played through
+// the motion engine with steps measured over each hold. Returns the samples.
+static std::vector<SensorData> runTest(Rig& rig) {
+    std::vector<SensorData> samples;
+    StepAggregator stats;
+
+    MotionProfile profile;
+    profile.clear();
+    for (size_t step = 0; step < sizeof(SPEEDS) / sizeof(SPEEDS[0]); step++) {
+        ProfileSegment segment;
+        segment.target = SPEEDS[step];
+        segment.rampMs = step == 0 ? FIRST_RAMP_MS : STEP_RAMP_MS;
+        segment.holdMs = STEP_MS;
+        segment.shape = step == 0 ? RampShape::Linear : RampShape::SCurve;
+        profile.add(segment);
+    }
+
+    rig.motor.initialize();
+    LoadCellSettings settings;
+    settings.calibration.addPoint(COUNTS_PER_10G, 10000);
+    rig.channel.configure(settings);
+    rig.clock.advanceMicros(200000);
+    rig.channel.refresh(rig.clock.millis());
+    settings.tare = rig.channel.getLoadCell();
+    rig.channel.configure(settings);
+    rig.motion.begin();
+    rig.motion.start(profile);
+
+    printf("step  speed  samples  thrust_g  p95_g    power_w  g_per_w\n");
+    int currentStep = -1;
+    for (uint32_t i = 1;; i++) {
+        rig.clock.advanceMicros(SAMPLE_PERIOD_US);
+        if (i % MOTION_UPDATE_EVERY == 0) {
+            rig.motion.update();
+        }
+
+        ProfilePoint point = rig.motion.getPoint();
+        int holdingStep = point.holding ? (int)point.segment : -1;
+        if (holdingStep != currentStep) {
+            if (stats.active()) {
+                StepSummary summary = stats.finish(rig.clock.millis());
+                printf("%4u  %5.2f  %7u  %8.1f  %7.1f  %7.2f  %7.2f\n", (unsigned)summary.step, summary.speed,
+                       (unsigned)summary.samples, summary.thrust.mean, summary.thrust.p95, summary.power.mean,
+                       summary.gramsPerWatt);
+            }
+            if (holdingStep >= 0) {
+                stats.begin((uint16_t)holdingStep, profile[holdingStep].target, rig.clock.millis(),
+                            settings.calibration);
+            }
+            currentStep = holdingStep;
+        }
+        if (point.done) {
+            break;
+        }
+
+        SensorData reading = rig.sample();
+        stats.add(reading);
+        samples.push_back(reading);
+    }
+    rig.motion.stop();
+    return samples;
+}
+
+static SampleRing<SensorData, 256> ring;  // SAMPLE_RING_CAPACITY
+
+// Acquisition (driver and decode work per sample, in simulated time),
+// buffering (ring push and pop in batch-sized bursts) and serialization
+// (binary frames of BATCH_SAMPLES samples), per sample
+static void benchStages(Rig& timed, const std::vector<SensorData>& samples) {
+    const size_t count = samples.size();
+    float total = 0.0f;
+    WallClock::time_point start = WallClock::now();
+    for (size_t i = 0; i < count; i++) {
+        timed.clock.advanceMicros(SAMPLE_PERIOD_US);
+        total += timed.sample().voltage;
+    }
+    double acquireNs = nanosSince(start) / count;
+
+    start = WallClock::now();
+    SensorData popped;
+    for (size_t i = 0; i < count; i += BATCH_SAMPLES) {
+        size_t end = i + BATCH_SAMPLES < count ? i + BATCH_SAMPLES : count;
+        for (size_t j = i; j < end; j += ring.capacity()) {
+            size_t burst = end - j < ring.capacity() ? end - j : ring.capacity();
+            for (size_t k = 0; k < burst; k++) {
+                ring.push(samples[j + k]);
+            }
+            while (ring.pop(popped)) {
+                total += popped.current;
+            }
+        }
+    }
+    double bufferNs = nanosSince(start) / count;
+
+    std::vector<uint8_t> frame;
+    size_t frameBytes = 0;
+    start = WallClock::now();
+    for (size_t i = 0; i < count; i += BATCH_SAMPLES) {
+        size_t n = i + BATCH_SAMPLES < count ? BATCH_SAMPLES : count - i;
+        frameBytes += telemetryEncodeBatch("sim", &samples[i], n, TELEMETRY_FLAG_LOAD_CELL_READY, frame);
+    }
+    double encodeNs = nanosSince(start) / count;
+    sink = total;
+
+    printf("stage          ns/sample  samples/s\n");
+    printf("acquisition    %9.1f  %9.0f\n", acquireNs, 1e9 / acquireNs);
+    printf("buffering      %9.1f  %9.0f\n", bufferNs, 1e9 / bufferNs);
+    printf("serialization  %9.1f  %9.0f  (%.2f bytes/sample)\n", encodeNs, 1e9 / encodeNs,
+           (double)frameBytes / count);
+}
+
+// Cost per conversion of the full filter chain, and of calibration to grams
+static void benchLoadCell() {
+    std::vector<int32_t> clean = loadCellTrace(false);
+    std::vector<int32_t> spiky = loadCellTrace(true);
+    LoadCellFilterConfig config;
+    config.medianWindow = 5;
+    config.emaShift = 3;
+    config.kalman = true;
+    config.processNoise = 50;
+    config.measurementNoise = 300;
+    LoadCellCalibration calibration;
+    calibration.addPoint(42000, 100000);
+    calibration.addPoint(4200, 10000);
+    calibration.addPoint(84000, 205000);
+
+    LoadCellFilter filter;
+    filter.configure(config);
+    float total = 0.0f;
+    WallClock::time_point start = WallClock::now();
+    for (size_t i = 0; i < FILTER_BENCH_CONVERSIONS; i++) {
+        filter.add(spiky[i % spiky.size()]);
+        total += (float)filter.valueFixed();
+    }
+    double filterNs = nanosSince(start) / FILTER_BENCH_CONVERSIONS;
+    start = WallClock::now();
+    for (size_t i = 0; i < FILTER_BENCH_CONVERSIONS; i++) {
+        total += calibration.toGrams((float)clean[i % clean.size()]);
+    }
+    double calibrateNs = nanosSince(start) / FILTER_BENCH_CONVERSIONS;
+    sink = total;
+    printf("\nload cell  %.1f ns/conversion (median 5, EMA, Kalman), %.1f ns to grams\n", filterNs, calibrateNs);
+}
+
+// Every body at every level: ratio, host time per batch and encoder RAM.
+// The ratios feed the seeds in UploadCompression.h and test_compression_picker.
+static GzipEncoder benchEncoder;
+
+static void benchCompression(const char* name, const std::vector<std::vector<uint8_t>>& bodies) {
+    size_t raw = 0;
+    for (size_t i = 0; i < bodies.size(); i++) {
+        raw += bodies[i].size();
+    }
+    printf("%-11s  %5u  %11.0f  %5.2f  %13.1f  %9s\n", name, 0u, (double)raw / bodies.size(), 1.0, 0.0, "-");
+
+    // The sink reuses its capacity so only the encoder is measured
+    ByteVector compressed;
+    compressed.bytes.reserve(raw);
+    for (uint8_t level = 1; level <= GZIP_MAX_LEVEL; level++) {
+        size_t sent = 0;
+        WallClock::time_point start = WallClock::now();
+        for (size_t i = 0; i < bodies.size(); i++) {
+            compressed.bytes.clear();
+            benchEncoder.begin(compressed, level);
+            benchEncoder.write(bodies[i].data(), bodies[i].size());
+            benchEncoder.finish();
+            sent += compressed.bytes.size();
+        }
+        double micros = nanosSince(start) / 1000.0;
+        printf("%-11s  %5u  %11.0f  %5.2f  %13.1f  %9u\n", name, (unsigned)level, (double)sent / bodies.size(),
+               (double)raw / sent, micros / bodies.size(), (unsigned)sizeof(GzipEncoder));
+    }
+}
+
+static SimHttpApi api;
+
+// Parse throughput and memory against plan length, fed in the pieces the
+// server reads; RAM is the parser and the job whatever the length, the
+// steps past RAM go to the spill
+static void benchPlans() {
+    printf("\nplan        steps  body_bytes  host_MB/s  host_ns/step  ram_bytes  flash_bytes\n");
+    static const size_t SIZES[] = {100, 1000, 10000, 50000};
+    for (int segments = 0; segments < 2; segments++) {
+        for (size_t i = 0; i < sizeof(SIZES) / sizeof(SIZES[0]); i++) {
+            std::string body = planBody(SIZES[i], segments != 0);
+            size_t runs = std::max<size_t>(1, 4000000 / body.size());
+            WallClock::time_point start = WallClock::now();
+            for (size_t run = 0; run < runs; run++) {
+                api.planParser.begin(api.planJob, 2, &api.planSpill, 7);
+                for (size_t at = 0; at < body.size(); at += HTTP_INPUT_BYTES) {
+                    api.planParser.feed(body.data() + at, std::min<size_t>(HTTP_INPUT_BYTES, body.size() - at));
+                }
+                api.planParser.finish();
+            }
+            double ns = nanosSince(start) / runs;
+            printf("%-9s  %6u  %10u  %9.1f  %12.1f  %9u  %11u\n", segments ? "segments" : "speeds",
+                   (unsigned)SIZES[i], (unsigned)body.size(), body.size() * 1000.0 / ns, ns / SIZES[i],
+                   (unsigned)(sizeof(PlanParser) + sizeof(TestJob)),
+                   (unsigned)(api.planJob.plan.spilled() ? api.planSpill.count * sizeof(PlanStep) : 0));
+        }
+    }
+}
+
+struct Jitter {
+    double p50Ns;
+    double p99Ns;
+};
+
+// The sampling loop with a status publish on every sample (the device
+// publishes every 100th), timed per iteration
+static Jitter timeSampling(Rig& rig, std::vector<double>& durations) {
+    StatusSnapshot status;
+    SensorData popped;
+    for (size_t i = 0; i < durations.size(); i++) {
+        WallClock::time_point start = WallClock::now();
+        rig.clock.advanceMicros(SAMPLE_PERIOD_US);
+        SensorData reading = rig.sample();
+        ring.push(reading);
+        status.timestampMs = (uint32_t)(reading.timestamp_us / 1000);
+        status.channelCount = 1;
+        status.channels[0].voltage = reading.voltage;
+        status.channels[0].current = reading.current;
+        status.channels[0].loadCell = reading.load_cell;
+        status.samplesTaken++;
+        status.samplesQueued = (uint32_t)ring.size();
+        api.status.publish(status);
+        ring.pop(popped);
+        durations[i] = nanosSince(start);
+    }
+    std::sort(durations.begin(), durations.end());
+    Jitter jitter;
+    jitter.p50Ns = durations[durations.size() / 2];
+    jitter.p99Ns = durations[durations.size() * 99 / 100];
+    return jitter;
+}
+
+// Sampling jitter alone, then with a reader thread polling the snapshot
+// as fast as it can, standing in for a browser hammering /status
+static void benchStatusReaders(Rig& rig) {
+    std::vector<double> durations(JITTER_SAMPLES);
+    Jitter quiet = timeSampling(rig, durations);
+
+    std::atomic<bool> stop{false};
+    std::atomic<uint32_t> reads{0};
+    std::thread reader([&stop, &reads]() {
+        StatusSnapshot snapshot;
+        while (!stop.load(std::memory_order_relaxed)) {
+            if (api.status.read(snapshot)) {
+                reads.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+    });
+    Jitter hammered = timeSampling(rig, durations);
+    stop = true;
+    reader.join();
+
+    printf("\nsampling with status reads  p50_ns  p99_ns\n");
+    printf("no readers                 %6.0f  %6.0f\n", quiet.p50Ns, quiet.p99Ns);
+    printf("1 reader, %9u reads  %6.0f  %6.0f  (%u reads retried)\n", (unsigned)reads.load(), hammered.p50Ns,
+           hammered.p99Ns, (unsigned)api.status.getRetries());
+}
+
+static HttpClient httpClients[HTTP_MAX_LOAD_CLIENTS];
+
+struct LoadResult {
+    size_t requests;
+    size_t errors;
+    size_t reconnects;
+};
+
+// Keep-alive client alternating GET /status and a plan POST until it has
+// made count requests, reconnecting when its idle connection was closed
+// for another client
+static void loadClient(HttpClient& client, uint16_t port, const std::string& plan, const std::atomic<bool>& go,
+                       size_t count, double* latencies, LoadResult& result) {
+    while (!go.load()) {
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+    while (result.requests < count && result.errors < count) {
+        if (client.fd < 0 && !client.open(port)) {
+            result.errors++;
+            continue;
+        }
+        bool post = result.requests % 2 == 1;
+        WallClock::time_point start = WallClock::now();
+        if (!client.exchange(post ? "POST" : "GET", post ? "/plan" : "/status", post ? plan.data() : nullptr,
+                             post ? plan.size() : 0)) {
+            client.close();
+            result.reconnects++;
+            continue;
+        }
+        latencies[result.requests % HTTP_LATENCIES] = nanosSince(start) / 1e6;
+        result.requests++;
+        if (client.status != 200) {
+            result.errors++;
+        }
+        if (client.closing) {
+            client.close();
+        }
+    }
+    client.close();
+}
+
+// The sampling task's wakeups at 1 kHz: periods between them in
+// microseconds, sorted, with a status publish per sample
+static size_t paceSampling(Rig& rig, const std::atomic<bool>& stop, std::vector<double>& periods) {
+    StatusSnapshot status;
+    size_t count = 0;
+    WallClock::time_point deadline = WallClock::now();
+    WallClock::time_point last = deadline;
+    while (!stop.load() && count < periods.size()) {
+        deadline += std::chrono::microseconds(SAMPLE_PERIOD_US);
+        std::this_thread::sleep_until(deadline);
+        WallClock::time_point now = WallClock::now();
+        periods[count++] = std::chrono::duration_cast<std::chrono::nanoseconds>(now - last).count() / 1000.0;
+        last = now;
+        rig.clock.advanceMicros(SAMPLE_PERIOD_US);
+        SensorData reading = rig.sample();
+        status.timestampMs = (uint32_t)(reading.timestamp_us / 1000);
+        status.channelCount = 1;
+        status.channels[0].voltage = reading.voltage;
+        status.channels[0].current = reading.current;
+        status.channels[0].loadCell = reading.load_cell;
+        status.samplesTaken++;
+        api.status.publish(status);
+    }
+    std::sort(periods.begin(), periods.begin() + count);
+    return count;
+}
+
+// Throughput and latency with 1, 4 and 16 clients on HTTP_MAX_CONNECTIONS
+// connection slots, each run making HTTP_LOAD_REQUESTS requests, and the
+// sampling period meanwhile against an idle server. test_http_server checks
+// the same runs on the server's counters.
+static void benchHttpServer(Rig& rig, uint16_t port) {
+    static const size_t CLIENTS[] = {0, 1, 4, 16};
+    std::string plan = planBody(HTTP_LOAD_STEPS, false);
+    std::vector<double> periods(HTTP_LOAD_MS * 4);
+    std::vector<double> latencies(HTTP_MAX_LOAD_CLIENTS * HTTP_LATENCIES);
+
+    printf("\nhttp load  requests   req/s  p50_ms  p99_ms  evicted  reconnects  errors  sample_p50_us  "
+           "sample_p99_us\n");
+    for (size_t run = 0; run < sizeof(CLIENTS) / sizeof(CLIENTS[0]); run++) {
+        size_t clients = CLIENTS[run];
+        size_t perClient = clients > 0 ? HTTP_LOAD_REQUESTS / clients : 0;
+        std::atomic<bool> go{false};
+        std::atomic<bool> stop{false};
+        LoadResult results[HTTP_MAX_LOAD_CLIENTS] = {};
+        std::vector<std::thread> threads;
+        threads.reserve(clients);
+        for (size_t i = 0; i < clients; i++) {
+            threads.emplace_back(loadClient, std::ref(httpClients[i]), port, std::cref(plan), std::cref(go), perClient,
+                                 &latencies[i * HTTP_LATENCIES], std::ref(results[i]));
+        }
+        size_t sampled = 0;
+        std::thread sampler([&rig, &stop, &periods, &sampled, &go]() {
+            while (!go.load()) {
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+            }
+            sampled = paceSampling(rig, stop, periods);
+        });
+
+        uint32_t evicted = api.server.getEvicted();
+        go = true;
+        WallClock::time_point start = WallClock::now();
+        if (clients == 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(HTTP_LOAD_MS));
+        }
+        for (size_t i = 0; i < clients; i++) {
+            threads[i].join();
+        }
+        double elapsedMs = nanosSince(start) / 1e6;
+        stop = true;
+        sampler.join();
+        evicted = api.server.getEvicted() - evicted;
+
+        LoadResult total = {};
+        std::vector<double> all;
+        for (size_t i = 0; i < clients; i++) {
+            total.requests += results[i].requests;
+            total.errors += results[i].errors;
+            total.reconnects += results[i].reconnects;
+            size_t kept = std::min(results[i].requests, HTTP_LATENCIES);
+            all.insert(all.end(), latencies.begin() + i * HTTP_LATENCIES, latencies.begin() + i * HTTP_LATENCIES + kept);
+        }
+        std::sort(all.begin(), all.end());
+        double p50 = all.empty() ? 0.0 : all[all.size() / 2];
+        double p99 = all.empty() ? 0.0 : all[all.size() * 99 / 100];
+        char label[16];
+        snprintf(label, sizeof(label), clients == 0 ? "idle" : "%u client%s", (unsigned)clients, clients == 1 ? "" : "s");
+        printf("%-10s %8u  %6.0f  %6.2f  %6.2f  %7u  %10u  %6u  %13.1f  %13.1f\n", label, (unsigned)total.requests,
+               clients > 0 ? total.requests * 1000.0 / elapsedMs : 0.0, p50, p99, (unsigned)evicted,
+               (unsigned)total.reconnects, (unsigned)total.errors, sampled > 0 ? periods[sampled / 2] : 0.0,
+               sampled > 0 ? periods[sampled * 99 / 100] : 0.0);
+    }
+    printf("\n%u connections, %u requests, %u refused, %u timeouts, %u truncated\n",
+           (unsigned)api.server.getConnections(), (unsigned)api.server.getRequests(), (unsigned)api.server.getRefused(),
+           (unsigned)api.server.getTimeouts(), (unsigned)api.server.getTruncated());
+}
+
+int main() {
+    Rig rig;
+    if (!rig.begin()) {
+        printf("Simulated INA260 did not respond\n");
+        return 1;
+    }
+    std::vector<SensorData> samples = runTest(rig);
+    printf("\n%u samples, %u INA260 bus transactions\n\n", (unsigned)samples.size(),
+           (unsigned)rig.bus.getTransactions());
+
+    Rig timed;
+    timed.begin();
+    timed.motor.initialize();
+    timed.motor.setSpeed(0.5f);
+    benchStages(timed, samples);
+    benchLoadCell();
+
+    printf("\ncompression  level  bytes/batch  ratio  host_us/batch  ram_bytes\n");
+    benchCompression("json", uploadBodies(samples, false, BATCH_SAMPLES));
+    benchCompression("binary", uploadBodies(samples, true, BATCH_SAMPLES));
+
+    benchPlans();
+    benchStatusReaders(timed);
+
+    if (!api.begin(0)) {
+        printf("Could not listen on loopback\n");
+        return 1;
+    }
+    benchHttpServer(timed, api.server.getPort());
+    api.end();
+    return 0;
+}
+
+#endif // PIO_UNIT_TESTING
@@ -0,0 +1,244 @@
+// Chunked upload bodies: framing that decodes back to the body written, a
+// refusing socket stopping the body, and batches of any size streamed as
+// JSON or binary frames, gzipped or not, through fixed buffers with no heap
+// use
+
+#include <unity.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "../../src/ChunkEncoder.h"
+#include "../../src/GzipEncoder.h"
+#include "../../src/SensorData.h"
+#include "../../src/TelemetryFrame.h"
+#include "../../src/UploadJson.h"
+#include "../../src/sim/HeapCounter.h"
+
+static const size_t BATCH_SIZES[] = {100, 1000, 10000, 100000};
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// Keeps everything, accepting at most limit bytes
+struct StoringSink : ByteSink {
+    std::vector<uint8_t> bytes;
+    size_t limit = SIZE_MAX;
+    bool put(const uint8_t* data, size_t length) override {
+        if (bytes.size() + length > limit) {
+            return false;
+        }
+        bytes.insert(bytes.end(), data, data + length);
+        return true;
+    }
+};
+
+// Counts what would go to the socket, keeping only the tail
+struct CountingSink : ByteSink {
+    size_t count = 0;
+    uint8_t tail[5] = {0};
+    bool put(const uint8_t* data, size_t length) override {
+        for (size_t i = 0; i < length; i++) {
+            memmove(tail, tail + 1, sizeof(tail) - 1);
+            tail[sizeof(tail) - 1] = data[i];
+        }
+        count += length;
+        return true;
+    }
+};
+
+// Gzip output handed on into the chunked body
+struct ChunkSink : ByteSink {
+    ChunkEncoder* chunks = nullptr;
+    bool put(const uint8_t* data, size_t length) override { return chunks->write(data, length) == length; }
+};
+
+// Undo the chunked encoding, checking every chunk but the last is a full
+// scratch buffer and the body ends with the zero-length chunk
+static bool dechunk(const std::vector<uint8_t>& encoded, std::vector<uint8_t>& body) {
+    size_t at = 0;
+    body.clear();
+    for (;;) {
+        char* end;
+        std::string header(encoded.begin() + at, encoded.end());
+        unsigned long size = strtoul(header.c_str(), &end, 16);
+        size_t headerLength = end - header.c_str();
+        if (headerLength == 0 || header.compare(headerLength, 2, "\r\n") != 0) {
+            return false;
+        }
+        at += headerLength + 2;
+        if (size == 0) {
+            return at + 2 == encoded.size() && encoded[at] == '\r' && encoded[at + 1] == '\n';
+        }
+        if (at + size + 2 > encoded.size() || encoded[at + size] != '\r' || encoded[at + size + 1] != '\n') {
+            return false;
+        }
+        body.insert(body.end(), encoded.begin() + at, encoded.begin() + at + size);
+        at += size + 2;
+        bool last = encoded.size() - at == 5;
+        if (!last && size != CHUNK_SCRATCH_SIZE) {
+            return false;
+        }
+    }
+}
+
+static void test_body_round_trip(void) {
+    std::vector<uint8_t> body(5 * CHUNK_SCRATCH_SIZE + 123);
+    for (size_t i = 0; i < body.size(); i++) {
+        body[i] = (uint8_t)(i * 7 + i / 300);
+    }
+
+    // Pieces smaller, equal to and larger than the scratch buffer
+    static const size_t PIECES[] = {1, 7, CHUNK_SCRATCH_SIZE, 3 * CHUNK_SCRATCH_SIZE / 2, 0, 1000};
+    StoringSink sink;
+    ChunkEncoder encoder;
+    encoder.begin(&sink);
+    size_t at = 0;
+    for (size_t i = 0; at < body.size(); i = (i + 1) % 6) {
+        size_t n = PIECES[i] < body.size() - at ? PIECES[i] : body.size() - at;
+        TEST_ASSERT_EQUAL_UINT32(n, encoder.write(body.data() + at, n));
+        at += n;
+    }
+    TEST_ASSERT_TRUE(encoder.finish());
+    TEST_ASSERT_FALSE(encoder.hasError());
+    TEST_ASSERT_EQUAL_UINT32(body.size(), encoder.getBodyBytes());
+
+    std::vector<uint8_t> decoded;
+    TEST_ASSERT_TRUE(dechunk(sink.bytes, decoded));
+    TEST_ASSERT_TRUE(decoded == body);
+
+    // The same encoder starts over for the next body
+    sink.bytes.clear();
+    encoder.begin(&sink);
+    TEST_ASSERT_TRUE(encoder.finish());
+    TEST_ASSERT_EQUAL_UINT32(0, encoder.getBodyBytes());
+    TEST_ASSERT_EQUAL_MEMORY("0\r\n\r\n", sink.bytes.data(), 5);
+    TEST_ASSERT_EQUAL_UINT32(5, sink.bytes.size());
+}
+
+static void test_refused_bytes_stop_the_body(void) {
+    uint8_t data[3 * CHUNK_SCRATCH_SIZE] = {0};
+    StoringSink sink;
+    sink.limit = CHUNK_SCRATCH_SIZE + 10;
+    ChunkEncoder encoder;
+    encoder.begin(&sink);
+    TEST_ASSERT_EQUAL_UINT32(CHUNK_SCRATCH_SIZE, encoder.write(data, CHUNK_SCRATCH_SIZE));
+    TEST_ASSERT_FALSE(encoder.hasError());
+
+    // The second chunk does not fit: what went into it is reported short
+    TEST_ASSERT_EQUAL_UINT32(CHUNK_SCRATCH_SIZE, encoder.write(data, sizeof(data)));
+    TEST_ASSERT_TRUE(encoder.hasError());
+    TEST_ASSERT_EQUAL_UINT32(0, encoder.write(data, 1));
+    TEST_ASSERT_FALSE(encoder.finish());
+    TEST_ASSERT_EQUAL_UINT32(CHUNK_SCRATCH_SIZE, encoder.getBodyBytes());
+
+    encoder.begin(nullptr);
+    TEST_ASSERT_TRUE(encoder.hasError());
+    TEST_ASSERT_EQUAL_UINT32(0, encoder.write(data, 1));
+    TEST_ASSERT_FALSE(encoder.finish());
+}
+
+static SensorData sampleAt(size_t i) {
+    SensorData sample;
+    sample.timestamp_us = 1000000 + i * 1000;
+    sample.channel = (uint8_t)(i % RIG_MAX_CHANNELS);
+    sample.load_cell = 42000.0f + (float)(i % 97);
+    sample.voltage = 16.8f - (float)(i % 13) * 0.001f;
+    sample.current = 1500.0f + (float)(i % 29);
+    sample.speed = 0.5f;
+    sample.rpm = 12000.0f + (float)(i % 31);
+    sample.rpm_timestamp = (uint32_t)(sample.timestamp_us / 1000);
+    return sample;
+}
+
+// BatchUploader::writeJson() and writeBinary() for a batch of count samples
+static void writeBody(ByteSink& out, size_t count, bool binary) {
+    if (binary) {
+        TelemetryEncoder encoder;
+        uint8_t scratch[TELEMETRY_MAX_HEADER_BYTES];
+        SensorData first = sampleAt(0);
+        out.put(scratch, encoder.encodeHeader(scratch, "heap", first.timestamp_us, (uint32_t)count,
+                                              TELEMETRY_FLAG_LOAD_CELL_READY));
+        for (size_t i = 0; i < count; i++) {
+            out.put(scratch, encoder.encodeSample(scratch, sampleAt(i)));
+        }
+        return;
+    }
+    char line[UPLOAD_JSON_LINE_SIZE];
+    const char* open = "{\"dropped\":0,\"overwritten\":0,\"data\":[";
+    out.put((const uint8_t*)open, strlen(open));
+    for (size_t i = 0; i < count; i++) {
+        size_t n = formatJsonSample(line, sizeof(line), sampleAt(i), true, i == 0);
+        out.put((const uint8_t*)line, n);
+    }
+    out.put((const uint8_t*)"]}", 2);
+}
+
+// Body bytes into the chunk encoder directly or through gzip
+struct BodySink : ByteSink {
+    ChunkEncoder* chunks = nullptr;
+    GzipEncoder* gzip = nullptr;
+    bool put(const uint8_t* data, size_t length) override {
+        return gzip != nullptr ? gzip->write(data, length) : chunks->write(data, length) == length;
+    }
+};
+
+static GzipEncoder gzip;
+static ChunkEncoder chunks;
+
+// Streamed from the samples into the socket, a batch of any size takes the
+// same fixed buffers: the chunk scratch, plus the encoder state when gzipped
+static void test_batches_without_heap(void) {
+    char line[160];
+    snprintf(line, sizeof(line), "RAM per body: %u bytes chunked, %u more gzipped",
+             (unsigned)sizeof(ChunkEncoder), (unsigned)sizeof(GzipEncoder));
+    TEST_MESSAGE(line);
+
+    for (size_t count : BATCH_SIZES) {
+        std::vector<uint8_t> frame;
+        std::vector<SensorData> samples;
+        for (size_t i = 0; i < count; i++) {
+            samples.push_back(sampleAt(i));
+        }
+        telemetryEncodeBatch("heap", samples.data(), count, TELEMETRY_FLAG_LOAD_CELL_READY, frame);
+
+        for (int binary = 0; binary < 2; binary++) {
+            for (uint8_t level = 0; level <= GZIP_MAX_LEVEL; level += 2) {
+                CountingSink socket;
+                ChunkSink compressed;
+                BodySink body;
+                compressed.chunks = &chunks;
+                body.chunks = &chunks;
+                body.gzip = level > 0 ? &gzip : nullptr;
+
+                size_t before = heapAllocations();
+                chunks.begin(&socket);
+                if (level > 0) {
+                    gzip.begin(compressed, level);
+                }
+                writeBody(body, count, binary);
+                TEST_ASSERT_TRUE(level == 0 || gzip.finish());
+                TEST_ASSERT_TRUE(chunks.finish());
+                TEST_ASSERT_EQUAL_UINT32(0, heapAllocations() - before);
+
+                TEST_ASSERT_EQUAL_MEMORY("0\r\n\r\n", socket.tail, 5);
+                if (binary && level == 0) {
+                    TEST_ASSERT_EQUAL_UINT32(frame.size(), chunks.getBodyBytes());
+                }
+                snprintf(line, sizeof(line), "%6u samples %-6s level %u: %8u body bytes, %8u on the socket",
+                         (unsigned)count, binary ? "binary" : "json", (unsigned)level,
+                         (unsigned)chunks.getBodyBytes(), (unsigned)socket.count);
+                TEST_MESSAGE(line);
+            }
+        }
+    }
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_body_round_trip);
+    RUN_TEST(test_refused_bytes_stop_the_body);
+    RUN_TEST(test_batches_without_heap);
+    return UNITY_END();
+}
@@ -0,0 +1,87 @@
+// The automatic gzip level against links of several speeds. Everything the
+// picker is fed is synthetic: each level compresses by the ratio the
+// encoder measured on the native sim's upload bodies (it is deterministic)
+// at the ESP32 speed of the seed tables, and the link takes exactly its
+// rate, so the outcome never depends on how fast the host is.
+
+#include <unity.h>
+#include "../../src/UploadCompression.h"
+
+static const size_t PICKER_BATCHES = 200;
+
+// From the sim's compression table: bytes per 500-sample batch and the ratio per level
+static const uint32_t JSON_BATCH_BYTES = 108679;
+static const double JSON_RATIOS[GZIP_MAX_LEVEL + 1] = {1.0, 10.38, 17.46, 17.52};
+static const uint32_t BINARY_BATCH_BYTES = 4527;
+static const double BINARY_RATIOS[GZIP_MAX_LEVEL + 1] = {1.0, 4.81, 4.85, 5.06};
+
+static const double UPLINKS[] = {10.0, 100.0, 1000.0, 10000.0};  // bytes per ms
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// Settled within 2% of the level that sends a batch soonest, and within
+// 10% of always using it with learning the link and exploring included
+static void checkPicker(const double* ratios, const CompressionEstimate* device, const CompressionEstimate* seeds,
+                        uint32_t rawBytes) {
+    for (size_t u = 0; u < sizeof(UPLINKS) / sizeof(UPLINKS[0]); u++) {
+        uint32_t compressMicros[GZIP_MAX_LEVEL + 1];
+        uint32_t sentBytes[GZIP_MAX_LEVEL + 1];
+        uint32_t sendMicros[GZIP_MAX_LEVEL + 1];
+        double batchMs[GZIP_MAX_LEVEL + 1];
+        uint8_t best = 0;
+        for (uint8_t level = 0; level <= GZIP_MAX_LEVEL; level++) {
+            compressMicros[level] = level > 0 ? (uint32_t)(rawBytes * 1000.0 / device[level].bytesPerMs) : 0;
+            sentBytes[level] = (uint32_t)(rawBytes / ratios[level]);
+            sendMicros[level] = (uint32_t)(sentBytes[level] * 1000.0 / UPLINKS[u]);
+            batchMs[level] = (compressMicros[level] + sendMicros[level]) / 1000.0;
+            if (batchMs[level] < batchMs[best]) {
+                best = level;
+            }
+        }
+
+        CompressionPicker picker(seeds);
+        double totalMs = 0.0;
+        for (size_t i = 0; i < PICKER_BATCHES; i++) {
+            uint8_t level = picker.pick();
+            picker.record(level, rawBytes, sentBytes[level], compressMicros[level], sendMicros[level]);
+            totalMs += batchMs[level];
+        }
+        uint8_t settled = picker.getBest();
+        TEST_ASSERT_TRUE(batchMs[settled] <= batchMs[best] * 1.02);
+        TEST_ASSERT_TRUE(totalMs < batchMs[best] * PICKER_BATCHES * 1.10);
+    }
+}
+
+static void test_json(void) {
+    checkPicker(JSON_RATIOS, COMPRESSION_SEED_JSON, COMPRESSION_SEED_JSON, JSON_BATCH_BYTES);
+}
+
+static void test_binary(void) {
+    checkPicker(BINARY_RATIOS, COMPRESSION_SEED_BINARY, COMPRESSION_SEED_BINARY, BINARY_BATCH_BYTES);
+}
+
+// Binary bodies starting from the JSON estimates
+static void test_mixed(void) {
+    checkPicker(BINARY_RATIOS, COMPRESSION_SEED_BINARY, COMPRESSION_SEED_JSON, BINARY_BATCH_BYTES);
+}
+
+// A fixed level is used as is; out of range is clamped
+static void test_fixed_level(void) {
+    CompressionPicker picker(COMPRESSION_SEED_JSON);
+    picker.setLevel(2);
+    for (size_t i = 0; i < PICKER_BATCHES; i++) {
+        TEST_ASSERT_EQUAL_UINT8(2, picker.pick());
+    }
+    picker.setLevel(9);
+    TEST_ASSERT_EQUAL_UINT8(GZIP_MAX_LEVEL, picker.getLevel());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_json);
+    RUN_TEST(test_binary);
+    RUN_TEST(test_mixed);
+    RUN_TEST(test_fixed_level);
+    return UNITY_END();
+}
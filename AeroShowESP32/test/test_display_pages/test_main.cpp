@@ -0,0 +1,209 @@
+// OLED page flushing against a fake SSD1306 that decodes the transactions
+// it is sent: bytes per frame for typical screen updates, only changed
+// spans sent, no transaction holding the bus past DISPLAY_BUS_HOLD_US, and
+// pages the panel refused sent again on the next flush
+
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include "../../src/DisplayPages.h"
+
+static const size_t WIDTH = 128;  // DISPLAY_WIDTH
+static const size_t PAGES = 4;    // DISPLAY_PAGES
+static const size_t CHAR_COLUMNS = 6;
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// Panel RAM as the SSD1306 fills it in horizontal addressing mode, with
+// every transaction counted
+class FakePanel : public Ssd1306PageSink {
+public:
+    explicit FakePanel(uint32_t clockHz = I2C_CLOCK_HZ)
+        : Ssd1306PageSink(displayChunkBytes(clockHz, DISPLAY_BUS_HOLD_US)), clockHz(clockHz) {
+        memset(ram, 0xA5, sizeof(ram));
+    }
+
+    uint8_t ram[WIDTH * PAGES];
+    size_t transactions = 0;
+    size_t wireBytes = 0;         // Address byte included
+    uint32_t longestHoldUs = 0;
+    long failAt = -1;             // Transaction to leave unacknowledged
+
+    void startFrame() {
+        transactions = 0;
+        wireBytes = 0;
+    }
+
+protected:
+    bool transmit(const uint8_t* bytes, size_t length) override {
+        uint32_t holdUs = i2cBitsMicros(i2cTransferBits(length), clockHz);
+        longestHoldUs = holdUs > longestHoldUs ? holdUs : longestHoldUs;
+        wireBytes += length + 1;
+        if ((long)transactions++ == failAt) {
+            return false;
+        }
+
+        TEST_ASSERT_TRUE(length >= 2);
+        if (bytes[0] == SSD1306_CONTROL_COMMANDS) {
+            TEST_ASSERT_EQUAL_UINT32(4, length);
+            if (bytes[1] == SSD1306_CMD_PAGE_ADDRESS) {
+                pageStart = page = bytes[2];
+                pageEnd = bytes[3];
+            } else {
+                TEST_ASSERT_EQUAL_UINT8(SSD1306_CMD_COLUMN_ADDRESS, bytes[1]);
+                columnStart = column = bytes[2];
+                columnEnd = bytes[3];
+            }
+            return true;
+        }
+        TEST_ASSERT_EQUAL_UINT8(SSD1306_CONTROL_DATA, bytes[0]);
+        for (size_t i = 1; i < length; i++) {
+            ram[page * WIDTH + column] = bytes[i];
+            if (column++ == columnEnd) {
+                column = columnStart;
+                page = page == pageEnd ? pageStart : page + 1;
+            }
+        }
+        return true;
+    }
+
+private:
+    uint32_t clockHz;
+    size_t page = 0, pageStart = 0, pageEnd = PAGES - 1;
+    size_t column = 0, columnStart = 0, columnEnd = WIDTH - 1;
+};
+
+typedef PageFlusher<WIDTH, PAGES> Flusher;
+
+// A character cell's worth of pixels standing for glyph at column
+static void drawChar(uint8_t* framebuffer, size_t line, size_t column, char glyph) {
+    for (size_t i = 0; i < CHAR_COLUMNS - 1; i++) {
+        framebuffer[line * WIDTH + column * CHAR_COLUMNS + i] = (uint8_t)(glyph * 7 + i * 13);
+    }
+    framebuffer[line * WIDTH + column * CHAR_COLUMNS + CHAR_COLUMNS - 1] = 0;
+}
+
+static void drawText(uint8_t* framebuffer, size_t line, const char* text) {
+    memset(framebuffer + line * WIDTH, 0, WIDTH);
+    for (size_t i = 0; text[i] != '\0' && i < WIDTH / CHAR_COLUMNS; i++) {
+        drawChar(framebuffer, line, i, text[i]);
+    }
+}
+
+// Flush one frame and check the panel now shows it; reported if labelled
+static size_t frame(Flusher& flusher, FakePanel& panel, const uint8_t* framebuffer, const char* label) {
+    panel.startFrame();
+    size_t sent = flusher.flush(framebuffer, panel);
+    TEST_ASSERT_FALSE(flusher.hasUnsent());
+    TEST_ASSERT_EQUAL_MEMORY(framebuffer, panel.ram, WIDTH * PAGES);
+    if (label == nullptr) {
+        return sent;
+    }
+
+    char line[120];
+    snprintf(line, sizeof(line), "%-28s %4u pixel bytes, %4u on the wire in %3u transactions", label,
+             (unsigned)sent, (unsigned)panel.wireBytes, (unsigned)panel.transactions);
+    TEST_MESSAGE(line);
+    return sent;
+}
+
+// The screens main.cpp shows: the whole panel once, then the few columns
+// that change between voltage readings
+static void test_bytes_per_frame(void) {
+    uint8_t framebuffer[WIDTH * PAGES] = {0};
+    Flusher flusher;
+    FakePanel panel;
+
+    drawText(framebuffer, 0, "AeroShow ready");
+    drawText(framebuffer, 1, "IP 192.168.1.42");
+    drawText(framebuffer, 2, "Voltage: 16.80V");
+    TEST_ASSERT_EQUAL_UINT32(WIDTH * PAGES, frame(flusher, panel, framebuffer, "first frame"));
+    TEST_ASSERT_EQUAL_UINT32(0, frame(flusher, panel, framebuffer, "unchanged"));
+    TEST_ASSERT_EQUAL_UINT32(0, panel.transactions);
+
+    // 16.80 -> 16.79: two characters next to each other
+    drawText(framebuffer, 2, "Voltage: 16.79V");
+    TEST_ASSERT_EQUAL_UINT32(2 * CHAR_COLUMNS - 1, frame(flusher, panel, framebuffer, "voltage reading"));
+    TEST_ASSERT_EQUAL_UINT32(3, panel.transactions);
+
+    // Changes on two lines: each page sends only its own span
+    drawText(framebuffer, 2, "Voltage: 16.78V");
+    drawText(framebuffer, 3, "Step 3/12");
+    size_t sent = frame(flusher, panel, framebuffer, "voltage and step line");
+    TEST_ASSERT_EQUAL_UINT32(CHAR_COLUMNS - 1 + 9 * CHAR_COLUMNS - 1, sent);
+
+    // A changed line costs at most one line of pixels plus the window
+    drawText(framebuffer, 1, "Uploading 4096 samples");
+    TEST_ASSERT_TRUE(frame(flusher, panel, framebuffer, "new status line") <= WIDTH);
+
+    // After invalidate() everything goes out again
+    flusher.invalidate();
+    TEST_ASSERT_EQUAL_UINT32(WIDTH * PAGES, frame(flusher, panel, framebuffer, "after invalidate"));
+}
+
+// Every transaction fits the hold limit, at the firmware's bus clock and
+// at the Wire default, and large spans still go out whole
+static void test_bus_hold_capped(void) {
+    static const uint32_t CLOCKS[] = {I2C_CLOCK_HZ, 100000};
+    for (uint32_t clockHz : CLOCKS) {
+        uint8_t framebuffer[WIDTH * PAGES];
+        for (size_t i = 0; i < sizeof(framebuffer); i++) {
+            framebuffer[i] = (uint8_t)(i * 31);
+        }
+        Flusher flusher;
+        FakePanel panel(clockHz);
+        panel.startFrame();
+        TEST_ASSERT_EQUAL_UINT32(WIDTH * PAGES, flusher.flush(framebuffer, panel));
+        TEST_ASSERT_EQUAL_MEMORY(framebuffer, panel.ram, sizeof(framebuffer));
+        TEST_ASSERT_TRUE(panel.longestHoldUs <= DISPLAY_BUS_HOLD_US);
+
+        char line[120];
+        snprintf(line, sizeof(line), "%6u Hz: %2u pixel bytes per transaction, longest hold %u us, %u transactions",
+                 (unsigned)clockHz, (unsigned)displayChunkBytes(clockHz, DISPLAY_BUS_HOLD_US),
+                 (unsigned)panel.longestHoldUs, (unsigned)panel.transactions);
+        TEST_MESSAGE(line);
+    }
+    TEST_ASSERT_EQUAL_UINT32(DISPLAY_MAX_CHUNK, displayChunkBytes(1000000000, DISPLAY_BUS_HOLD_US));
+    TEST_ASSERT_EQUAL_UINT32(1, displayChunkBytes(10000, DISPLAY_BUS_HOLD_US));
+}
+
+// A transaction the panel does not acknowledge, in the window or in the
+// pixels, leaves its page to be sent again by the next flush, without the
+// framebuffer changing; the pages that went out are not resent
+static void test_refused_page_retried(void) {
+    for (long failAt = 0; failAt < 6; failAt++) {
+        uint8_t framebuffer[WIDTH * PAGES] = {0};
+        Flusher flusher;
+        FakePanel panel;
+        drawText(framebuffer, 0, "Voltage: 16.80V");
+        drawText(framebuffer, 2, "Step 1/12");
+        frame(flusher, panel, framebuffer, nullptr);
+
+        drawText(framebuffer, 0, "Voltage: 16.79V");
+        drawText(framebuffer, 2, "Step 2/12");
+        panel.startFrame();
+        panel.failAt = failAt;
+        size_t sent = flusher.flush(framebuffer, panel);
+        bool firstPageFailed = failAt < 3;
+        TEST_ASSERT_TRUE(flusher.hasUnsent());
+        TEST_ASSERT_EQUAL_UINT32(firstPageFailed ? CHAR_COLUMNS - 1 : 2 * CHAR_COLUMNS - 1, sent);
+        TEST_ASSERT_FALSE(memcmp(framebuffer, panel.ram, sizeof(framebuffer)) == 0);
+
+        panel.failAt = -1;
+        panel.startFrame();
+        sent = flusher.flush(framebuffer, panel);
+        TEST_ASSERT_FALSE(flusher.hasUnsent());
+        TEST_ASSERT_EQUAL_UINT32(firstPageFailed ? 2 * CHAR_COLUMNS - 1 : CHAR_COLUMNS - 1, sent);
+        TEST_ASSERT_EQUAL_UINT32(3, panel.transactions);
+        TEST_ASSERT_EQUAL_MEMORY(framebuffer, panel.ram, sizeof(framebuffer));
+    }
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_bytes_per_frame);
+    RUN_TEST(test_bus_hold_capped);
+    RUN_TEST(test_refused_page_retried);
+    return UNITY_END();
+}
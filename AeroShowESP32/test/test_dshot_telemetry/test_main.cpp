@@ -0,0 +1,110 @@
+// Bidirectional DShot replies: a captured waveform, every value at every
+// speed with timing skew, the error classes and their accounting, and rpm
+// surviving the upload frame
+
+#include <unity.h>
+#include <vector>
+#include "../../src/DShotTelemetry.h"
+#include "../../src/EscProtocol.h"
+#include "../../src/SensorData.h"
+#include "../../src/TelemetryFrame.h"
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// eRPM reply captured at DShot600 (107 ticks per reply bit at 80 MHz) from
+// an ESC on a 14-pole motor turning at 8571 RPM: period 1000us, value 0x3F4
+static const DShotRun CAPTURED_REPLY[] = {
+    {0, 112}, {1, 316}, {0, 101}, {1, 219}, {0, 104}, {1, 111}, {0, 98}, {1, 109},
+    {0, 113}, {1, 103}, {0, 209}, {1, 110}, {0, 220}, {1, 99},  {0, 104}, {1, 0},
+};
+static const size_t CAPTURED_RUNS = sizeof(CAPTURED_REPLY) / sizeof(CAPTURED_REPLY[0]);
+
+static void test_captured_reply(void) {
+    // Bidirectional frames invert the checksum
+    TEST_ASSERT_EQUAL_HEX16(0x82C9, dshotEncodeFrame(1046, false, true));
+
+    uint16_t value = 0;
+    TEST_ASSERT_TRUE(dshotDecodeReply(CAPTURED_REPLY, CAPTURED_RUNS, 107, value) == DShotReplyStatus::Ok);
+    TEST_ASSERT_EQUAL_HEX16(0x3F4, value);
+    TEST_ASSERT_FLOAT_WITHIN(0.5f, 8571.5f, dshotReplyRpm(value, 7));
+}
+
+// Every value, with runs stretched or squeezed by up to 30% of a bit
+static void test_reply_round_trip(void) {
+    static const EscProtocol PROTOCOLS[] = {EscProtocol::DShot150, EscProtocol::DShot300, EscProtocol::DShot600};
+    for (EscProtocol protocol : PROTOCOLS) {
+        uint32_t bitTicks = dshotReplyBitTicks(protocol, 80);
+        for (uint16_t v = 0; v <= DSHOT_REPLY_STOPPED; v++) {
+            DShotRun runs[DSHOT_REPLY_BITS];
+            size_t count = dshotEncodeReply(dshotReplyWord(v), bitTicks, runs);
+            for (size_t i = 0; i < count; i++) {
+                int skew = (int)(bitTicks * 3 / 10) * ((i + v) % 3 == 0 ? 1 : ((i + v) % 3 == 1 ? -1 : 0));
+                runs[i].ticks = (uint16_t)(runs[i].ticks + skew);
+            }
+            uint16_t value = 0;
+            TEST_ASSERT_TRUE(dshotDecodeReply(runs, count, bitTicks, value) == DShotReplyStatus::Ok);
+            TEST_ASSERT_EQUAL_UINT16(v, value);
+        }
+    }
+    TEST_ASSERT_TRUE(dshotReplyRpm(dshotReplyValueForPeriod(200), 7) >= 42857.0f);
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, dshotReplyRpm(DSHOT_REPLY_STOPPED, 7));
+}
+
+// Each error class lands in its own counter
+static void test_error_accounting(void) {
+    DShotReplyStats stats;
+    DShotRun runs[DSHOT_REPLY_BITS + 1];
+    uint16_t value = 0;
+    uint32_t bitTicks = dshotReplyBitTicks(EscProtocol::DShot600, 80);
+    uint16_t badChecksum = (uint16_t)(dshotReplyWord(0x3F4) ^ 0x0001);
+    stats.record(dshotDecodeReply(runs, dshotEncodeReply(badChecksum, bitTicks, runs), bitTicks, value));
+    uint32_t badGcr = (1u << 20) | (0x19u << 15) | (0x00u << 10) | (0x1Bu << 5) | 0x12u;
+    stats.record(dshotDecodeReply(runs, dshotGcrRuns(badGcr, bitTicks, runs), bitTicks, value));
+    // Capture started late, so the first run is high
+    size_t count = dshotEncodeReply(dshotReplyWord(0x3F4), bitTicks, runs);
+    stats.record(dshotDecodeReply(runs + 1, count - 1, bitTicks, value));
+    // Glitch: an extra bit's worth of line time
+    runs[0].ticks = (uint16_t)(runs[0].ticks + 2 * bitTicks);
+    runs[count] = {1, (uint16_t)(2 * bitTicks)};
+    stats.record(dshotDecodeReply(runs, count + 1, bitTicks, value));
+    stats.record(dshotDecodeReply(CAPTURED_REPLY, CAPTURED_RUNS, 107, value));
+    stats.recordMissing();
+
+    TEST_ASSERT_EQUAL_UINT32(1, stats.getChecksumErrors());
+    TEST_ASSERT_EQUAL_UINT32(1, stats.getGcrErrors());
+    TEST_ASSERT_EQUAL_UINT32(2, stats.getFramingErrors());
+    TEST_ASSERT_EQUAL_UINT32(1, stats.getDecoded());
+    TEST_ASSERT_EQUAL_UINT32(1, stats.getMissing());
+}
+
+// rpm and its timestamp round-trip through the upload frame
+static void test_rpm_upload(void) {
+    SensorData sent[3];
+    for (int i = 0; i < 3; i++) {
+        sent[i].timestamp_us = (5000 + i) * 1000;
+        sent[i].rpm = 8571.0f + 10.0f * i;
+        sent[i].rpm_timestamp = i == 0 ? 0 : 4990 + i;
+    }
+    std::vector<uint8_t> frame;
+    telemetryEncodeBatch("rpm", sent, 3, 0, frame);
+    TelemetryDecoder decoder(frame.data(), frame.size());
+    TelemetryHeader header;
+    TEST_ASSERT_TRUE(decoder.readHeader(header));
+    for (int i = 0; i < 3; i++) {
+        SensorData received;
+        TEST_ASSERT_TRUE(decoder.readSample(received));
+        TEST_ASSERT_EQUAL_FLOAT(sent[i].rpm, received.rpm);
+        TEST_ASSERT_EQUAL_UINT32(sent[i].rpm_timestamp, received.rpm_timestamp);
+    }
+    TEST_ASSERT_TRUE(decoder.atEnd());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_captured_reply);
+    RUN_TEST(test_reply_round_trip);
+    RUN_TEST(test_error_accounting);
+    RUN_TEST(test_rpm_upload);
+    return UNITY_END();
+}
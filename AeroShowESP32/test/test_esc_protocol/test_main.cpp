@@ -0,0 +1,82 @@
+// ESC output encoders: DShot frames bit for bit against a reference,
+// symbol timings at each DShot speed, and analog pulse endpoints
+
+#include <unity.h>
+#include "../../src/EscProtocol.h"
+
+void setUp(void) {}
+void tearDown(void) {}
+
+static void test_dshot_frame(void) {
+    // Reference: value 1046 without telemetry is 0x82C6
+    TEST_ASSERT_EQUAL_HEX16(0x82C6, dshotEncodeFrame(1046, false));
+
+    // Every value and telemetry bit against a bitwise checksum
+    for (uint32_t value = 0; value <= DSHOT_MAX_THROTTLE; value++) {
+        for (int telemetry = 0; telemetry < 2; telemetry++) {
+            uint16_t frame = dshotEncodeFrame((uint16_t)value, telemetry != 0);
+            uint16_t data = (uint16_t)((value << 1) | (uint32_t)telemetry);
+            uint16_t crc = 0;
+            for (int bit = 0; bit < 12; bit++) {
+                crc ^= (uint16_t)(((data >> bit) & 1) << (bit % 4));
+            }
+            TEST_ASSERT_EQUAL_HEX16(data, frame >> 4);
+            TEST_ASSERT_EQUAL_HEX16(crc, frame & 0x0F);
+        }
+    }
+    TEST_ASSERT_EQUAL_UINT16(DSHOT_MOTOR_STOP, dshotThrottleValue(0.0f));
+    TEST_ASSERT_EQUAL_UINT16(DSHOT_MIN_THROTTLE, dshotThrottleValue(0.0001f));
+    TEST_ASSERT_EQUAL_UINT16(DSHOT_MAX_THROTTLE, dshotThrottleValue(1.0f));
+}
+
+// Symbols at 80 ticks/us (RMT at the APB clock): total bit time, 3/4 and 3/8 highs
+static void test_dshot_symbol_timing(void) {
+    static const struct {
+        EscProtocol protocol;
+        uint16_t bitTicks;
+    } SPEEDS[] = {
+        {EscProtocol::DShot150, 533},
+        {EscProtocol::DShot300, 267},
+        {EscProtocol::DShot600, 133},
+    };
+    for (const auto& speed : SPEEDS) {
+        DShotSymbol symbols[DSHOT_FRAME_BITS];
+        uint16_t frame = dshotEncodeFrame(1046, false);
+        dshotFrameSymbols(frame, dshotBitNs(speed.protocol), 80, symbols);
+        for (int i = 0; i < DSHOT_FRAME_BITS; i++) {
+            bool one = (frame >> (DSHOT_FRAME_BITS - 1 - i)) & 1;
+            uint16_t expectedHigh = one ? (speed.bitTicks * 3 + 2) / 4 : (speed.bitTicks * 3 + 4) / 8;
+            TEST_ASSERT_EQUAL_UINT16(speed.bitTicks, symbols[i].highTicks + symbols[i].lowTicks);
+            TEST_ASSERT_EQUAL_UINT16(expectedHigh, symbols[i].highTicks);
+        }
+    }
+}
+
+// Pulse endpoints and the duty they give at the command rate
+static void test_pulse_widths(void) {
+    TEST_ASSERT_EQUAL_UINT32(125000, escPulseNs(EscProtocol::OneShot125, 0.0f));
+    TEST_ASSERT_EQUAL_UINT32(250000, escPulseNs(EscProtocol::OneShot125, 1.0f));
+    TEST_ASSERT_EQUAL_UINT32(5000, escPulseNs(EscProtocol::Multishot, 0.0f));
+    TEST_ASSERT_EQUAL_UINT32(25000, escPulseNs(EscProtocol::Multishot, 1.0f));
+    TEST_ASSERT_EQUAL_UINT32(1500000, escPulseNs(EscProtocol::Pwm, 0.5f));
+
+    uint32_t hz = escCommandHz(EscProtocol::OneShot125, 0);
+    uint8_t bits = ledcResolutionForFrequency(hz);
+    TEST_ASSERT_EQUAL_UINT32(ESC_DEFAULT_COMMAND_HZ, hz);
+    TEST_ASSERT_EQUAL_UINT32((1u << bits) / 4, ledcDutyForPulse(250000, hz, bits));
+}
+
+static void test_command_rate_limits(void) {
+    TEST_ASSERT_EQUAL_UINT32(ESC_PWM_COMMAND_HZ, escCommandHz(EscProtocol::Pwm, 0));
+    TEST_ASSERT_TRUE(escCommandHz(EscProtocol::OneShot125, 100000) <= 1000000000u / (250000 + ESC_MIN_GAP_NS));
+    TEST_ASSERT_EQUAL_UINT32(ESC_MAX_COMMAND_HZ, escCommandHz(EscProtocol::DShot600, 100000));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_dshot_frame);
+    RUN_TEST(test_dshot_symbol_timing);
+    RUN_TEST(test_pulse_widths);
+    RUN_TEST(test_command_rate_limits);
+    return UNITY_END();
+}
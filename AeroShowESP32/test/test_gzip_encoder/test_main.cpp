@@ -0,0 +1,258 @@
+// Gzip upload bodies at every level, JSON and binary, read back by a
+// minimal inflater and, when it is installed, by the system gzip, the zlib
+// reader an ingest server would use; the encoder never touches the heap
+
+#include <unity.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <vector>
+#include "../../src/Crc32.h"
+#include "../../src/GzipEncoder.h"
+#include "../../src/sim/HeapCounter.h"
+#include "../../src/sim/SimChannels.h"
+#include "../../src/sim/SimUploads.h"
+
+static const size_t BATCH_SAMPLES = 256;  // UPLOAD_BATCH_CAPACITY
+static const size_t BATCHES = 4;
+
+static GzipEncoder encoder;
+static std::vector<std::vector<uint8_t>> jsonBodies;
+static std::vector<std::vector<uint8_t>> binaryBodies;
+static bool haveSystemGzip = false;
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// Minimal gzip reader for what GzipEncoder writes (fixed-Huffman blocks),
+// checking the trailer's CRC and length. The device never decodes, so this
+// only lives here.
+struct BitReader {
+    const std::vector<uint8_t>& in;
+    size_t bit;
+    bool overrun;
+
+    uint32_t bits(int count) {
+        uint32_t value = 0;
+        for (int i = 0; i < count; i++, bit++) {
+            if (bit / 8 >= in.size()) {
+                overrun = true;
+                return 0;
+            }
+            value |= (uint32_t)((in[bit / 8] >> (bit % 8)) & 1) << i;
+        }
+        return value;
+    }
+
+    // Huffman codes arrive most significant bit first
+    uint32_t code(int count) {
+        uint32_t value = 0;
+        for (int i = 0; i < count; i++) {
+            value = (value << 1) | bits(1);
+        }
+        return value;
+    }
+};
+
+static bool gunzip(const std::vector<uint8_t>& in, std::vector<uint8_t>& out) {
+    static const uint16_t lengthBase[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                                            35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+    static const uint16_t distanceBase[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+                                              257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+                                              8193, 12289, 16385, 24577};
+    out.clear();
+    if (in.size() < 18 || in[0] != 0x1f || in[1] != 0x8b || in[2] != 8 || in[3] != 0) {
+        return false;
+    }
+
+    BitReader reader = {in, 80, false};
+    bool last = false;
+    while (!last) {
+        last = reader.bits(1) != 0;
+        if (reader.bits(2) != 1) {
+            return false;  // Only fixed-Huffman blocks are expected
+        }
+        for (;;) {
+            uint32_t symbol = reader.code(7);
+            if (symbol < 24) {
+                symbol += 256;
+            } else {
+                symbol = (symbol << 1) | reader.code(1);
+                if (symbol < 192) {
+                    symbol -= 48;
+                } else if (symbol < 200) {
+                    symbol += 280 - 192;
+                } else {
+                    symbol = ((symbol << 1) | reader.code(1)) - 400 + 144;
+                }
+            }
+            if (reader.overrun || symbol > 285) {
+                return false;
+            }
+            if (symbol < 256) {
+                out.push_back((uint8_t)symbol);
+                continue;
+            }
+            if (symbol == 256) {
+                break;
+            }
+            size_t index = symbol - 257;
+            size_t extra = index < 8 || index == 28 ? 0 : (index - 4) / 4;
+            size_t length = lengthBase[index] + reader.bits((int)extra);
+            index = reader.code(5);
+            if (index > 29) {
+                return false;
+            }
+            extra = index < 4 ? 0 : (index - 2) / 2;
+            size_t distance = distanceBase[index] + reader.bits((int)extra);
+            if (reader.overrun || distance > out.size()) {
+                return false;
+            }
+            for (size_t i = 0; i < length; i++) {
+                out.push_back(out[out.size() - distance]);
+            }
+        }
+    }
+
+    size_t at = (reader.bit + 7) / 8;
+    if (at + 8 != in.size()) {
+        return false;
+    }
+    uint32_t crc = 0;
+    uint32_t size = 0;
+    for (int i = 0; i < 4; i++) {
+        crc |= (uint32_t)in[at + i] << (8 * i);
+        size |= (uint32_t)in[at + 4 + i] << (8 * i);
+    }
+    return crc == crc32(out.data(), out.size()) && size == (uint32_t)out.size();
+}
+
+// Decode with the system gzip. False if the tool refuses the stream.
+static bool systemGunzip(const std::vector<uint8_t>& in, std::vector<uint8_t>& out) {
+    char path[] = "/tmp/aeroshow-gzip-XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        return false;
+    }
+    bool ok = write(fd, in.data(), in.size()) == (ssize_t)in.size();
+    close(fd);
+    out.clear();
+    char command[64];
+    snprintf(command, sizeof(command), "gzip -dc < %s 2>/dev/null", path);
+    FILE* pipe = ok ? popen(command, "r") : nullptr;
+    if (pipe != nullptr) {
+        uint8_t buffer[4096];
+        size_t n;
+        while ((n = fread(buffer, 1, sizeof(buffer), pipe)) > 0) {
+            out.insert(out.end(), buffer, buffer + n);
+        }
+        ok = pclose(pipe) == 0;
+    } else {
+        ok = false;
+    }
+    unlink(path);
+    return ok;
+}
+
+// Upload bodies of a motor ramping up through the sim rig
+static void makeBodies() {
+    Rig rig;
+    rig.begin();
+    rig.motor.initialize();
+    std::vector<SensorData> samples;
+    for (size_t i = 0; i < BATCHES * BATCH_SAMPLES; i++) {
+        rig.motor.setSpeed(0.2f + 0.6f * i / (BATCHES * BATCH_SAMPLES));
+        rig.clock.advanceMicros(1000);
+        samples.push_back(rig.sample());
+    }
+    jsonBodies = uploadBodies(samples, false, BATCH_SAMPLES);
+    binaryBodies = uploadBodies(samples, true, BATCH_SAMPLES);
+}
+
+// Every body at every level, fed in uneven pieces like the JSON writer's lines
+static void checkRoundTrip(const std::vector<std::vector<uint8_t>>& bodies) {
+    ByteVector compressed;
+    std::vector<uint8_t> restored;
+    for (uint8_t level = 1; level <= GZIP_MAX_LEVEL; level++) {
+        for (size_t i = 0; i < bodies.size(); i++) {
+            compressed.bytes.clear();
+            encoder.begin(compressed, level);
+            for (size_t at = 0; at < bodies[i].size(); at += 97) {
+                size_t n = bodies[i].size() - at < 97 ? bodies[i].size() - at : 97;
+                TEST_ASSERT_TRUE(encoder.write(&bodies[i][at], n));
+            }
+            TEST_ASSERT_TRUE(encoder.finish());
+            TEST_ASSERT_EQUAL_UINT32(bodies[i].size(), encoder.getInputBytes());
+            TEST_ASSERT_EQUAL_UINT32(compressed.bytes.size(), encoder.getOutputBytes());
+            TEST_ASSERT_TRUE(compressed.bytes.size() < bodies[i].size());
+
+            TEST_ASSERT_TRUE(gunzip(compressed.bytes, restored));
+            TEST_ASSERT_TRUE(restored == bodies[i]);
+            if (haveSystemGzip) {
+                TEST_ASSERT_TRUE(systemGunzip(compressed.bytes, restored));
+                TEST_ASSERT_TRUE(restored == bodies[i]);
+            }
+        }
+    }
+}
+
+static void test_json_round_trip(void) {
+    checkRoundTrip(jsonBodies);
+}
+
+static void test_binary_round_trip(void) {
+    checkRoundTrip(binaryBodies);
+}
+
+// Higher levels never do worse on the same body
+static void test_levels_ordered(void) {
+    ByteVector compressed;
+    size_t previous = jsonBodies[0].size();
+    for (uint8_t level = 1; level <= GZIP_MAX_LEVEL; level++) {
+        compressed.bytes.clear();
+        encoder.begin(compressed, level);
+        encoder.write(jsonBodies[0].data(), jsonBodies[0].size());
+        encoder.finish();
+        TEST_ASSERT_TRUE(compressed.bytes.size() <= previous);
+        previous = compressed.bytes.size();
+    }
+}
+
+// A sink whose capacity is already there, so only the encoder is counted
+static void test_no_heap(void) {
+    ByteVector compressed;
+    compressed.bytes.reserve(jsonBodies[0].size());
+    size_t before = heapAllocations();
+    for (uint8_t level = 1; level <= GZIP_MAX_LEVEL; level++) {
+        compressed.bytes.clear();
+        encoder.begin(compressed, level);
+        encoder.write(jsonBodies[0].data(), jsonBodies[0].size());
+        encoder.finish();
+    }
+    TEST_ASSERT_EQUAL_UINT32(0, heapAllocations() - before);
+}
+
+// An empty body is still a valid stream
+static void test_empty_body(void) {
+    ByteVector compressed;
+    std::vector<uint8_t> restored;
+    encoder.begin(compressed, 1);
+    TEST_ASSERT_TRUE(encoder.finish());
+    TEST_ASSERT_TRUE(gunzip(compressed.bytes, restored));
+    TEST_ASSERT_EQUAL_UINT32(0, restored.size());
+}
+
+int main() {
+    haveSystemGzip = system("gzip --version > /dev/null 2>&1") == 0;
+    makeBodies();
+    UNITY_BEGIN();
+    if (!haveSystemGzip) {
+        TEST_MESSAGE("No system gzip, streams are read back by the test's inflater only");
+    }
+    RUN_TEST(test_json_round_trip);
+    RUN_TEST(test_binary_round_trip);
+    RUN_TEST(test_levels_ordered);
+    RUN_TEST(test_no_heap);
+    RUN_TEST(test_empty_body);
+    return UNITY_END();
+}
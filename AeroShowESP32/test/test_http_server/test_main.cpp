@@ -0,0 +1,270 @@
+// The HTTP server on loopback: routing and refusals, keep-alive, responses
+// in parts, query decoding, whole and streamed bodies, a stalled client not
+// holding up another, an abandoned body reaching its handler, streamed
+// bodies queueing for their route, a socket taken over by its handler, and
+// fixed request counts from 1 to 16 clients, checked on the server's
+// counters rather than on host timing
+
+#include <unity.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../../src/sim/HeapCounter.h"
+#include "../../src/sim/SimHttpApi.h"
+#include "../../src/sim/SimHttpClient.h"
+#include "../../src/sim/SimPlans.h"
+
+static const size_t HTTP_LOAD_REQUESTS = 2400;  // Per run, shared between its clients
+static const size_t HTTP_LOAD_STEPS = 50;
+static const size_t HTTP_MAX_LOAD_CLIENTS = 16;
+
+static SimHttpApi api;
+static HttpClient httpClients[HTTP_MAX_LOAD_CLIENTS];
+static HttpClient& a = httpClients[0];
+static HttpClient& b = httpClients[1];
+static HttpClient& c = httpClients[2];
+static uint16_t port;
+
+void setUp(void) {}
+
+void tearDown(void) {
+    a.close();
+    b.close();
+    c.close();
+}
+
+static bool waitFor(const std::atomic<uint32_t>& counter, uint32_t value) {
+    for (int i = 0; i < 2000 && counter.load() < value; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return counter.load() >= value;
+}
+
+static void test_keep_alive(void) {
+    uint32_t connections = api.server.getConnections();
+    TEST_ASSERT_TRUE(a.open(port));
+    TEST_ASSERT_TRUE(a.exchange("GET", "/status"));
+    TEST_ASSERT_EQUAL_INT(200, a.status);
+    TEST_ASSERT_NOT_NULL(strstr(a.body, "\"channels\":["));
+    TEST_ASSERT_TRUE(a.exchange("GET", "/status"));
+    TEST_ASSERT_EQUAL_INT(200, a.status);
+    TEST_ASSERT_FALSE(a.closing);
+    TEST_ASSERT_EQUAL_UINT32(connections + 1, api.server.getConnections());
+}
+
+static void test_404_and_405(void) {
+    TEST_ASSERT_TRUE(a.open(port));
+    TEST_ASSERT_TRUE(a.exchange("GET", "/missing"));
+    TEST_ASSERT_EQUAL_INT(404, a.status);
+    TEST_ASSERT_FALSE(a.closing);
+    TEST_ASSERT_TRUE(a.exchange("POST", "/status"));
+    TEST_ASSERT_EQUAL_INT(405, a.status);
+    TEST_ASSERT_TRUE(a.exchange("GET", "/status"));
+    TEST_ASSERT_EQUAL_INT(200, a.status);
+}
+
+static void test_response_in_parts(void) {
+    TEST_ASSERT_TRUE(a.open(port));
+    TEST_ASSERT_TRUE(a.exchange("GET", "/parts?count=40"));
+    TEST_ASSERT_EQUAL_INT(200, a.status);
+    TEST_ASSERT_EQUAL_UINT32(10 * 7 + 30 * 8, a.bodyLength);
+    TEST_ASSERT_EQUAL_MEMORY("part 0\npart 1\n", a.body, 14);
+    TEST_ASSERT_EQUAL_STRING("part 39\n", a.body + a.bodyLength - 8);
+}
+
+static void test_query_decoding(void) {
+    TEST_ASSERT_TRUE(a.open(port));
+    TEST_ASSERT_TRUE(a.exchange("GET", "/echo?x=1&text=a%20b+c%26d&y"));
+    TEST_ASSERT_EQUAL_INT(200, a.status);
+    TEST_ASSERT_EQUAL_STRING("a b c&d", a.body);
+}
+
+static void test_whole_body_and_413(void) {
+    static const char BODY[] = "{\"channel\":0,\"tare\":true}";
+    TEST_ASSERT_TRUE(a.open(port));
+    TEST_ASSERT_TRUE(a.exchange("POST", "/echo", BODY, sizeof(BODY) - 1));
+    TEST_ASSERT_EQUAL_INT(200, a.status);
+    TEST_ASSERT_EQUAL_STRING(BODY, a.body);
+    // Only the head: the body would not be read
+    TEST_ASSERT_TRUE(a.sendHead("POST", "/echo", HTTP_INPUT_BYTES + 1));
+    TEST_ASSERT_TRUE(a.readResponse());
+    TEST_ASSERT_EQUAL_INT(413, a.status);
+    TEST_ASSERT_TRUE(a.closing);
+}
+
+static void test_streamed_plan_body(void) {
+    std::string plan = planBody(2000, false);
+    TEST_ASSERT_TRUE(b.open(port));
+    TEST_ASSERT_TRUE(b.exchange("POST", "/plan", plan.data(), plan.size()));
+    TEST_ASSERT_EQUAL_INT(200, b.status);
+    TEST_ASSERT_EQUAL_STRING("{\"steps\":2000}", b.body);
+    TEST_ASSERT_TRUE(api.planJob.plan.spilled());
+}
+
+// Half a head, then another client's whole request, then the rest
+static void test_stalled_head(void) {
+    TEST_ASSERT_TRUE(a.open(port));
+    TEST_ASSERT_TRUE(b.open(port));
+    TEST_ASSERT_TRUE(a.sendAll("GET /sta", 8));
+    TEST_ASSERT_TRUE(b.exchange("GET", "/status"));
+    TEST_ASSERT_EQUAL_INT(200, b.status);
+    TEST_ASSERT_TRUE(a.sendAll("tus HTTP/1.1\r\n\r\n", 16));
+    TEST_ASSERT_TRUE(a.readResponse());
+    TEST_ASSERT_EQUAL_INT(200, a.status);
+}
+
+static void test_abandoned_body(void) {
+    std::string plan = planBody(2000, false);
+    uint32_t aborted = api.aborted.load();
+    TEST_ASSERT_TRUE(c.open(port));
+    TEST_ASSERT_TRUE(c.sendHead("POST", "/plan", plan.size()));
+    TEST_ASSERT_TRUE(c.sendAll(plan.data(), 100));
+    c.close();
+    TEST_ASSERT_TRUE(waitFor(api.aborted, aborted + 1));
+}
+
+// The second waits for the route until the first is done
+static void test_concurrent_plan_bodies(void) {
+    std::string plan = planBody(2000, false);
+    size_t half = plan.size() / 2;
+    TEST_ASSERT_TRUE(a.open(port));
+    TEST_ASSERT_TRUE(b.open(port));
+    TEST_ASSERT_TRUE(a.sendHead("POST", "/plan", plan.size()));
+    TEST_ASSERT_TRUE(a.sendAll(plan.data(), half));
+    TEST_ASSERT_TRUE(b.sendHead("POST", "/plan", plan.size()));
+    TEST_ASSERT_TRUE(b.sendAll(plan.data(), half));
+    TEST_ASSERT_TRUE(b.sendAll(plan.data() + half, plan.size() - half));
+    TEST_ASSERT_TRUE(a.sendAll(plan.data() + half, plan.size() - half));
+    TEST_ASSERT_TRUE(a.readResponse());
+    TEST_ASSERT_TRUE(b.readResponse());
+    TEST_ASSERT_EQUAL_INT(200, a.status);
+    TEST_ASSERT_EQUAL_INT(200, b.status);
+    TEST_ASSERT_EQUAL_STRING("{\"steps\":2000}", a.body);
+    TEST_ASSERT_EQUAL_STRING("{\"steps\":2000}", b.body);
+}
+
+static void test_detached_socket(void) {
+    TEST_ASSERT_TRUE(c.open(port));
+    TEST_ASSERT_TRUE(c.sendHead("GET", "/stream", 0));
+    while (c.fill()) {
+    }
+    TEST_ASSERT_EQUAL_UINT32(9, c.used);
+    TEST_ASSERT_EQUAL_MEMORY("detached\n", c.input, 9);
+}
+
+struct LoadResult {
+    size_t requests;
+    size_t errors;
+    size_t reconnects;
+};
+
+// Keep-alive client alternating GET /status and a plan POST until it has
+// made count requests, reconnecting when its idle connection was closed
+// for another client
+static void loadClient(HttpClient& client, const std::string& plan, const std::atomic<bool>& go, size_t count,
+                       LoadResult& result) {
+    while (!go.load()) {
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+    while (result.requests < count && result.errors < count) {
+        if (client.fd < 0 && !client.open(port)) {
+            result.errors++;
+            continue;
+        }
+        bool post = result.requests % 2 == 1;
+        if (!client.exchange(post ? "POST" : "GET", post ? "/plan" : "/status", post ? plan.data() : nullptr,
+                             post ? plan.size() : 0)) {
+            client.close();
+            result.reconnects++;
+            continue;
+        }
+        result.requests++;
+        if (client.status != 200) {
+            result.errors++;
+        }
+        if (client.closing) {
+            client.close();
+        }
+    }
+    client.close();
+}
+
+// HTTP_LOAD_REQUESTS over clients: every request answered 200 and counted
+// once by the server, nothing refused, timed out or truncated, no reconnect
+// that an eviction does not explain, and no heap use anywhere
+static void checkLoad(size_t clients) {
+    std::string plan = planBody(HTTP_LOAD_STEPS, false);
+    size_t perClient = HTTP_LOAD_REQUESTS / clients;
+    LoadResult results[HTTP_MAX_LOAD_CLIENTS] = {};
+    std::vector<std::thread> threads;
+    threads.reserve(clients);
+    std::atomic<bool> go{false};
+    for (size_t i = 0; i < clients; i++) {
+        threads.emplace_back(loadClient, std::ref(httpClients[i]), std::cref(plan), std::cref(go), perClient,
+                             std::ref(results[i]));
+    }
+
+    uint32_t evicted = api.server.getEvicted();
+    uint32_t served = api.server.getRequests();
+    uint32_t refused = api.server.getRefused() + api.server.getTimeouts() + api.server.getTruncated();
+    size_t allocations = heapAllocations();
+    go = true;
+    for (size_t i = 0; i < clients; i++) {
+        threads[i].join();
+    }
+    allocations = heapAllocations() - allocations;
+    evicted = api.server.getEvicted() - evicted;
+    served = api.server.getRequests() - served;
+    refused = api.server.getRefused() + api.server.getTimeouts() + api.server.getTruncated() - refused;
+
+    LoadResult total = {};
+    for (size_t i = 0; i < clients; i++) {
+        total.requests += results[i].requests;
+        total.errors += results[i].errors;
+        total.reconnects += results[i].reconnects;
+    }
+    TEST_ASSERT_EQUAL_UINT32(perClient * clients, total.requests);
+    TEST_ASSERT_EQUAL_UINT32(0, total.errors);
+    TEST_ASSERT_EQUAL_UINT32(perClient * clients, served);
+    TEST_ASSERT_EQUAL_UINT32(0, refused);
+    TEST_ASSERT_EQUAL_UINT32(0, allocations);
+    TEST_ASSERT_TRUE(total.reconnects <= evicted);
+}
+
+static void test_load_1_client(void) {
+    checkLoad(1);
+}
+
+static void test_load_4_clients(void) {
+    checkLoad(4);
+}
+
+// More clients than HTTP_MAX_CONNECTIONS, so idle connections are evicted
+static void test_load_16_clients(void) {
+    checkLoad(16);
+}
+
+int main() {
+    if (!api.begin(0)) {
+        return 1;
+    }
+    port = api.server.getPort();
+    UNITY_BEGIN();
+    RUN_TEST(test_keep_alive);
+    RUN_TEST(test_404_and_405);
+    RUN_TEST(test_response_in_parts);
+    RUN_TEST(test_query_decoding);
+    RUN_TEST(test_whole_body_and_413);
+    RUN_TEST(test_streamed_plan_body);
+    RUN_TEST(test_stalled_head);
+    RUN_TEST(test_abandoned_body);
+    RUN_TEST(test_concurrent_plan_bodies);
+    RUN_TEST(test_detached_socket);
+    RUN_TEST(test_load_1_client);
+    RUN_TEST(test_load_4_clients);
+    RUN_TEST(test_load_16_clients);
+    int failures = UNITY_END();
+    api.end();
+    return failures;
+}
@@ -0,0 +1,120 @@
+// Decoding recorded HX711 DT levels: ordinary codes on both sides of zero,
+// the two clamp codes the chip reports out of range, and back-to-back
+// conversions separated by the gain pulses that select the next one
+
+#include <unity.h>
+#include "../../src/HX711Decode.h"
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// 0x012345, MSB first
+static const uint8_t POSITIVE_LEVELS[HX711_DATA_BITS] = {
+    0, 0, 0, 0, 0, 0, 0, 1,
+    0, 0, 1, 0, 0, 0, 1, 1,
+    0, 1, 0, 0, 0, 1, 0, 1,
+};
+
+// 0xFEDCBB, the 24-bit two's complement of -0x012345
+static const uint8_t NEGATIVE_LEVELS[HX711_DATA_BITS] = {
+    1, 1, 1, 1, 1, 1, 1, 0,
+    1, 1, 0, 1, 1, 1, 0, 0,
+    1, 0, 1, 1, 1, 0, 1, 1,
+};
+
+// 0xFFFFFF
+static const uint8_t MINUS_ONE_LEVELS[HX711_DATA_BITS] = {
+    1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1,
+};
+
+// 0x7FFFFF, reported above full scale
+static const uint8_t MAX_CODE_LEVELS[HX711_DATA_BITS] = {
+    0, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1,
+};
+
+// 0x800000, reported below full scale
+static const uint8_t MIN_CODE_LEVELS[HX711_DATA_BITS] = {
+    1, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0,
+};
+
+// Two conversions as DT reads on every SCK pulse. The first is followed by
+// the single 25th pulse (channel A, gain 128), the second by the three
+// pulses up to the 27th (channel A, gain 64). DT rises after the 25th pulse
+// and stays high until the next conversion is ready.
+static const uint8_t GAIN_PULSE_STREAM[] = {
+    // 0x00000F
+    0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 1, 1, 1, 1,
+    // 25th pulse
+    1,
+    // 0xFFFFF0
+    1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 0, 0, 0, 0,
+    // 25th to 27th pulses
+    1, 1, 1,
+};
+
+// Codes on either side of zero decode to their signed value and are in range
+static void test_signed_codes(void) {
+    TEST_ASSERT_EQUAL_INT32(74565, hx711DecodeBits(POSITIVE_LEVELS));
+    TEST_ASSERT_EQUAL_INT32(-74565, hx711DecodeBits(NEGATIVE_LEVELS));
+    TEST_ASSERT_EQUAL_INT32(-1, hx711DecodeBits(MINUS_ONE_LEVELS));
+
+    TEST_ASSERT_FALSE(hx711IsSaturated(hx711DecodeBits(POSITIVE_LEVELS)));
+    TEST_ASSERT_FALSE(hx711IsSaturated(hx711DecodeBits(NEGATIVE_LEVELS)));
+    TEST_ASSERT_FALSE(hx711IsSaturated(hx711DecodeBits(MINUS_ONE_LEVELS)));
+}
+
+// Both clamp codes decode to the extremes and are flagged; their neighbours
+// are real readings and are not
+static void test_clamp_codes(void) {
+    TEST_ASSERT_EQUAL_INT32(8388607, hx711DecodeBits(MAX_CODE_LEVELS));
+    TEST_ASSERT_EQUAL_INT32(-8388608, hx711DecodeBits(MIN_CODE_LEVELS));
+
+    TEST_ASSERT_TRUE(hx711IsSaturated(hx711DecodeBits(MAX_CODE_LEVELS)));
+    TEST_ASSERT_TRUE(hx711IsSaturated(hx711DecodeBits(MIN_CODE_LEVELS)));
+    TEST_ASSERT_FALSE(hx711IsSaturated(8388606));
+    TEST_ASSERT_FALSE(hx711IsSaturated(-8388607));
+}
+
+// Bits above the 24 the HX711 sends are ignored when sign-extending
+static void test_sign_extend_masks_high_bits(void) {
+    TEST_ASSERT_EQUAL_INT32(-8388608, hx711SignExtend(0x01800000u));
+    TEST_ASSERT_EQUAL_INT32(8388607, hx711SignExtend(0xFF7FFFFFu));
+    TEST_ASSERT_EQUAL_INT32(0, hx711SignExtend(0xFF000000u));
+}
+
+// Each conversion is decoded from its own 24 levels; the gain pulses that
+// follow it do not bleed into either neighbour
+static void test_gain_pulses_between_conversions(void) {
+    const uint8_t* first = GAIN_PULSE_STREAM;
+    const uint8_t* second = first + HX711_DATA_BITS + HX711_PULSES_GAIN_A128;
+
+    TEST_ASSERT_EQUAL(2 * HX711_DATA_BITS + HX711_PULSES_GAIN_A128 + HX711_PULSES_GAIN_A64,
+                      sizeof(GAIN_PULSE_STREAM));
+    TEST_ASSERT_EQUAL_INT32(15, hx711DecodeBits(first));
+    TEST_ASSERT_EQUAL_INT32(-16, hx711DecodeBits(second));
+    TEST_ASSERT_FALSE(hx711IsSaturated(hx711DecodeBits(first)));
+    TEST_ASSERT_FALSE(hx711IsSaturated(hx711DecodeBits(second)));
+
+    // Starting one level early picks up the 25th pulse as the sign bit and
+    // drops the last data bit
+    TEST_ASSERT_EQUAL_INT32(-8, hx711DecodeBits(second - 1));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_signed_codes);
+    RUN_TEST(test_clamp_codes);
+    RUN_TEST(test_sign_extend_masks_high_bits);
+    RUN_TEST(test_gain_pulses_between_conversions);
+    return UNITY_END();
+}
@@ -0,0 +1,289 @@
+// The INA260 driver against a scripted bus: every register read is answered
+// with literal big-endian bytes in the order the script lists them, and
+// every transfer is logged so the register sequence can be checked. Covers
+// the configuration written at begin(), the fixed LSB scaling, and the
+// order of the alert burst: data first, Mask/Enable (which re-arms ALERT)
+// last, and the re-read when the burst finished after the next conversion.
+
+#include <unity.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "../../src/INA260Driver.h"
+
+void setUp(void) {}
+void tearDown(void) {}
+
+static const uint8_t ADDRESS = 0x41;
+static const int ALERT_PIN = 4;
+
+struct BusOp {
+    bool write;
+    uint8_t reg;
+    uint16_t value;
+};
+
+// Reads are answered from the script, two bytes per register, MSB first. A
+// read the script does not cover fails, as a NACK would.
+class ScriptedBus : public I2CBus {
+public:
+    void script(const uint8_t* bytes, size_t count) {
+        replies.insert(replies.end(), bytes, bytes + count);
+    }
+
+    bool writeRegister16(uint8_t address, uint8_t reg, uint16_t value) override {
+        if (address != ADDRESS) {
+            return false;
+        }
+        ops.push_back({true, reg, value});
+        return true;
+    }
+
+    bool readRegisters16(uint8_t address, const uint8_t* regs, uint16_t* values, size_t count) override {
+        if (address != ADDRESS || next + 2 * count > replies.size()) {
+            return false;
+        }
+        for (size_t i = 0; i < count; i++) {
+            values[i] = (uint16_t)(replies[next] << 8 | replies[next + 1]);
+            next += 2;
+            ops.push_back({false, regs[i], values[i]});
+        }
+        return true;
+    }
+
+    std::vector<BusOp> ops;
+
+private:
+    std::vector<uint8_t> replies;
+    size_t next = 0;
+};
+
+// Manufacturer "TI" and die 0x227, revision 0
+static const uint8_t ID_REPLY[] = {0x54, 0x49, 0x22, 0x70};
+
+static void expectReads(const ScriptedBus& bus, size_t from, const uint8_t* regs, size_t count) {
+    TEST_ASSERT_EQUAL_UINT(from + count, bus.ops.size());
+    for (size_t i = 0; i < count; i++) {
+        TEST_ASSERT_FALSE(bus.ops[from + i].write);
+        TEST_ASSERT_EQUAL_HEX16(regs[i], bus.ops[from + i].reg);
+    }
+}
+
+static void expectWrite(const ScriptedBus& bus, size_t index, uint8_t reg, uint16_t value) {
+    TEST_ASSERT_TRUE(bus.ops[index].write);
+    TEST_ASSERT_EQUAL_HEX16(reg, bus.ops[index].reg);
+    TEST_ASSERT_EQUAL_HEX16(value, bus.ops[index].value);
+}
+
+static uint32_t hostMicros() {
+    using namespace std::chrono;
+    return (uint32_t)duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+// begin() checks the IDs, resets, then writes the CONFIG word for the
+// requested averaging and conversion times
+static void test_config_words(void) {
+    struct Case {
+        INA260Averaging averaging;
+        INA260ConversionTime busTime;
+        INA260ConversionTime currentTime;
+        uint16_t config;
+        uint32_t periodMicros;
+    };
+    static const Case cases[] = {
+        {INA260Averaging::Avg1, INA260ConversionTime::Us140, INA260ConversionTime::Us140, 0x0007, 280},
+        {INA260Averaging::Avg1, INA260ConversionTime::Us1100, INA260ConversionTime::Us1100, 0x0127, 2200},
+        {INA260Averaging::Avg4, INA260ConversionTime::Us332, INA260ConversionTime::Us332, 0x0297, 2656},
+        {INA260Averaging::Avg64, INA260ConversionTime::Us1100, INA260ConversionTime::Us588, 0x071F, 108032},
+        {INA260Averaging::Avg1024, INA260ConversionTime::Us8244, INA260ConversionTime::Us8244, 0x0FFF, 16883712},
+    };
+    static const uint8_t idRegisters[] = {INA260_REG_MANUFACTURER_ID, INA260_REG_DIE_ID};
+
+    for (const Case& c : cases) {
+        ScriptedBus bus;
+        bus.script(ID_REPLY, sizeof(ID_REPLY));
+        INA260Driver driver(bus, ADDRESS);
+        TEST_ASSERT_TRUE(driver.begin(c.averaging, c.busTime, c.currentTime));
+
+        TEST_ASSERT_EQUAL_UINT(5, bus.ops.size());
+        TEST_ASSERT_EQUAL_HEX16(idRegisters[0], bus.ops[0].reg);
+        TEST_ASSERT_EQUAL_HEX16(idRegisters[1], bus.ops[1].reg);
+        expectWrite(bus, 2, INA260_REG_CONFIG, 0x8000);
+        expectWrite(bus, 3, INA260_REG_CONFIG, c.config);
+        expectWrite(bus, 4, INA260_REG_MASK_ENABLE, 0x0000);
+        TEST_ASSERT_EQUAL_UINT32(c.periodMicros, driver.getConversionPeriodMicros());
+    }
+
+    // With an ALERT pin, conversion-ready drives ALERT and latches it
+    ScriptedBus bus;
+    bus.script(ID_REPLY, sizeof(ID_REPLY));
+    INA260Driver driver(bus, ADDRESS, ALERT_PIN);
+    TEST_ASSERT_TRUE(driver.begin());
+    expectWrite(bus, 3, INA260_REG_CONFIG, 0x0297);
+    expectWrite(bus, 4, INA260_REG_MASK_ENABLE, 0x0401);
+}
+
+// A part answering with another manufacturer or die is left unconfigured
+static void test_wrong_ids(void) {
+    static const uint8_t wrongDie[] = {0x54, 0x49, 0x22, 0x60};
+    ScriptedBus bus;
+    bus.script(wrongDie, sizeof(wrongDie));
+    INA260Driver driver(bus, ADDRESS);
+    TEST_ASSERT_FALSE(driver.begin());
+    TEST_ASSERT_FALSE(driver.isReady());
+    TEST_ASSERT_EQUAL_UINT(2, bus.ops.size());
+
+    // Revision in the low nibble is accepted
+    static const uint8_t revision[] = {0x54, 0x49, 0x22, 0x73};
+    ScriptedBus revised;
+    revised.script(revision, sizeof(revision));
+    INA260Driver revisedDriver(revised, ADDRESS);
+    TEST_ASSERT_TRUE(revisedDriver.begin());
+}
+
+// Polled conversions: voltage at 1.25 mV, current at 1.25 mA in two's
+// complement and power at 10 mW per LSB
+static void test_scaling(void) {
+    static const uint8_t ready[] = {0x00, 0x08};
+    static const uint8_t notReady[] = {0x00, 0x00};
+    static const uint8_t pollRegisters[] = {INA260_REG_MASK_ENABLE, INA260_REG_CURRENT, INA260_REG_BUS_VOLTAGE,
+                                            INA260_REG_POWER};
+    struct Case {
+        uint8_t bytes[6];  // Current, bus voltage, power
+        float current;
+        float voltage;
+        float power;
+    };
+    static const Case cases[] = {
+        {{0x03, 0x20, 0x25, 0x80, 0x04, 0xB0}, 1000.0f, 12.0f, 12000.0f},
+        {{0x00, 0x01, 0x00, 0x01, 0x00, 0x01}, 1.25f, 0.00125f, 10.0f},
+        {{0xFF, 0x38, 0x2E, 0xE0, 0x01, 0xF4}, -250.0f, 15.0f, 5000.0f},
+        {{0xFF, 0xFF, 0x00, 0x00, 0x00, 0x00}, -1.25f, 0.0f, 0.0f},
+        {{0x80, 0x00, 0x70, 0x80, 0xFF, 0xFF}, -40960.0f, 36.0f, 655350.0f},
+        {{0x7F, 0xFF, 0x00, 0x00, 0x00, 0x00}, 40958.75f, 0.0f, 0.0f},
+    };
+
+    for (const Case& c : cases) {
+        ScriptedBus bus;
+        bus.script(ID_REPLY, sizeof(ID_REPLY));
+        bus.script(notReady, sizeof(notReady));
+        bus.script(ready, sizeof(ready));
+        bus.script(c.bytes, sizeof(c.bytes));
+        INA260Driver driver(bus, ADDRESS);
+        TEST_ASSERT_TRUE(driver.begin());
+        size_t start = bus.ops.size();
+
+        // Nothing read until the conversion-ready flag is set
+        INA260Reading reading;
+        TEST_ASSERT_FALSE(driver.readLatest(reading));
+        expectReads(bus, start, pollRegisters, 1);
+
+        TEST_ASSERT_TRUE(driver.readLatest(reading));
+        expectReads(bus, start + 1, pollRegisters, 4);
+        TEST_ASSERT_EQUAL_FLOAT(c.current, reading.current);
+        TEST_ASSERT_FLOAT_WITHIN(1e-4f, c.voltage, reading.voltage);
+        TEST_ASSERT_EQUAL_FLOAT(c.power, reading.power);
+        TEST_ASSERT_EQUAL_UINT32(1, driver.getReadingCount());
+    }
+}
+
+// An alert reads current, voltage and power before Mask/Enable: reading
+// Mask/Enable re-arms ALERT, so it must not release the next edge before
+// the data it announced is in
+static void test_alert_burst_order(void) {
+    static const uint8_t burst[] = {0x03, 0x20, 0x25, 0x80, 0x04, 0xB0, 0x04, 0x09};
+    static const uint8_t burstRegisters[] = {INA260_REG_CURRENT, INA260_REG_BUS_VOLTAGE, INA260_REG_POWER,
+                                             INA260_REG_MASK_ENABLE};
+    ScriptedBus bus;
+    bus.script(ID_REPLY, sizeof(ID_REPLY));
+    bus.script(burst, sizeof(burst));
+    INA260Driver driver(bus, ADDRESS, ALERT_PIN);
+    // A 17 s period, so the burst is never late however slow the host
+    TEST_ASSERT_TRUE(driver.begin(INA260Averaging::Avg1024, INA260ConversionTime::Us8244,
+                                  INA260ConversionTime::Us8244));
+    size_t start = bus.ops.size();
+
+    // No edge, no bus traffic
+    INA260Reading reading;
+    TEST_ASSERT_FALSE(driver.readLatest(reading));
+    TEST_ASSERT_EQUAL_UINT(start, bus.ops.size());
+
+    driver.raiseAlert();
+    TEST_ASSERT_TRUE(driver.readLatest(reading));
+    expectReads(bus, start, burstRegisters, 4);
+    TEST_ASSERT_EQUAL_FLOAT(1000.0f, reading.current);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, 12.0f, reading.voltage);
+    TEST_ASSERT_EQUAL_FLOAT(12000.0f, reading.power);
+    TEST_ASSERT_EQUAL_UINT32(0, driver.getLateCount());
+
+    // The edge is consumed once
+    TEST_ASSERT_FALSE(driver.readLatest(reading));
+    TEST_ASSERT_EQUAL_UINT(start + 4, bus.ops.size());
+}
+
+// A burst that finishes a period or more after its edge raced a conversion
+// that raised no edge; the data registers are read again and that later
+// conversion is what comes back
+static void test_late_alert_rereads(void) {
+    static const uint8_t burst[] = {0x03, 0x20, 0x25, 0x80, 0x04, 0xB0, 0x04, 0x09};
+    static const uint8_t later[] = {0xFF, 0x38, 0x2E, 0xE0, 0x01, 0xF4};
+    static const uint8_t lateRegisters[] = {INA260_REG_CURRENT, INA260_REG_BUS_VOLTAGE, INA260_REG_POWER,
+                                            INA260_REG_MASK_ENABLE, INA260_REG_CURRENT, INA260_REG_BUS_VOLTAGE,
+                                            INA260_REG_POWER};
+    ScriptedBus bus;
+    bus.script(ID_REPLY, sizeof(ID_REPLY));
+    bus.script(burst, sizeof(burst));
+    bus.script(later, sizeof(later));
+    INA260Driver driver(bus, ADDRESS, ALERT_PIN);
+    // 280 us period
+    TEST_ASSERT_TRUE(driver.begin(INA260Averaging::Avg1, INA260ConversionTime::Us140,
+                                  INA260ConversionTime::Us140));
+    size_t start = bus.ops.size();
+
+    uint32_t before = hostMicros();
+    driver.raiseAlert();
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    INA260Reading reading;
+    TEST_ASSERT_TRUE(driver.readLatest(reading));
+    expectReads(bus, start, lateRegisters, 7);
+    TEST_ASSERT_EQUAL_FLOAT(-250.0f, reading.current);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, 15.0f, reading.voltage);
+    TEST_ASSERT_EQUAL_FLOAT(5000.0f, reading.power);
+    TEST_ASSERT_EQUAL_UINT32(1, driver.getLateCount());
+    TEST_ASSERT_EQUAL_UINT32(1, driver.getReadingCount());
+    // Stamped with when the later conversion was due, not with the edge
+    TEST_ASSERT_GREATER_OR_EQUAL(280, (int32_t)(reading.timestampMicros - before));
+}
+
+// With ALERT stuck, the driver falls back to polling after four quiet periods
+static void test_stalled_alert_polls(void) {
+    static const uint8_t poll[] = {0x04, 0x09, 0x03, 0x20, 0x25, 0x80, 0x04, 0xB0};
+    static const uint8_t pollRegisters[] = {INA260_REG_MASK_ENABLE, INA260_REG_CURRENT, INA260_REG_BUS_VOLTAGE,
+                                            INA260_REG_POWER};
+    ScriptedBus bus;
+    bus.script(ID_REPLY, sizeof(ID_REPLY));
+    bus.script(poll, sizeof(poll));
+    INA260Driver driver(bus, ADDRESS, ALERT_PIN);
+    TEST_ASSERT_TRUE(driver.begin(INA260Averaging::Avg1, INA260ConversionTime::Us140,
+                                  INA260ConversionTime::Us140));
+    size_t start = bus.ops.size();
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    INA260Reading reading;
+    TEST_ASSERT_TRUE(driver.readLatest(reading));
+    expectReads(bus, start, pollRegisters, 4);
+    TEST_ASSERT_EQUAL_FLOAT(1000.0f, reading.current);
+    TEST_ASSERT_EQUAL_UINT32(0, driver.getLateCount());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_config_words);
+    RUN_TEST(test_wrong_ids);
+    RUN_TEST(test_scaling);
+    RUN_TEST(test_alert_burst_order);
+    RUN_TEST(test_late_alert_rereads);
+    RUN_TEST(test_stalled_alert_polls);
+    return UNITY_END();
+}
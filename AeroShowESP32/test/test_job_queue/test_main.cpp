@@ -0,0 +1,148 @@
+// Queue and handover semantics the test scheduler relies on
+
+#include <unity.h>
+#include <string.h>
+#include "../../src/TestJobQueue.h"
+
+static TestJobQueue<3, 4> jobQueue;
+static TestJob job;
+
+void setUp(void) {
+    jobQueue = TestJobQueue<3, 4>();
+}
+
+void tearDown(void) {}
+
+static JobPushResult pushJob(const char* testId, int8_t priority, size_t channels, uint32_t& id) {
+    memset(job.testId, 0, sizeof(job.testId));
+    strncpy(job.testId, testId, sizeof(job.testId) - 1);
+    job.priority = priority;
+    for (size_t i = 0; i < RIG_MAX_CHANNELS; i++) {
+        job.active[i] = i < channels;
+    }
+    id = 0;
+    return jobQueue.push(job, id);
+}
+
+// ID of the queued job, 0 if it was refused
+static uint32_t queueJob(const char* testId, int8_t priority, size_t channels) {
+    uint32_t id;
+    return pushJob(testId, priority, channels, id) == JobPushResult::Queued ? id : 0;
+}
+
+// Priority first, arrival order within a priority
+static void test_priority_order(void) {
+    uint32_t a = queueJob("a", 0, 1);
+    uint32_t b = queueJob("b", 5, 1);
+    uint32_t c = queueJob("c", 0, 2);
+    TEST_ASSERT_TRUE(a != 0 && b != 0 && c != 0);
+    TEST_ASSERT_EQUAL_UINT32(3, jobQueue.size());
+    TEST_ASSERT_EQUAL_UINT32(b, jobQueue.at(0).id);
+    TEST_ASSERT_EQUAL_UINT32(a, jobQueue.at(1).id);
+    TEST_ASSERT_EQUAL_UINT32(c, jobQueue.at(2).id);
+    size_t position = 9;
+    TEST_ASSERT_TRUE(jobQueue.stateOf(c, &position) == JobState::Queued);
+    TEST_ASSERT_EQUAL_UINT32(2, position);
+}
+
+static void test_full_and_duplicate_refused(void) {
+    queueJob("a", 0, 1);
+    queueJob("b", 5, 1);
+    queueJob("c", 0, 2);
+    uint32_t refused;
+    TEST_ASSERT_TRUE(pushJob("d", 9, 1, refused) == JobPushResult::Full);
+    TEST_ASSERT_TRUE(jobQueue.full());
+    TEST_ASSERT_TRUE(pushJob("a", 0, 1, refused) == JobPushResult::Duplicate);
+    TEST_ASSERT_EQUAL_UINT32(0, refused);
+}
+
+// The running job keeps its test ID and frees a queue place
+static void test_one_running_at_a_time(void) {
+    queueJob("a", 0, 1);
+    uint32_t b = queueJob("b", 5, 1);
+    queueJob("c", 0, 2);
+    const TestJob* running = jobQueue.startNext();
+    TEST_ASSERT_NOT_NULL(running);
+    TEST_ASSERT_EQUAL_UINT32(b, running->id);
+    TEST_ASSERT_TRUE(jobQueue.running() == running);
+    TEST_ASSERT_NULL(jobQueue.startNext());
+    TEST_ASSERT_TRUE(queueJob("d", -3, 2) != 0);
+
+    uint32_t refused;
+    TEST_ASSERT_TRUE(pushJob("b", 0, 1, refused) == JobPushResult::Duplicate);
+    TEST_ASSERT_TRUE(jobQueue.stateOf(b) == JobState::Running);
+    TEST_ASSERT_EQUAL_UINT32(b, jobQueue.findId("b"));
+}
+
+static void test_cancel(void) {
+    uint32_t a = queueJob("a", 0, 1);
+    uint32_t b = queueJob("b", 5, 1);
+    uint32_t c = queueJob("c", 0, 2);
+    jobQueue.startNext();
+
+    bool wasRunning = true;
+    TEST_ASSERT_TRUE(jobQueue.cancel(a, wasRunning));
+    TEST_ASSERT_FALSE(wasRunning);
+    TEST_ASSERT_TRUE(jobQueue.stateOf(a) == JobState::Cancelled);
+    TEST_ASSERT_EQUAL_UINT32(1, jobQueue.size());
+    TEST_ASSERT_EQUAL_UINT32(c, jobQueue.at(0).id);
+    TEST_ASSERT_FALSE(jobQueue.cancel(a, wasRunning));
+
+    // A running job stays running until the scheduler has stopped it
+    TEST_ASSERT_TRUE(jobQueue.cancel(b, wasRunning));
+    TEST_ASSERT_TRUE(wasRunning);
+    TEST_ASSERT_TRUE(jobQueue.stateOf(b) == JobState::Running);
+    jobQueue.finishRunning(JobState::Cancelled);
+    TEST_ASSERT_TRUE(jobQueue.stateOf(b) == JobState::Cancelled);
+    TEST_ASSERT_NULL(jobQueue.running());
+    TEST_ASSERT_EQUAL_UINT32(2, jobQueue.getCancelled());
+}
+
+// c and d drive the same two channels, so c can hand its motors to d
+static void test_compatible_handover(void) {
+    uint32_t c = queueJob("c", 0, 2);
+    uint32_t d = queueJob("d", -3, 2);
+    const TestJob* running = jobQueue.startNext();
+    TEST_ASSERT_NOT_NULL(running);
+    TEST_ASSERT_EQUAL_UINT32(c, running->id);
+    TEST_ASSERT_NOT_NULL(jobQueue.next());
+    TEST_ASSERT_TRUE(running->compatibleWith(*jobQueue.next()));
+    jobQueue.finishRunning(JobState::Done);
+
+    running = jobQueue.startNext();
+    queueJob("e", 0, 1);
+    TEST_ASSERT_NOT_NULL(running);
+    TEST_ASSERT_EQUAL_UINT32(d, running->id);
+    TEST_ASSERT_FALSE(running->compatibleWith(*jobQueue.next()));
+    jobQueue.finishRunning(JobState::Done);
+    TEST_ASSERT_EQUAL_UINT32(2, jobQueue.getCompleted());
+}
+
+// History keeps the newest four finished jobs
+static void test_history(void) {
+    static const char* IDS[] = {"a", "b", "c", "d", "e"};
+    uint32_t ids[5];
+    for (size_t i = 0; i < 5; i++) {
+        ids[i] = queueJob(IDS[i], 0, 1);
+        jobQueue.startNext();
+        jobQueue.finishRunning(JobState::Done);
+    }
+    TEST_ASSERT_TRUE(jobQueue.stateOf(ids[0]) == JobState::Unknown);
+    for (size_t i = 1; i < 5; i++) {
+        TEST_ASSERT_TRUE(jobQueue.stateOf(ids[i]) == JobState::Done);
+    }
+    TEST_ASSERT_TRUE(jobQueue.stateOf(12345) == JobState::Unknown);
+    TEST_ASSERT_EQUAL_UINT32(0, jobQueue.size());
+    TEST_ASSERT_NULL(jobQueue.next());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_priority_order);
+    RUN_TEST(test_full_and_duplicate_refused);
+    RUN_TEST(test_one_running_at_a_time);
+    RUN_TEST(test_cancel);
+    RUN_TEST(test_compatible_handover);
+    RUN_TEST(test_history);
+    return UNITY_END();
+}
@@ -0,0 +1,294 @@
+// Live SSE stream against local clients in virtual time: each subscriber
+// gets its own rate, reduction and channel, a client that stops reading
+// never holds up publishing and has its missed intervals folded into the
+// next event and counted, and closed clients free their slot
+
+#include <unity.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include "../../src/LiveStream.h"
+#include "../../src/sim/SimClock.h"
+
+static const uint32_t SAMPLE_EVERY_MS = 1;  // RIG_DEFAULT_SAMPLE_HZ
+static const int SLOW_BUFFER_BYTES = 4096;
+
+void setUp(void) {}
+void tearDown(void) {}
+
+struct Event {
+    unsigned channel;
+    unsigned long timestampMs;
+    unsigned count;
+    unsigned ageMs;
+    unsigned dropped;
+    float loadCell[3];  // Newest sample's in Decimate mode, then min, mean, max
+};
+
+// The subscriber's end of a connection, reading whatever has arrived
+struct Client {
+    int fd = -1;
+    std::string input;
+    bool headSeen = false;
+    std::vector<Event> events;
+    size_t keepalives = 0;
+
+    // Connect to stream; the server end goes to the stream
+    bool connect(LiveStream& stream, float rateHz, LiveMode mode, uint8_t channel, int bufferBytes = 0) {
+        int fds[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+            return false;
+        }
+        if (bufferBytes > 0) {
+            setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &bufferBytes, sizeof(bufferBytes));
+            setsockopt(fds[1], SOL_SOCKET, SO_RCVBUF, &bufferBytes, sizeof(bufferBytes));
+        }
+        fd = fds[1];
+        if (!stream.subscribe(fds[0], rateHz, mode, channel)) {
+            ::close(fds[0]);
+            ::close(fds[1]);
+            fd = -1;
+            return false;
+        }
+        return true;
+    }
+
+    void read() {
+        char buffer[4096];
+        int n;
+        while ((n = recv(fd, buffer, sizeof(buffer), MSG_DONTWAIT)) > 0) {
+            input.append(buffer, n);
+        }
+        size_t end;
+        while ((end = input.find("\n\n")) != std::string::npos) {
+            parse(input.substr(0, end + 2));
+            input.erase(0, end + 2);
+        }
+    }
+
+    void close() {
+        ::close(fd);
+        fd = -1;
+    }
+
+    unsigned long samples() const {
+        unsigned long total = 0;
+        for (const Event& event : events) {
+            total += event.count;
+        }
+        return total;
+    }
+
+private:
+    void parse(const std::string& block) {
+        if (!headSeen) {
+            // Response head, then the reconnect delay
+            TEST_ASSERT_EQUAL_INT(0, block.find("HTTP/1.1 200 OK\r\n"));
+            TEST_ASSERT_TRUE(block.find("Content-Type: text/event-stream\r\n") != std::string::npos);
+            TEST_ASSERT_TRUE(block.find("\r\n\r\nretry: 2000\n\n") != std::string::npos);
+            headSeen = true;
+            return;
+        }
+        if (block == ": keepalive\n\n") {
+            keepalives++;
+            return;
+        }
+        Event event;
+        const char* data = strstr(block.c_str(), "data: ");
+        TEST_ASSERT_EQUAL_INT(0, block.find("event: sample\n"));
+        TEST_ASSERT_NOT_NULL(data);
+        TEST_ASSERT_EQUAL_INT(5, sscanf(data, "data: {\"ch\":%u,\"t\":%lu,\"n\":%u,\"age_ms\":%u,\"dropped\":%u",
+                                        &event.channel, &event.timestampMs, &event.count, &event.ageMs,
+                                        &event.dropped));
+        const char* loadCell = strstr(data, "\"load_cell\":");
+        TEST_ASSERT_NOT_NULL(loadCell);
+        if (sscanf(loadCell, "\"load_cell\":[%f,%f,%f]", &event.loadCell[0], &event.loadCell[1],
+                   &event.loadCell[2]) != 3) {
+            TEST_ASSERT_EQUAL_INT(1, sscanf(loadCell, "\"load_cell\":%f", &event.loadCell[0]));
+        }
+        events.push_back(event);
+    }
+};
+
+static SensorData sampleAt(uint8_t channel, uint32_t nowMs) {
+    SensorData sample;
+    sample.timestamp_us = (uint64_t)nowMs * 1000;
+    sample.channel = channel;
+    sample.load_cell = (float)(nowMs % 1000) + 1000.0f * channel;
+    sample.voltage = 16.0f;
+    sample.current = 1200.0f;
+    return sample;
+}
+
+// Sample every channel in channels each ms for durationMs, servicing the
+// stream as loop() does and letting the clients read every readEveryMs
+static uint32_t run(SimClock& clock, LiveStream& stream, uint8_t channels, uint32_t durationMs,
+                    std::vector<Client*> clients, uint32_t readEveryMs = 1) {
+    uint32_t published = 0;
+    for (uint32_t i = 0; i < durationMs; i++) {
+        clock.advanceMicros(SAMPLE_EVERY_MS * 1000);
+        for (uint8_t channel = 0; channel < channels; channel++) {
+            stream.publish(sampleAt(channel, clock.millis()));
+        }
+        published++;
+        stream.service();
+        if (clock.millis() % readEveryMs == 0) {
+            for (Client* client : clients) {
+                client->read();
+            }
+        }
+    }
+    return published;
+}
+
+static void closeAll(LiveStream& stream, std::vector<Client*> clients) {
+    for (Client* client : clients) {
+        client->close();
+    }
+    stream.service();
+    TEST_ASSERT_EQUAL_UINT32(0, stream.getSubscriberCount());
+}
+
+// Rates clamped to the limits, each client on its own channel or sharing
+// one, Decimate carrying the newest sample of each interval
+static void test_rates_and_channels_per_client(void) {
+    SimClock clock;
+    LiveStream stream(clock);
+    Client slow, fast, fastest, clamped;
+    TEST_ASSERT_TRUE(slow.connect(stream, 10.0f, LiveMode::Decimate, 0));
+    TEST_ASSERT_TRUE(fast.connect(stream, 50.0f, LiveMode::MinMax, 1));
+    TEST_ASSERT_TRUE(fastest.connect(stream, 500.0f, LiveMode::Decimate, 0));
+    TEST_ASSERT_TRUE(clamped.connect(stream, 0.1f, LiveMode::MinMax, 2));
+    TEST_ASSERT_EQUAL_UINT32(4, stream.getSubscriberCount());
+
+    uint32_t published = run(clock, stream, 3, 10000, {&slow, &fast, &fastest, &clamped});
+    struct Expected {
+        Client* client;
+        unsigned channel;
+        uint32_t intervalMs;
+    };
+    const Expected expected[] = {
+        {&slow, 0, 100}, {&fast, 1, 20}, {&fastest, 0, (uint32_t)(1000 / LIVE_MAX_RATE_HZ)},
+        {&clamped, 2, (uint32_t)(1000 / LIVE_MIN_RATE_HZ)}};
+    for (const Expected& e : expected) {
+        TEST_ASSERT_TRUE(e.client->headSeen);
+        TEST_ASSERT_EQUAL_UINT32(published / e.intervalMs, e.client->events.size());
+        TEST_ASSERT_EQUAL_UINT32(published, e.client->samples());
+        for (const Event& event : e.client->events) {
+            TEST_ASSERT_EQUAL_UINT32(e.channel, event.channel);
+            TEST_ASSERT_EQUAL_UINT32(e.intervalMs, event.count);
+            TEST_ASSERT_EQUAL_UINT32(0, event.ageMs);
+            TEST_ASSERT_EQUAL_UINT32(0, event.dropped);
+        }
+    }
+    for (const Event& event : slow.events) {
+        TEST_ASSERT_EQUAL_FLOAT(sampleAt(0, event.timestampMs).load_cell, event.loadCell[0]);
+    }
+    TEST_ASSERT_EQUAL_UINT32(0, stream.getDroppedEvents());
+    closeAll(stream, {&slow, &fast, &fastest, &clamped});
+}
+
+// Min, mean and max over each window of a sawtooth
+static void test_min_max_window(void) {
+    SimClock clock;
+    LiveStream stream(clock);
+    Client client;
+    TEST_ASSERT_TRUE(client.connect(stream, 4.0f, LiveMode::MinMax, 1));
+    run(clock, stream, 2, 2000, {&client});
+
+    TEST_ASSERT_EQUAL_UINT32(8, client.events.size());
+    for (const Event& event : client.events) {
+        // The window ending at t holds samples t-249 .. t
+        float first = sampleAt(1, event.timestampMs - 249).load_cell;
+        float last = sampleAt(1, event.timestampMs).load_cell;
+        float low = first < last ? first : 1000.0f;
+        float high = first < last ? last : 1999.0f;
+        TEST_ASSERT_EQUAL_UINT32(250, event.count);
+        TEST_ASSERT_FLOAT_WITHIN(0.05f, low, event.loadCell[0]);
+        TEST_ASSERT_FLOAT_WITHIN(0.05f, high, event.loadCell[2]);
+        if (first < last) {
+            TEST_ASSERT_FLOAT_WITHIN(0.1f, (first + last) / 2, event.loadCell[1]);
+        }
+    }
+    closeAll(stream, {&client});
+}
+
+// A client that stops reading for two seconds: publishing and servicing go
+// on, the intervals it misses are counted and folded into its next event,
+// and the other client is unaffected. Every sample is accounted for.
+static void test_slow_client_folds_and_counts(void) {
+    SimClock clock;
+    LiveStream stream(clock);
+    Client stalled, steady;
+    TEST_ASSERT_TRUE(stalled.connect(stream, LIVE_MAX_RATE_HZ, LiveMode::MinMax, 0, SLOW_BUFFER_BYTES));
+    TEST_ASSERT_TRUE(steady.connect(stream, LIVE_MAX_RATE_HZ, LiveMode::MinMax, 0, SLOW_BUFFER_BYTES));
+
+    uint32_t published = run(clock, stream, 1, 1000, {&stalled, &steady});
+    published += run(clock, stream, 1, 2000, {&steady});
+    uint32_t dropped = stream.getDroppedEvents();
+    TEST_ASSERT_TRUE(dropped > 0);
+    published += run(clock, stream, 1, 1000, {&stalled, &steady});
+    TEST_ASSERT_EQUAL_UINT32(dropped, stream.getDroppedEvents());
+
+    uint32_t intervalMs = (uint32_t)(1000 / LIVE_MAX_RATE_HZ);
+    TEST_ASSERT_EQUAL_UINT32(published / intervalMs, steady.events.size());
+    TEST_ASSERT_EQUAL_UINT32(published, steady.samples());
+
+    // Each event reports the drops so far; the event sent when the client
+    // caught up carries everything from the intervals it missed
+    unsigned maxCount = 0;
+    for (size_t i = 0; i < stalled.events.size(); i++) {
+        const Event& event = stalled.events[i];
+        maxCount = event.count > maxCount ? event.count : maxCount;
+        TEST_ASSERT_TRUE(i == 0 || event.dropped >= stalled.events[i - 1].dropped);
+    }
+    TEST_ASSERT_EQUAL_UINT32(dropped, stalled.events.back().dropped);
+    TEST_ASSERT_TRUE(maxCount > 1000);
+    TEST_ASSERT_EQUAL_UINT32(published, stalled.samples());
+    TEST_ASSERT_EQUAL_UINT32(published / intervalMs, stalled.events.size() + dropped);
+    closeAll(stream, {&stalled, &steady});
+}
+
+// Slots are freed when clients close, refused when all are taken, and an
+// idle stream is kept open with comments
+static void test_slots_and_keepalive(void) {
+    SimClock clock;
+    LiveStream stream(clock);
+    Client clients[LIVE_MAX_SUBSCRIBERS + 1];
+    for (size_t i = 0; i < LIVE_MAX_SUBSCRIBERS; i++) {
+        TEST_ASSERT_TRUE(clients[i].connect(stream, 10.0f, LiveMode::Decimate, 0));
+    }
+    TEST_ASSERT_FALSE(clients[LIVE_MAX_SUBSCRIBERS].connect(stream, 10.0f, LiveMode::Decimate, 0));
+
+    clients[1].close();
+    stream.service();
+    TEST_ASSERT_EQUAL_UINT32(LIVE_MAX_SUBSCRIBERS - 1, stream.getSubscriberCount());
+    TEST_ASSERT_TRUE(clients[1].connect(stream, 10.0f, LiveMode::Decimate, 3));
+
+    // No samples on channel 3 for a while: keepalives only
+    run(clock, stream, 1, 2 * LIVE_KEEPALIVE_MS, {&clients[0], &clients[1]}, 100);
+    TEST_ASSERT_EQUAL_UINT32(0, clients[1].events.size());
+    TEST_ASSERT_EQUAL_UINT32(2, clients[1].keepalives);
+    TEST_ASSERT_EQUAL_UINT32(0, clients[0].keepalives);
+    TEST_ASSERT_EQUAL_UINT32(2 * LIVE_KEEPALIVE_MS / 100, clients[0].events.size());
+
+    std::vector<Client*> open;
+    for (size_t i = 0; i < LIVE_MAX_SUBSCRIBERS; i++) {
+        open.push_back(&clients[i]);
+    }
+    closeAll(stream, open);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_rates_and_channels_per_client);
+    RUN_TEST(test_min_max_window);
+    RUN_TEST(test_slow_client_folds_and_counts);
+    RUN_TEST(test_slots_and_keepalive);
+    return UNITY_END();
+}
@@ -0,0 +1,177 @@
+// Load cell filter stages against synthetic traces, fixed point against a
+// double-precision reference on both sides of zero, and calibration with
+// its stored record
+
+#include <unity.h>
+#include <math.h>
+#include <algorithm>
+#include <vector>
+#include "../../src/LoadCellCalibration.h"
+#include "../../src/LoadCellFilter.h"
+#include "../../src/StepStats.h"
+#include "../../src/sim/SimLoadCell.h"
+
+void setUp(void) {}
+void tearDown(void) {}
+
+static std::vector<float> filterTrace(const LoadCellFilterConfig& config, const std::vector<int32_t>& trace) {
+    LoadCellFilter filter;
+    filter.configure(config);
+    std::vector<float> out;
+    for (int32_t counts : trace) {
+        filter.add(counts);
+        out.push_back(filter.value());
+    }
+    return out;
+}
+
+// The same chain in double precision, for the fixed-point comparison
+static std::vector<float> filterTraceReference(const LoadCellFilterConfig& config, const std::vector<int32_t>& trace) {
+    std::vector<float> out;
+    double ema = 0.0;
+    double estimate = 0.0;
+    double variance = 0.0;
+    for (size_t i = 0; i < trace.size(); i++) {
+        size_t first = i + 1 >= config.medianWindow ? i + 1 - config.medianWindow : 0;
+        std::vector<int32_t> window(trace.begin() + first, trace.begin() + i + 1);
+        std::sort(window.begin(), window.end());
+        double z = window[window.size() / 2];
+        if (i == 0) {
+            ema = estimate = z;
+            variance = config.measurementNoise;
+        } else {
+            ema += (z - ema) / (double)(1 << config.emaShift);
+            if (config.kalman) {
+                variance += config.processNoise;
+                double gain = variance / (variance + config.measurementNoise);
+                estimate += (ema - estimate) * gain;
+                variance *= 1.0 - gain;
+            } else {
+                estimate = ema;
+            }
+        }
+        out.push_back((float)estimate);
+    }
+    return out;
+}
+
+static float maxDifference(const std::vector<float>& a, const std::vector<float>& b) {
+    float worst = 0.0f;
+    for (size_t i = 0; i < a.size(); i++) {
+        worst = std::max(worst, fabsf(a[i] - b[i]));
+    }
+    return worst;
+}
+
+// Every stage at once, as the fixed-point and calibration cases configure it
+static LoadCellFilterConfig fullChain() {
+    LoadCellFilterConfig config;
+    config.medianWindow = 5;
+    config.emaShift = 3;
+    config.kalman = true;
+    config.processNoise = 50;
+    config.measurementNoise = 300;
+    return config;
+}
+
+// Median of 3 removes isolated glitches; without it they reach the output
+static void test_median(void) {
+    std::vector<int32_t> clean = loadCellTrace(false);
+    std::vector<int32_t> spiky = loadCellTrace(true);
+    LoadCellFilterConfig config;
+    config.medianWindow = 3;
+    config.emaShift = 2;
+    TEST_ASSERT_TRUE(maxDifference(filterTrace(config, spiky), filterTrace(config, clean)) < 60.0f);
+    config.medianWindow = 1;
+    TEST_ASSERT_TRUE(maxDifference(filterTrace(config, spiky), filterTrace(config, clean)) > 100000.0f);
+}
+
+// EMA at 1/4: a clean step is 95% there after 11 conversions, not 10
+static void test_ema(void) {
+    std::vector<int32_t> step(40, 0);
+    std::fill(step.begin() + 10, step.end(), 40000);
+    LoadCellFilterConfig config;
+    config.medianWindow = 1;
+    std::vector<float> response = filterTrace(config, step);
+    TEST_ASSERT_TRUE(response[10 + 9] < 38000.0f);
+    TEST_ASSERT_TRUE(response[10 + 10] >= 38000.0f);
+}
+
+// Kalman on the idle stretch: a third of the input scatter at most
+static void test_kalman(void) {
+    std::vector<int32_t> clean = loadCellTrace(false);
+    LoadCellFilterConfig config;
+    config.medianWindow = 1;
+    config.emaShift = 0;
+    config.kalman = true;
+    config.processNoise = 1;
+    config.measurementNoise = 300;
+    std::vector<float> settled = filterTrace(config, clean);
+    RunningStats in;
+    RunningStats out;
+    for (size_t i = 50; i < 100; i++) {
+        in.add((float)clean[i]);
+        out.add(settled[i]);
+    }
+    TEST_ASSERT_TRUE(out.stddev() * 3.0f < in.stddev());
+}
+
+// Fixed point against double precision, then the same trace below zero as a
+// cell pulled under its tare reads
+static void test_fixed_point(void) {
+    std::vector<int32_t> spiky = loadCellTrace(true);
+    LoadCellFilterConfig config = fullChain();
+    TEST_ASSERT_TRUE(maxDifference(filterTrace(config, spiky), filterTraceReference(config, spiky)) < 1.0f);
+
+    std::vector<int32_t> negative(spiky.size());
+    for (size_t i = 0; i < spiky.size(); i++) {
+        negative[i] = -spiky[i] - 60000;
+    }
+    std::vector<float> filtered = filterTrace(config, negative);
+    TEST_ASSERT_TRUE(maxDifference(filtered, filterTraceReference(config, negative)) < 1.0f);
+    TEST_ASSERT_TRUE(filtered.back() < -60000.0f);
+}
+
+// Three known weights with a stiffening cell: exact at the points, linear
+// between them and beyond, and the first slope below zero
+static void test_calibrate(void) {
+    LoadCellSettings settings;
+    settings.filter = fullChain();
+    LoadCellCalibration& calibration = settings.calibration;
+    TEST_ASSERT_TRUE(calibration.addPoint(42000, 100000));
+    TEST_ASSERT_TRUE(calibration.addPoint(4200, 10000));
+    TEST_ASSERT_TRUE(calibration.addPoint(84000, 205000));
+    TEST_ASSERT_FALSE(calibration.addPoint(4200, 11000));
+    TEST_ASSERT_FALSE(calibration.addPoint(0, 0));
+
+    TEST_ASSERT_EQUAL_FLOAT(10.0f, calibration.toGrams(4200.0f));
+    TEST_ASSERT_EQUAL_FLOAT(100.0f, calibration.toGrams(42000.0f));
+    TEST_ASSERT_EQUAL_FLOAT(205.0f, calibration.toGrams(84000.0f));
+    TEST_ASSERT_FLOAT_WITHIN(0.002f, 152.5f, calibration.toGrams(63000.0f));
+    TEST_ASSERT_FLOAT_WITHIN(0.005f, 310.0f, calibration.toGrams(126000.0f));
+    TEST_ASSERT_FLOAT_WITHIN(0.002f, -5.0f, calibration.toGrams(-2100.0f));
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, calibration.toGrams(0.0f));
+    TEST_ASSERT_EQUAL_FLOAT(-12.0f, LoadCellCalibration().toGrams(-12.0f));
+
+    // Stored record round trip; damaged records are refused
+    uint8_t record[LOAD_CELL_RECORD_BYTES];
+    loadCellEncodeRecord(settings, record);
+    LoadCellSettings loaded;
+    TEST_ASSERT_TRUE(loadCellDecodeRecord(record, sizeof(record), loaded));
+    TEST_ASSERT_TRUE(loaded.filter == settings.filter);
+    TEST_ASSERT_EQUAL_UINT32(3, loaded.calibration.count());
+    TEST_ASSERT_EQUAL_FLOAT(calibration.toGrams(63000.0f), loaded.calibration.toGrams(63000.0f));
+    record[1] = 4;  // Even median window
+    TEST_ASSERT_FALSE(loadCellDecodeRecord(record, sizeof(record), loaded));
+    TEST_ASSERT_FALSE(loadCellDecodeRecord(record, 10, loaded));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_median);
+    RUN_TEST(test_ema);
+    RUN_TEST(test_kalman);
+    RUN_TEST(test_fixed_point);
+    RUN_TEST(test_calibrate);
+    return UNITY_END();
+}
@@ -0,0 +1,201 @@
+// Ramp shapes through the motion profile, the engine handing the motor
+// from one profile to the next without stopping it, and a plan whose
+// source falls behind resuming where it stopped
+
+#include <unity.h>
+#include "../../src/MotionProfile.h"
+#include "../../src/sim/SimChannels.h"
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// Ramp from 0.1 up to 0.9 and back to 0.3 with the given shape, sampled
+// every millisecond: never the wrong way, never steeper than the shape allows
+static void checkShape(RampShape shape) {
+    static const float FROM = 0.1f;
+    static const float UP = 0.9f;
+    static const float DOWN = 0.3f;
+    static const uint32_t RAMP_MS = 1000;
+    // Steepest slope of each shape, relative to a linear ramp
+    float maxSlope = shape == RampShape::Trapezoid ? 1.0f / (1.0f - MOTION_TRAPEZOID_ACCEL_FRACTION)
+                   : shape == RampShape::SCurve    ? 1.875f
+                                                   : 1.0f;
+
+    MotionProfile profile;
+    profile.clear(FROM);
+    ProfileSegment segment;
+    segment.shape = shape;
+    segment.rampMs = RAMP_MS;
+    segment.holdMs = 500;
+    segment.target = UP;
+    profile.add(segment);
+    segment.target = DOWN;
+    segment.holdMs = 0;
+    profile.add(segment);
+
+    float previous = profile.evaluate(0).setpoint;
+    float limit = (UP - FROM) * maxSlope / RAMP_MS + 1e-4f;
+    for (uint64_t ms = 1; ms <= profile.durationMs(); ms++) {
+        ProfilePoint point = profile.evaluate(ms * 1000);
+        float change = point.setpoint - previous;
+        if (point.segment == 0) {
+            TEST_ASSERT_TRUE(change >= -1e-6f);
+        } else {
+            TEST_ASSERT_TRUE(change <= 1e-6f);
+        }
+        if (shape != RampShape::Step) {
+            TEST_ASSERT_FLOAT_WITHIN(limit, 0.0f, change);
+        }
+        previous = point.setpoint;
+    }
+
+    // Holds sit exactly on the target, and the profile ends on the last one
+    ProfilePoint hold = profile.evaluate((uint64_t)(RAMP_MS + 250) * 1000);
+    ProfilePoint end = profile.evaluate(profile.durationMs() * 1000);
+    TEST_ASSERT_TRUE(hold.holding);
+    TEST_ASSERT_EQUAL_FLOAT(UP, hold.setpoint);
+    TEST_ASSERT_TRUE(end.done);
+    TEST_ASSERT_EQUAL_FLOAT(DOWN, end.setpoint);
+}
+
+static void test_step(void) {
+    checkShape(RampShape::Step);
+}
+
+static void test_linear(void) {
+    checkShape(RampShape::Linear);
+}
+
+static void test_trapezoid(void) {
+    checkShape(RampShape::Trapezoid);
+}
+
+static void test_s_curve(void) {
+    checkShape(RampShape::SCurve);
+}
+
+// Play a profile on the sim rig's engine until it is done, returning the
+// lowest setpoint seen after the first millisecond
+static float playToEnd(Rig& rig) {
+    float lowest = 1.0f;
+    for (uint32_t ms = 0; rig.motion.isRunning(); ms++) {
+        rig.clock.advanceMicros(1000);
+        rig.motion.update();
+        if (ms > 0 && rig.motion.getSetpoint() < lowest) {
+            lowest = rig.motion.getSetpoint();
+        }
+    }
+    return lowest;
+}
+
+// start() begins from standstill, follow() from the setpoint the last
+// profile ended on, without the motor stopping
+static void test_follow_keeps_motor_spinning(void) {
+    Rig rig;
+    rig.motor.initialize();
+    MotionProfile first;
+    first.clear();
+    ProfileSegment segment;
+    segment.target = 0.6f;
+    segment.rampMs = 100;
+    segment.holdMs = 50;
+    first.add(segment);
+    MotionProfile second = first;
+    second.clear();
+    segment.target = 0.3f;
+    second.add(segment);
+
+    rig.motion.start(first);
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, rig.motion.getSetpoint());
+    playToEnd(rig);
+    rig.motion.follow(second);
+    TEST_ASSERT_EQUAL_FLOAT(0.6f, rig.motion.getSetpoint());
+    TEST_ASSERT_TRUE(playToEnd(rig) >= 0.3f);
+    TEST_ASSERT_EQUAL_FLOAT(0.3f, rig.motor.getSpeed());
+    rig.motion.stop();
+}
+
+// A plan longer than the engine's window: linear ramps of RAMP_MS to a
+// different target each, then a hold
+struct CountingSource : SegmentSource {
+    static const uint32_t RAMP_MS = 10;
+    static const uint32_t HOLD_MS = 10;
+    size_t total;
+    size_t given = 0;
+
+    explicit CountingSource(size_t total) : total(total) {}
+
+    static float targetOf(size_t i) { return 0.1f * (float)(i % 9 + 1); }
+
+    bool next(ProfileSegment& segment) override {
+        if (given >= total) {
+            return false;
+        }
+        segment.shape = RampShape::Linear;
+        segment.rampMs = RAMP_MS;
+        segment.holdMs = HOLD_MS;
+        segment.target = targetOf(given++);
+        return true;
+    }
+};
+
+// The window plays out before refill() is called: the last target holds
+// and the profile clock stops, so once refilled the next segment plays
+// from its start and no part of the plan is skipped or cut short
+static void test_starved_source_pauses(void) {
+    static const uint32_t STARVED_MS = 500;
+    static const uint32_t SEGMENT_MS = CountingSource::RAMP_MS + CountingSource::HOLD_MS;
+    Rig rig;
+    rig.motor.initialize();
+    CountingSource source(MOTION_MAX_SEGMENTS + 40);
+    TEST_ASSERT_TRUE(rig.motion.start(source));
+
+    uint32_t playedMs = 0;
+    while (rig.motion.getUnderruns() == 0) {
+        rig.clock.advanceMicros(1000);
+        rig.motion.update();
+        playedMs++;
+    }
+    TEST_ASSERT_EQUAL_UINT32(MOTION_MAX_SEGMENTS * SEGMENT_MS, playedMs);
+    for (uint32_t ms = 1; ms < STARVED_MS; ms++) {
+        rig.clock.advanceMicros(1000);
+        rig.motion.update();
+        TEST_ASSERT_TRUE(rig.motion.isRunning());
+        TEST_ASSERT_EQUAL_FLOAT(CountingSource::targetOf(MOTION_MAX_SEGMENTS - 1), rig.motion.getSetpoint());
+        TEST_ASSERT_EQUAL_UINT32(MOTION_MAX_SEGMENTS, rig.motion.getPoint().segment);
+    }
+    TEST_ASSERT_EQUAL_UINT32(STARVED_MS, rig.motion.getUnderruns());
+
+    // One millisecond into the first segment after the gap
+    rig.motion.refill();
+    rig.clock.advanceMicros(1000);
+    rig.motion.update();
+    float from = CountingSource::targetOf(MOTION_MAX_SEGMENTS - 1);
+    float to = CountingSource::targetOf(MOTION_MAX_SEGMENTS);
+    TEST_ASSERT_EQUAL_UINT32(MOTION_MAX_SEGMENTS, rig.motion.getPoint().segment);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, from + (to - from) / CountingSource::RAMP_MS, rig.motion.getSetpoint());
+
+    // The rest plays in full, with the source kept ahead
+    playedMs = 1;
+    while (rig.motion.isRunning()) {
+        rig.motion.refill();
+        rig.clock.advanceMicros(1000);
+        rig.motion.update();
+        playedMs++;
+    }
+    TEST_ASSERT_EQUAL_UINT32(STARVED_MS, rig.motion.getUnderruns());
+    TEST_ASSERT_EQUAL_UINT32(40 * SEGMENT_MS, playedMs);
+    TEST_ASSERT_EQUAL_FLOAT(CountingSource::targetOf(MOTION_MAX_SEGMENTS + 39), rig.motor.getSpeed());
+    rig.motion.stop();
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_step);
+    RUN_TEST(test_linear);
+    RUN_TEST(test_trapezoid);
+    RUN_TEST(test_s_curve);
+    RUN_TEST(test_follow_keeps_motor_spinning);
+    RUN_TEST(test_starved_source_pauses);
+    return UNITY_END();
+}
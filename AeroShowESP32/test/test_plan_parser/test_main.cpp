@@ -0,0 +1,229 @@
+// The streaming test plan parser: what it accepts and refuses, that key
+// order and chunking do not matter, that plans past RAM spill and play
+// every step through the motion engine, and that no plan size reaches the heap
+
+#include <unity.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../../src/HttpServer.h"
+#include "../../src/PlanParser.h"
+#include "../../src/sim/HeapCounter.h"
+#include "../../src/sim/SimChannels.h"
+#include "../../src/sim/SimPlans.h"
+
+static ArraySpill planSpill;
+static PlanParser planParser;
+static TestJob planJob;
+static TestJob otherJob;
+
+// HTTP_INPUT_BYTES, the pieces the server hands the body over in
+static const size_t PLAN_CHUNK_BYTES = HTTP_INPUT_BYTES;
+
+void setUp(void) {}
+void tearDown(void) {}
+
+static const char* parsePlan(TestJob& target, const std::string& body, size_t chunk, bool withSpill = true) {
+    planParser.begin(target, 2, withSpill ? &planSpill : nullptr, 7);
+    for (size_t at = 0; at < body.size(); at += chunk) {
+        planParser.feed(body.data() + at, std::min(chunk, body.size() - at));
+    }
+    return planParser.finish();
+}
+
+static void assertSegment(const ProfileSegment& a, float target, uint32_t rampMs, uint32_t holdMs, RampShape shape) {
+    TEST_ASSERT_FLOAT_WITHIN(0.5f / PLAN_THROTTLE_FULL, target, a.target);
+    TEST_ASSERT_EQUAL_UINT32(rampMs, a.rampMs);
+    TEST_ASSERT_EQUAL_UINT32(holdMs, a.holdMs);
+    TEST_ASSERT_TRUE(a.shape == shape);
+}
+
+// Field by field where a struct has padding, which memcmp would compare too
+static bool sameTable(const TestJob& a, const TestJob& b) {
+    for (size_t i = 0; i < RIG_MAX_CHANNELS; i++) {
+        const PlanChannel& x = a.plan.channels[i];
+        const PlanChannel& y = b.plan.channels[i];
+        if (x.first != y.first || x.count != y.count || x.holdMs != y.holdMs || x.rampMs != y.rampMs ||
+            x.shape != y.shape || x.durationMs != y.durationMs) {
+            return false;
+        }
+    }
+    return a.plan.stepCount == b.plan.stepCount &&
+           memcmp(a.plan.steps, b.plan.steps, std::min<size_t>(a.plan.stepCount, PLAN_RAM_STEPS) * sizeof(PlanStep)) == 0 &&
+           memcmp(a.active, b.active, sizeof(a.active)) == 0;
+}
+
+// The first speed ramps from standstill, the rest use ramp_ms and ramp_shape
+static void test_stepped_plan(void) {
+    const char* error = parsePlan(planJob, "{\"test_id\":\"t\",\"speeds\":[0,0.5,1],\"ramp_delay\":2000,"
+                                           "\"ramp_ms\":100,\"ramp_shape\":\"s_curve\"}", PLAN_CHUNK_BYTES);
+    TEST_ASSERT_NULL(error);
+    PlanReader reader;
+    reader.begin(planJob.plan, 0, nullptr);
+    ProfileSegment s0, s1, s2, s3;
+    TEST_ASSERT_TRUE(reader.next(s0) && reader.next(s1) && reader.next(s2));
+    TEST_ASSERT_FALSE(reader.next(s3));
+    TEST_ASSERT_TRUE(planJob.active[0]);
+    TEST_ASSERT_FALSE(planJob.active[1]);
+    assertSegment(s0, 0.0f, 0, 2000, RampShape::Linear);
+    assertSegment(s1, 0.5f, 100, 2000, RampShape::SCurve);
+    assertSegment(s2, 1.0f, 100, 2000, RampShape::SCurve);
+    TEST_ASSERT_EQUAL_UINT32(6200, planJob.plan.channels[0].durationMs);
+    TEST_ASSERT_EQUAL_UINT32(2000, planJob.rampDelay);
+}
+
+// The defaults may come after the speeds; byte by byte is the same as whole
+static void test_key_order_and_chunking(void) {
+    TEST_ASSERT_NULL(parsePlan(planJob, "{\"test_id\":\"t\",\"speeds\":[0,0.5,1],\"ramp_delay\":2000,"
+                                        "\"ramp_ms\":100,\"ramp_shape\":\"s_curve\"}", PLAN_CHUNK_BYTES));
+    TEST_ASSERT_NULL(parsePlan(otherJob, "{\"ramp_shape\":\"s_curve\",\"ramp_ms\":100, \"speeds\" : [ 0 , 0.5 , 1 ] ,"
+                                         "\"test_id\":\"t\",\"ramp_delay\":2000}", 1));
+    TEST_ASSERT_TRUE(sameTable(planJob, otherJob));
+}
+
+// Segments on two channels, listed out of order, plus options
+static void test_channels_and_options(void) {
+    const char* error = parsePlan(planJob, "{\"test_id\":\"m\",\"channels\":[{\"segments\":[{\"speed\":0.3,\"ramp_ms\":500,"
+                                           "\"hold_ms\":1000,\"shape\":\"trapezoid\"},{\"speed\":0.1}],\"channel\":1},"
+                                           "{\"channel\":0,\"speeds\":[0.2],\"ramp_delay\":10,\"extra\":{\"a\":[1,{}]}}],"
+                                           "\"priority\":-3,\"format\":\"binary\",\"overflow\":\"block\","
+                                           "\"keep_spinning\":true,\"summary_only\":false,"
+                                           "\"test_id_note\":\"x\\u00e9\\\"\"}",
+                                  PLAN_CHUNK_BYTES);
+    TEST_ASSERT_NULL(error);
+    PlanReader reader;
+    ProfileSegment s0, s1, s2, s3;
+    reader.begin(planJob.plan, 1, nullptr);
+    TEST_ASSERT_TRUE(reader.next(s0) && reader.next(s1));
+    TEST_ASSERT_FALSE(reader.next(s2));
+    reader.begin(planJob.plan, 0, nullptr);
+    TEST_ASSERT_TRUE(reader.next(s2));
+    TEST_ASSERT_FALSE(reader.next(s3));
+    TEST_ASSERT_TRUE(planJob.active[0] && planJob.active[1]);
+    assertSegment(s0, 0.3f, 500, 1000, RampShape::Trapezoid);
+    assertSegment(s1, 0.1f, 0, 0, RampShape::Linear);
+    assertSegment(s2, 0.2f, PLAN_INITIAL_RAMP_MS, 10, RampShape::Linear);
+    TEST_ASSERT_EQUAL_INT(-3, planJob.priority);
+    TEST_ASSERT_TRUE(planJob.format == TelemetryFormat::Binary);
+    TEST_ASSERT_TRUE(planJob.overflow == OverflowPolicy::Block);
+    TEST_ASSERT_TRUE(planJob.keepSpinning);
+    TEST_ASSERT_EQUAL_UINT32(1500, planJob.plan.channels[1].durationMs);
+    TEST_ASSERT_EQUAL_UINT32(0, planJob.rampDelay);
+}
+
+static void test_string_escapes(void) {
+    TEST_ASSERT_NULL(parsePlan(planJob, "{\"test_id\":\"a\\\"b\\u00e9\",\"speeds\":[0.5],\"ramp_delay\":1}",
+                               PLAN_CHUNK_BYTES));
+    TEST_ASSERT_EQUAL_STRING("a\"b\xc3\xa9", planJob.testId);
+}
+
+// Refusals, with the messages the API has always given
+static void test_bad_plans_refused(void) {
+    static const struct {
+        const char* body;
+        const char* error;
+    } REFUSED[] = {
+        {"", "No data received"},
+        {"{\"test_id\":\"x\",\"speeds\":[0.5]", "Invalid JSON"},
+        {"{\"test_id\":\"x\",\"speeds\":[0.5],\"ramp_delay\":1} x", "Invalid JSON"},
+        {"{\"test_id\":\"x\",\"speeds\":[0.5,],\"ramp_delay\":1}", "Invalid JSON"},
+        {"{\"speeds\":[0.5],\"ramp_delay\":1}", "Missing or invalid required fields"},
+        {"{\"test_id\":\"x\",\"speeds\":[0.5]}", "Missing or invalid required fields"},
+        {"{\"test_id\":\"x\",\"channels\":[]}", "Missing or invalid required fields"},
+        {"{\"test_id\":\"0123456789012345678901234567890123456789012345678901234567890123\",\"speeds\":[0.5],"
+         "\"ramp_delay\":1}", "test_id too long"},
+        {"{\"test_id\":\"x\",\"speeds\":[1.5],\"ramp_delay\":1}", "Invalid speed profile"},
+        {"{\"test_id\":\"x\",\"speeds\":[0.5],\"ramp_delay\":1,\"ramp_shape\":\"zigzag\"}", "Invalid speed profile"},
+        {"{\"test_id\":\"x\",\"segments\":[]}", "Invalid speed profile"},
+        {"{\"test_id\":\"x\",\"segments\":[{\"speed\":0.5,\"ramp_ms\":70000}]}", "Invalid speed profile"},
+        {"{\"test_id\":\"x\",\"channels\":[{\"channel\":2,\"speeds\":[0.5],\"ramp_delay\":1}]}", "Invalid channel"},
+        {"{\"test_id\":\"x\",\"channels\":[{\"channel\":0,\"speeds\":[0.5],\"ramp_delay\":1},"
+         "{\"channel\":0,\"speeds\":[0.5],\"ramp_delay\":1}]}", "Invalid channel"},
+        {"{\"test_id\":\"x\",\"speeds\":[0.5],\"ramp_delay\":1,\"format\":\"xml\"}", "Unsupported format"},
+        {"{\"test_id\":\"x\",\"speeds\":[0.5],\"ramp_delay\":1,\"overflow\":\"drop\"}", "Unsupported overflow policy"},
+        {"{\"test_id\":\"x\",\"speeds\":[0.5],\"ramp_delay\":1,\"summary_only\":1}", "summary_only must be a boolean"},
+        {"{\"test_id\":\"x\",\"speeds\":[0.5],\"ramp_delay\":1,\"priority\":300}",
+         "priority must be an integer from -128 to 127"},
+        {"{\"test_id\":\"x\",\"speeds\":[0.5],\"ramp_delay\":1,\"keep_spinning\":\"yes\"}",
+         "keep_spinning must be a boolean"},
+    };
+    for (size_t i = 0; i < sizeof(REFUSED) / sizeof(REFUSED[0]); i++) {
+        const char* error = parsePlan(planJob, REFUSED[i].body, PLAN_CHUNK_BYTES);
+        TEST_ASSERT_NOT_NULL_MESSAGE(error, REFUSED[i].body);
+        TEST_ASSERT_EQUAL_STRING_MESSAGE(REFUSED[i].error, error, REFUSED[i].body);
+        TEST_ASSERT_FALSE(planParser.isTooLarge());
+    }
+}
+
+// Past RAM with nowhere to spill, and past PLAN_MAX_STEPS with somewhere
+static void test_too_large_refused(void) {
+    TEST_ASSERT_NOT_NULL(parsePlan(planJob, planBody(PLAN_RAM_STEPS + 1, false), PLAN_CHUNK_BYTES, false));
+    TEST_ASSERT_TRUE(planParser.isTooLarge());
+    TEST_ASSERT_NOT_NULL(parsePlan(planJob, planBody(PLAN_MAX_STEPS + 1, false), PLAN_CHUNK_BYTES));
+    TEST_ASSERT_TRUE(planParser.isTooLarge());
+    TEST_ASSERT_FALSE(planSpill.exists);
+}
+
+// A long plan streams through the engine's window from the spill: every
+// step is held at its target, in order, and the window never runs dry
+static void test_spilled_plan_plays(void) {
+    const size_t steps = 20000;
+    TEST_ASSERT_NULL(parsePlan(planJob, planBody(steps, true), PLAN_CHUNK_BYTES));
+    TEST_ASSERT_TRUE(planJob.plan.spilled());
+
+    Rig rig;
+    rig.motor.initialize();
+    PlanReader reader;
+    reader.begin(planJob.plan, 0, &planSpill);
+    rig.motion.start(reader);
+    size_t held = 0;
+    int lastHeld = -1;
+    uint64_t ms = 0;
+    for (; rig.motion.isRunning(); ms++) {
+        rig.clock.advanceMicros(1000);
+        rig.motion.update();
+        rig.motion.refill();
+        ProfilePoint point = rig.motion.getPoint();
+        if (point.holding && (int)point.segment != lastHeld) {
+            lastHeld = (int)point.segment;
+            char sent[16];
+            snprintf(sent, sizeof(sent), "%.4f", planBodyTarget(point.segment));
+            float expected = PlanStep::quantize(strtof(sent, nullptr)) / (float)PLAN_THROTTLE_FULL;
+            TEST_ASSERT_EQUAL_UINT32(held, point.segment);
+            TEST_ASSERT_FLOAT_WITHIN(1e-6f, expected, point.setpoint);
+            held++;
+        }
+    }
+    rig.motion.stop();
+    TEST_ASSERT_EQUAL_UINT32(steps, held);
+    TEST_ASSERT_EQUAL_UINT32(0, rig.motion.getUnderruns());
+    TEST_ASSERT_EQUAL_UINT32(planJob.plan.channels[0].durationMs, (uint32_t)ms);
+}
+
+// RAM is the parser and the job whatever the length; nothing reaches the heap
+static void test_no_heap_at_any_size(void) {
+    static const size_t SIZES[] = {100, 1000, 10000, 50000};
+    for (int segments = 0; segments < 2; segments++) {
+        for (size_t i = 0; i < sizeof(SIZES) / sizeof(SIZES[0]); i++) {
+            std::string body = planBody(SIZES[i], segments != 0);
+            size_t before = heapAllocations();
+            const char* error = parsePlan(planJob, body, PLAN_CHUNK_BYTES);
+            TEST_ASSERT_EQUAL_UINT32(0, heapAllocations() - before);
+            TEST_ASSERT_NULL(error);
+            TEST_ASSERT_EQUAL_UINT32(SIZES[i], planJob.plan.stepCount);
+        }
+    }
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_stepped_plan);
+    RUN_TEST(test_key_order_and_chunking);
+    RUN_TEST(test_channels_and_options);
+    RUN_TEST(test_string_escapes);
+    RUN_TEST(test_bad_plans_refused);
+    RUN_TEST(test_too_large_refused);
+    RUN_TEST(test_spilled_plan_plays);
+    RUN_TEST(test_no_heap_at_any_size);
+    return UNITY_END();
+}
@@ -0,0 +1,213 @@
+// The rig scheduler on a shared I2C bus: every channel at its sample rate
+// when the bus has room, an even shortfall when it does not, timer pacing
+// that does not drift over ten virtual minutes, and interleaved samples
+// surviving the upload frame
+
+#include <unity.h>
+#include <math.h>
+#include <algorithm>
+#include <vector>
+#include "../../src/I2CBus.h"
+#include "../../src/TelemetryFrame.h"
+#include "../../src/sim/SimChannels.h"
+
+static const uint32_t SCHEDULE_TICK_US = 1000;       // FreeRTOS tick
+static const uint32_t SCHEDULE_MAX_BUSY_US = 10000;  // SAMPLING_MAX_BUSY_MS
+static const uint32_t SCHEDULE_RUN_MS = 10000;
+static const uint32_t PACING_RUN_S = 600;
+static const uint32_t PACING_STALL_EVERY = 4096;  // Timer wakeups between 2 ms stalls (flash, WiFi)
+static const uint32_t PACING_STALL_US = 2000;
+static const size_t BATCH_SAMPLES = 500;
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// What the sampling task does between polls: sleep until the deadline timer
+// fires wakeMicros late, or when already behind go again at once, yielding
+// a tick after SCHEDULE_MAX_BUSY_US without sleeping
+static void paceToNextDeadline(SimClock& clock, TestRig& rig, uint32_t wakeMicros, uint64_t& awakeSince) {
+    uint64_t due = rig.getNextDueMicros();
+    uint64_t now = clock.micros64();
+    if (due > now) {
+        clock.advanceMicros(due - now + wakeMicros);
+        awakeSince = clock.micros64();
+    } else if (now - awakeSince >= SCHEDULE_MAX_BUSY_US) {
+        clock.advanceMicros(SCHEDULE_TICK_US);
+        awakeSince = clock.micros64();
+    }
+}
+
+// Samples encoded as one frame, decoded field by field and encoded again to
+// the same bytes
+static void assertFrameRoundTrip(const std::vector<SensorData>& samples) {
+    std::vector<uint8_t> frame;
+    std::vector<uint8_t> again;
+    telemetryEncodeBatch("rig", samples.data(), samples.size(), 0, frame);
+    TelemetryDecoder decoder(frame.data(), frame.size());
+    TelemetryHeader header;
+    std::vector<SensorData> decoded(samples.size());
+    TEST_ASSERT_TRUE(decoder.readHeader(header));
+    TEST_ASSERT_EQUAL_UINT32(samples.size(), header.sampleCount);
+    TEST_ASSERT_TRUE(header.baseTimestampUs == samples[0].timestamp_us);
+    for (size_t i = 0; i < samples.size(); i++) {
+        TEST_ASSERT_TRUE(decoder.readSample(decoded[i]));
+        TEST_ASSERT_EQUAL_UINT8(samples[i].channel, decoded[i].channel);
+        TEST_ASSERT_TRUE(decoded[i].timestamp_us == samples[i].timestamp_us);
+        TEST_ASSERT_EQUAL_UINT32(samples[i].jitter_us, decoded[i].jitter_us);
+        TEST_ASSERT_EQUAL_UINT32(samples[i].missed, decoded[i].missed);
+    }
+    TEST_ASSERT_TRUE(decoder.atEnd());
+    telemetryEncodeBatch("rig", decoded.data(), decoded.size(), 0, again);
+    TEST_ASSERT_TRUE(again == frame);
+}
+
+// Every channel of a full rig at rateHz, their INA260s sharing one bus
+// clocked at i2cClockHz, paced like the sampling task. Each channel must
+// get its rate within 1% with no deadline missed; on an overloaded bus the
+// shortfall must instead be shared evenly.
+static void checkScheduling(uint32_t rateHz, uint32_t i2cClockHz, bool overloaded) {
+    SimClock clock;
+    SimSharedBus bus(clock, i2cClockHz);
+    SimChannel* channels[RIG_MAX_CHANNELS];
+    TestRig rig(clock);
+    for (size_t i = 0; i < RIG_MAX_CHANNELS; i++) {
+        channels[i] = new SimChannel((uint8_t)i, clock, bus);
+        channels[i]->channel.setPowerReady(channels[i]->ina260.begin());
+        channels[i]->motor.initialize();
+        channels[i]->motor.setSpeed(0.2f + 0.2f * i);
+        rig.addChannel(channels[i]->channel);
+    }
+    rig.setSampleRateHz(rateHz);
+
+    std::vector<SensorData> samples;
+    SensorData taken[RIG_MAX_CHANNELS];
+    uint32_t start = clock.micros();
+    uint64_t awakeSince = clock.micros64();
+    while ((uint64_t)(clock.micros() - start) < (uint64_t)SCHEDULE_RUN_MS * 1000) {
+        size_t n = rig.poll(taken, RIG_MAX_CHANNELS);
+        samples.insert(samples.end(), taken, taken + n);
+        paceToNextDeadline(clock, rig, 20, awakeSince);
+    }
+
+    uint32_t expected = (uint32_t)((uint64_t)rateHz * SCHEDULE_RUN_MS / 1000);
+    uint32_t fewest = UINT32_MAX;
+    uint32_t most = 0;
+    for (size_t i = 0; i < rig.channelCount(); i++) {
+        uint32_t got = rig.getSamples(i);
+        fewest = std::min(fewest, got);
+        most = std::max(most, got);
+        if (!overloaded) {
+            TEST_ASSERT_UINT32_WITHIN(expected / 100, expected, got);
+            TEST_ASSERT_EQUAL_UINT32(0, rig.getMissed(i));
+            TEST_ASSERT_TRUE(rig.getMaxLatenessMicros(i) < 1000000 / rateHz);
+        }
+    }
+    // No channel is served ahead of the others, and an overloaded bus must
+    // really fall short or the case tests nothing
+    TEST_ASSERT_TRUE(most - fewest <= most / 100);
+    if (overloaded) {
+        TEST_ASSERT_TRUE(most * 100 < expected * 99);
+    }
+
+    // Channels interleave in the frame, each with its own delta state
+    samples.resize(std::min(samples.size(), BATCH_SAMPLES));
+    assertFrameRoundTrip(samples);
+
+    for (size_t i = 0; i < RIG_MAX_CHANNELS; i++) {
+        delete channels[i];
+    }
+}
+
+// The clock the firmware sets
+static void test_four_channels_at_firmware_clock(void) {
+    checkScheduling(1000, I2C_CLOCK_HZ, false);
+}
+
+static void test_four_channels_at_1_mhz(void) {
+    checkScheduling(1000, 1000000, false);
+}
+
+// The Wire default, too slow for four channels at 1 kHz
+static void test_overloaded_bus_shares_shortfall(void) {
+    checkScheduling(1000, 100000, true);
+}
+
+// Ten virtual minutes of timer-paced acquisition: the timer wakes the
+// sampling task 5-45 us late, with a 2 ms stall every PACING_STALL_EVERY
+// wakeups. Every sample's deadline (timestamp - jitter) must sit within a
+// microsecond of its channel's ideal grid to the end of the run, samples
+// plus missed deadlines must account for every deadline, and a batch
+// spanning a stall must keep its timing through the upload frame.
+static void checkPacing(uint32_t rateHz, size_t channelCount) {
+    SimClock clock;
+    SimSharedBus bus(clock, I2C_CLOCK_HZ);
+    SimChannel* channels[RIG_MAX_CHANNELS];
+    TestRig rig(clock);
+    for (size_t i = 0; i < channelCount; i++) {
+        channels[i] = new SimChannel((uint8_t)i, clock, bus);
+        channels[i]->channel.setPowerReady(channels[i]->ina260.begin());
+        channels[i]->motor.initialize();
+        rig.addChannel(channels[i]->channel);
+    }
+    rig.setSampleRateHz(rateHz);
+    uint64_t start = clock.micros64();
+    uint64_t end = start + (uint64_t)PACING_RUN_S * 1000000;
+    uint64_t awakeSince = start;
+
+    uint64_t nextIndex[RIG_MAX_CHANNELS] = {0};
+    double drift = 0.0;
+    std::vector<SensorData> framed;
+    SensorData readings[RIG_MAX_CHANNELS];
+    uint32_t rng = 1;
+    for (uint32_t wakeups = 1; clock.micros64() < end; wakeups++) {
+        size_t n = rig.poll(readings, RIG_MAX_CHANNELS);
+        for (size_t k = 0; k < n; k++) {
+            const SensorData& reading = readings[k];
+            uint64_t index = nextIndex[reading.channel] + reading.missed;
+            // Channels are staggered by whole microseconds from the start
+            uint64_t phase = (uint64_t)1000000 * reading.channel / ((uint64_t)rateHz * channelCount);
+            double ideal = (double)(start + phase) + 1e6 * (double)index / rateHz;
+            drift = std::max(drift, fabs((double)(reading.timestamp_us - reading.jitter_us) - ideal));
+            nextIndex[reading.channel] = index + 1;
+            if (wakeups > PACING_STALL_EVERY - 100 && framed.size() < BATCH_SAMPLES) {
+                framed.push_back(reading);
+            }
+        }
+        rng = rng * 1664525u + 1013904223u;
+        uint32_t late = 5 + (rng >> 16) % 41 + (wakeups % PACING_STALL_EVERY == 0 ? PACING_STALL_US : 0);
+        paceToNextDeadline(clock, rig, late, awakeSince);
+    }
+
+    TEST_ASSERT_TRUE(drift < 1.0);
+    uint64_t expected = (uint64_t)rateHz * PACING_RUN_S;
+    for (size_t i = 0; i < channelCount; i++) {
+        TEST_ASSERT_TRUE(rig.getSamples(i) + rig.getMissed(i) == nextIndex[i]);
+        TEST_ASSERT_TRUE(nextIndex[i] + 1 >= expected && nextIndex[i] <= expected + 1);
+    }
+    assertFrameRoundTrip(framed);
+
+    for (size_t i = 0; i < channelCount; i++) {
+        delete channels[i];
+    }
+}
+
+// Four channels at 1 kHz leave a 400 kHz bus no room for the timer's
+// lateness, so the full rig paces at 500 Hz
+static void test_pacing_full_rig(void) {
+    checkPacing(500, RIG_MAX_CHANNELS);
+}
+
+// A period that is not a whole microsecond
+static void test_pacing_fractional_period(void) {
+    checkPacing(3000, 1);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_four_channels_at_firmware_clock);
+    RUN_TEST(test_four_channels_at_1_mhz);
+    RUN_TEST(test_overloaded_bus_shares_shortfall);
+    RUN_TEST(test_pacing_full_rig);
+    RUN_TEST(test_pacing_fractional_period);
+    return UNITY_END();
+}
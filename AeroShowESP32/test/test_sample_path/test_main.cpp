@@ -0,0 +1,80 @@
+// The per-sample path in steady state: sample, ring, step statistics,
+// batch encoding and log lines, with no heap use once running
+
+#include <unity.h>
+#include <stdio.h>
+#include <vector>
+#include "../../src/LogRing.h"
+#include "../../src/SampleRing.h"
+#include "../../src/StepStats.h"
+#include "../../src/TelemetryFrame.h"
+#include "../../src/sim/HeapCounter.h"
+#include "../../src/sim/SimChannels.h"
+
+static const size_t SOAK_SAMPLES = 200000;
+static const size_t BATCH_SAMPLES = 256;  // UPLOAD_BATCH_CAPACITY
+static const uint32_t SAMPLE_PERIOD_US = 1000;
+static const int32_t COUNTS_PER_10G = 4200;  // SimHX711's 420 counts per gram
+
+static SampleRing<SensorData, 256> ring;  // SAMPLE_RING_CAPACITY
+static LogRing<100, 120> logRing;
+static SensorData batch[BATCH_SAMPLES];
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// loop()'s share of a running test: drain the ring into the step statistics
+// and a batch, encode full batches and log them
+static void test_soak_without_heap(void) {
+    Rig rig;
+    TEST_ASSERT_TRUE(rig.begin());
+    rig.motor.initialize();
+    rig.motor.setSpeed(0.5f);
+
+    // The frame buffer grows to a full batch once, before steady state
+    std::vector<uint8_t> frame;
+    telemetryEncodeBatch("sim", batch, BATCH_SAMPLES, TELEMETRY_FLAG_LOAD_CELL_READY, frame);
+
+    StepAggregator stats;
+    LoadCellCalibration calibration;
+    calibration.addPoint(COUNTS_PER_10G, 10000);
+    size_t batched = 0;
+    size_t frames = 0;
+    char line[256];
+    SensorData popped;
+
+    size_t before = heapAllocations();
+    stats.begin(0, 0.5f, rig.clock.millis(), calibration);
+    for (size_t i = 0; i < SOAK_SAMPLES; i++) {
+        rig.clock.advanceMicros(SAMPLE_PERIOD_US);
+        ring.push(rig.sample());
+        while (ring.pop(popped)) {
+            stats.add(popped);
+            batch[batched++] = popped;
+        }
+        if (batched == BATCH_SAMPLES) {
+            telemetryEncodeBatch("sim", batch, batched, TELEMETRY_FLAG_LOAD_CELL_READY, frame);
+            snprintf(line, sizeof(line), "Queueing %u data points, %u bytes", (unsigned)batched,
+                     (unsigned)frame.size());
+            logRing.append(line);
+            batched = 0;
+            frames++;
+        }
+    }
+    StepSummary summary = stats.finish(rig.clock.millis());
+    snprintf(line, sizeof(line), "Step %u: %lu samples, thrust %.1fg", (unsigned)summary.step,
+             (unsigned long)summary.samples, summary.thrust.mean);
+    logRing.append(line);
+    TEST_ASSERT_EQUAL_UINT32(0, heapAllocations() - before);
+
+    TEST_ASSERT_EQUAL_UINT32(SOAK_SAMPLES / BATCH_SAMPLES, frames);
+    TEST_ASSERT_EQUAL_UINT32(SOAK_SAMPLES, summary.samples);
+    TEST_ASSERT_EQUAL_UINT32(frames + 1, logRing.getTotal());
+    TEST_ASSERT_TRUE(summary.thrust.mean > 0.0f);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_soak_without_heap);
+    return UNITY_END();
+}
@@ -0,0 +1,242 @@
+// SampleRing overflow policies: exact counters and contents from one
+// thread, then a producer and a consumer thread, as the sampling task and
+// loop() use it. Items are larger than a word and carry their sequence
+// number in every field, so a copy torn by the producer overwriting its
+// slot would show.
+
+#include <unity.h>
+#include <atomic>
+#include <thread>
+#include "../../src/SampleRing.h"
+
+static const size_t RING_CAPACITY = 64;
+static const uint32_t STRESS_ITEMS = 2000000;
+static const uint32_t HEAD_START = 4 * RING_CAPACITY;  // Items pushed before the consumer starts
+
+struct Item {
+    uint32_t sequence;
+    uint32_t check[15];
+
+    static Item make(uint32_t sequence) {
+        Item item;
+        item.sequence = sequence;
+        for (size_t i = 0; i < 15; i++) {
+            item.check[i] = sequence * (uint32_t)(i + 3) ^ 0xA5A5A5A5u;
+        }
+        return item;
+    }
+
+    bool intact() const {
+        for (size_t i = 0; i < 15; i++) {
+            if (check[i] != (sequence * (uint32_t)(i + 3) ^ 0xA5A5A5A5u)) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+static SampleRing<Item, RING_CAPACITY> ring;
+
+void setUp(void) {
+    Item discarded;
+    while (ring.pop(discarded)) {
+    }
+    ring.resetCounters();
+}
+
+void tearDown(void) {}
+
+// Push count items numbered from first, returning how many were stored
+static uint32_t pushRun(uint32_t first, uint32_t count) {
+    uint32_t stored = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        stored += ring.push(Item::make(first + i)) ? 1 : 0;
+    }
+    return stored;
+}
+
+// Pop everything, checking the items run on from first
+static void assertQueued(uint32_t first, uint32_t count) {
+    TEST_ASSERT_EQUAL_UINT32(count, ring.size());
+    Item item;
+    for (uint32_t i = 0; i < count; i++) {
+        TEST_ASSERT_TRUE(ring.pop(item));
+        TEST_ASSERT_TRUE(item.intact());
+        TEST_ASSERT_EQUAL_UINT32(first + i, item.sequence);
+    }
+    TEST_ASSERT_FALSE(ring.pop(item));
+    TEST_ASSERT_TRUE(ring.empty());
+}
+
+static void test_policy_names(void) {
+    OverflowPolicy policy = OverflowPolicy::Block;
+    TEST_ASSERT_TRUE(parseOverflowPolicy("drop_newest", policy));
+    TEST_ASSERT_TRUE(policy == OverflowPolicy::DropNewest);
+    TEST_ASSERT_TRUE(parseOverflowPolicy("overwrite_oldest", policy));
+    TEST_ASSERT_TRUE(policy == OverflowPolicy::OverwriteOldest);
+    TEST_ASSERT_TRUE(parseOverflowPolicy("block", policy));
+    TEST_ASSERT_TRUE(policy == OverflowPolicy::Block);
+    TEST_ASSERT_FALSE(parseOverflowPolicy("drop_oldest", policy));
+    TEST_ASSERT_TRUE(policy == OverflowPolicy::Block);
+}
+
+// A full ring turns away each new item and keeps the oldest
+static void test_drop_newest_counters(void) {
+    ring.setPolicy(OverflowPolicy::DropNewest);
+    TEST_ASSERT_EQUAL_UINT32(RING_CAPACITY, pushRun(0, RING_CAPACITY + 10));
+    TEST_ASSERT_EQUAL_UINT32(10, ring.getDropped());
+    TEST_ASSERT_EQUAL_UINT32(0, ring.getOverwritten());
+    TEST_ASSERT_EQUAL_UINT32(0, ring.getBlocked());
+    assertQueued(0, RING_CAPACITY);
+
+    // Room again once drained; the counter runs on until reset
+    TEST_ASSERT_EQUAL_UINT32(RING_CAPACITY, pushRun(100, RING_CAPACITY + 1));
+    TEST_ASSERT_EQUAL_UINT32(11, ring.getDropped());
+    ring.resetCounters();
+    TEST_ASSERT_EQUAL_UINT32(0, ring.getDropped());
+    assertQueued(100, RING_CAPACITY);
+}
+
+// A full ring discards its oldest item for each new one, so the newest
+// capacity items survive
+static void test_overwrite_oldest_counters(void) {
+    ring.setPolicy(OverflowPolicy::OverwriteOldest);
+    TEST_ASSERT_EQUAL_UINT32(3 * RING_CAPACITY + 5, pushRun(0, 3 * RING_CAPACITY + 5));
+    TEST_ASSERT_EQUAL_UINT32(2 * RING_CAPACITY + 5, ring.getOverwritten());
+    TEST_ASSERT_EQUAL_UINT32(0, ring.getDropped());
+    TEST_ASSERT_EQUAL_UINT32(0, ring.getBlocked());
+    assertQueued(2 * RING_CAPACITY + 5, RING_CAPACITY);
+
+    // Items popped in between make room, so nothing more is lost
+    pushRun(0, RING_CAPACITY);
+    Item item;
+    TEST_ASSERT_TRUE(ring.pop(item));
+    TEST_ASSERT_TRUE(ring.pop(item));
+    pushRun(RING_CAPACITY, 2);
+    TEST_ASSERT_EQUAL_UINT32(2 * RING_CAPACITY + 5, ring.getOverwritten());
+    assertQueued(2, RING_CAPACITY);
+}
+
+// Changing policy keeps what is queued; only later overflow follows the new one
+static void test_policy_change_keeps_queue(void) {
+    ring.setPolicy(OverflowPolicy::OverwriteOldest);
+    pushRun(0, RING_CAPACITY + 1);
+    ring.setPolicy(OverflowPolicy::DropNewest);
+    TEST_ASSERT_EQUAL_UINT32(0, pushRun(RING_CAPACITY + 1, 3));
+    TEST_ASSERT_EQUAL_UINT32(1, ring.getOverwritten());
+    TEST_ASSERT_EQUAL_UINT32(3, ring.getDropped());
+    ring.clear();
+    TEST_ASSERT_TRUE(ring.empty());
+    TEST_ASSERT_EQUAL_UINT32(1, ring.getOverwritten());
+}
+
+struct Received {
+    uint32_t count;
+    uint32_t torn;
+    uint32_t outOfOrder;
+    uint32_t last;
+};
+
+// Push every item, letting the consumer start once HEAD_START are in
+static void produce(uint32_t items, std::atomic<bool>& started, std::atomic<bool>& done) {
+    for (uint32_t i = 0; i < items; i++) {
+        ring.push(Item::make(i));
+        if (i + 1 == HEAD_START) {
+            started = true;
+        }
+    }
+    started = true;
+    done = true;
+}
+
+// Pop until the producer is done and the ring is empty, checking each item
+static Received consume(const std::atomic<bool>& started, const std::atomic<bool>& done) {
+    Received received = {0, 0, 0, 0};
+    while (!started.load()) {
+        std::this_thread::yield();
+    }
+    Item item;
+    bool first = true;
+    for (;;) {
+        bool finished = done.load();
+        if (!ring.pop(item)) {
+            if (finished) {
+                break;
+            }
+            std::this_thread::yield();
+            continue;
+        }
+        received.torn += item.intact() ? 0 : 1;
+        received.outOfOrder += first || item.sequence > received.last ? 0 : 1;
+        received.last = item.sequence;
+        received.count++;
+        first = false;
+    }
+    return received;
+}
+
+// With a head start the consumer is held back until the ring has
+// overflowed several times over
+static Received run(bool headStart) {
+    std::atomic<bool> started{!headStart};
+    std::atomic<bool> done{false};
+    Received received;
+    std::thread consumer([&]() { received = consume(started, done); });
+    std::thread producer([&]() { produce(STRESS_ITEMS, started, done); });
+    producer.join();
+    consumer.join();
+    return received;
+}
+
+// The producer waits instead, so the consumer starts with it: everything
+// arrives, once, in order
+static void test_block_keeps_order_without_loss(void) {
+    ring.setPolicy(OverflowPolicy::Block);
+    Received received = run(false);
+    TEST_ASSERT_EQUAL_UINT32(0, received.torn);
+    TEST_ASSERT_EQUAL_UINT32(0, received.outOfOrder);
+    TEST_ASSERT_EQUAL_UINT32(STRESS_ITEMS, received.count);
+    TEST_ASSERT_EQUAL_UINT32(STRESS_ITEMS - 1, received.last);
+    TEST_ASSERT_EQUAL_UINT32(0, ring.getDropped());
+    TEST_ASSERT_EQUAL_UINT32(0, ring.getOverwritten());
+    TEST_ASSERT_TRUE(ring.getBlocked() > 0);
+}
+
+// The producer moves the tail under the consumer: every item is either
+// delivered intact and in order or counted as overwritten, and the newest
+// always arrives
+static void test_overwrite_oldest_counts_every_loss(void) {
+    ring.setPolicy(OverflowPolicy::OverwriteOldest);
+    Received received = run(true);
+    TEST_ASSERT_EQUAL_UINT32(0, received.torn);
+    TEST_ASSERT_EQUAL_UINT32(0, received.outOfOrder);
+    TEST_ASSERT_EQUAL_UINT32(STRESS_ITEMS, received.count + ring.getOverwritten());
+    TEST_ASSERT_TRUE(ring.getOverwritten() >= HEAD_START - RING_CAPACITY);
+    TEST_ASSERT_EQUAL_UINT32(STRESS_ITEMS - 1, received.last);
+    TEST_ASSERT_EQUAL_UINT32(0, ring.getDropped());
+    TEST_ASSERT_EQUAL_UINT32(0, ring.getBlocked());
+}
+
+// New items are turned away instead: every one delivered or counted
+static void test_drop_newest_counts_every_loss(void) {
+    ring.setPolicy(OverflowPolicy::DropNewest);
+    Received received = run(true);
+    TEST_ASSERT_EQUAL_UINT32(0, received.torn);
+    TEST_ASSERT_EQUAL_UINT32(0, received.outOfOrder);
+    TEST_ASSERT_EQUAL_UINT32(STRESS_ITEMS, received.count + ring.getDropped());
+    TEST_ASSERT_TRUE(ring.getDropped() >= HEAD_START - RING_CAPACITY);
+    TEST_ASSERT_EQUAL_UINT32(0, ring.getOverwritten());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_policy_names);
+    RUN_TEST(test_drop_newest_counters);
+    RUN_TEST(test_overwrite_oldest_counters);
+    RUN_TEST(test_policy_change_keeps_queue);
+    RUN_TEST(test_block_keeps_order_without_loss);
+    RUN_TEST(test_overwrite_oldest_counts_every_loss);
+    RUN_TEST(test_drop_newest_counts_every_loss);
+    return UNITY_END();
+}
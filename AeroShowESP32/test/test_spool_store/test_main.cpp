@@ -0,0 +1,302 @@
+// Store-and-forward spool on a file-backed flash stand-in: records come
+// back in order across restarts and segments, retention drops the oldest
+// segments whole, a corrupted record costs only the rest of its segment,
+// and a power cut at any point of a write loses no record whose append
+// returned true and never hands back a damaged one
+
+#include <unity.h>
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include "../../src/SpoolStore.h"
+#include "../../src/sim/SimFlash.h"
+
+static const size_t POWER_CUT_STRIDE = 17;  // Bytes between the cut points tried
+
+static std::string root;
+
+// Empty flash for every test
+void setUp(void) {
+    char path[] = "/tmp/spoolXXXXXX";
+    TEST_ASSERT_NOT_NULL(mkdtemp(path));
+    root = path;
+}
+
+static void removeTree(const std::string& path) {
+    DIR* dir = opendir(path.c_str());
+    if (dir != nullptr) {
+        for (struct dirent* entry = readdir(dir); entry != nullptr; entry = readdir(dir)) {
+            if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0) {
+                removeTree(path + "/" + entry->d_name);
+            }
+        }
+        closedir(dir);
+        rmdir(path.c_str());
+    } else {
+        unlink(path.c_str());
+    }
+}
+
+void tearDown(void) {
+    removeTree(root);
+}
+
+// Record id's payload: the id, then bytes that depend on it and their position
+static std::vector<uint8_t> payloadOf(uint32_t id, size_t length) {
+    std::vector<uint8_t> payload(length);
+    for (size_t i = 0; i < length; i++) {
+        payload[i] = i < 4 ? (uint8_t)(id >> (8 * i)) : (uint8_t)(id * 31 + i * 7);
+    }
+    return payload;
+}
+
+static size_t lengthOf(uint32_t id) {
+    return 16 + (id * 397) % 3000;
+}
+
+// Streams the payload in the pieces BatchUploader's frame writer would
+static bool appendRecord(SpoolStore& spool, uint32_t id) {
+    std::vector<uint8_t> payload = payloadOf(id, lengthOf(id));
+    return spool.append(SPOOL_FLAG_TELEMETRY_FRAME, [&payload](ByteSink& out) {
+        for (size_t at = 0; at < payload.size(); at += 100) {
+            out.put(payload.data() + at, payload.size() - at < 100 ? payload.size() - at : 100);
+        }
+    });
+}
+
+struct Collect : ByteSink {
+    std::vector<uint8_t> bytes;
+    bool put(const uint8_t* data, size_t length) override {
+        bytes.insert(bytes.end(), data, data + length);
+        return true;
+    }
+};
+
+// Replay the oldest record, checking it is whole; returns its id, or -1
+// when the spool is empty
+static long replayOne(SpoolStore& spool, bool consume = true) {
+    SpoolRecordInfo info;
+    if (!spool.peek(info)) {
+        return -1;
+    }
+    Collect body;
+    TEST_ASSERT_TRUE(spool.copyPayload(info, body));
+    TEST_ASSERT_TRUE(body.bytes.size() >= 4);
+    uint32_t id = body.bytes[0] | body.bytes[1] << 8 | body.bytes[2] << 16 | (uint32_t)body.bytes[3] << 24;
+    TEST_ASSERT_EQUAL_UINT32(SPOOL_FLAG_TELEMETRY_FRAME, info.header.flags);
+    TEST_ASSERT_EQUAL_UINT32(lengthOf(id), body.bytes.size());
+    TEST_ASSERT_TRUE(body.bytes == payloadOf(id, lengthOf(id)));
+
+    uint8_t prefix[8];
+    TEST_ASSERT_EQUAL_UINT32(sizeof(prefix), spool.readPayload(info, prefix, sizeof(prefix)));
+    TEST_ASSERT_EQUAL_MEMORY(body.bytes.data(), prefix, sizeof(prefix));
+    if (consume) {
+        spool.consume(info);
+    }
+    return (long)id;
+}
+
+static std::vector<long> replayAll(SpoolStore& spool) {
+    std::vector<long> ids;
+    for (long id = replayOne(spool); id >= 0; id = replayOne(spool)) {
+        ids.push_back(id);
+    }
+    TEST_ASSERT_FALSE(spool.hasPending());
+    return ids;
+}
+
+static void assertRange(const std::vector<long>& ids, long first, long end) {
+    TEST_ASSERT_EQUAL_UINT32(end - first, ids.size());
+    for (size_t i = 0; i < ids.size(); i++) {
+        TEST_ASSERT_EQUAL_INT32(first + (long)i, ids[i]);
+    }
+}
+
+// Oldest first across segment boundaries, and a restart continues from
+// the saved cursor: peeked but unconsumed records come back again
+static void test_records_replay_in_order(void) {
+    SimFlash flash(root);
+    const uint32_t COUNT = 60;  // About three segments
+    {
+        SpoolStore spool(flash);
+        TEST_ASSERT_TRUE(spool.begin());
+        TEST_ASSERT_FALSE(spool.hasPending());
+        for (uint32_t id = 0; id < COUNT; id++) {
+            TEST_ASSERT_TRUE(appendRecord(spool, id));
+        }
+        TEST_ASSERT_EQUAL_UINT32(COUNT, spool.getAppendedRecords());
+        for (long id = 0; id < 25; id++) {
+            TEST_ASSERT_EQUAL_INT32(id, replayOne(spool));
+        }
+        TEST_ASSERT_EQUAL_INT32(25, replayOne(spool, false));
+        TEST_ASSERT_EQUAL_UINT32(25, spool.getConsumedRecords());
+    }
+
+    SpoolStore restarted(flash);
+    TEST_ASSERT_TRUE(restarted.begin());
+    TEST_ASSERT_TRUE(restarted.hasPending());
+    TEST_ASSERT_TRUE(appendRecord(restarted, COUNT));
+    assertRange(replayAll(restarted), 25, COUNT + 1);
+    TEST_ASSERT_EQUAL_UINT32(0, restarted.getDiscardedSegments());
+}
+
+// Past SPOOL_MAX_SEGMENTS the oldest segments go, whole, and the rest
+// still replays in order
+static void test_retention_drops_oldest_segments(void) {
+    SimFlash flash(root);
+    SpoolStore spool(flash);
+    TEST_ASSERT_TRUE(spool.begin());
+
+    uint32_t count = 0;
+    for (uint64_t bytes = 0; bytes < (uint64_t)(SPOOL_MAX_SEGMENTS + 3) * SPOOL_SEGMENT_BYTES; count++) {
+        TEST_ASSERT_TRUE(appendRecord(spool, count));
+        bytes += SPOOL_RECORD_HEADER_BYTES + lengthOf(count);
+    }
+    TEST_ASSERT_TRUE(spool.getDiscardedSegments() >= 3);
+
+    std::vector<long> ids = replayAll(spool);
+    TEST_ASSERT_TRUE(ids.front() > 0);
+    assertRange(ids, ids.front(), count);
+}
+
+// A flipped payload byte fails the CRC: the reader gives up on the rest of
+// that segment and carries on with the next
+static void test_corrupt_record_skips_its_segment(void) {
+    SimFlash flash(root);
+    {
+        SpoolStore spool(flash);
+        TEST_ASSERT_TRUE(spool.begin());
+        for (uint32_t id = 0; id < 40; id++) {
+            TEST_ASSERT_TRUE(appendRecord(spool, id));
+        }
+    }
+
+    // Third record of the first segment
+    uint32_t offset = 2 * SPOOL_RECORD_HEADER_BYTES + lengthOf(0) + lengthOf(1) + SPOOL_RECORD_HEADER_BYTES + 10;
+    std::string path = root + "/spool/00000001.seg";
+    FILE* file = fopen(path.c_str(), "r+b");
+    TEST_ASSERT_NOT_NULL(file);
+    fseek(file, offset, SEEK_SET);
+    int value = fgetc(file);
+    fseek(file, offset, SEEK_SET);
+    fputc(value ^ 0x01, file);
+    fclose(file);
+
+    // First record of the second segment
+    uint32_t next = 0;
+    for (uint32_t bytes = 0; bytes + SPOOL_RECORD_HEADER_BYTES + lengthOf(next) <= SPOOL_SEGMENT_BYTES; next++) {
+        bytes += SPOOL_RECORD_HEADER_BYTES + lengthOf(next);
+    }
+
+    SpoolStore spool(flash);
+    TEST_ASSERT_TRUE(spool.begin());
+    std::vector<long> ids = replayAll(spool);
+    TEST_ASSERT_EQUAL_UINT32(2 + (40 - next), ids.size());
+    TEST_ASSERT_EQUAL_INT32(0, ids[0]);
+    TEST_ASSERT_EQUAL_INT32(1, ids[1]);
+    ids.erase(ids.begin(), ids.begin() + 2);
+    assertRange(ids, next, 40);
+}
+
+// What one run of the workload did before the power went
+struct Outcome {
+    std::vector<long> stored;     // Appends that returned true
+    long inFlight = -1;           // Append the cut interrupted
+    long consumedUpTo = -1;       // Highest id whose cursor reached flash
+    bool completed = false;
+};
+
+// Records stored while earlier ones are replayed, as the uploader does
+// during an outage that is ending, until the power goes
+static Outcome runWorkload(SimFlash& flash) {
+    Outcome outcome;
+    SpoolStore spool(flash);
+    if (!spool.begin()) {
+        return outcome;
+    }
+    for (uint32_t id = 0; id < 30; id++) {
+        if (!appendRecord(spool, id)) {
+            outcome.inFlight = id;
+            return outcome;
+        }
+        outcome.stored.push_back(id);
+        if (id % 3 == 2) {
+            long replayed = replayOne(spool);
+            if (!flash.isPowered()) {
+                return outcome;
+            }
+            TEST_ASSERT_TRUE(replayed >= 0);
+            outcome.consumedUpTo = replayed;
+        }
+    }
+    outcome.completed = true;
+    return outcome;
+}
+
+// Cut the power after every POWER_CUT_STRIDE-th byte of the workload's
+// writes, restart, and replay what the spool kept: everything stored and
+// not yet consumed comes back once, in order, and intact, the record being
+// appended at the cut only if it was whole, and new records go in after
+static void test_power_loss_mid_write(void) {
+    uint64_t total;
+    {
+        SimFlash flash(root);
+        TEST_ASSERT_TRUE(runWorkload(flash).completed);
+        total = flash.getBytesWritten();
+        removeTree(root + "/spool");
+    }
+
+    size_t cuts = 0;
+    size_t tornAppends = 0;
+    for (uint64_t cut = 0; cut < total; cut += POWER_CUT_STRIDE, cuts++) {
+        SimFlash flash(root);
+        flash.cutPowerAfter(cut);
+        Outcome outcome = runWorkload(flash);
+        TEST_ASSERT_FALSE(outcome.completed);
+        TEST_ASSERT_FALSE(flash.isPowered());
+        flash.powerOn();
+
+        SpoolStore spool(flash);
+        TEST_ASSERT_TRUE(spool.begin());
+        TEST_ASSERT_TRUE(appendRecord(spool, 1000));
+        std::vector<long> ids = replayAll(spool);
+        TEST_ASSERT_EQUAL_INT32(1000, ids.back());
+        ids.pop_back();
+
+        // A consume whose cursor did not reach flash leaves its record here
+        std::vector<long> expected;
+        for (long id : outcome.stored) {
+            if (id > outcome.consumedUpTo) {
+                expected.push_back(id);
+            }
+        }
+        if (!ids.empty() && ids.back() == outcome.inFlight) {
+            ids.pop_back();
+            tornAppends++;
+        }
+        if (!(ids == expected)) {
+            char message[80];
+            snprintf(message, sizeof(message), "cut after %u bytes", (unsigned)cut);
+            TEST_FAIL_MESSAGE(message);
+        }
+        removeTree(root + "/spool");
+    }
+
+    char line[120];
+    snprintf(line, sizeof(line), "%u power cuts over %u bytes written, %u appends complete despite the cut",
+             (unsigned)cuts, (unsigned)total, (unsigned)tornAppends);
+    TEST_MESSAGE(line);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_records_replay_in_order);
+    RUN_TEST(test_retention_drops_oldest_segments);
+    RUN_TEST(test_corrupt_record_skips_its_segment);
+    RUN_TEST(test_power_loss_mid_write);
+    return UNITY_END();
+}
@@ -0,0 +1,242 @@
+// Per-step statistics against a reference computed from the raw samples
+// in double precision: two-pass mean and standard deviation, exact min and
+// max, and percentiles from the sorted samples. The streaming p50/p95 are
+// held to a rank error, as a sketch can only be, or to a share of the
+// spread where the input trends; everything else to float rounding.
+
+#include <unity.h>
+#include <math.h>
+#include <stdio.h>
+#include <algorithm>
+#include <vector>
+#include "../../src/StepStats.h"
+
+static const size_t STEP_SAMPLES = 10000;     // 10 s step at RIG_DEFAULT_SAMPLE_HZ
+static const double MAX_RANK_ERROR = 0.02;    // Of the sample count, for p50/p95
+static const double MAX_TREND_ERROR = 0.3;    // Of the standard deviation, for p50/p95 of a trend
+
+void setUp(void) {}
+void tearDown(void) {}
+
+struct Reference {
+    double mean;
+    double stddev;
+    double min;
+    double max;
+    std::vector<double> sorted;
+
+    explicit Reference(const std::vector<float>& values) : sorted(values.begin(), values.end()) {
+        std::sort(sorted.begin(), sorted.end());
+        double sum = 0.0;
+        for (double value : sorted) {
+            sum += value;
+        }
+        mean = sum / sorted.size();
+        double squares = 0.0;
+        for (double value : sorted) {
+            squares += (value - mean) * (value - mean);
+        }
+        stddev = sorted.size() > 1 ? sqrt(squares / (sorted.size() - 1)) : 0.0;
+        min = sorted.front();
+        max = sorted.back();
+    }
+
+    double quantile(double p) const {
+        return sorted[(size_t)lround(p * (sorted.size() - 1))];
+    }
+
+    // How far rank p is from the ranks value could hold, give or take a
+    // thousandth of the spread; 0 when value is a p-quantile
+    double rankError(double value, double p) const {
+        double slack = 1e-3 * stddev + 1e-6 * fabs(mean);
+        double below = (double)(std::lower_bound(sorted.begin(), sorted.end(), value - slack) - sorted.begin());
+        double through = (double)(std::upper_bound(sorted.begin(), sorted.end(), value + slack) - sorted.begin());
+        below /= sorted.size();
+        through /= sorted.size();
+        return p < below ? below - p : p > through ? p - through : 0.0;
+    }
+};
+
+// Deterministic generator, so a failure is the same every run
+struct Random {
+    uint32_t state;
+    explicit Random(uint32_t seed) : state(seed) {}
+
+    double uniform() {
+        state = state * 1664525u + 1013904223u;
+        return ((state >> 8) + 0.5) / 16777216.0;
+    }
+
+    double normal() {
+        return sqrt(-2.0 * log(uniform())) * cos(2.0 * M_PI * uniform());
+    }
+};
+
+// P-square moves its markers one position per sample, so on input that
+// trends across the step the upper markers lag; a trend is held to a share
+// of the spread instead of a rank
+static void checkSummary(const char* name, const std::vector<float>& values, bool trend = false) {
+    ChannelStats stats;
+    stats.reset();
+    for (float value : values) {
+        stats.add(value);
+    }
+    ChannelSummary summary = stats.summarize();
+    Reference reference(values);
+
+    // Float rounding of values around the mean, not of the values themselves
+    double scale = fabs(reference.mean) + reference.stddev;
+    TEST_ASSERT_FLOAT_WITHIN_MESSAGE(scale * 1e-5 + 1e-6, reference.mean, summary.mean, name);
+    TEST_ASSERT_FLOAT_WITHIN_MESSAGE(reference.stddev * 1e-3 + 1e-6, reference.stddev, summary.stddev, name);
+    TEST_ASSERT_EQUAL_FLOAT(reference.min, summary.min);
+    TEST_ASSERT_EQUAL_FLOAT(reference.max, summary.max);
+
+    double p50Rank = reference.rankError(summary.p50, 0.50);
+    double p95Rank = reference.rankError(summary.p95, 0.95);
+    double p50Spread = fabs(summary.p50 - reference.quantile(0.50)) / reference.stddev;
+    double p95Spread = fabs(summary.p95 - reference.quantile(0.95)) / reference.stddev;
+    if (trend) {
+        TEST_ASSERT_TRUE_MESSAGE(p50Spread <= MAX_TREND_ERROR, name);
+        TEST_ASSERT_TRUE_MESSAGE(p95Spread <= MAX_TREND_ERROR, name);
+    } else {
+        TEST_ASSERT_TRUE_MESSAGE(p50Rank <= MAX_RANK_ERROR, name);
+        TEST_ASSERT_TRUE_MESSAGE(p95Rank <= MAX_RANK_ERROR, name);
+    }
+
+    char line[160];
+    snprintf(line, sizeof(line), "%-13s stddev error %.1e; p50 off by %.4f in rank, %.3f sd; p95 by %.4f, %.3f sd",
+             name, fabs(summary.stddev - reference.stddev) / reference.stddev, p50Rank, p50Spread, p95Rank,
+             p95Spread);
+    TEST_MESSAGE(line);
+}
+
+// Shapes a step's channels take: noise on a large offset (the load cell in
+// counts, the pack voltage), skew, a drift across the step, clipping to
+// few distinct values, and input that arrives sorted
+static void test_channels_match_reference(void) {
+    Random random(12345);
+    std::vector<float> offset, skewed, drifting, quantized, rising, falling, bimodal;
+    for (size_t i = 0; i < STEP_SAMPLES; i++) {
+        offset.push_back((float)(42000.0 + 3.0 * random.normal()));
+        skewed.push_back((float)(-200.0 * log(random.uniform())));
+        drifting.push_back((float)(16.8 - 0.4 * i / STEP_SAMPLES + 0.01 * random.normal()));
+        quantized.push_back((float)floor(5.0 * random.uniform()) * 1.25f);
+        rising.push_back((float)i * 0.5f);
+        falling.push_back((float)(STEP_SAMPLES - i) * 0.5f);
+        bimodal.push_back((float)(random.uniform() < 0.8 ? 1500.0 + 20.0 * random.normal()
+                                                        : 2500.0 + 20.0 * random.normal()));
+    }
+    checkSummary("offset noise", offset);
+    checkSummary("skewed", skewed);
+    checkSummary("drifting", drifting, true);
+    checkSummary("five levels", quantized);
+    checkSummary("rising", rising);
+    checkSummary("falling", falling);
+    checkSummary("two modes", bimodal);
+}
+
+// Up to five samples the percentiles are exact order statistics, one
+// sample has no spread, and a constant input stays constant
+static void test_short_and_constant_steps(void) {
+    const float values[] = {7.0f, -3.0f, 11.0f, 2.0f, 5.0f};
+    for (size_t n = 1; n <= 5; n++) {
+        ChannelStats stats;
+        std::vector<float> seen(values, values + n);
+        for (float value : seen) {
+            stats.add(value);
+        }
+        std::sort(seen.begin(), seen.end());
+        ChannelSummary summary = stats.summarize();
+        TEST_ASSERT_EQUAL_FLOAT(seen[lround(0.5 * (n - 1))], summary.p50);
+        TEST_ASSERT_EQUAL_FLOAT(seen[lround(0.95 * (n - 1))], summary.p95);
+        TEST_ASSERT_EQUAL_FLOAT(seen.front(), summary.min);
+        TEST_ASSERT_EQUAL_FLOAT(seen.back(), summary.max);
+        if (n == 1) {
+            TEST_ASSERT_EQUAL_FLOAT(0.0f, summary.stddev);
+        }
+    }
+
+    ChannelStats constant;
+    for (size_t i = 0; i < STEP_SAMPLES; i++) {
+        constant.add(16.8f);
+    }
+    ChannelSummary summary = constant.summarize();
+    TEST_ASSERT_EQUAL_FLOAT(16.8f, summary.mean);
+    TEST_ASSERT_FLOAT_WITHIN(1e-6f, 0.0f, summary.stddev);
+    TEST_ASSERT_EQUAL_FLOAT(16.8f, summary.p50);
+    TEST_ASSERT_EQUAL_FLOAT(16.8f, summary.p95);
+
+    ChannelStats empty;
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, empty.summarize().p50);
+}
+
+// A whole step through the aggregator: thrust through the calibration,
+// power from voltage and current, grams per watt from the means, and a
+// second step starting clean
+static void test_step_summary(void) {
+    LoadCellCalibration calibration;
+    calibration.addPoint(42000, 1000000);  // 1 kg at 42000 counts
+
+    Random random(777);
+    std::vector<float> thrust, voltage, current, power;
+    StepAggregator aggregator;
+    aggregator.begin(3, 0.6f, 5000, calibration, 2);
+    TEST_ASSERT_TRUE(aggregator.active());
+    for (size_t i = 0; i < STEP_SAMPLES; i++) {
+        SensorData sample;
+        sample.channel = 2;
+        sample.load_cell = (float)(21000.0 + 50.0 * random.normal());
+        sample.voltage = (float)(16.0 + 0.05 * random.normal());
+        sample.current = (float)(8000.0 + 300.0 * random.normal());
+        aggregator.add(sample);
+        thrust.push_back(calibration.toGrams(sample.load_cell));
+        voltage.push_back(sample.voltage);
+        current.push_back(sample.current);
+        power.push_back(sample.voltage * sample.current / 1000.0f);
+    }
+    StepSummary summary = aggregator.finish(15000);
+    TEST_ASSERT_FALSE(aggregator.active());
+
+    TEST_ASSERT_EQUAL_UINT32(3, summary.step);
+    TEST_ASSERT_EQUAL_UINT8(2, summary.channel);
+    TEST_ASSERT_EQUAL_FLOAT(0.6f, summary.speed);
+    TEST_ASSERT_EQUAL_UINT32(5000, summary.startMs);
+    TEST_ASSERT_EQUAL_UINT32(10000, summary.durationMs);
+    TEST_ASSERT_EQUAL_UINT32(STEP_SAMPLES, summary.samples);
+
+    Reference thrustReference(thrust);
+    Reference powerReference(power);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 500.0f, summary.thrust.mean);
+    TEST_ASSERT_FLOAT_WITHIN(thrustReference.mean * 1e-5, thrustReference.mean, summary.thrust.mean);
+    TEST_ASSERT_FLOAT_WITHIN(thrustReference.stddev * 1e-3, thrustReference.stddev, summary.thrust.stddev);
+    TEST_ASSERT_FLOAT_WITHIN(powerReference.mean * 1e-5, powerReference.mean, summary.power.mean);
+    TEST_ASSERT_FLOAT_WITHIN(powerReference.stddev * 1e-3, powerReference.stddev, summary.power.stddev);
+    TEST_ASSERT_FLOAT_WITHIN(1e-5 * summary.gramsPerWatt, thrustReference.mean / powerReference.mean,
+                             summary.gramsPerWatt);
+    TEST_ASSERT_TRUE(Reference(current).rankError(summary.current.p95, 0.95) <= MAX_RANK_ERROR);
+    TEST_ASSERT_TRUE(Reference(voltage).rankError(summary.voltage.p50, 0.50) <= MAX_RANK_ERROR);
+
+    // Samples between steps are ignored, and the next step owes nothing to this one
+    SensorData idle;
+    idle.load_cell = 99999.0f;
+    aggregator.add(idle);
+    aggregator.begin(4, 0.7f, 15000, calibration, 2);
+    SensorData sample;
+    sample.load_cell = 42000.0f;
+    sample.voltage = 16.0f;
+    sample.current = 0.0f;
+    aggregator.add(sample);
+    summary = aggregator.finish(15100);
+    TEST_ASSERT_EQUAL_UINT32(1, summary.samples);
+    TEST_ASSERT_EQUAL_FLOAT(1000.0f, summary.thrust.max);
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, summary.power.mean);
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, summary.gramsPerWatt);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_channels_match_reference);
+    RUN_TEST(test_short_and_constant_steps);
+    RUN_TEST(test_step_summary);
+    return UNITY_END();
+}
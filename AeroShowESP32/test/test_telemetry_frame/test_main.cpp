@@ -0,0 +1,455 @@
+// Upload frame: the current version round-trips through the encoder, frames
+// of every older version the decoder still accepts decode to the values they
+// were written from, and truncated or corrupted frames are refused without
+// reading past their end
+
+#include <unity.h>
+#include <string.h>
+#include <vector>
+#include "../../src/SensorData.h"
+#include "../../src/StepStats.h"
+#include "../../src/TelemetryFrame.h"
+
+void setUp(void) {}
+void tearDown(void) {}
+
+static const char TEST_ID[] = "frame-check";
+static const size_t SAMPLE_COUNT = 600;
+static const size_t SUMMARY_COUNT = 3;
+static const uint64_t CONVERSION_PERIOD_US = 2668;  // INA260 at Avg4, 332 us + 332 us
+
+// Fixed-point values and timings chosen so every field survives its scale
+// exactly; later versions carry more channels and fields than earlier ones
+struct Fixture {
+    SensorData samples[SAMPLE_COUNT];
+    StepSummary summaries[SUMMARY_COUNT];
+};
+
+static uint32_t nextRandom(uint32_t& state) {
+    state = state * 1664525u + 1013904223u;
+    return state >> 8;
+}
+
+static void makeFixture(Fixture& fixture, uint8_t version) {
+    uint32_t state = 12345u + version;
+    size_t channels = version >= 5 ? TELEMETRY_MAX_CHANNELS : 1;
+    uint64_t deadline = 3600000000ull;  // An hour into the test clock
+    uint32_t timestampMs = 3600000u;
+
+    for (size_t i = 0; i < SAMPLE_COUNT; i++) {
+        SensorData& sample = fixture.samples[i];
+        sample.channel = (uint8_t)(i % channels);
+        if (version >= 6) {
+            // Paced deadlines with the odd late sample and skipped deadline
+            deadline += 250 + (i % 97 == 0 ? 4000 : 0);
+            sample.jitter_us = nextRandom(state) % 8 == 0 ? nextRandom(state) % 900 : 0;
+            sample.missed = i % 53 == 7 ? (uint16_t)(1 + nextRandom(state) % 40) : 0;
+            sample.timestamp_us = deadline + sample.jitter_us;
+        } else {
+            timestampMs += nextRandom(state) % 3;
+            sample.timestamp_us = (uint64_t)timestampMs * 1000;
+        }
+        int32_t loadCell = (int32_t)(nextRandom(state) % 400000) - 200000;
+        sample.load_cell = loadCell / TELEMETRY_LOAD_CELL_SCALE;
+        sample.voltage = (int32_t)(14000 + nextRandom(state) % 12000) / TELEMETRY_VOLTAGE_SCALE;
+        sample.current = (int32_t)(nextRandom(state) % 600000) / TELEMETRY_CURRENT_SCALE;
+        sample.speed = (int32_t)(nextRandom(state) % 10001) / TELEMETRY_SPEED_SCALE;
+        if (version >= 4 && i % 5 != 0) {
+            sample.rpm = (float)(nextRandom(state) % 40000);
+            sample.rpm_timestamp = (uint32_t)(sample.timestamp_us / 1000) - nextRandom(state) % 50;
+        }
+        if (version >= 7 && i >= channels) {
+            // The newest of the channel's conversions, finishing about every
+            // 2.67 ms, each a few us off the period
+            uint64_t phase = 100 * sample.channel;
+            uint64_t k = (sample.timestamp_us - phase) / CONVERSION_PERIOD_US;
+            uint64_t finished = phase + k * CONVERSION_PERIOD_US + k * 7919 % 13;
+            if (finished > sample.timestamp_us) {
+                k--;
+                finished = phase + k * CONVERSION_PERIOD_US + k * 7919 % 13;
+            }
+            sample.power_timestamp_us = finished;
+        }
+    }
+
+    for (size_t i = 0; i < SUMMARY_COUNT; i++) {
+        StepSummary& summary = fixture.summaries[i];
+        summary.step = (uint16_t)(i * 700);
+        summary.channel = version >= 5 ? (uint8_t)(i % channels) : 0;
+        summary.speed = 0.25f * (i + 1);
+        summary.startMs = 3600000u + 2000u * i;
+        summary.durationMs = 2000;
+        summary.samples = 1999 + i;
+        summary.gramsPerWatt = 7.5f - i;
+        ChannelSummary* blocks[] = {&summary.thrust, &summary.voltage, &summary.current, &summary.power};
+        for (size_t b = 0; b < 4; b++) {
+            float base = 100.0f * (b + 1) + i;
+            blocks[b]->mean = base;
+            blocks[b]->stddev = 0.5f;
+            blocks[b]->min = base - 3.0f;
+            blocks[b]->max = base + 3.0f;
+            blocks[b]->p50 = base + 0.25f;
+            blocks[b]->p95 = base + 2.5f;
+        }
+    }
+}
+
+static void putU32(std::vector<uint8_t>& out, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        out.push_back((uint8_t)(value >> (8 * i)));
+    }
+}
+
+static void putFloat(std::vector<uint8_t>& out, float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    putU32(out, bits);
+}
+
+static void putVarint(std::vector<uint8_t>& out, uint32_t value) {
+    uint8_t bytes[TELEMETRY_MAX_VARINT_BYTES];
+    size_t n = telemetryWriteVarint(bytes, value);
+    out.insert(out.end(), bytes, bytes + n);
+}
+
+static void putDelta(std::vector<uint8_t>& out, float value, float scale, int32_t& last) {
+    int32_t fixed = telemetryToFixed(value, scale);
+    putVarint(out, telemetryZigZag((int32_t)((uint32_t)fixed - (uint32_t)last)));
+    last = fixed;
+}
+
+// A frame as the firmware wrote it at versions 1 to 6, from the layout in
+// TelemetryFrame.h; the encoder only writes the current version
+static std::vector<uint8_t> legacyFrame(uint8_t version, const Fixture& fixture) {
+    std::vector<uint8_t> out(TELEMETRY_MAGIC, TELEMETRY_MAGIC + sizeof(TELEMETRY_MAGIC));
+    out.push_back(version);
+    out.push_back(TELEMETRY_FLAG_LOAD_CELL_READY);
+    out.push_back((uint8_t)strlen(TEST_ID));
+    out.insert(out.end(), TEST_ID, TEST_ID + strlen(TEST_ID));
+
+    uint32_t lastMs = (uint32_t)(fixture.samples[0].timestamp_us / 1000);
+    if (version >= 6) {
+        putU32(out, (uint32_t)fixture.samples[0].timestamp_us);
+        putU32(out, (uint32_t)(fixture.samples[0].timestamp_us >> 32));
+    } else {
+        putU32(out, lastMs);
+    }
+    putVarint(out, SAMPLE_COUNT);
+    if (version >= 2) {
+        putVarint(out, 17);
+        putVarint(out, 300);
+    }
+    if (version >= 3) {
+        putVarint(out, SUMMARY_COUNT);
+    }
+
+    TelemetryChannelState last[TELEMETRY_MAX_CHANNELS];
+    for (TelemetryChannelState& state : last) {
+        state.deadline = fixture.samples[0].timestamp_us;
+    }
+    for (size_t i = 0; i < SAMPLE_COUNT; i++) {
+        const SensorData& sample = fixture.samples[i];
+        TelemetryChannelState& state = last[sample.channel];
+        if (version >= 5) {
+            putVarint(out, sample.channel);
+        }
+        uint32_t timestampMs = (uint32_t)(sample.timestamp_us / 1000);
+        if (version >= 6) {
+            uint64_t deadline = sample.timestamp_us - sample.jitter_us;
+            int32_t interval = (int32_t)(deadline - state.deadline);
+            putVarint(out, telemetryZigZag(interval - state.interval));
+            state.deadline = deadline;
+            state.interval = interval;
+        } else {
+            putVarint(out, timestampMs - lastMs);
+            lastMs = timestampMs;
+        }
+        putDelta(out, sample.load_cell, TELEMETRY_LOAD_CELL_SCALE, state.loadCell);
+        putDelta(out, sample.voltage, TELEMETRY_VOLTAGE_SCALE, state.voltage);
+        putDelta(out, sample.current, TELEMETRY_CURRENT_SCALE, state.current);
+        putDelta(out, sample.speed, TELEMETRY_SPEED_SCALE, state.speed);
+        if (version >= 4) {
+            putDelta(out, sample.rpm, TELEMETRY_RPM_SCALE, state.rpm);
+            putVarint(out, sample.rpm_timestamp == 0 ? 0 : timestampMs - sample.rpm_timestamp + 1);
+        }
+        if (version >= 6) {
+            putVarint(out, sample.jitter_us << 1 | (sample.missed > 0 ? 1 : 0));
+            if (sample.missed > 0) {
+                putVarint(out, sample.missed);
+            }
+        }
+    }
+
+    for (size_t i = 0; version >= 3 && i < SUMMARY_COUNT; i++) {
+        const StepSummary& summary = fixture.summaries[i];
+        putVarint(out, summary.step);
+        if (version >= 5) {
+            putVarint(out, summary.channel);
+        }
+        putU32(out, summary.startMs);
+        putVarint(out, summary.durationMs);
+        putVarint(out, summary.samples);
+        putFloat(out, summary.speed);
+        putFloat(out, summary.gramsPerWatt);
+        const ChannelSummary* blocks[] = {&summary.thrust, &summary.voltage, &summary.current, &summary.power};
+        for (const ChannelSummary* block : blocks) {
+            putFloat(out, block->mean);
+            putFloat(out, block->stddev);
+            putFloat(out, block->min);
+            putFloat(out, block->max);
+            putFloat(out, block->p50);
+            putFloat(out, block->p95);
+        }
+    }
+    return out;
+}
+
+static std::vector<uint8_t> currentFrame(const Fixture& fixture) {
+    std::vector<uint8_t> out;
+    telemetryEncodeBatch(TEST_ID, fixture.samples, SAMPLE_COUNT, TELEMETRY_FLAG_LOAD_CELL_READY, out,
+                         17, 300, fixture.summaries, SUMMARY_COUNT);
+    return out;
+}
+
+// Reads a whole frame; false as soon as any part is refused
+static bool decodeFrame(const uint8_t* data, size_t length, TelemetryHeader& header,
+                        std::vector<SensorData>& samples, std::vector<StepSummary>& summaries) {
+    TelemetryDecoder decoder(data, length);
+    samples.clear();
+    summaries.clear();
+    if (!decoder.readHeader(header)) {
+        return false;
+    }
+    // Counts come off the wire, so grow one at a time rather than trusting them
+    for (uint32_t i = 0; i < header.sampleCount; i++) {
+        SensorData sample;
+        if (!decoder.readSample(sample)) {
+            return false;
+        }
+        samples.push_back(sample);
+    }
+    for (uint32_t i = 0; i < header.summaryCount; i++) {
+        StepSummary summary;
+        if (!decoder.readSummary(summary)) {
+            return false;
+        }
+        summaries.push_back(summary);
+    }
+    return decoder.atEnd();
+}
+
+static void assertChannelSummary(const ChannelSummary& expected, const ChannelSummary& actual) {
+    TEST_ASSERT_EQUAL_FLOAT(expected.mean, actual.mean);
+    TEST_ASSERT_EQUAL_FLOAT(expected.stddev, actual.stddev);
+    TEST_ASSERT_EQUAL_FLOAT(expected.min, actual.min);
+    TEST_ASSERT_EQUAL_FLOAT(expected.max, actual.max);
+    TEST_ASSERT_EQUAL_FLOAT(expected.p50, actual.p50);
+    TEST_ASSERT_EQUAL_FLOAT(expected.p95, actual.p95);
+}
+
+static void assertFrame(uint8_t version, const Fixture& fixture, const std::vector<uint8_t>& frame) {
+    TelemetryHeader header;
+    std::vector<SensorData> samples;
+    std::vector<StepSummary> summaries;
+    TEST_ASSERT_TRUE(decodeFrame(frame.data(), frame.size(), header, samples, summaries));
+
+    TEST_ASSERT_EQUAL_UINT8(version, header.version);
+    TEST_ASSERT_EQUAL_UINT8(TELEMETRY_FLAG_LOAD_CELL_READY, header.flags);
+    TEST_ASSERT_EQUAL_STRING(TEST_ID, header.testId);
+    TEST_ASSERT_TRUE(header.baseTimestampUs == (version >= 6 ? fixture.samples[0].timestamp_us
+                                                               : fixture.samples[0].timestamp_us / 1000 * 1000));
+    TEST_ASSERT_EQUAL_UINT32(SAMPLE_COUNT, header.sampleCount);
+    TEST_ASSERT_EQUAL_UINT32(version >= 2 ? 17 : 0, header.droppedSamples);
+    TEST_ASSERT_EQUAL_UINT32(version >= 2 ? 300 : 0, header.overwrittenSamples);
+    TEST_ASSERT_EQUAL_UINT32(version >= 3 ? SUMMARY_COUNT : 0, header.summaryCount);
+
+    for (size_t i = 0; i < SAMPLE_COUNT; i++) {
+        const SensorData& expected = fixture.samples[i];
+        const SensorData& actual = samples[i];
+        TEST_ASSERT_TRUE(expected.timestamp_us == actual.timestamp_us);
+        TEST_ASSERT_EQUAL_UINT32(expected.jitter_us, actual.jitter_us);
+        TEST_ASSERT_EQUAL_UINT32(expected.missed, actual.missed);
+        TEST_ASSERT_EQUAL_UINT8(expected.channel, actual.channel);
+        TEST_ASSERT_EQUAL_FLOAT(expected.load_cell, actual.load_cell);
+        TEST_ASSERT_EQUAL_FLOAT(expected.voltage, actual.voltage);
+        TEST_ASSERT_EQUAL_FLOAT(expected.current, actual.current);
+        TEST_ASSERT_EQUAL_FLOAT(expected.speed, actual.speed);
+        TEST_ASSERT_EQUAL_FLOAT(expected.rpm, actual.rpm);
+        TEST_ASSERT_EQUAL_UINT32(expected.rpm_timestamp, actual.rpm_timestamp);
+        TEST_ASSERT_TRUE(expected.power_timestamp_us == actual.power_timestamp_us);
+    }
+
+    for (size_t i = 0; i < summaries.size(); i++) {
+        const StepSummary& expected = fixture.summaries[i];
+        const StepSummary& actual = summaries[i];
+        TEST_ASSERT_EQUAL_UINT32(expected.step, actual.step);
+        TEST_ASSERT_EQUAL_UINT8(expected.channel, actual.channel);
+        TEST_ASSERT_EQUAL_UINT32(expected.startMs, actual.startMs);
+        TEST_ASSERT_EQUAL_UINT32(expected.durationMs, actual.durationMs);
+        TEST_ASSERT_EQUAL_UINT32(expected.samples, actual.samples);
+        TEST_ASSERT_EQUAL_FLOAT(expected.speed, actual.speed);
+        TEST_ASSERT_EQUAL_FLOAT(expected.gramsPerWatt, actual.gramsPerWatt);
+        assertChannelSummary(expected.thrust, actual.thrust);
+        assertChannelSummary(expected.voltage, actual.voltage);
+        assertChannelSummary(expected.current, actual.current);
+        assertChannelSummary(expected.power, actual.power);
+    }
+}
+
+static void test_current_version_round_trip(void) {
+    Fixture fixture;
+    makeFixture(fixture, TELEMETRY_VERSION);
+    assertFrame(TELEMETRY_VERSION, fixture, currentFrame(fixture));
+}
+
+static void test_older_versions_decode(void) {
+    for (uint8_t version = TELEMETRY_MIN_VERSION; version < TELEMETRY_VERSION; version++) {
+        Fixture fixture;
+        makeFixture(fixture, version);
+        assertFrame(version, fixture, legacyFrame(version, fixture));
+    }
+}
+
+// Extremes the fixture leaves out: jitter past the clamp, the largest missed
+// count, and fixed-point values a full int32 apart on one channel
+static void test_extremes_round_trip(void) {
+    SensorData samples[3];
+    samples[0].timestamp_us = 1000000000ull;
+    samples[0].load_cell = 2.0e8f;
+    samples[0].missed = UINT16_MAX;
+    samples[1].timestamp_us = 3000000000ull;
+    samples[1].jitter_us = 0x80000000u;
+    samples[1].load_cell = -2.0e8f;
+    samples[2].timestamp_us = 1000000005ull;
+    samples[2].channel = 1;
+    samples[2].load_cell = -2.0e8f;
+
+    std::vector<uint8_t> frame;
+    telemetryEncodeBatch("", samples, 3, 0, frame);
+    TelemetryHeader header;
+    std::vector<SensorData> decoded;
+    std::vector<StepSummary> summaries;
+    TEST_ASSERT_TRUE(decodeFrame(frame.data(), frame.size(), header, decoded, summaries));
+    TEST_ASSERT_EQUAL_STRING("", header.testId);
+    TEST_ASSERT_EQUAL_UINT32(UINT16_MAX, decoded[0].missed);
+    TEST_ASSERT_EQUAL_UINT32(TELEMETRY_MAX_JITTER_US, decoded[1].jitter_us);
+    for (size_t i = 0; i < 3; i++) {
+        TEST_ASSERT_TRUE(decoded[i].timestamp_us == samples[i].timestamp_us);
+        TEST_ASSERT_EQUAL_FLOAT(samples[i].load_cell, decoded[i].load_cell);
+    }
+}
+
+// Each prefix is copied to a buffer of its own size, so a read past the end
+// lands outside the allocation where a sanitizer build will see it
+static void test_truncated_frames_refused(void) {
+    for (uint8_t version = TELEMETRY_MIN_VERSION; version <= TELEMETRY_VERSION; version++) {
+        Fixture fixture;
+        makeFixture(fixture, version);
+        std::vector<uint8_t> frame = version == TELEMETRY_VERSION ? currentFrame(fixture) : legacyFrame(version, fixture);
+        TelemetryHeader header;
+        std::vector<SensorData> samples;
+        std::vector<StepSummary> summaries;
+        for (size_t length = 0; length < frame.size(); length++) {
+            std::vector<uint8_t> prefix(frame.begin(), frame.begin() + length);
+            TEST_ASSERT_FALSE(decodeFrame(prefix.data(), prefix.size(), header, samples, summaries));
+        }
+        // A trailing byte is left over rather than ignored
+        frame.push_back(0);
+        TEST_ASSERT_FALSE(decodeFrame(frame.data(), frame.size(), header, samples, summaries));
+    }
+}
+
+static void test_corrupt_frames_refused(void) {
+    Fixture fixture;
+    makeFixture(fixture, TELEMETRY_VERSION);
+    const std::vector<uint8_t> good = currentFrame(fixture);
+    const size_t versionAt = sizeof(TELEMETRY_MAGIC);
+    const size_t firstSampleAt = versionAt + 3 + strlen(TEST_ID) + 8 + 2 + 1 + 2 + 1;
+    TelemetryHeader header;
+    std::vector<SensorData> samples;
+    std::vector<StepSummary> summaries;
+    TEST_ASSERT_TRUE(decodeFrame(good.data(), good.size(), header, samples, summaries));
+
+    std::vector<uint8_t> frame = good;
+    frame[0] = 'X';
+    TEST_ASSERT_FALSE(decodeFrame(frame.data(), frame.size(), header, samples, summaries));
+
+    static const uint8_t BAD_VERSIONS[] = {0, TELEMETRY_VERSION + 1, 0xFF};
+    for (uint8_t version : BAD_VERSIONS) {
+        frame = good;
+        frame[versionAt] = version;
+        TEST_ASSERT_FALSE(decodeFrame(frame.data(), frame.size(), header, samples, summaries));
+    }
+
+    // Test id longer than the rest of a short frame
+    frame.assign(good.begin(), good.begin() + versionAt + 3);
+    frame[versionAt + 2] = 200;
+    frame.resize(frame.size() + 20, 'a');
+    TEST_ASSERT_FALSE(decodeFrame(frame.data(), frame.size(), header, samples, summaries));
+
+    // First sample's channel out of range
+    TEST_ASSERT_EQUAL_UINT8(0, good[firstSampleAt]);
+    frame = good;
+    frame[firstSampleAt] = TELEMETRY_MAX_CHANNELS;
+    TEST_ASSERT_FALSE(decodeFrame(frame.data(), frame.size(), header, samples, summaries));
+
+    // Varint running into a fifth byte with more than the top four bits
+    static const uint8_t OVERLONG[] = {0xFF, 0xFF, 0xFF, 0xFF, 0x1F};
+    frame = good;
+    frame.erase(frame.begin() + firstSampleAt);
+    frame.insert(frame.begin() + firstSampleAt, OVERLONG, OVERLONG + sizeof(OVERLONG));
+    TEST_ASSERT_FALSE(decodeFrame(frame.data(), frame.size(), header, samples, summaries));
+
+    // A missed count flagged but zero, or past a u16
+    static const uint8_t FLAGGED[] = {0, 0, 0, 0, 0, 0, 0, 0, 1};
+    std::vector<uint8_t> sample(FLAGGED, FLAGGED + sizeof(FLAGGED));
+    uint8_t missed[TELEMETRY_MAX_VARINT_BYTES];
+    for (uint32_t count : {0u, (uint32_t)UINT16_MAX + 1}) {
+        frame.assign(good.begin(), good.begin() + firstSampleAt);
+        frame.insert(frame.end(), sample.begin(), sample.end());
+        frame.insert(frame.end(), missed, missed + telemetryWriteVarint(missed, count));
+        TelemetryDecoder decoder(frame.data(), frame.size());
+        SensorData decoded;
+        TEST_ASSERT_TRUE(decoder.readHeader(header));
+        TEST_ASSERT_FALSE(decoder.readSample(decoded));
+    }
+}
+
+// Every single-byte change in every position, to any value: the frame is
+// either refused or decodes within its length, and never reads past it
+static void test_byte_changes_stay_in_bounds(void) {
+    Fixture fixture;
+    makeFixture(fixture, TELEMETRY_VERSION);
+    fixture.samples[0].missed = 3;
+    std::vector<uint8_t> good;
+    telemetryEncodeBatch(TEST_ID, fixture.samples, 8, 0, good, 1, 2, fixture.summaries, 1);
+
+    TelemetryHeader header;
+    std::vector<SensorData> samples;
+    std::vector<StepSummary> summaries;
+    size_t refused = 0;
+    for (size_t at = 0; at < good.size(); at++) {
+        for (int value = 0; value < 256; value++) {
+            if (value == good[at]) {
+                continue;
+            }
+            std::vector<uint8_t> frame = good;
+            frame[at] = (uint8_t)value;
+            if (!decodeFrame(frame.data(), frame.size(), header, samples, summaries)) {
+                refused++;
+            }
+        }
+    }
+    TEST_ASSERT_TRUE(refused > 0);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_current_version_round_trip);
+    RUN_TEST(test_older_versions_decode);
+    RUN_TEST(test_extremes_round_trip);
+    RUN_TEST(test_truncated_frames_refused);
+    RUN_TEST(test_corrupt_frames_refused);
+    RUN_TEST(test_byte_changes_stay_in_bounds);
+    return UNITY_END();
+}
@@ -0,0 +1,346 @@
+// Upload pipeline in virtual time: the sampling ring, loop() filling batches
+// from the uploader's pool and the upload task posting them over a link
+// with a given round trip, retrying and spooling by UploadRetry. Every
+// sample must arrive at 200 ms RTT, through blips and through an outage
+// with a spool, and a post must take no longer than its round trip.
+
+#include <unity.h>
+#include <deque>
+#include <vector>
+#include "../../src/SampleRing.h"
+#include "../../src/UploadCompression.h"
+#include "../../src/UploadRetry.h"
+
+static const size_t BATCH_CAPACITY = 256;        // UPLOAD_BATCH_CAPACITY
+static const size_t BATCH_COUNT = 3;             // UPLOAD_BATCH_COUNT
+static const uint32_t HANDOVER_MS = 2000;        // SEND_INTERVAL_MS
+static const uint32_t SAMPLE_EVERY_MS = 1;       // RIG_DEFAULT_SAMPLE_HZ on one channel
+static const uint32_t BODY_BYTES_PER_SAMPLE = 10;  // Binary frame, 9.4 in the sim benchmark
+static const uint32_t SPOOL_WRITE_MS = 40;       // Appending a batch to flash
+static const uint32_t RUN_MS = 120000;
+static const uint32_t DRAIN_MS = 60000;          // After the last sample, for the spool to empty
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// Round trip and outages of the uplink. A failed attempt takes failMs:
+// about a round trip for a refused or reset connection, near nothing with
+// WiFi down, where the client fails to connect at once.
+struct Link {
+    uint32_t rttMs;
+    uint32_t failMs;
+    uint32_t downAtMs;   // First outage
+    uint32_t downForMs;  // 0 for none
+    uint32_t everyMs;    // Outages repeat this often
+
+    bool up(uint32_t nowMs) const {
+        return downForMs == 0 || nowMs < downAtMs || (nowMs - downAtMs) % everyMs >= downForMs;
+    }
+
+    uint32_t postMs(uint32_t samples) const {
+        return rttMs + (uint32_t)(samples * BODY_BYTES_PER_SAMPLE / COMPRESSION_UPLINK_SEED);
+    }
+};
+
+struct Batch {
+    uint32_t count;
+    uint32_t closedMs;
+};
+
+struct Result {
+    uint32_t produced = 0;
+    uint32_t delivered = 0;
+    uint32_t ringDropped = 0;
+    uint32_t batchesLost = 0;
+    uint32_t retries = 0;
+    uint32_t spooled = 0;
+    uint32_t replayed = 0;
+    uint32_t maxLatencyMs = 0;  // Handover to response, live batches
+    size_t spoolLeft = 0;
+};
+
+static SampleRing<uint32_t, 256> ring;  // SAMPLE_RING_CAPACITY
+
+// BatchUploader::run() and upload() as a state machine stepped each ms
+class UploadTask {
+public:
+    UploadTask(const Link& link, bool spooling, Result& result) : link(link), result(result), spooling(spooling) {
+        retry.setSpooling(spooling);
+        for (size_t i = 0; i < BATCH_COUNT; i++) {
+            freeBatches.push_back(i);
+        }
+    }
+
+    // loop(): take a batch from the pool, or nullptr while every one is busy
+    Batch* acquire() {
+        if (freeBatches.empty()) {
+            return nullptr;
+        }
+        Batch* batch = &batches[freeBatches.front()];
+        freeBatches.pop_front();
+        batch->count = 0;
+        return batch;
+    }
+
+    void submit(Batch* batch, uint32_t nowMs) {
+        batch->closedMs = nowMs;
+        if (batch->count == 0) {
+            freeBatches.push_back(batch - batches);
+        } else {
+            pendingBatches.push_back(batch - batches);
+        }
+    }
+
+    void step(uint32_t nowMs) {
+        for (;;) {
+            if (phase != Phase::Idle && nowMs < untilMs) {
+                return;
+            }
+            switch (phase) {
+            case Phase::Idle:
+                if (!pendingBatches.empty()) {
+                    current = pendingBatches.front();
+                    pendingBatches.pop_front();
+                    maxAttempts = retry.attempts(nowMs);
+                    attempt = 1;
+                    if (maxAttempts == 0) {
+                        startSpooling(nowMs);
+                    } else {
+                        startPost(nowMs);
+                    }
+                } else if (retry.replayDue(nowMs, false) && !retry.isDown() && !spool.empty()) {
+                    attemptOk = link.up(nowMs);
+                    phase = Phase::Replaying;
+                    untilMs = nowMs + (attemptOk ? link.postMs(spool.front()) : link.failMs);
+                }
+                return;
+            case Phase::Posting:
+                if (attemptOk) {
+                    retry.succeeded();
+                    uint32_t latency = nowMs - batches[current].closedMs;
+                    result.maxLatencyMs = latency > result.maxLatencyMs ? latency : result.maxLatencyMs;
+                    result.delivered += batches[current].count;
+                    release();
+                } else if (retry.retryAfter(attempt, maxAttempts, !pendingBatches.empty())) {
+                    result.retries++;
+                    phase = Phase::Backoff;
+                    untilMs = nowMs + UploadRetry::backoffMs(attempt);
+                } else {
+                    retry.failed(nowMs);
+                    if (spooling) {
+                        startSpooling(nowMs);
+                    } else {
+                        result.batchesLost += batches[current].count;
+                        release();
+                    }
+                }
+                break;
+            case Phase::Backoff:
+                attempt++;
+                startPost(nowMs);
+                break;
+            case Phase::Spooling:
+                spool.push_back(batches[current].count);
+                result.spooled++;
+                release();
+                break;
+            case Phase::Replaying:
+                if (attemptOk) {
+                    result.delivered += spool.front();
+                    result.replayed++;
+                    spool.pop_front();
+                } else {
+                    retry.failed(nowMs);
+                }
+                phase = Phase::Idle;
+                break;
+            }
+        }
+    }
+
+    size_t spoolLeft() const { return spool.size(); }
+
+private:
+    enum class Phase { Idle, Posting, Backoff, Spooling, Replaying };
+
+    void startPost(uint32_t nowMs) {
+        attemptOk = link.up(nowMs);
+        phase = Phase::Posting;
+        untilMs = nowMs + (attemptOk ? link.postMs(batches[current].count) : link.failMs);
+    }
+
+    void startSpooling(uint32_t nowMs) {
+        phase = Phase::Spooling;
+        untilMs = nowMs + SPOOL_WRITE_MS;
+    }
+
+    void release() {
+        freeBatches.push_back(current);
+        phase = Phase::Idle;
+    }
+
+    const Link& link;
+    Result& result;
+    UploadRetry retry;
+    bool spooling;
+    Batch batches[BATCH_COUNT];
+    std::deque<size_t> freeBatches;
+    std::deque<size_t> pendingBatches;
+    std::deque<uint32_t> spool;  // Samples per spooled batch
+    Phase phase = Phase::Idle;
+    uint32_t untilMs = 0;
+    size_t current = 0;
+    uint8_t attempt = 0;
+    uint8_t maxAttempts = 0;
+    bool attemptOk = false;
+};
+
+// Sampling for RUN_MS, then DRAIN_MS more for the pipeline to empty
+static Result run(const Link& link, bool spooling) {
+    Result result;
+    UploadTask task(link, spooling, result);
+    Batch* batch = nullptr;
+    uint32_t lastHandoverMs = 0;
+    ring.clear();
+    ring.resetCounters();
+
+    for (uint32_t now = 0; now < RUN_MS + DRAIN_MS; now++) {
+        if (now < RUN_MS && now % SAMPLE_EVERY_MS == 0) {
+            ring.push(result.produced++);
+        }
+
+        // drainSampleRing() and the handover in loop()
+        if (batch == nullptr) {
+            batch = task.acquire();
+        }
+        uint32_t sample;
+        while (batch != nullptr && batch->count < BATCH_CAPACITY && ring.pop(sample)) {
+            batch->count++;
+        }
+        if ((batch != nullptr && batch->count >= BATCH_CAPACITY) || now - lastHandoverMs >= HANDOVER_MS) {
+            if (batch != nullptr) {
+                task.submit(batch, now);
+                batch = nullptr;
+            }
+            lastHandoverMs = now;
+        }
+
+        task.step(now);
+    }
+    result.ringDropped = ring.getDropped();
+    result.spoolLeft = task.spoolLeft();
+    return result;
+}
+
+static void assertNoLoss(const Result& result) {
+    TEST_ASSERT_EQUAL_UINT32(RUN_MS / SAMPLE_EVERY_MS, result.produced);
+    TEST_ASSERT_EQUAL_UINT32(0, result.ringDropped);
+    TEST_ASSERT_EQUAL_UINT32(0, result.batchesLost);
+    TEST_ASSERT_EQUAL_UINT32(0, result.spoolLeft);
+    TEST_ASSERT_EQUAL_UINT32(result.produced, result.delivered);
+}
+
+static void test_backoff_doubles_to_cap(void) {
+    static const uint32_t EXPECTED[] = {250, 500, 1000, 2000, 4000, 4000, 4000};
+    for (uint8_t attempt = 1; attempt <= 7; attempt++) {
+        TEST_ASSERT_EQUAL_UINT32(EXPECTED[attempt - 1], UploadRetry::backoffMs(attempt));
+    }
+    UploadRetry retry;
+    TEST_ASSERT_TRUE(retry.retryAfter(UPLOAD_MAX_ATTEMPTS - 1, UPLOAD_MAX_ATTEMPTS, true));
+    TEST_ASSERT_FALSE(retry.retryAfter(UPLOAD_MAX_ATTEMPTS, UPLOAD_MAX_ATTEMPTS, false));
+}
+
+// Without a spool every batch gets all its attempts; with one, a down
+// uplink is probed once per interval and batches waiting behind a failed
+// one cut its retries short
+static void test_down_uplink_probed_with_spool(void) {
+    UploadRetry retry;
+    retry.failed(1000);
+    TEST_ASSERT_TRUE(retry.isDown());
+    TEST_ASSERT_EQUAL_UINT8(UPLOAD_MAX_ATTEMPTS, retry.attempts(1001));
+    TEST_ASSERT_TRUE(retry.retryAfter(1, UPLOAD_MAX_ATTEMPTS, true));
+
+    retry.setSpooling(true);
+    TEST_ASSERT_EQUAL_UINT8(0, retry.attempts(1001));
+    TEST_ASSERT_EQUAL_UINT8(0, retry.attempts(1000 + UPLOAD_PROBE_INTERVAL_MS - 1));
+    TEST_ASSERT_EQUAL_UINT8(1, retry.attempts(1000 + UPLOAD_PROBE_INTERVAL_MS));
+    TEST_ASSERT_FALSE(retry.retryAfter(1, UPLOAD_MAX_ATTEMPTS, true));
+    TEST_ASSERT_TRUE(retry.retryAfter(1, UPLOAD_MAX_ATTEMPTS, false));
+
+    retry.succeeded();
+    TEST_ASSERT_FALSE(retry.isDown());
+    TEST_ASSERT_EQUAL_UINT8(UPLOAD_MAX_ATTEMPTS, retry.attempts(1001));
+
+    // millis() wraps after 49 days; the probe is still due on time
+    retry.failed(0xFFFFF000u);
+    TEST_ASSERT_EQUAL_UINT8(0, retry.attempts(0xFFFFF001u));
+    TEST_ASSERT_EQUAL_UINT8(1, retry.attempts(0xFFFFF000u + UPLOAD_PROBE_INTERVAL_MS));
+}
+
+static void test_replay_waits_for_live_batches(void) {
+    UploadRetry retry;
+    TEST_ASSERT_FALSE(retry.replayDue(SPOOL_REPLAY_INTERVAL_MS - 1, false));
+    TEST_ASSERT_FALSE(retry.replayDue(SPOOL_REPLAY_INTERVAL_MS, true));
+    TEST_ASSERT_TRUE(retry.replayDue(SPOOL_REPLAY_INTERVAL_MS, false));
+    TEST_ASSERT_FALSE(retry.replayDue(2 * SPOOL_REPLAY_INTERVAL_MS - 1, false));
+    TEST_ASSERT_TRUE(retry.replayDue(2 * SPOOL_REPLAY_INTERVAL_MS, false));
+}
+
+// A batch fills every 256 ms and takes a round trip plus 25 ms to send, so
+// each one goes out alone and its latency is exactly that
+static void test_no_loss_at_200ms_rtt(void) {
+    Link link = {200, 200, 0, 0, 1};
+    Result result = run(link, false);
+    assertNoLoss(result);
+    TEST_ASSERT_EQUAL_UINT32(0, result.retries);
+    TEST_ASSERT_EQUAL_UINT32(link.postMs(BATCH_CAPACITY), result.maxLatencyMs);
+}
+
+// The pipeline keeps up until a post takes longer than a batch takes to fill
+static void test_rtt_headroom(void) {
+    Link link = {230, 230, 0, 0, 1};
+    assertNoLoss(run(link, false));
+
+    link.rttMs = 260;
+    Result result = run(link, false);
+    TEST_ASSERT_TRUE(result.ringDropped > 0);
+    TEST_ASSERT_EQUAL_UINT32(result.produced, result.delivered + result.ringDropped);
+}
+
+// Connections reset for 400 ms every 10 s: the failing batch is retried
+// while the pool and the ring, about a second of samples, hold the ones
+// behind it
+static void test_blips_retried_without_loss(void) {
+    Link link = {200, 200, 5000, 400, 10000};
+    Result result = run(link, false);
+    assertNoLoss(result);
+    TEST_ASSERT_TRUE(result.retries >= RUN_MS / link.everyMs);
+    TEST_ASSERT_EQUAL_UINT32(0, result.spooled);
+}
+
+// WiFi down for 30 s with a spool: batches go to flash instead of backing
+// up, and are replayed between live batches once the uplink is back
+static void test_outage_spooled_and_replayed(void) {
+    Link link = {200, 10, 20000, 30000, RUN_MS + DRAIN_MS};
+    Result result = run(link, true);
+    assertNoLoss(result);
+    TEST_ASSERT_TRUE(result.spooled >= 30000 / BATCH_CAPACITY);
+    TEST_ASSERT_EQUAL_UINT32(result.spooled, result.replayed);
+
+    // Without one the first failed batch holds the pool through its
+    // retries, and the samples behind it overflow the ring
+    result = run(link, false);
+    TEST_ASSERT_TRUE(result.ringDropped > 0);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_backoff_doubles_to_cap);
+    RUN_TEST(test_down_uplink_probed_with_spool);
+    RUN_TEST(test_replay_waits_for_live_batches);
+    RUN_TEST(test_no_loss_at_200ms_rtt);
+    RUN_TEST(test_rtt_headroom);
+    RUN_TEST(test_blips_retried_without_loss);
+    RUN_TEST(test_outage_spooled_and_replayed);
+    return UNITY_END();
+}